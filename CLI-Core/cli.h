@@ -12,8 +12,15 @@
 #include <sstream>
 #include "core/core.h"
 #include "core/debugger/debugger.h";
+#include "core/debugger/output_pipe/output_pipe.h"
+#include "core/debugger/modules.h"
+#include "core/disasm/x86_decoder.h"
+#include "core/disasm/xref.h"
 #include "core/mapper/mapper.h"
 #include "core/scanner/scanner.h"
+#include "core/scanner/scan_stats.h"
+#include "core/scanner/kernel_counters.h"
+#include "core/trace_recorder/trace_recorder.h"
 
 namespace cli {
     using command_handler = std::function<void(const std::vector<std::string>&)>;
@@ -40,6 +47,56 @@ R"""(
       debugger attach     Attach debugger to current process
       debugger detach     Detach debugger from current process
       debugger status     Show current debugger state
+      debugger log        Show log queue counters (queued, written, dropped)
+      debugger log policy <drop-oldest|drop-new|block>
+                          Set what happens when the log queue is full
+      debugger log mode <text|binary>
+                          Send formatted lines or binary records to the console
+                          (takes effect on the next debugger attach)
+      debugger log flush <kb> <us>
+                          Batch log writes until <kb> KB or <us> microseconds
+                          (1-255 KB, up to 1000000 us; default 64 2000,
+                          0 us = flush when the queue drains)
+      debugger log transport <pipe|shm>
+                          Transport to the console (takes effect on the next debugger attach)
+      debugger log level <debugger|scanner|core|all> <trace|debug|info|warn|error|off>
+                          Lowest level logged for a category (default info)
+      debugger bp add <address> [address...]
+                          Set int3 breakpoints (hex addresses); hits are counted
+                          and the target continues
+      debugger bp remove <address> [address...]
+                          Remove breakpoints and restore the original bytes
+      debugger bp cond <address> [expression]
+                          Count hits only when expression holds, e.g.
+                          "rcx == 0x1234 && [rdx+8] > 100" (registers, numbers,
+                          [qword], byte/word/dword[...], C operators); compiled
+                          once and evaluated on the debugger thread at each hit.
+                          No expression removes the condition
+      debugger bp list    Show breakpoints, hit counts and conditions
+      debugger bp clear   Remove all breakpoints
+      debugger hw set <address> <x|w|rw> [1|2|4|8]
+                          Set a debug-register breakpoint on every thread (execute,
+                          write or read-write, length in bytes); up to 4
+      debugger hw clear <slot|all>
+                          Clear a debug-register slot (0-3) or all of them
+      debugger hw list    Show the debug-register slots and hit counts
+      debugger watch add <address> <size>
+                          Watch a range of any size (hex address and size) by
+                          guarding its pages; every access to those pages faults,
+                          hits outside the range count as false hits of the page
+      debugger watch remove <id>
+                          Remove a watch and unguard pages no other watch covers
+      debugger watch list Show watches, and per page the hits, false hits and
+                          the stall each fault costs the target
+      debugger watch clear
+                          Remove all watches
+      debugger modules [refresh]
+                          List the target's modules. While attached the map is
+                          kept from load and unload events; 'refresh' enumerates
+                          them again
+      debugger stack <tid>
+                          Suspend a thread and walk its stack with the modules'
+                          unwind tables (.pdata/.xdata, .eh_frame)
 
     DRIVER MANAGEMENT
     ---------------
@@ -49,6 +106,79 @@ R"""(
       mapper load           Load the specified driver into the system
       mapper unload         Unload the currently loaded driver
 
+    DIAGNOSTICS
+    -----------
+      stats [json]        Show scanner counters and phase timings for the last
+                          command (regions, bytes read, failed reads, syscalls,
+                          compare ns/byte, merge time, peak candidate memory)
+      stats hw <on|off>   Wrap the search/filter kernels in hardware counters
+                          (cycles/byte, IPC, LLC and branch misses where the
+                          host exposes them) and append them to 'stats'
+      trace start <file>  Start recording scanner and debugger thread activity
+      trace stop          Stop recording and write Chrome trace-event JSON
+                          (open in chrome://tracing or ui.perfetto.dev)
+      trace writes <address> [seconds]
+      trace access <address> [seconds]
+                          Count which instructions write (or read/write) an address
+                          with a data breakpoint for [seconds] (default 10), then
+                          list them as module+offset
+      trace steps <tid> <count|until <address>> <file> [regs]
+                          Single-step a thread for <count> instructions or until it
+                          reaches <address>, recording every rip (and with 'regs' the
+                          registers that changed) into a 64 MB ring file that keeps
+                          the latest steps
+      trace steps [stop]  Show the step count, or stop stepping
+      trace read <file> [address]
+                          Which instructions a step trace executed and how often,
+                          or how often one address did
+      coverage start <module> [blocks file]
+                          Put a one-shot int3 on every block of a module (the
+                          listed hex offsets, or every function it unwinds)
+      coverage status     Show blocks, blocks hit and int3s still armed
+      coverage stop       Remove the int3s not hit yet
+      coverage save <file>
+                          Write the blocks hit to a coverage file
+      coverage diff <a> <b>
+                          Blocks hit by only one of two runs, as module+offset
+      profile <seconds> <hz> [stacks [folded file]]
+                          Sample every thread of the target <hz> times a second:
+                          hottest modules and functions, with 'stacks' walked
+                          call stacks written as folded stacks
+                          (flamegraph.pl, speedscope)
+      events              Show how many debug events the journal recorded and keeps
+      events count [seconds]
+                          Events of the last [seconds] (default: all kept) per
+                          type and per exception code
+      events top [seconds] [exception code]
+                          Exception sites (code and module+offset) by count,
+                          e.g. 'events top 60 c0000005'
+      events since <seconds>
+                          List the events of the last <seconds>, with the text
+                          of debug strings
+      events clear        Empty the journal
+      exceptions [top <n>]
+                          Exception counts per code and address (first and second
+                          chance), most first, with each code's policy
+      exceptions <on|off> Statistics mode: exceptions are only counted and resumed
+                          by their code's policy (no logging or handlers), for
+                          targets that raise thousands a second
+      exceptions policy <code> <pass|continue|dispatch>
+                          First chances of <code> go to the target, are continued
+                          as handled, or go through the handlers as usual
+                          (breakpoints, single steps, guard pages by default)
+      exceptions clear    Reset the counts
+      disasm <address> [count]
+                          Disassemble [count] (default 16) instructions of the
+                          target at a hex address, Intel syntax, with branch and
+                          rip-relative targets as module+offset
+      xref build <module> Index every direct call, jump and rip-relative operand
+                          target of a module's code, decoded on all cores; the
+                          index is cached in the "xref" folder per build of the
+                          module and reused by later sessions
+      xref to <address> [size]
+                          Instructions that call, jump to or reference <address>
+                          (or the [size] bytes from it, hex), as module+offset
+
     SYSTEM COMMANDS
     -------------
       run <command>       Execute system command (via std::system)
@@ -108,6 +238,26 @@ R"""(
             return tokens;
         }
 
+        static bool parse_address(const std::string& text, uint64_t& address) {
+            try {
+                size_t used = 0;
+                address = std::stoull(text, &used, 16);
+                return used == text.size();
+            }
+            catch (...) {
+                return false;
+            }
+        }
+
+        // Decimal digits only: stoul alone takes "-1" and wraps it.
+        static bool parse_count(const std::string& text, unsigned long& value) {
+            if (text.empty() || text.size() > 9 || text.find_first_not_of("0123456789") != std::string::npos) {
+                return false;
+            }
+            value = std::stoul(text);
+            return true;
+        }
+
         std::string get_welcome_message() {
             char username[UNLEN + 1];
             DWORD username_len = UNLEN + 1;
@@ -223,6 +373,378 @@ R"""(
                     return;
                 }
 
+                if (args[0] == "log") {
+                    if (args.size() == 3 && args[1] == "policy") {
+                        if (args[2] == "drop-oldest") {
+                            debug::set_overflow_policy(debug::OverflowPolicy::DROP_OLDEST);
+                        }
+                        else if (args[2] == "drop-new") {
+                            debug::set_overflow_policy(debug::OverflowPolicy::DROP_NEW);
+                        }
+                        else if (args[2] == "block") {
+                            debug::set_overflow_policy(debug::OverflowPolicy::BLOCK);
+                        }
+                        else {
+                            std::cout << "Invalid usage!\ndebugger log policy [drop-oldest|drop-new|block]\n";
+                            return;
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    if (args.size() == 4 && args[1] == "flush") {
+                        // A batch may run one record past <kb> and still has to fit in one frame.
+                        const unsigned long max_kb_limit = static_cast<unsigned long>(debug::LOG_MAX_FRAME_SIZE / 1024 - 1);
+                        const unsigned long max_us_limit = 1000000;
+                        unsigned long max_kb = 0;
+                        unsigned long max_us = 0;
+                        if (!parse_count(args[2], max_kb) || !parse_count(args[3], max_us) || max_kb == 0 || max_kb > max_kb_limit ||
+                            max_us > max_us_limit) {
+                            std::cout << "Invalid usage!\ndebugger log flush <kb 1-" << max_kb_limit << "> <us 0-" << max_us_limit << ">\n";
+                            return;
+                        }
+                        debug::set_flush_policy(static_cast<uint32_t>(max_kb * 1024), static_cast<uint32_t>(max_us));
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    if (args.size() == 3 && args[1] == "transport") {
+                        debug::TransportKind kind;
+                        if (!debug::parse_transport_kind(args[2], kind) || !debug::transport_supported(kind)) {
+                            std::cout << "Invalid usage!\ndebugger log transport [pipe|shm]\n";
+                            return;
+                        }
+                        debug::set_transport(kind);
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    if (args.size() == 4 && args[1] == "level") {
+                        debug::LogLevel level;
+                        debug::LogCategory category = debug::LogCategory::COUNT;
+                        if (!debug::parse_log_level(args[3], level) ||
+                            (args[2] != "all" && !debug::parse_log_category(args[2], category))) {
+                            std::cout << "Invalid usage!\ndebugger log level [debugger|scanner|core|all] [trace|debug|info|warn|error|off]\n";
+                            return;
+                        }
+                        for (int i = 0; i < static_cast<int>(debug::LogCategory::COUNT); i++) {
+                            if (category == debug::LogCategory::COUNT || category == static_cast<debug::LogCategory>(i)) {
+                                debug::set_log_level(static_cast<debug::LogCategory>(i), level);
+                            }
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    if (args.size() == 3 && args[1] == "mode") {
+                        if (args[2] == "text") {
+                            debug::set_wire_mode(debug::WireMode::TEXT);
+                        }
+                        else if (args[2] == "binary") {
+                            debug::set_wire_mode(debug::WireMode::BINARY);
+                        }
+                        else {
+                            std::cout << "Invalid usage!\ndebugger log mode [text|binary]\n";
+                            return;
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    debug::LogStats log_stats = debug::get_stats();
+                    std::cout << "Policy: " << debug::overflow_policy_name(debug::Debugger::instance().get_overflow_policy())
+                              << " Mode: " << (debug::Debugger::instance().get_wire_mode() == debug::WireMode::BINARY ? "binary" : "text")
+                              << " Transport: " << debug::transport_kind_name(debug::Debugger::instance().get_transport()) << "\n"
+                              << "Queued: " << log_stats.enqueued << " (deferred " << log_stats.deferred << ") Written: " << log_stats.written
+                              << " Write calls: " << log_stats.write_calls << "\n"
+                              << "Messages per write: "
+                              << (log_stats.write_calls ? static_cast<double>(log_stats.written) / log_stats.write_calls : 0.0)
+                              << " Bytes: " << log_stats.bytes_written
+                              << " Flushes: " << log_stats.flushes_size << " size, " << log_stats.flushes_timer << " timer\n"
+                              << "Dropped: " << log_stats.dropped_oldest << " oldest, " << log_stats.dropped_new << " new"
+                              << " Blocked producers: " << log_stats.blocked
+                              << " Truncated: " << log_stats.truncated << "\n"
+                              << "Credit waits: " << log_stats.credit_waits << " (" << log_stats.credit_wait_ns / 1000000 << " ms)\n"
+                              << "Levels: debugger " << debug::log_level_name(debug::LogFilter::get_level(debug::LogCategory::DEBUGGER))
+                              << ", scanner " << debug::log_level_name(debug::LogFilter::get_level(debug::LogCategory::SCANNER))
+                              << ", core " << debug::log_level_name(debug::LogFilter::get_level(debug::LogCategory::CORE)) << "\n";
+                    return;
+                }
+
+                if (args[0] == "bp") {
+                    if (args.size() == 2 && args[1] == "list") {
+                        std::vector<breakpoint> entries = core_debugger::instance()->get_breakpoints()->list();
+                        std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                        module_resolver resolver(*modules);
+                        for (const auto& entry : entries) {
+                            const module_range* module = resolver.find(entry.address);
+                            std::cout << "[0x" << std::hex << std::uppercase << entry.address << "] ";
+                            if (module) {
+                                std::cout << module->name << "+0x" << entry.address - module->base << " ";
+                            }
+                            std::cout << std::dec << std::nouppercase << "hits: " << entry.hits << (entry.armed ? "" : " (disarmed)");
+                            if (entry.conditional) {
+                                std::cout << " misses: " << entry.misses << " if "
+                                          << core_debugger::instance()->get_breakpoints()->get_condition(entry.address);
+                            }
+                            std::cout << "\n";
+                        }
+                        std::cout << "Breakpoints: " << entries.size()
+                                  << " Total hits: " << core_debugger::instance()->get_breakpoints()->get_total_hits() << "\n";
+                        return;
+                    }
+
+                    if (args.size() == 2 && args[1] == "clear") {
+                        auto removed = std::make_shared<size_t>(0);
+                        if (!core_debugger::instance()->execute([removed] () -> bool {
+                            *removed = core_debugger::instance()->get_breakpoints()->clear();
+                            return true;
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Removed " << *removed << " breakpoints.\n";
+                        return;
+                    }
+
+                    if (args.size() >= 3 && (args[1] == "add" || args[1] == "remove")) {
+                        std::vector<uint64_t> addresses;
+                        for (size_t i = 2; i < args.size(); i++) {
+                            uint64_t address = 0;
+                            if (!parse_address(args[i], address)) {
+                                std::cout << "Invalid usage!\nInvalid address: " << args[i] << "\n";
+                                return;
+                            }
+                            addresses.push_back(address);
+                        }
+
+                        bool add = args[1] == "add";
+                        auto count = std::make_shared<size_t>(0);
+                        if (!core_debugger::instance()->execute([addresses, add, count] () -> bool {
+                            breakpoint_manager* breakpoints = core_debugger::instance()->get_breakpoints();
+                            *count = add ? breakpoints->add(addresses) : breakpoints->remove(addresses);
+                            return true;
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << (add ? "Set " : "Removed ") << *count << " of " << addresses.size() << " breakpoints.\n";
+                        return;
+                    }
+
+                    if (args.size() >= 3 && args[1] == "cond") {
+                        uint64_t address = 0;
+                        if (!parse_address(args[2], address)) {
+                            std::cout << "Invalid usage!\ndebugger bp cond <address> [expression]\n";
+                            return;
+                        }
+                        std::string expression;
+                        for (size_t i = 3; i < args.size(); i++) {
+                            expression += (i > 3 ? " " : "") + args[i];
+                        }
+                        auto error = std::make_shared<std::string>();
+                        if (!core_debugger::instance()->execute([address, expression, error] () -> bool {
+                            return core_debugger::instance()->get_breakpoints()->set_condition(address, expression, *error);
+                        })) {
+                            std::cout << "Failed." << (error->empty() ? "" : " " + *error) << "\n";
+                            return;
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    std::cout << "Invalid usage!\ndebugger bp [add|remove] <address> [address...]\ndebugger bp cond <address> [expression]\ndebugger bp [list|clear]\n";
+                    return;
+                }
+
+                if (args[0] == "hw") {
+                    if (args.size() == 2 && args[1] == "list") {
+                        std::vector<hardware_breakpoint> slots = core_debugger::instance()->get_hardware_breakpoints()->list();
+                        for (size_t i = 0; i < slots.size(); i++) {
+                            if (!slots[i].active) {
+                                std::cout << "Dr" << i << ": free\n";
+                                continue;
+                            }
+                            std::cout << "Dr" << i << ": [0x" << std::hex << std::uppercase << slots[i].address << std::dec << std::nouppercase
+                                      << "] " << hardware_condition_name(slots[i].condition) << " " << static_cast<int>(slots[i].length)
+                                      << " hits: " << slots[i].hits << "\n";
+                        }
+                        return;
+                    }
+
+                    if ((args.size() == 4 || args.size() == 5) && args[1] == "set") {
+                        uint64_t address = 0;
+                        hardware_condition condition;
+                        int length = 1;
+                        try {
+                            length = args.size() == 5 ? std::stoi(args[4]) : 1;
+                        }
+                        catch (...) {
+                            length = 0;
+                        }
+                        if (!parse_address(args[2], address) || !parse_hardware_condition(args[3], condition) ||
+                            (length != 1 && length != 2 && length != 4 && length != 8)) {
+                            std::cout << "Invalid usage!\ndebugger hw set <address> [x|w|rw] [1|2|4|8]\n";
+                            return;
+                        }
+                        auto slot = std::make_shared<int>(-1);
+                        if (!core_debugger::instance()->execute([address, condition, length, slot] () -> bool {
+                            *slot = core_debugger::instance()->get_hardware_breakpoints()->set(address, condition, static_cast<uint8_t>(length));
+                            return *slot >= 0;
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Success. Slot Dr" << *slot << "\n";
+                        return;
+                    }
+
+                    if (args.size() == 3 && args[1] == "clear") {
+                        int slot = -1;
+                        if (args[2] != "all") {
+                            try {
+                                slot = std::stoi(args[2]);
+                            }
+                            catch (...) {
+                                std::cout << "Invalid usage!\ndebugger hw clear <slot|all>\n";
+                                return;
+                            }
+                        }
+                        if (!core_debugger::instance()->execute([slot] () -> bool {
+                            if (slot < 0) {
+                                core_debugger::instance()->get_hardware_breakpoints()->clear_all();
+                                return true;
+                            }
+                            return core_debugger::instance()->get_hardware_breakpoints()->clear(slot);
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    std::cout << "Invalid usage!\ndebugger hw set <address> [x|w|rw] [1|2|4|8]\ndebugger hw [list|clear <slot|all>]\n";
+                    return;
+                }
+
+                if (args[0] == "watch") {
+                    if (args.size() == 2 && args[1] == "list") {
+                        page_watch_manager* watches = core_debugger::instance()->get_page_watches();
+                        for (const auto& watch : watches->list()) {
+                            std::cout << "#" << watch.id << " [0x" << std::hex << std::uppercase << watch.address
+                                      << " - 0x" << watch.address + watch.size << std::dec << std::nouppercase
+                                      << ") hits: " << watch.hits << "\n";
+                        }
+                        for (const auto& page : watches->page_stats()) {
+                            uint64_t faults = page.hits + page.false_hits;
+                            std::cout << "Page 0x" << std::hex << std::uppercase << page.page << std::dec << std::nouppercase
+                                      << " hits: " << page.hits << " false hits: " << page.false_hits
+                                      << " (" << (faults ? page.false_hits * 100 / faults : 0) << "%)"
+                                      << " stall: " << (faults ? page.stall_ns / faults / 1000 : 0) << " us/fault\n";
+                        }
+                        return;
+                    }
+
+                    if (args.size() == 4 && args[1] == "add") {
+                        uint64_t address = 0;
+                        uint64_t size = 0;
+                        if (!parse_address(args[2], address) || !parse_address(args[3], size) || size == 0) {
+                            std::cout << "Invalid usage!\ndebugger watch add <address> <size>\n";
+                            return;
+                        }
+                        auto id = std::make_shared<uint32_t>(0);
+                        if (!core_debugger::instance()->execute([address, size, id] () -> bool {
+                            *id = core_debugger::instance()->get_page_watches()->add(address, size);
+                            return *id != 0;
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Success. Watch #" << *id << "\n";
+                        return;
+                    }
+
+                    if ((args.size() == 3 && args[1] == "remove") || (args.size() == 2 && args[1] == "clear")) {
+                        uint32_t id = 0;
+                        if (args[1] == "remove") {
+                            try {
+                                id = static_cast<uint32_t>(std::stoul(args[2]));
+                            }
+                            catch (...) {
+                                std::cout << "Invalid usage!\ndebugger watch remove <id>\n";
+                                return;
+                            }
+                        }
+                        if (!core_debugger::instance()->execute([id] () -> bool {
+                            if (!id) {
+                                core_debugger::instance()->get_page_watches()->clear();
+                                return true;
+                            }
+                            return core_debugger::instance()->get_page_watches()->remove(id);
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Success.\n";
+                        return;
+                    }
+
+                    std::cout << "Invalid usage!\ndebugger watch add <address> <size>\ndebugger watch [remove <id>|list|clear]\n";
+                    return;
+                }
+
+                if (args[0] == "modules" && (args.size() == 1 || (args.size() == 2 && args[1] == "refresh"))) {
+                    module_map* map = core_debugger::instance()->get_module_map();
+                    if (args.size() == 2 && !core_debugger::instance()->execute([map] () -> bool {
+                        return map->refresh();
+                    })) {
+                        std::cout << "Failed. Is the debugger attached?\n";
+                        return;
+                    }
+                    std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                    for (const module_range& module : *modules) {
+                        std::cout << "0x" << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << module.base
+                                  << " - 0x" << std::setw(16) << module.base + module.size << std::setfill(' ') << std::dec << std::nouppercase
+                                  << "  " << module.name << "\n";
+                    }
+                    std::cout << "Modules: " << modules->size() << (map->get_pid() ? " (kept from debug events)" : " (enumerated)") << "\n";
+                    return;
+                }
+
+                if (args[0] == "stack" && args.size() == 2) {
+                    uint32_t tid = 0;
+                    try {
+                        tid = static_cast<uint32_t>(std::stoul(args[1]));
+                    }
+                    catch (...) {
+                        std::cout << "Invalid usage!\ndebugger stack <tid>\n";
+                        return;
+                    }
+                    auto frames = std::make_shared<std::vector<uint64_t>>(STACK_WALK_MAX_FRAMES);
+                    auto modules = std::make_shared<std::vector<module_range>>();
+                    if (!core_debugger::instance()->execute([tid, frames, modules] () -> bool {
+                        core_debugger* debugger = core_debugger::instance();
+                        stack_walker* walker = debugger->get_stack_walker();
+                        walker->set_modules(*debugger->get_modules(core::core::instance()->get_pid()));
+                        *modules = walker->get_modules();
+                        size_t count = 0;
+                        debugger->get_event_source()->sample_threads(&tid, 1, [&] (size_t, const thread_registers& registers) {
+                            count = walker->walk(registers, frames->data(), frames->size());
+                        });
+                        frames->resize(count);
+                        return count != 0;
+                    })) {
+                        std::cout << "Failed. Is the debugger attached and the thread known?\n";
+                        return;
+                    }
+                    for (size_t i = 0; i < frames->size(); i++) {
+                        std::cout << "#" << std::setw(3) << std::left << i << std::right << " " << format_address(*modules, (*frames)[i])
+                                  << " [0x" << std::hex << std::uppercase << (*frames)[i] << std::dec << std::nouppercase << "]\n";
+                    }
+                    return;
+                }
+
                 std::cout << "Ivalid usage.\nCheck [help]\n";
             };
             commands["mapper"] = [this] (const std::vector<std::string>& args) -> void {
@@ -271,7 +793,7 @@ R"""(
 
                 if (args.size() == 1) {
                     if (args[0] == "print") {
-                        scanner->print_scanned_ints();
+                        scanner->print_scanned_ints(*core_debugger::instance()->get_modules(core->get_pid()));
                     }
                     return;
                 }
@@ -285,7 +807,7 @@ R"""(
                         int scanned_count = scanner->get_scanned_count();
                         std::cout << "Found " << scanned_count << " values\n";
                         if (scanned_count < 250) {
-                            scanner->print_scanned_ints();
+                            scanner->print_scanned_ints(*core_debugger::instance()->get_modules(core->get_pid()));
                         }
                         return;
                     }
@@ -297,15 +819,738 @@ R"""(
                         int scanned_count = scanner->get_scanned_count();
                         std::cout << "Found " << scanned_count << " values\n";
                         if (scanned_count < 250) {
-                            scanner->print_scanned_ints();
+                            scanner->print_scanned_ints(*core_debugger::instance()->get_modules(core->get_pid()));
+                        }
+                        return;
+                    }
+                }
+
+                std::cout << "Invalid usage!\nCheck [help]\n";
+                return;
+            };
+
+            commands["stats"] = [this] (const std::vector<std::string>& args) -> void {
+                if (args.empty()) {
+                    scan_stats::instance()->print(false);
+                    return;
+                }
+
+                if (args[0] == "json") {
+                    scan_stats::instance()->print(true);
+                    return;
+                }
+
+                if (args[0] == "hw" && args.size() == 2) {
+                    if (args[1] == "on" || args[1] == "off") {
+                        kernel_profiler::enabled = args[1] == "on";
+                        std::cout << "Success.\n";
+                        return;
+                    }
+                }
+
+                std::cout << "Invalid usage!\nstats [json]\nstats hw [on|off]\n";
+            };
+
+            commands["trace"] = [this] (const std::vector<std::string>& args) -> void {
+                if (args.empty() || args[0].empty()) {
+                    std::cout << "Invalid usage!\nCheck [help]\n";
+                    return;
+                }
+
+                if (args[0] == "start") {
+                    if (args.size() < 2 || args[1].empty()) {
+                        std::cout << "Invalid usage!\ntrace start [file]\n";
+                        return;
+                    }
+                    if (!trace_recorder::instance()->start(args[1])) {
+                        std::cout << "Failed.\n";
+                        return;
+                    }
+                    std::cout << "Success.\n";
+                    return;
+                }
+
+                if (args[0] == "stop") {
+                    if (!trace_recorder::instance()->stop()) {
+                        std::cout << "Failed.\n";
+                    }
+                    return;
+                }
+
+                if ((args[0] == "writes" || args[0] == "access") && (args.size() == 2 || args.size() == 3)) {
+                    uint64_t address = 0;
+                    int seconds = 10;
+                    try {
+                        seconds = args.size() == 3 ? std::stoi(args[2]) : seconds;
+                    }
+                    catch (...) {
+                        seconds = 0;
+                    }
+                    if (!parse_address(args[1], address) || seconds <= 0) {
+                        std::cout << "Invalid usage!\ntrace [writes|access] <address> [seconds]\n";
+                        return;
+                    }
+                    hardware_condition condition = args[0] == "writes" ? hardware_condition::write : hardware_condition::read_write;
+                    uint8_t length = address % 4 == 0 ? 4 : address % 2 == 0 ? 2 : 1;
+                    if (!core_debugger::instance()->execute([address, condition, length] () -> bool {
+                        core_debugger* debugger = core_debugger::instance();
+                        return debugger->get_access_tracer()->start(*debugger->get_hardware_breakpoints(), address, condition, length);
+                    })) {
+                        std::cout << "Failed. Is the debugger attached with a free debug register?\n";
+                        return;
+                    }
+                    std::cout << "Tracing " << args[0] << " to 0x" << std::hex << std::uppercase << address << std::dec << std::nouppercase
+                              << " for " << seconds << " s...\n";
+                    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+
+                    auto hits = std::make_shared<uint64_t>(0);
+                    auto results = std::make_shared<std::vector<std::pair<uint64_t, uint64_t>>>();
+                    if (!core_debugger::instance()->execute([hits, results] () -> bool {
+                        core_debugger* debugger = core_debugger::instance();
+                        debugger->get_access_tracer()->stop(*debugger->get_hardware_breakpoints());
+                        *hits = debugger->get_access_tracer()->get_hits();
+                        *results = debugger->get_access_tracer()->results();
+                        return true;
+                    })) {
+                        std::cout << "Failed.\n";
+                        return;
+                    }
+
+                    std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                    std::cout << "Hits: " << *hits << " Instructions: " << results->size()
+                              << " (listed by the instruction after the access)\n";
+                    size_t shown = (std::min)(results->size(), static_cast<size_t>(50));
+                    for (size_t i = 0; i < shown; i++) {
+                        std::cout << std::setw(12) << (*results)[i].second << "  " << format_address(*modules, (*results)[i].first)
+                                  << " [0x" << std::hex << std::uppercase << (*results)[i].first << std::dec << std::nouppercase << "]\n";
+                    }
+                    return;
+                }
+
+                if (args[0] == "steps") {
+                    step_tracer* stepper = core_debugger::instance()->get_step_tracer();
+                    if (args.size() == 1) {
+                        std::cout << (stepper->is_running() ? "Stepping. " : "Not stepping. ") << "Steps: " << stepper->get_steps() << "\n";
+                        return;
+                    }
+                    if (args.size() == 2 && args[1] == "stop") {
+                        if (!core_debugger::instance()->execute([stepper] () -> bool {
+                            stepper->stop();
+                            return true;
+                        })) {
+                            std::cout << "Failed.\n";
+                            return;
+                        }
+                        std::cout << "Stopped after " << stepper->get_steps() << " steps.\n";
+                        return;
+                    }
+
+                    uint32_t tid = 0;
+                    uint64_t count = 0;
+                    uint64_t until = 0;
+                    size_t file_index = args.size() > 2 && args[2] == "until" ? 4 : 3;
+                    bool valid = args.size() == file_index + 1 || (args.size() == file_index + 2 && args[file_index + 1] == "regs");
+                    try {
+                        tid = valid ? static_cast<uint32_t>(std::stoul(args[1])) : 0;
+                        if (valid && file_index == 3) {
+                            count = std::stoull(args[2]);
+                        }
+                    }
+                    catch (...) {
+                        valid = false;
+                    }
+                    if (valid && file_index == 4) {
+                        valid = parse_address(args[3], until);
+                    }
+                    if (!valid || !tid || (!count && !until)) {
+                        std::cout << "Invalid usage!\ntrace steps <tid> <count|until <address>> <file> [regs]\ntrace steps [stop]\n";
+                        return;
+                    }
+                    std::string path = args[file_index];
+                    bool with_registers = args.size() == file_index + 2;
+                    if (!core_debugger::instance()->execute([stepper, tid, count, until, path, with_registers] () -> bool {
+                        return stepper->start(tid, count, until, path, with_registers);
+                    })) {
+                        std::cout << "Failed. Is the debugger attached and the thread known?\n";
+                        return;
+                    }
+                    std::cout << "Stepping thread " << tid << " into " << path << "; 'trace steps' shows progress.\n";
+                    return;
+                }
+
+                if (args[0] == "read" && (args.size() == 2 || args.size() == 3)) {
+                    uint64_t address = 0;
+                    if (args.size() == 3 && !parse_address(args[2], address)) {
+                        std::cout << "Invalid usage!\ntrace read <file> [address]\n";
+                        return;
+                    }
+                    step_trace_reader reader;
+                    if (!reader.open(args[1])) {
+                        std::cout << "Failed to open step trace " << args[1] << "\n";
+                        return;
+                    }
+                    const step_trace_header& header = reader.get_header();
+                    std::cout << "Thread: " << header.tid << " Steps: " << header.steps << " Blocks kept: "
+                              << (std::min)(header.blocks_written, static_cast<uint64_t>(header.block_count))
+                              << " of " << header.blocks_written << (header.flags & STEP_TRACE_FLAG_REGISTERS ? " (registers)" : "") << "\n";
+
+                    if (args.size() == 3) {
+                        uint64_t executions = 0;
+                        if (!reader.for_each_step([&] (uint64_t rip, const thread_registers&) {
+                            executions += rip == address ? 1 : 0;
+                        }, address, address)) {
+                            std::cout << "Failed. The trace is damaged.\n";
+                            return;
                         }
+                        std::cout << "0x" << std::hex << std::uppercase << address << std::dec << std::nouppercase
+                                  << " executed " << executions << " times.\n";
+                        return;
+                    }
+
+                    address_histogram executed;
+                    if (!reader.executed(executed)) {
+                        std::cout << "Failed. The trace is damaged.\n";
                         return;
                     }
+                    std::vector<std::pair<uint64_t, uint64_t>> results = executed.sorted();
+                    std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                    std::cout << "Instructions: " << results.size() << "\n";
+                    size_t shown = (std::min)(results.size(), static_cast<size_t>(50));
+                    for (size_t i = 0; i < shown; i++) {
+                        std::cout << std::setw(12) << results[i].second << "  " << format_address(*modules, results[i].first)
+                                  << " [0x" << std::hex << std::uppercase << results[i].first << std::dec << std::nouppercase << "]\n";
+                    }
+                    return;
                 }
 
                 std::cout << "Invalid usage!\nCheck [help]\n";
+            };
+
+            commands["coverage"] = [this] (const std::vector<std::string>& args) -> void {
+                coverage_collector* coverage = core_debugger::instance()->get_coverage();
+                if (args.empty() || args[0].empty()) {
+                    std::cout << "Invalid usage!\nCheck [help]\n";
+                    return;
+                }
+
+                if (args[0] == "start" && (args.size() == 2 || args.size() == 3)) {
+                    std::string name = args[1];
+                    std::string list = args.size() == 3 ? args[2] : "";
+                    auto armed = std::make_shared<size_t>(0);
+                    auto blocks = std::make_shared<size_t>(0);
+                    auto found = std::make_shared<bool>(false);
+                    if (!core_debugger::instance()->execute([coverage, name, list, armed, blocks, found] () -> bool {
+                        for (const module_range& module : *core_debugger::instance()->get_modules(core::core::instance()->get_pid())) {
+                            std::string file = module.name.substr(module.name.find_last_of("/\\") + 1);
+                            if (_stricmp(file.c_str(), name.c_str()) != 0 && _stricmp(module.name.c_str(), name.c_str()) != 0) {
+                                continue;
+                            }
+                            *found = true;
+                            std::vector<uint64_t> addresses;
+                            if (list.empty()) {
+                                addresses = discover_functions(core_debugger::instance()->get_event_source(), module);
+                            }
+                            else if (!load_block_list(list, module.base, addresses)) {
+                                return false;
+                            }
+                            *armed = coverage->start(module, std::move(addresses));
+                            *blocks = coverage->get_blocks();
+                            return *armed != 0;
+                        }
+                        return false;
+                    })) {
+                        std::cout << (*found ? "Failed. Nothing could be armed.\n" : "Failed. Is the debugger attached and the module loaded?\n");
+                        return;
+                    }
+                    std::cout << "Armed " << *armed << " of " << *blocks << " blocks in " << name << ".\n";
+                    return;
+                }
+
+                if (args[0] == "status" && args.size() == 1) {
+                    uint64_t blocks = coverage->get_blocks();
+                    uint64_t hits = coverage->get_hits();
+                    std::cout << "Blocks: " << blocks << " Hit: " << hits << " Armed: " << coverage->get_armed();
+                    if (blocks) {
+                        std::cout << " (" << std::fixed << std::setprecision(1) << 100.0 * hits / blocks << "%)" << std::defaultfloat;
+                    }
+                    std::cout << "\n";
+                    return;
+                }
+
+                if (args[0] == "stop" && args.size() == 1) {
+                    auto removed = std::make_shared<size_t>(0);
+                    if (!core_debugger::instance()->execute([coverage, removed] () -> bool {
+                        *removed = coverage->stop();
+                        return true;
+                    })) {
+                        std::cout << "Failed.\n";
+                        return;
+                    }
+                    std::cout << "Removed " << *removed << " int3s. Hit " << coverage->get_hits() << " of " << coverage->get_blocks() << " blocks.\n";
+                    return;
+                }
+
+                if (args[0] == "save" && args.size() == 2) {
+                    auto map = std::make_shared<coverage_map>();
+                    if (!core_debugger::instance()->execute([coverage, map] () -> bool {
+                        *map = coverage->snapshot();
+                        return true;
+                    }) || map->offsets.empty() || !map->save(args[1])) {
+                        std::cout << "Failed.\n";
+                        return;
+                    }
+                    std::cout << "Saved " << map->count() << " of " << map->offsets.size() << " blocks hit to " << args[1] << "\n";
+                    return;
+                }
+
+                if (args[0] == "diff" && args.size() == 3) {
+                    coverage_map a;
+                    coverage_map b;
+                    if (!a.load(args[1]) || !b.load(args[2])) {
+                        std::cout << "Failed to open the coverage files.\n";
+                        return;
+                    }
+                    std::vector<uint32_t> only_a;
+                    std::vector<uint32_t> only_b;
+                    if (!coverage_diff(a, b, only_a, only_b)) {
+                        std::cout << "Failed. The files were recorded over different block lists.\n";
+                        return;
+                    }
+                    std::cout << "Hit: " << a.count() << " / " << b.count() << " Only in " << args[1] << ": " << only_a.size()
+                              << " Only in " << args[2] << ": " << only_b.size() << "\n";
+                    const std::vector<uint32_t>* sides[] = { &only_a, &only_b };
+                    for (int side = 0; side < 2; side++) {
+                        size_t shown = (std::min)(sides[side]->size(), static_cast<size_t>(50));
+                        for (size_t i = 0; i < shown; i++) {
+                            std::cout << (side ? "  + " : "  - ") << a.module << "+0x" << std::hex << std::uppercase << (*sides[side])[i]
+                                      << std::dec << std::nouppercase << "\n";
+                        }
+                    }
+                    return;
+                }
+
+                std::cout << "Invalid usage!\ncoverage start <module> [blocks file]\ncoverage [status|stop]\n"
+                             "coverage save <file>\ncoverage diff <a> <b>\n";
+            };
+
+            commands["profile"] = [this] (const std::vector<std::string>& args) -> void {
+                int seconds = 0;
+                int hz = 0;
+                bool valid = (args.size() == 2 || ((args.size() == 3 || args.size() == 4) && args[2] == "stacks"));
+                try {
+                    seconds = valid ? std::stoi(args[0]) : 0;
+                    hz = valid ? std::stoi(args[1]) : 0;
+                }
+                catch (...) {
+                    valid = false;
+                }
+                if (!valid || seconds <= 0 || hz <= 0 || hz > 10000) {
+                    std::cout << "Invalid usage!\nprofile <seconds> <hz> [stacks [folded file]]\n";
+                    return;
+                }
+                bool with_stacks = args.size() >= 3;
+                sampling_profiler* profiler = core_debugger::instance()->get_profiler();
+                // The debugger loop takes the ticks itself; nothing is sent to it per tick.
+                if (!core_debugger::instance()->execute([profiler, with_stacks, seconds, hz] () -> bool {
+                    core_debugger* debugger = core_debugger::instance();
+                    debugger->get_stack_walker()->set_modules(*debugger->get_modules(core::core::instance()->get_pid()));
+                    profiler->start(with_stacks);
+                    profiler->schedule(static_cast<uint32_t>(seconds) * 1000, static_cast<uint32_t>(hz));
+                    return true;
+                })) {
+                    std::cout << "Failed. Is the debugger attached?\n";
+                    return;
+                }
+
+                std::cout << "Sampling for " << seconds << " s at " << hz << " Hz...\n";
+                // The loop ends the schedule on its first pass past the end; a detach ends it early.
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds + 1);
+                std::this_thread::sleep_for(std::chrono::seconds(seconds));
+                while (profiler->is_scheduled() && std::chrono::steady_clock::now() < deadline) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+
+                auto report = std::make_shared<profile_report>();
+                if (!core_debugger::instance()->execute([profiler, report] () -> bool {
+                    *report = profiler->report(*core_debugger::instance()->get_modules(core::core::instance()->get_pid()));
+                    return true;
+                })) {
+                    std::cout << "Failed.\n";
+                    return;
+                }
+                uint64_t ticks = profiler->get_ticks();
+                std::cout << "Ticks: " << ticks << " Samples: " << report->samples << " Held per tick: " << std::fixed << std::setprecision(1)
+                          << (ticks ? profiler->get_held_ns() / 1000.0 / ticks : 0.0) << " us\n";
+                auto print = [&report] (const char* title, const std::vector<profile_count>& counts, size_t limit) {
+                    std::cout << title << "\n";
+                    for (size_t i = 0; i < (std::min)(counts.size(), limit); i++) {
+                        std::cout << std::setw(10) << counts[i].samples << std::setw(7) << 100.0 * counts[i].samples / report->samples
+                                  << "%  " << counts[i].name << "\n";
+                    }
+                };
+                if (report->samples) {
+                    print("Modules:", report->modules, 10);
+                    print("Functions:", report->functions, 25);
+                }
+                std::cout << std::defaultfloat;
+
+                if (args.size() == 4) {
+                    if (!save_folded(*report, args[3])) {
+                        std::cout << "Failed to write " << args[3] << "\n";
+                        return;
+                    }
+                    std::cout << "Wrote " << report->stacks.size() << " folded stacks to " << args[3] << "\n";
+                }
+            };
+
+            commands["events"] = [this] (const std::vector<std::string>& args) -> void {
+                event_journal* journal = core_debugger::instance()->get_event_journal();
+                if (args.empty()) {
+                    std::cout << "Recorded: " << journal->get_recorded() << " Kept: " << journal->get_kept() << " of " << journal->get_capacity()
+                              << " Strings: " << journal->get_strings() << "\n";
+                    return;
+                }
+                if (args[0] == "clear" && args.size() == 1) {
+                    journal->clear();
+                    std::cout << "Success.\n";
+                    return;
+                }
+
+                // [seconds] back from now, 0 or absent for every event kept.
+                auto window = [] (const std::vector<std::string>& args, size_t index, uint64_t& since) -> bool {
+                    since = 0;
+                    if (args.size() <= index) {
+                        return true;
+                    }
+                    try {
+                        size_t used = 0;
+                        uint64_t seconds = std::stoull(args[index], &used);
+                        uint64_t now = journal_now();
+                        since = seconds && seconds * 1000000000ull < now ? now - seconds * 1000000000ull : 0;
+                        return used == args[index].size();
+                    }
+                    catch (...) {
+                        return false;
+                    }
+                };
+                auto code_name = [] (uint32_t code) -> std::string {
+                    const char* name = debug_exception_name(code);
+                    std::ostringstream text;
+                    text << "0x" << std::hex << std::uppercase << code;
+                    return name ? text.str() + " " + name : text.str();
+                };
+                uint64_t since = 0;
+
+                if (args[0] == "count" && args.size() <= 2) {
+                    if (!window(args, 1, since)) {
+                        std::cout << "Invalid usage!\nevents count [seconds]\n";
+                        return;
+                    }
+                    journal_counts counts = journal->count(since);
+                    std::cout << "Events: " << counts.events << "\n";
+                    for (size_t type = 0; type < static_cast<size_t>(debug_event_type::count); type++) {
+                        if (counts.by_type[type]) {
+                            std::cout << std::setw(12) << counts.by_type[type] << "  " << debug_event_type_name(static_cast<debug_event_type>(type)) << "\n";
+                        }
+                    }
+                    for (const auto& code : counts.by_code) {
+                        std::cout << std::setw(12) << code.second << "    " << code_name(code.first) << "\n";
+                    }
+                    return;
+                }
+
+                if (args[0] == "top" && args.size() <= 3) {
+                    uint32_t code = 0;
+                    uint64_t parsed = 0;
+                    if (!window(args, 1, since) || (args.size() == 3 && (!parse_address(args[2], parsed) || parsed > 0xFFFFFFFF))) {
+                        std::cout << "Invalid usage!\nevents top [seconds] [exception code]\n";
+                        return;
+                    }
+                    code = static_cast<uint32_t>(parsed);
+                    std::vector<journal_site> sites = journal->top(since, code, 25);
+                    std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                    module_resolver resolver(*modules);
+                    char address[MAX_ADDRESS_TEXT];
+                    for (const journal_site& site : sites) {
+                        resolver.format(site.address, address, sizeof(address));
+                        std::cout << std::setw(12) << site.events << "  " << address << "  " << code_name(site.code) << "\n";
+                    }
+                    std::cout << "Sites: " << sites.size() << "\n";
+                    return;
+                }
+
+                if (args[0] == "since" && args.size() == 2) {
+                    if (!window(args, 1, since)) {
+                        std::cout << "Invalid usage!\nevents since <seconds>\n";
+                        return;
+                    }
+                    std::vector<journal_event> events = journal->since(since, 100);
+                    std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                    module_resolver resolver(*modules);
+                    char address[MAX_ADDRESS_TEXT];
+                    uint64_t now = journal_now();
+                    for (const journal_event& event : events) {
+                        resolver.format(event.address, address, sizeof(address));
+                        std::cout << std::fixed << std::setprecision(3) << std::setw(10) << -((now - event.timestamp) / 1e9) << std::defaultfloat
+                                  << "  " << std::setw(14) << std::left << debug_event_type_name(event.type) << std::right
+                                  << " pid " << event.pid << " tid " << event.tid;
+                        if (event.type == debug_event_type::exception) {
+                            std::cout << " " << code_name(event.code) << (event.first_chance ? "" : " (second chance)") << " at " << address;
+                        }
+                        else if (event.type == debug_event_type::output_string) {
+                            std::cout << " \"" << journal->get_string(event.string) << "\"";
+                        }
+                        else if (event.address) {
+                            std::cout << " " << address;
+                        }
+                        std::cout << "\n";
+                    }
+                    std::cout << "Events: " << events.size() << (events.size() == 100 ? " (newest 100)" : "") << "\n";
+                    return;
+                }
+
+                std::cout << "Invalid usage!\nCheck [help]\n";
+            };
+
+            commands["exceptions"] = [this] (const std::vector<std::string>& args) -> void {
+                exception_stats* stats = core_debugger::instance()->get_exception_stats();
+                auto code_name = [] (uint32_t code) -> std::string {
+                    const char* name = debug_exception_name(code);
+                    std::ostringstream text;
+                    text << "0x" << std::hex << std::uppercase << code;
+                    return name ? text.str() + " " + name : text.str();
+                };
+
+                if (args.size() == 1 && (args[0] == "on" || args[0] == "off")) {
+                    stats->set_enabled(args[0] == "on");
+                    std::cout << "Success.\n";
+                    return;
+                }
+
+                if (args.size() == 1 && args[0] == "clear") {
+                    // Not attached: no debugger thread writes the table.
+                    if (!core_debugger::instance()->execute([stats] () -> bool {
+                        stats->clear();
+                        return true;
+                    })) {
+                        stats->clear();
+                    }
+                    std::cout << "Success.\n";
+                    return;
+                }
+
+                if (args.size() == 3 && args[0] == "policy") {
+                    uint64_t code = 0;
+                    bool valid = parse_address(args[1], code) && code <= 0xFFFFFFFF;
+                    exception_policy policy = { continue_action::not_handled, false };
+                    if (args[2] == "continue") {
+                        policy.action = continue_action::handled;
+                    }
+                    else if (args[2] == "dispatch") {
+                        policy.dispatch = true;
+                    }
+                    else if (args[2] != "pass") {
+                        valid = false;
+                    }
+                    if (!valid) {
+                        std::cout << "Invalid usage!\nexceptions policy <code> <pass|continue|dispatch>\n";
+                        return;
+                    }
+                    std::cout << (stats->set_policy(static_cast<uint32_t>(code), policy) ? "Success.\n" : "Failed. The policy table is full.\n");
+                    return;
+                }
+
+                size_t limit = 25;
+                if (args.size() == 2 && args[0] == "top") {
+                    try {
+                        limit = static_cast<size_t>(std::stoul(args[1]));
+                    }
+                    catch (...) {
+                        limit = 0;
+                    }
+                }
+                if (!args.empty() && !(args.size() == 2 && args[0] == "top" && limit)) {
+                    std::cout << "Invalid usage!\nCheck [help]\n";
+                    return;
+                }
+                std::cout << "Statistics mode: " << (stats->is_enabled() ? "on" : "off") << " Exceptions: " << stats->get_total()
+                          << " Sites: " << stats->get_sites() << " Dropped: " << stats->get_dropped() << "\n";
+                std::vector<exception_site> sites = stats->top(limit);
+                std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                module_resolver resolver(*modules);
+                char address[MAX_ADDRESS_TEXT];
+                for (const exception_site& site : sites) {
+                    resolver.format(site.address, address, sizeof(address));
+                    exception_policy policy = stats->policy_for(site.code);
+                    std::cout << std::setw(12) << site.first_chance << std::setw(8) << site.second_chance << "  " << address << "  "
+                              << code_name(site.code) << " (" << (policy.dispatch ? "dispatch" : policy.action == continue_action::handled ? "continue" : "pass")
+                              << ")\n";
+                }
                 return;
             };
+
+            commands["disasm"] = [this] (const std::vector<std::string>& args) -> void {
+                uint64_t address = 0;
+                size_t count = 16;
+                bool valid = (args.size() == 1 || args.size() == 2) && parse_address(args[0], address);
+                if (valid && args.size() == 2) {
+                    try {
+                        count = static_cast<size_t>(std::stoul(args[1]));
+                    }
+                    catch (...) {
+                        count = 0;
+                    }
+                    valid = count && count <= 4096;
+                }
+                if (!valid) {
+                    std::cout << "Invalid usage!\ndisasm <address> [count]\n";
+                    return;
+                }
+
+                // Enough for count instructions of the longest length; a read that fails drops its last
+                // page until what is left is readable, so code running into unmapped memory still lists.
+                std::vector<uint8_t> code(count * X86_MAX_LENGTH);
+                size_t size = code.size();
+                HANDLE handle = core::core::instance()->get_handle();
+                SIZE_T read = 0;
+                while (size && !ReadProcessMemory(handle, reinterpret_cast<LPCVOID>(address), code.data(), size, &read)) {
+                    uint64_t last_page = (address + size - 1) & ~static_cast<uint64_t>(0xFFF);
+                    size = last_page > address ? static_cast<size_t>(last_page - address) : 0;
+                }
+                if (!size) {
+                    std::cout << "Failed. Is a process attached and the address readable?\n";
+                    return;
+                }
+
+                std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                module_resolver resolver(*modules);
+                char location[MAX_ADDRESS_TEXT];
+                char text[X86_MAX_TEXT];
+                resolver.format(address, location, sizeof(location));
+                std::cout << location << ":\n";
+                size_t offset = 0;
+                for (size_t i = 0; i < count && offset < size; i++) {
+                    uint64_t at = address + offset;
+                    x86_instruction instruction;
+                    bool decoded = x86_decode(code.data() + offset, size - offset, instruction);
+                    size_t length = decoded ? instruction.length : 1;
+                    std::ostringstream bytes;
+                    bytes << std::hex << std::uppercase << std::setfill('0');
+                    for (size_t j = 0; j < length; j++) {
+                        bytes << std::setw(2) << static_cast<int>(code[offset + j]) << (j + 1 < length ? " " : "");
+                    }
+                    std::cout << "0x" << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << at << std::setfill(' ') << std::dec << std::nouppercase
+                              << "  " << std::setw(3 * X86_MAX_LENGTH) << std::left << bytes.str() << std::right << "  ";
+                    if (!decoded) {
+                        std::cout << "db 0x" << std::hex << std::uppercase << static_cast<int>(code[offset]) << std::dec << std::nouppercase << "\n";
+                        offset++;
+                        continue;
+                    }
+                    x86_format(instruction, at, text, sizeof(text));
+                    std::cout << text;
+                    uint64_t target = 0;
+                    if (x86_target(instruction, at, target)) {
+                        resolver.format(target, location, sizeof(location));
+                        std::cout << "  ; " << location;
+                    }
+                    std::cout << "\n";
+                    offset += length;
+                }
+                return;
+            };
+
+            commands["xref"] = [this] (const std::vector<std::string>& args) -> void {
+                HANDLE handle = core::core::instance()->get_handle();
+                xref_reader read = [handle] (uint64_t address, void* buffer, size_t size) -> bool {
+                    SIZE_T copied = 0;
+                    return ReadProcessMemory(handle, reinterpret_cast<LPCVOID>(address), buffer, size, &copied) && copied == size;
+                };
+                std::shared_ptr<const std::vector<module_range>> modules = core_debugger::instance()->get_modules(core::core::instance()->get_pid());
+                xref_store* store = xref_store::instance();
+                bool built = false;
+                xref_build_stats stats = {};
+
+                if (args.size() == 2 && args[0] == "build") {
+                    for (const module_range& module : *modules) {
+                        std::string file = module.name.substr(module.name.find_last_of("/\\") + 1);
+                        if (_stricmp(file.c_str(), args[1].c_str()) != 0 && _stricmp(module.name.c_str(), args[1].c_str()) != 0) {
+                            continue;
+                        }
+                        const xref_index* index = store->load(read, module, true, built, stats);
+                        if (!index) {
+                            std::cout << "Failed. Is the module readable and the xref folder writable?\n";
+                            return;
+                        }
+                        if (built) {
+                            std::cout << "Built in " << stats.nanoseconds / 1000000 << " ms: " << stats.code_bytes / 1024 << " KB of code, "
+                                      << stats.instructions << " instructions, " << stats.chunks << " chunks (" << stats.resynced << " resynced) on "
+                                      << stats.threads << " threads.\n";
+                        }
+                        std::cout << (built ? "Indexed " : "Cached: ") << index->get_count() << " references in " << file << ".\n";
+                        return;
+                    }
+                    std::cout << "Failed. Module not found.\n";
+                    return;
+                }
+
+                if ((args.size() == 2 || args.size() == 3) && args[0] == "to") {
+                    uint64_t address = 0;
+                    uint64_t size = 1;
+                    bool valid = parse_address(args[1], address);
+                    if (valid && args.size() == 3) {
+                        valid = parse_address(args[2], size) && size;
+                    }
+                    if (!valid) {
+                        std::cout << "Invalid usage!\nxref to <address> [size]\n";
+                        return;
+                    }
+                    const module_range* module = find_module(*modules, address);
+                    if (!module) {
+                        std::cout << "Failed. The address is in no module.\n";
+                        return;
+                    }
+                    // Offsets are stored in 32 bits; xref_build refuses larger images too.
+                    if (module->size > UINT32_MAX) {
+                        std::cout << "Failed. Images over 4 GB are not indexed.\n";
+                        return;
+                    }
+                    const xref_index* index = store->find(*module);
+                    index = index ? index : store->load(read, *module, false, built, stats);
+                    if (!index) {
+                        std::cout << "Failed. No index for this module; run 'xref build' on it first.\n";
+                        return;
+                    }
+                    uint64_t low = address - module->base;
+                    size = (std::min)(size, module->size - low);
+                    uint64_t high = low + size - 1;
+                    size_t first = 0;
+                    size_t last = 0;
+                    index->find(static_cast<uint32_t>(low), static_cast<uint32_t>(high), first, last);
+
+                    module_resolver resolver(*modules);
+                    char location[MAX_ADDRESS_TEXT];
+                    char text[X86_MAX_TEXT];
+                    for (size_t i = first; i < last; i++) {
+                        const xref_entry& entry = index->entry(i);
+                        uint64_t source = module->base + entry.source;
+                        uint8_t code[X86_MAX_LENGTH] = {};
+                        x86_instruction instruction;
+                        // The index only knows offsets; the text comes from the target as it is now.
+                        bool decoded = read(source, code, sizeof(code)) && x86_decode(code, sizeof(code), instruction);
+                        if (decoded) {
+                            x86_format(instruction, source, text, sizeof(text));
+                        }
+                        resolver.format(source, location, sizeof(location));
+                        std::cout << std::setw(9) << std::left << xref_kind_name(index->kind(i)) << std::right << location
+                                  << " [0x" << std::hex << std::uppercase << source << std::dec << std::nouppercase << "]"
+                                  << (decoded ? "  " : "") << (decoded ? text : "") << "\n";
+                    }
+                    std::cout << "References: " << last - first << "\n";
+                    return;
+                }
+
+                std::cout << "Invalid usage!\nCheck [help]\n";
+            };
         }
 
         void loop() {
@@ -323,7 +1568,14 @@ R"""(
 
                 auto iterator = commands.find(tokens[0]);
                 if (iterator != commands.end()) {
+                    bool is_recorded = tokens[0] != "stats";
+                    if (is_recorded) {
+                        scan_stats::instance()->begin(input);
+                    }
                     iterator->second({tokens.begin() + 1, tokens.end()});
+                    if (is_recorded) {
+                        scan_stats::instance()->end();
+                    }
                 }
                 else {
                     std::cout << "Unknown command\n";
@@ -1,4 +1,5 @@
 #include "core.h"
+#include "debugger/output_pipe/output_pipe.h"
 #include <iostream>
 
 bool core::core::attach(DWORD pid) {
@@ -24,6 +25,7 @@ bool core::core::attach(DWORD pid) {
     attached_pid = pid;
     attached_handle = process_handle;
     current_status = status::attached;
+    DEBUG_LOG(INFO, CORE, "[core] Attached to process %lu", pid);
     return true;
 }
 
@@ -47,18 +49,6 @@ void core::core::force_detach() {
     std::cout << "Success.\n";
 }
 
-void core::core::set_hardware_breakpoint(HANDLE handle, void* address) {
-    CONTEXT ctx = {0};
-    ctx.ContextFlags = CONTEXT_DEBUG_REGISTERS;
-    if (GetThreadContext(handle, &ctx)) {
-        ctx.Dr0 = (DWORD_PTR)address;
-        ctx.Dr7 |= (1 << 0);
-        ctx.Dr7 |= (1 << 16); // RW
-        ctx.Dr7 |= (0b00 << 18);
-        SetThreadContext(handle, &ctx);
-    }
-}
-
 void core::core::check_handle_status() {
     if (attached_handle == NULL) {
         return;
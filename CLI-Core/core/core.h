@@ -23,7 +23,6 @@ namespace core {
         bool attach(DWORD pid);
         bool detach();
         void force_detach();
-        void set_hardware_breakpoint(HANDLE handle, void* address);
         void check_handle_status();
         status get_status();
         DWORD get_pid();
@@ -0,0 +1,83 @@
+#include "access_tracer.h"
+#include <algorithm>
+
+static const size_t MIN_HISTOGRAM_CAPACITY = 64;
+
+void address_histogram::grow() {
+    std::vector<bucket> old = std::move(buckets);
+    buckets.assign((std::max)(old.size() * 2, MIN_HISTOGRAM_CAPACITY), bucket{0, 0});
+    size_t mask = buckets.size() - 1;
+    for (const auto& entry : old) {
+        if (!entry.address) {
+            continue;
+        }
+        size_t index = static_cast<size_t>((entry.address * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        while (buckets[index].address) {
+            index = (index + 1) & mask;
+        }
+        buckets[index] = entry;
+    }
+}
+
+void address_histogram::add(uint64_t address) {
+    if ((used + 1) * 2 > buckets.size()) {
+        grow();
+    }
+    size_t mask = buckets.size() - 1;
+    for (size_t index = static_cast<size_t>((address * 0x9E3779B97F4A7C15ull) >> 32) & mask;; index = (index + 1) & mask) {
+        bucket& entry = buckets[index];
+        if (entry.address == address) {
+            entry.count++;
+            return;
+        }
+        if (!entry.address) {
+            entry = bucket{address, 1};
+            used++;
+            return;
+        }
+    }
+}
+
+void address_histogram::clear() {
+    buckets.clear();
+    used = 0;
+}
+
+std::vector<std::pair<uint64_t, uint64_t>> address_histogram::sorted() const {
+    std::vector<std::pair<uint64_t, uint64_t>> entries;
+    entries.reserve(used);
+    for (const auto& entry : buckets) {
+        if (entry.address) {
+            entries.push_back(std::make_pair(entry.address, entry.count));
+        }
+    }
+    std::sort(entries.begin(), entries.end(), [] (const std::pair<uint64_t, uint64_t>& a, const std::pair<uint64_t, uint64_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return entries;
+}
+
+bool access_tracer::start(hardware_breakpoint_manager& watchpoints, uint64_t target, hardware_condition trace_condition, uint8_t length) {
+    stop(watchpoints);
+    histogram.clear();
+    hits = 0;
+    slot = watchpoints.set(target, trace_condition, length, [this] (const debug_event& event) {
+        hits++;
+        histogram.add(event.address);
+    });
+    address = target;
+    condition = trace_condition;
+    return slot >= 0;
+}
+
+void access_tracer::stop(hardware_breakpoint_manager& watchpoints) {
+    if (slot < 0) {
+        return;
+    }
+    // The manager forgets its slots when the target goes away; do not clear a reused one.
+    hardware_breakpoint current = watchpoints.list()[slot];
+    if (current.active && current.address == address && current.condition == condition) {
+        watchpoints.clear(slot);
+    }
+    slot = -1;
+}
@@ -0,0 +1,52 @@
+#ifndef ACCESS_TRACER_H
+#define ACCESS_TRACER_H
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "hardware_breakpoints.h"
+
+// Hit counts per address in an open-addressed table (linear probing, power-of-two capacity, at
+// most half full). Address 0 marks an empty bucket.
+class address_histogram
+{
+    struct bucket
+    {
+        uint64_t address;
+        uint64_t count;
+    };
+    std::vector<bucket> buckets;
+    size_t used;
+
+    void grow();
+public:
+    address_histogram() : used(0) {}
+
+    void add(uint64_t address);
+    void clear();
+    size_t size() const { return used; }
+    // Highest count first.
+    std::vector<std::pair<uint64_t, uint64_t>> sorted() const;
+};
+
+// "What writes/accesses this address": a data breakpoint whose hits are counted per
+// instruction. Data breakpoints trap after the access, so the counted address is the
+// instruction following the one that touched the data. Runs on the debugger thread.
+class access_tracer
+{
+    address_histogram histogram;
+    int slot;
+    uint64_t address;
+    hardware_condition condition;
+    uint64_t hits;
+public:
+    access_tracer() : slot(-1), address(0), condition(hardware_condition::write), hits(0) {}
+
+    // Starting again discards the previous results.
+    bool start(hardware_breakpoint_manager& watchpoints, uint64_t target, hardware_condition trace_condition, uint8_t length);
+    void stop(hardware_breakpoint_manager& watchpoints);
+    bool is_running() const { return slot >= 0; }
+
+    uint64_t get_hits() const { return hits; }
+    std::vector<std::pair<uint64_t, uint64_t>> results() const { return histogram.sorted(); }
+};
+#endif // !ACCESS_TRACER_H
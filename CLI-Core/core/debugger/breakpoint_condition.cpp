@@ -0,0 +1,325 @@
+#include "breakpoint_condition.h"
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+static const size_t CONDITION_REGISTERS = 16;
+static const uint64_t MEMORY_LINE = 64;
+static const uint32_t RIP_INDEX = 16;
+static const uint32_t RFLAGS_INDEX = 17;
+
+static const char* const REGISTER_NAMES[] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15", "rip", "rflags"
+};
+
+struct memory_width
+{
+    const char* name;
+    uint32_t size;
+};
+
+static const memory_width MEMORY_WIDTHS[] = {
+    {"byte", 1}, {"word", 2}, {"dword", 4}, {"qword", 8}
+};
+
+struct binary_operator
+{
+    const char* text;
+    condition_op op;
+    int precedence;
+};
+
+// Longest spellings first so "<=" is not taken for "<". && and || are the jumps that
+// short-circuit them.
+static const binary_operator BINARY_OPERATORS[] = {
+    {"||", condition_op::jump_if_nonzero, 1},
+    {"&&", condition_op::jump_if_zero, 2},
+    {"==", condition_op::equal, 6},
+    {"!=", condition_op::not_equal, 6},
+    {"<=", condition_op::less_equal, 7},
+    {">=", condition_op::greater_equal, 7},
+    {"<<", condition_op::shl, 8},
+    {">>", condition_op::shr, 8},
+    {"|", condition_op::bit_or, 3},
+    {"^", condition_op::bit_xor, 4},
+    {"&", condition_op::bit_and, 5},
+    {"<", condition_op::less, 7},
+    {">", condition_op::greater, 7},
+    {"+", condition_op::add, 9},
+    {"-", condition_op::sub, 9},
+    {"*", condition_op::mul, 10},
+    {"/", condition_op::div, 10},
+    {"%", condition_op::mod, 10}
+};
+
+// Recursive descent over the expression; each subexpression leaves its value in the bytecode
+// register given by its nesting depth.
+class condition_parser
+{
+    const std::string& text;
+    size_t position;
+    std::vector<condition_instruction>& code;
+    std::vector<uint64_t>& constants;
+    std::string& error;
+
+    void skip_spaces() {
+        while (position < text.size() && isspace(static_cast<unsigned char>(text[position]))) {
+            position++;
+        }
+    }
+
+    bool fail(const std::string& message) {
+        error = message + " at column " + std::to_string(position + 1);
+        return false;
+    }
+
+    void emit(condition_op op, uint8_t dst, uint8_t a, uint8_t b, uint32_t operand) {
+        code.push_back(condition_instruction{op, dst, a, b, operand});
+    }
+
+    const binary_operator* peek_operator() const {
+        for (const auto& candidate : BINARY_OPERATORS) {
+            if (text.compare(position, strlen(candidate.text), candidate.text) == 0) {
+                return &candidate;
+            }
+        }
+        return nullptr;
+    }
+
+    bool parse_memory(uint8_t dst, uint32_t width) {
+        position++;
+        if (!parse_binary(1, dst)) {
+            return false;
+        }
+        skip_spaces();
+        if (position >= text.size() || text[position] != ']') {
+            return fail("expected ']'");
+        }
+        position++;
+        emit(condition_op::load_memory, dst, dst, 0, width);
+        return true;
+    }
+
+    bool parse_primary(uint8_t dst) {
+        skip_spaces();
+        if (position >= text.size()) {
+            return fail("expected a value");
+        }
+
+        char c = text[position];
+        if (c == '(') {
+            position++;
+            if (!parse_binary(1, dst)) {
+                return false;
+            }
+            skip_spaces();
+            if (position >= text.size() || text[position] != ')') {
+                return fail("expected ')'");
+            }
+            position++;
+            return true;
+        }
+
+        if (c == '[') {
+            return parse_memory(dst, 8);
+        }
+
+        if (isdigit(static_cast<unsigned char>(c))) {
+            bool hex = text.compare(position, 2, "0x") == 0 || text.compare(position, 2, "0X") == 0;
+            const char* start = text.c_str() + position + (hex ? 2 : 0);
+            char* end = nullptr;
+            uint64_t value = strtoull(start, &end, hex ? 16 : 10);
+            if (end == start || isalnum(static_cast<unsigned char>(*end))) {
+                return fail("bad number");
+            }
+            position = static_cast<size_t>(end - text.c_str());
+            emit(condition_op::constant, dst, 0, 0, static_cast<uint32_t>(constants.size()));
+            constants.push_back(value);
+            return true;
+        }
+
+        if (isalpha(static_cast<unsigned char>(c))) {
+            size_t start = position;
+            std::string name;
+            while (position < text.size() && isalnum(static_cast<unsigned char>(text[position]))) {
+                name += static_cast<char>(tolower(static_cast<unsigned char>(text[position++])));
+            }
+            for (uint32_t i = 0; i < sizeof(REGISTER_NAMES) / sizeof(REGISTER_NAMES[0]); i++) {
+                if (name == REGISTER_NAMES[i]) {
+                    emit(condition_op::load_register, dst, 0, 0, i);
+                    return true;
+                }
+            }
+            for (const auto& width : MEMORY_WIDTHS) {
+                if (name == width.name) {
+                    skip_spaces();
+                    if (position < text.size() && text[position] == '[') {
+                        return parse_memory(dst, width.size);
+                    }
+                }
+            }
+            position = start;
+            return fail("unknown register '" + name + "'");
+        }
+        return fail(std::string("unexpected '") + c + "'");
+    }
+
+    bool parse_unary(uint8_t dst) {
+        skip_spaces();
+        if (position < text.size() && (text[position] == '-' || text[position] == '!' || text[position] == '~')) {
+            char c = text[position++];
+            if (!parse_unary(dst)) {
+                return false;
+            }
+            emit(c == '-' ? condition_op::negate : c == '!' ? condition_op::logical_not : condition_op::bit_not, dst, dst, 0, 0);
+            return true;
+        }
+        return parse_primary(dst);
+    }
+
+    bool parse_binary(int min_precedence, uint8_t dst) {
+        if (!parse_unary(dst)) {
+            return false;
+        }
+        for (;;) {
+            skip_spaces();
+            const binary_operator* op = peek_operator();
+            if (!op || op->precedence < min_precedence) {
+                return true;
+            }
+            position += strlen(op->text);
+
+            if (op->op == condition_op::jump_if_zero || op->op == condition_op::jump_if_nonzero) {
+                size_t jump = code.size();
+                emit(op->op, dst, dst, 0, 0);
+                if (!parse_binary(op->precedence + 1, dst)) {
+                    return false;
+                }
+                emit(condition_op::to_bool, dst, dst, 0, 0);
+                code[jump].operand = static_cast<uint32_t>(code.size());
+                continue;
+            }
+
+            if (dst + 1u >= CONDITION_REGISTERS) {
+                return fail("expression nested too deeply");
+            }
+            if (!parse_binary(op->precedence + 1, static_cast<uint8_t>(dst + 1))) {
+                return false;
+            }
+            emit(op->op, dst, dst, static_cast<uint8_t>(dst + 1), 0);
+        }
+    }
+public:
+    condition_parser(const std::string& expression, std::vector<condition_instruction>& out_code,
+                     std::vector<uint64_t>& out_constants, std::string& out_error)
+        : text(expression), position(0), code(out_code), constants(out_constants), error(out_error) {}
+
+    bool parse() {
+        if (!parse_binary(1, 0)) {
+            return false;
+        }
+        skip_spaces();
+        if (position != text.size()) {
+            return fail(std::string("unexpected '") + text[position] + "'");
+        }
+        emit(condition_op::ret, 0, 0, 0, 0);
+        return true;
+    }
+};
+
+bool breakpoint_condition::compile(const std::string& expression, std::string& error) {
+    std::vector<condition_instruction> compiled;
+    std::vector<uint64_t> pool;
+    condition_parser parser(expression, compiled, pool, error);
+    if (!parser.parse()) {
+        return false;
+    }
+    text = expression;
+    code = std::move(compiled);
+    constants = std::move(pool);
+    return true;
+}
+
+bool breakpoint_condition::evaluate(const thread_registers& registers, debug_event_source* source, uint64_t& result) const {
+    uint64_t r[CONDITION_REGISTERS] = {};
+    // Line 1 is never aligned, so the first read always fetches.
+    uint64_t line_address = 1;
+    uint8_t line[MEMORY_LINE];
+
+    for (size_t pc = 0; pc < code.size(); pc++) {
+        const condition_instruction& instruction = code[pc];
+        uint64_t& dst = r[instruction.dst];
+        uint64_t a = r[instruction.a];
+        uint64_t b = r[instruction.b];
+        switch (instruction.op) {
+        case condition_op::constant:
+            dst = constants[instruction.operand];
+            break;
+        case condition_op::load_register:
+            dst = instruction.operand == RIP_INDEX ? registers.rip :
+                  instruction.operand == RFLAGS_INDEX ? registers.rflags : registers.gpr[instruction.operand];
+            break;
+        case condition_op::load_memory: {
+            // An aligned line never crosses a page, so it is readable whenever the value is.
+            uint64_t value = 0;
+            uint64_t base = a & ~(MEMORY_LINE - 1);
+            if (a - base + instruction.operand <= MEMORY_LINE) {
+                if (base != line_address) {
+                    if (!source->read_memory(base, line, MEMORY_LINE)) {
+                        return false;
+                    }
+                    line_address = base;
+                }
+                memcpy(&value, line + (a - base), instruction.operand);
+            }
+            else if (!source->read_memory(a, &value, instruction.operand)) {
+                return false;
+            }
+            dst = value;
+            break;
+        }
+        case condition_op::negate:        dst = 0 - a; break;
+        case condition_op::logical_not:   dst = !a; break;
+        case condition_op::bit_not:       dst = ~a; break;
+        case condition_op::add:           dst = a + b; break;
+        case condition_op::sub:           dst = a - b; break;
+        case condition_op::mul:           dst = a * b; break;
+        case condition_op::div:
+        case condition_op::mod:
+            if (!b) {
+                return false;
+            }
+            dst = instruction.op == condition_op::div ? a / b : a % b;
+            break;
+        case condition_op::shl:           dst = a << (b & 63); break;
+        case condition_op::shr:           dst = a >> (b & 63); break;
+        case condition_op::bit_and:       dst = a & b; break;
+        case condition_op::bit_or:        dst = a | b; break;
+        case condition_op::bit_xor:       dst = a ^ b; break;
+        case condition_op::equal:         dst = a == b; break;
+        case condition_op::not_equal:     dst = a != b; break;
+        case condition_op::less:          dst = a < b; break;
+        case condition_op::less_equal:    dst = a <= b; break;
+        case condition_op::greater:       dst = a > b; break;
+        case condition_op::greater_equal: dst = a >= b; break;
+        case condition_op::jump_if_zero:
+            if (!a) {
+                dst = 0;
+                pc = instruction.operand - 1;
+            }
+            break;
+        case condition_op::jump_if_nonzero:
+            if (a) {
+                dst = 1;
+                pc = instruction.operand - 1;
+            }
+            break;
+        case condition_op::to_bool:       dst = a != 0; break;
+        case condition_op::ret:
+            result = a;
+            return true;
+        }
+    }
+    return false;
+}
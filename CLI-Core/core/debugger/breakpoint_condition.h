@@ -0,0 +1,52 @@
+#ifndef BREAKPOINT_CONDITION_H
+#define BREAKPOINT_CONDITION_H
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "debug_event_source.h"
+
+enum class condition_op : uint8_t
+{
+    constant,           // r[dst] = constants[operand]
+    load_register,      // r[dst] = gpr[operand] (16 rip, 17 rflags)
+    load_memory,        // r[dst] = operand bytes at r[a]
+    negate, logical_not, bit_not,
+    add, sub, mul, div, mod, shl, shr,
+    bit_and, bit_or, bit_xor,
+    equal, not_equal, less, less_equal, greater, greater_equal,
+    jump_if_zero,       // r[a] == 0: r[dst] = 0, continue at operand
+    jump_if_nonzero,    // r[a] != 0: r[dst] = 1, continue at operand
+    to_bool,            // r[dst] = r[a] != 0
+    ret                 // result is r[a]
+};
+
+struct condition_instruction
+{
+    condition_op op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    uint32_t operand;
+};
+
+// A breakpoint condition such as "rcx == 0x1234 && [rdx+8] > 100", parsed once into
+// register-machine bytecode. Operands are the 64-bit registers, rip and rflags, numbers
+// (0x for hex) and memory reads: [expr] is a qword, byte/word/dword/qword[expr] pick the
+// width. Operators and precedence are C's, on unsigned 64-bit values; && and || short-circuit,
+// so "rdx && [rdx]" never reads through a null rdx.
+class breakpoint_condition
+{
+    std::string text;
+    std::vector<condition_instruction> code;
+    std::vector<uint64_t> constants;
+public:
+    // False with a message in error when the expression does not parse.
+    bool compile(const std::string& expression, std::string& error);
+    // Evaluates against a stopped thread; memory is read through source, each aligned
+    // 64-byte line once per evaluation. False when a read fails or a division is by zero.
+    bool evaluate(const thread_registers& registers, debug_event_source* source, uint64_t& result) const;
+
+    const std::string& get_text() const { return text; }
+    size_t size() const { return code.size(); }
+};
+#endif // !BREAKPOINT_CONDITION_H
@@ -0,0 +1,561 @@
+#include "breakpoints.h"
+#include <algorithm>
+#include <iterator>
+
+static const uint64_t EMPTY_SLOT = 0;
+static const uint64_t REMOVED_SLOT = 1;
+static const size_t MIN_TABLE_CAPACITY = 64;
+static const uint8_t INT3 = 0xCC;
+// Breakpoints closer than this share one read and one write.
+static const uint64_t PATCH_MAX_GAP = 64;
+static const uint64_t PATCH_MAX_SPAN = 4096;
+static const size_t MAX_INSTRUCTION_LENGTH = 15;
+static const uint64_t ARITHMETIC_FLAGS = 0x8D5;     // CF PF AF ZF SF OF
+
+size_t breakpoint_table::slot_for(uint64_t address) const {
+    return static_cast<size_t>((address * 0x9E3779B97F4A7C15ull) >> 32) & (slots.size() - 1);
+}
+
+void breakpoint_table::rehash(size_t capacity) {
+    std::vector<breakpoint> old = std::move(slots);
+    slots.assign(capacity, breakpoint{});
+    used = 0;
+    live = 0;
+    for (const auto& slot : old) {
+        if (slot.address > REMOVED_SLOT) {
+            *insert(slot.address) = slot;
+        }
+    }
+}
+
+breakpoint* breakpoint_table::find(uint64_t address) {
+    if (slots.empty()) {
+        return nullptr;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t slot = slot_for(address);; slot = (slot + 1) & mask) {
+        if (slots[slot].address == address) {
+            return &slots[slot];
+        }
+        if (slots[slot].address == EMPTY_SLOT) {
+            return nullptr;
+        }
+    }
+}
+
+breakpoint* breakpoint_table::insert(uint64_t address) {
+    if ((used + 1) * 2 > slots.size()) {
+        // Mostly removed slots: rebuild at the same size instead of growing.
+        size_t capacity = (std::max)(slots.size(), MIN_TABLE_CAPACITY);
+        rehash((live + 1) * 2 > capacity / 2 ? capacity * 2 : capacity);
+    }
+
+    size_t mask = slots.size() - 1;
+    breakpoint* reuse = nullptr;
+    for (size_t slot = slot_for(address);; slot = (slot + 1) & mask) {
+        breakpoint& entry = slots[slot];
+        if (entry.address == address) {
+            return &entry;
+        }
+        if (entry.address == REMOVED_SLOT && !reuse) {
+            reuse = &entry;
+        }
+        if (entry.address == EMPTY_SLOT) {
+            if (!reuse) {
+                reuse = &entry;
+                used++;
+            }
+            live++;
+            *reuse = breakpoint{address, 0, 0, 0, false, false, breakpoint_emulation::none, 0, 0, 0};
+            return reuse;
+        }
+    }
+}
+
+bool breakpoint_table::erase(uint64_t address) {
+    breakpoint* entry = find(address);
+    if (!entry) {
+        return false;
+    }
+    entry->address = REMOVED_SLOT;
+    live--;
+    return true;
+}
+
+void breakpoint_table::clear() {
+    slots.clear();
+    used = 0;
+    live = 0;
+}
+
+void breakpoint_manager::bind(debug_event_source* event_source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    source = event_source;
+    total_hits = 0;
+}
+
+void breakpoint_manager::unbind() {
+    clear();
+    // Whatever could not be restored (the target exited, say) is dropped as well.
+    std::lock_guard<std::mutex> lock(mutex);
+    table.clear();
+    conditions.clear();
+    stepping.clear();
+    source = nullptr;
+}
+
+void breakpoint_manager::forget_conditions() {
+    for (auto condition = conditions.begin(); condition != conditions.end();) {
+        condition = table.find(condition->first) ? std::next(condition) : conditions.erase(condition);
+    }
+}
+
+size_t breakpoint_manager::write_bytes(std::vector<breakpoint*>& targets, bool arm) {
+    std::sort(targets.begin(), targets.end(), [] (const breakpoint* a, const breakpoint* b) {
+        return a->address < b->address;
+    });
+
+    struct span
+    {
+        size_t first;
+        size_t last;
+        uint64_t start;
+        size_t size;
+        size_t offset;
+        bool ok;
+    };
+    // Arming also reads the instruction after the last breakpoint to classify it.
+    size_t tail = arm ? MAX_INSTRUCTION_LENGTH : 0;
+    std::vector<span> spans;
+    size_t storage_size = 0;
+    for (size_t i = 0; i < targets.size(); i++) {
+        uint64_t address = targets[i]->address;
+        if (!spans.empty()) {
+            span& current = spans.back();
+            uint64_t end = current.start + current.size;
+            if (address - end < PATCH_MAX_GAP && address + 1 - current.start <= PATCH_MAX_SPAN) {
+                storage_size += static_cast<size_t>(address + 1 - end);
+                current.size = static_cast<size_t>(address + 1 - current.start);
+                current.last = i;
+                continue;
+            }
+        }
+        if (!spans.empty()) {
+            storage_size += tail;
+        }
+        spans.push_back(span{i, i, address, 1, storage_size, false});
+        storage_size += 1;
+    }
+    storage_size += tail;
+
+    std::vector<uint8_t> storage(storage_size);
+    std::vector<code_patch> patches;
+    std::vector<span*> patched;
+    for (auto& current : spans) {
+        uint8_t* bytes = storage.data() + current.offset;
+        size_t readable = current.size + tail;
+        if (!source->read_memory(current.start, bytes, readable)) {
+            // The tail may run off the end of the mapping.
+            readable = current.size;
+            if (!tail || !source->read_memory(current.start, bytes, readable)) {
+                continue;
+            }
+        }
+        for (size_t i = current.first; i <= current.last; i++) {
+            breakpoint* target = targets[i];
+            size_t offset = static_cast<size_t>(target->address - current.start);
+            uint8_t& byte = bytes[offset];
+            if (arm) {
+                if (!target->armed) {
+                    target->original = byte;
+                    classify(*target, bytes + offset, readable - offset);
+                }
+                byte = INT3;
+            }
+            else {
+                byte = target->original;
+            }
+        }
+        patches.push_back(code_patch{current.start, bytes, current.size});
+        patched.push_back(&current);
+        current.ok = true;
+    }
+
+    if (!patches.empty() && !source->write_code(patches.data(), patches.size())) {
+        // Find out which spans made it.
+        for (size_t i = 0; i < patches.size(); i++) {
+            patched[i]->ok = source->write_code(&patches[i], 1);
+        }
+    }
+
+    size_t written = 0;
+    for (const auto& current : spans) {
+        if (!current.ok) {
+            continue;
+        }
+        for (size_t i = current.first; i <= current.last; i++) {
+            targets[i]->armed = arm;
+            written++;
+        }
+    }
+    return written;
+}
+
+bool breakpoint_manager::write_byte(uint64_t address, uint8_t value) {
+    code_patch patch{address, &value, 1};
+    return source->write_code(&patch, 1);
+}
+
+bool breakpoint_manager::is_stepped_over(uint64_t address) const {
+    for (const auto& entry : stepping) {
+        if (entry.second == address) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void breakpoint_manager::classify(breakpoint& entry, const uint8_t* bytes, size_t size) {
+    entry.emulation = breakpoint_emulation::none;
+    entry.length = 0;
+    if (!emulation_enabled) {
+        return;
+    }
+
+    // Earlier breakpoints inside the instruction show up as int3s; look through them.
+    uint8_t code[MAX_INSTRUCTION_LENGTH] = {};
+    size = (std::min)(size, MAX_INSTRUCTION_LENGTH);
+    for (size_t i = 0; i < size; i++) {
+        code[i] = bytes[i];
+        if (i > 0 && code[i] == INT3) {
+            const breakpoint* other = table.find(entry.address + i);
+            if (other && other->armed) {
+                code[i] = other->original;
+            }
+        }
+    }
+    code[0] = entry.original;
+
+    auto set = [&] (breakpoint_emulation emulation, size_t length, uint8_t reg, int32_t immediate) {
+        if (length <= size) {
+            entry.emulation = emulation;
+            entry.length = static_cast<uint8_t>(length);
+            entry.reg = reg;
+            entry.immediate = immediate;
+        }
+    };
+
+    // nop, xchg ax, ax, endbr64/endbr32
+    if (code[0] == 0x90) {
+        set(breakpoint_emulation::skip, 1, 0, 0);
+        return;
+    }
+    if (code[0] == 0x66 && code[1] == 0x90) {
+        set(breakpoint_emulation::skip, 2, 0, 0);
+        return;
+    }
+    if (code[0] == 0xF3 && code[1] == 0x0F && code[2] == 0x1E && (code[3] == 0xFA || code[3] == 0xFB)) {
+        set(breakpoint_emulation::skip, 4, 0, 0);
+        return;
+    }
+
+    // Multi-byte nop: [66]* 0F 1F /0
+    size_t prefixes = 0;
+    while (prefixes < 4 && code[prefixes] == 0x66) {
+        prefixes++;
+    }
+    if (code[prefixes] == 0x0F && code[prefixes + 1] == 0x1F) {
+        uint8_t modrm = code[prefixes + 2];
+        uint8_t mod = modrm >> 6;
+        uint8_t rm = modrm & 7;
+        size_t length = prefixes + 3;
+        if (mod != 3 && rm == 4) {
+            length += 1;
+            if (mod == 0 && (code[prefixes + 3] & 7) == 5) {
+                length += 4;
+            }
+        }
+        if (mod == 0 && rm == 5) {
+            length += 4;
+        }
+        length += mod == 1 ? 1 : mod == 2 ? 4 : 0;
+        set(breakpoint_emulation::skip, length, 0, 0);
+        return;
+    }
+
+    // push r64
+    if (code[0] >= 0x50 && code[0] <= 0x57) {
+        set(breakpoint_emulation::push, 1, code[0] - 0x50, 0);
+        return;
+    }
+    if (code[0] == 0x41 && code[1] >= 0x50 && code[1] <= 0x57) {
+        set(breakpoint_emulation::push, 2, code[1] - 0x50 + 8, 0);
+        return;
+    }
+
+    if (code[0] == 0x48) {
+        // mov rbp, rsp (both encodings)
+        if ((code[1] == 0x89 && code[2] == 0xE5) || (code[1] == 0x8B && code[2] == 0xEC)) {
+            set(breakpoint_emulation::mov_rbp_rsp, 3, 0, 0);
+            return;
+        }
+        // sub rsp, imm8 / imm32
+        if (code[1] == 0x83 && code[2] == 0xEC) {
+            set(breakpoint_emulation::sub_rsp, 4, 0, static_cast<int8_t>(code[3]));
+            return;
+        }
+        if (code[1] == 0x81 && code[2] == 0xEC) {
+            int32_t immediate = static_cast<int32_t>(code[3] | code[4] << 8 | code[5] << 16 | static_cast<uint32_t>(code[6]) << 24);
+            set(breakpoint_emulation::sub_rsp, 7, 0, immediate);
+            return;
+        }
+    }
+
+    // mov [rsp+disp8/disp32], r64 (register home spills)
+    if ((code[0] == 0x48 || code[0] == 0x4C) && code[1] == 0x89 && (code[2] & 7) == 4 && code[3] == 0x24) {
+        uint8_t mod = code[2] >> 6;
+        uint8_t reg = ((code[2] >> 3) & 7) + (code[0] == 0x4C ? 8 : 0);
+        if (mod == 1) {
+            set(breakpoint_emulation::store_rsp, 5, reg, static_cast<int8_t>(code[4]));
+        }
+        else if (mod == 2) {
+            int32_t immediate = static_cast<int32_t>(code[4] | code[5] << 8 | code[6] << 16 | static_cast<uint32_t>(code[7]) << 24);
+            set(breakpoint_emulation::store_rsp, 8, reg, immediate);
+        }
+    }
+}
+
+bool breakpoint_manager::emulate(const breakpoint& entry, uint32_t tid, thread_registers& registers) {
+    uint64_t& rsp = registers[x86_register::rsp];
+    switch (entry.emulation) {
+    case breakpoint_emulation::skip:
+        break;
+    case breakpoint_emulation::push: {
+        uint64_t value = registers.gpr[entry.reg];
+        if (!source->write_memory(rsp - 8, &value, sizeof(value))) {
+            return false;
+        }
+        rsp -= 8;
+        break;
+    }
+    case breakpoint_emulation::mov_rbp_rsp:
+        registers[x86_register::rbp] = rsp;
+        break;
+    case breakpoint_emulation::sub_rsp: {
+        uint64_t a = rsp;
+        uint64_t b = static_cast<uint64_t>(static_cast<int64_t>(entry.immediate));
+        uint64_t result = a - b;
+        uint8_t parity = static_cast<uint8_t>(result);
+        parity ^= parity >> 4;
+        parity ^= parity >> 2;
+        parity ^= parity >> 1;
+        uint64_t flags = registers.rflags & ~ARITHMETIC_FLAGS;
+        flags |= a < b ? 0x1 : 0;
+        flags |= (parity & 1) ? 0 : 0x4;
+        flags |= (a ^ b ^ result) & 0x10;
+        flags |= result == 0 ? 0x40 : 0;
+        flags |= (result >> 63) ? 0x80 : 0;
+        flags |= (((a ^ b) & (a ^ result)) >> 63) ? 0x800 : 0;
+        registers.rflags = flags;
+        rsp = result;
+        break;
+    }
+    case breakpoint_emulation::store_rsp: {
+        uint64_t value = registers.gpr[entry.reg];
+        if (!source->write_memory(rsp + static_cast<int64_t>(entry.immediate), &value, sizeof(value))) {
+            return false;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    registers.rip = entry.address + entry.length;
+    return source->set_registers(tid, registers);
+}
+
+size_t breakpoint_manager::add(const std::vector<uint64_t>& addresses) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source) {
+        return 0;
+    }
+
+    std::vector<uint64_t> fresh;
+    for (uint64_t address : addresses) {
+        if (address > REMOVED_SLOT && !table.find(address)) {
+            fresh.push_back(address);
+        }
+    }
+    std::sort(fresh.begin(), fresh.end());
+    fresh.erase(std::unique(fresh.begin(), fresh.end()), fresh.end());
+
+    // Insert everything first: a rehash would invalidate earlier pointers.
+    for (uint64_t address : fresh) {
+        table.insert(address);
+    }
+    std::vector<breakpoint*> targets;
+    targets.reserve(fresh.size());
+    for (uint64_t address : fresh) {
+        targets.push_back(table.find(address));
+    }
+
+    size_t armed = write_bytes(targets, true);
+    if (armed != fresh.size()) {
+        for (uint64_t address : fresh) {
+            if (!table.find(address)->armed) {
+                table.erase(address);
+            }
+        }
+    }
+    return armed;
+}
+
+size_t breakpoint_manager::remove(const std::vector<uint64_t>& addresses) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source) {
+        return 0;
+    }
+
+    std::vector<breakpoint*> armed;
+    std::vector<uint64_t> found;
+    for (uint64_t address : addresses) {
+        breakpoint* entry = table.find(address);
+        if (!entry) {
+            continue;
+        }
+        found.push_back(address);
+        if (entry->armed) {
+            armed.push_back(entry);
+        }
+    }
+    write_bytes(armed, false);
+
+    // A breakpoint whose int3 could not be restored stays in the table rather than leaking a trap.
+    size_t removed = 0;
+    for (uint64_t address : found) {
+        breakpoint* entry = table.find(address);
+        if (entry && !entry->armed) {
+            removed += table.erase(address) ? 1 : 0;
+        }
+    }
+    if (removed && !conditions.empty()) {
+        forget_conditions();
+    }
+    return removed;
+}
+
+size_t breakpoint_manager::clear() {
+    std::vector<uint64_t> addresses;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        table.for_each([&] (const breakpoint& entry) {
+            addresses.push_back(entry.address);
+        });
+    }
+    return remove(addresses);
+}
+
+bool breakpoint_manager::on_exception(const debug_event& event) {
+    if (event.code == DEBUG_EXCEPTION_BREAKPOINT) {
+        std::lock_guard<std::mutex> lock(mutex);
+        breakpoint* entry = source ? table.find(event.address) : nullptr;
+        if (!entry) {
+            return false;
+        }
+        // Another thread may have executed the int3 before this hit disarmed it; it is still ours.
+        // One register read serves both the condition and the emulation.
+        bool emulated = entry->armed && entry->emulation != breakpoint_emulation::none;
+        thread_registers registers;
+        bool have_registers = (emulated || entry->conditional) && source->get_registers(event.tid, registers);
+        bool met = true;
+        if (entry->conditional) {
+            uint64_t value = 0;
+            registers.rip = entry->address;
+            met = have_registers && conditions[entry->address].evaluate(registers, source, value) && value;
+        }
+        if (met) {
+            entry->hits++;
+            total_hits++;
+        }
+        else {
+            entry->misses++;
+        }
+        if (emulated && have_registers && emulate(*entry, event.tid, registers)) {
+            return true;
+        }
+        if (entry->armed && write_byte(entry->address, entry->original)) {
+            entry->armed = false;
+        }
+        stepping[event.tid] = entry->address;
+        source->step_from(event.tid, entry->address);
+        return true;
+    }
+
+    if (event.code == DEBUG_EXCEPTION_SINGLE_STEP) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto step = stepping.find(event.tid);
+        if (step == stepping.end()) {
+            return false;
+        }
+        uint64_t address = step->second;
+        stepping.erase(step);
+        breakpoint* entry = table.find(address);
+        if (entry && !entry->armed && !is_stepped_over(address) && write_byte(address, INT3)) {
+            entry->armed = true;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool breakpoint_manager::set_condition(uint64_t address, const std::string& expression, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    breakpoint* entry = table.find(address);
+    if (!entry) {
+        error = "no breakpoint at that address";
+        return false;
+    }
+    if (expression.find_first_not_of(" \t") == std::string::npos) {
+        conditions.erase(address);
+        entry->conditional = false;
+        return true;
+    }
+    breakpoint_condition condition;
+    if (!condition.compile(expression, error)) {
+        return false;
+    }
+    conditions[address] = std::move(condition);
+    entry->conditional = true;
+    entry->hits = 0;
+    entry->misses = 0;
+    return true;
+}
+
+std::string breakpoint_manager::get_condition(uint64_t address) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto condition = conditions.find(address);
+    return condition != conditions.end() ? condition->second.get_text() : std::string();
+}
+
+std::vector<breakpoint> breakpoint_manager::list() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<breakpoint> entries;
+    entries.reserve(table.size());
+    table.for_each([&] (const breakpoint& entry) {
+        entries.push_back(entry);
+    });
+    std::sort(entries.begin(), entries.end(), [] (const breakpoint& a, const breakpoint& b) {
+        return a.address < b.address;
+    });
+    return entries;
+}
+
+uint64_t breakpoint_manager::get_total_hits() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total_hits;
+}
+
+void breakpoint_manager::set_emulation(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex);
+    emulation_enabled = enabled;
+}
@@ -0,0 +1,114 @@
+#ifndef BREAKPOINTS_H
+#define BREAKPOINTS_H
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "debug_event_source.h"
+#include "breakpoint_condition.h"
+
+// Instructions a hit can execute on the target's behalf, leaving the int3 in place.
+enum class breakpoint_emulation : uint8_t
+{
+    none,               // step over it
+    skip,               // nop, endbr64
+    push,               // push reg
+    mov_rbp_rsp,
+    sub_rsp,            // sub rsp, immediate
+    store_rsp           // mov [rsp+immediate], reg
+};
+
+struct breakpoint
+{
+    uint64_t address;
+    uint64_t hits;              // with a condition: executions where it held
+    uint64_t misses;            // executions where the condition was false or failed
+    uint8_t original;
+    bool armed;
+    bool conditional;
+    breakpoint_emulation emulation;
+    uint8_t length;
+    uint8_t reg;
+    int32_t immediate;
+};
+
+// Open-addressed breakpoint table keyed by address (linear probing, power-of-two capacity,
+// at most half full). Address 0 marks an empty slot and 1 a removed one; neither is code.
+class breakpoint_table
+{
+    std::vector<breakpoint> slots;
+    size_t used;
+    size_t live;
+
+    size_t slot_for(uint64_t address) const;
+    void rehash(size_t capacity);
+public:
+    breakpoint_table() : used(0), live(0) {}
+
+    breakpoint* find(uint64_t address);
+    breakpoint* insert(uint64_t address);
+    bool erase(uint64_t address);
+    void clear();
+    size_t size() const { return live; }
+
+    template<typename F>
+    void for_each(F callback) {
+        for (auto& slot : slots) {
+            if (slot.address > 1) {
+                callback(slot);
+            }
+        }
+    }
+};
+
+// int3 breakpoints for one bound event source. Everything but list() and hit totals runs on
+// the debugger thread. When the original instruction is a simple prologue one (see
+// breakpoint_emulation) a hit executes it by editing registers and stack, so the int3 never
+// leaves. Otherwise the hit puts the original byte back, rewinds the thread onto it and
+// single-steps it; the step's trap re-arms the int3. Other threads passing the address while
+// it is disarmed are not counted. A breakpoint with a condition counts a hit only when the
+// condition holds; it is evaluated here, on the same stop, and the thread goes on either way.
+class breakpoint_manager
+{
+    std::mutex mutex;
+    breakpoint_table table;
+    std::unordered_map<uint64_t, breakpoint_condition> conditions;
+    // Thread -> breakpoint it is stepping over.
+    std::unordered_map<uint32_t, uint64_t> stepping;
+    debug_event_source* source;
+    uint64_t total_hits;
+    bool emulation_enabled;
+
+    // Reads the bytes around nearby breakpoints once and writes them back as one patch each.
+    size_t write_bytes(std::vector<breakpoint*>& targets, bool arm);
+    bool write_byte(uint64_t address, uint8_t value);
+    bool is_stepped_over(uint64_t address) const;
+    void classify(breakpoint& entry, const uint8_t* code, size_t size);
+    bool emulate(const breakpoint& entry, uint32_t tid, thread_registers& registers);
+    void forget_conditions();
+public:
+    breakpoint_manager() : source(nullptr), total_hits(0), emulation_enabled(true) {}
+
+    void bind(debug_event_source* event_source);
+    // Restores every original byte and forgets all breakpoints.
+    void unbind();
+
+    // Returns how many breakpoints were set (or removed); unreadable addresses are skipped.
+    size_t add(const std::vector<uint64_t>& addresses);
+    size_t remove(const std::vector<uint64_t>& addresses);
+    size_t clear();
+    // Compiles expression (see breakpoint_condition) for the breakpoint at address; an empty
+    // expression removes the condition. False with a message in error otherwise.
+    bool set_condition(uint64_t address, const std::string& expression, std::string& error);
+    std::string get_condition(uint64_t address);
+
+    // Exception handler: true for the int3s and single steps this manager caused.
+    bool on_exception(const debug_event& event);
+
+    std::vector<breakpoint> list();
+    uint64_t get_total_hits();
+    // Off: every hit single-steps. Applies to breakpoints added afterwards.
+    void set_emulation(bool enabled);
+};
+#endif // !BREAKPOINTS_H
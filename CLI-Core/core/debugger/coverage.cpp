@@ -0,0 +1,301 @@
+#include "coverage.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+static const char COVERAGE_MAGIC[8] = { 'M', 'S', 'C', 'O', 'V', '1', 0, 0 };
+static const uint8_t INT3 = 0xCC;
+static const size_t NO_BLOCK = static_cast<size_t>(-1);
+// Blocks closer than the gap share one read and one write, up to a span of this size.
+static const uint64_t COVERAGE_MAX_GAP = 0x1000;
+static const uint64_t COVERAGE_MAX_SPAN = 0x10000;
+
+static bool test_bit(const std::vector<uint64_t>& bits, size_t index) {
+    return (bits[index / 64] >> (index % 64)) & 1;
+}
+
+static void set_bit(std::vector<uint64_t>& bits, size_t index, bool value) {
+    uint64_t mask = 1ull << (index % 64);
+    bits[index / 64] = value ? (bits[index / 64] | mask) : (bits[index / 64] & ~mask);
+}
+
+size_t coverage_map::count() const {
+    size_t total = 0;
+    for (uint64_t word : bits) {
+        for (; word; word &= word - 1) {
+            total++;
+        }
+    }
+    return total;
+}
+
+bool coverage_map::save(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    uint32_t name_size = static_cast<uint32_t>(module.size());
+    uint64_t count = offsets.size();
+    bool written = fwrite(COVERAGE_MAGIC, sizeof(COVERAGE_MAGIC), 1, file) == 1 &&
+                   fwrite(&name_size, sizeof(name_size), 1, file) == 1 &&
+                   fwrite(module.data(), 1, name_size, file) == name_size &&
+                   fwrite(&count, sizeof(count), 1, file) == 1 &&
+                   fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), file) == offsets.size() &&
+                   fwrite(bits.data(), sizeof(uint64_t), bits.size(), file) == bits.size();
+    return fclose(file) == 0 && written;
+}
+
+bool coverage_map::load(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    char magic[sizeof(COVERAGE_MAGIC)] = {};
+    uint32_t name_size = 0;
+    uint64_t count = 0;
+    bool read = fread(magic, sizeof(magic), 1, file) == 1 && memcmp(magic, COVERAGE_MAGIC, sizeof(magic)) == 0 &&
+                fread(&name_size, sizeof(name_size), 1, file) == 1 && name_size < 4096;
+    if (read) {
+        module.assign(name_size, '\0');
+        read = fread(&module[0], 1, name_size, file) == name_size && fread(&count, sizeof(count), 1, file) == 1 && count < (1ull << 32);
+    }
+    if (read) {
+        offsets.resize(static_cast<size_t>(count));
+        bits.assign(static_cast<size_t>((count + 63) / 64), 0);
+        read = fread(offsets.data(), sizeof(uint32_t), offsets.size(), file) == offsets.size() &&
+               fread(bits.data(), sizeof(uint64_t), bits.size(), file) == bits.size();
+    }
+    fclose(file);
+    return read;
+}
+
+bool coverage_diff(const coverage_map& a, const coverage_map& b, std::vector<uint32_t>& only_a, std::vector<uint32_t>& only_b) {
+    if (a.offsets != b.offsets || a.bits.size() != b.bits.size()) {
+        return false;
+    }
+    for (size_t word = 0; word < a.bits.size(); word++) {
+        for (uint64_t differ = a.bits[word] ^ b.bits[word]; differ; differ &= differ - 1) {
+            size_t bit = 0;
+            while (!((differ >> bit) & 1)) {
+                bit++;
+            }
+            size_t index = word * 64 + bit;
+            (a.is_hit(index) ? only_a : only_b).push_back(a.offsets[index]);
+        }
+    }
+    return true;
+}
+
+bool load_block_list(const std::string& path, uint64_t module_base, std::vector<uint64_t>& blocks) {
+    std::ifstream file(path);
+    if (!file) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos) {
+            continue;
+        }
+        char* end = nullptr;
+        uint64_t offset = strtoull(line.c_str() + first, &end, 16);
+        if (end == line.c_str() + first) {
+            return false;
+        }
+        blocks.push_back(module_base + offset);
+    }
+    return true;
+}
+
+void coverage_collector::bind(debug_event_source* event_source) {
+    source = event_source;
+}
+
+void coverage_collector::unbind() {
+    if (source) {
+        stop();
+    }
+    blocks.clear();
+    originals.clear();
+    owned.clear();
+    armed.clear();
+    hit.clear();
+    source = nullptr;
+}
+
+size_t coverage_collector::find(uint64_t address) const {
+    auto block = std::lower_bound(blocks.begin(), blocks.end(), address);
+    return block != blocks.end() && *block == address ? static_cast<size_t>(block - blocks.begin()) : NO_BLOCK;
+}
+
+size_t coverage_collector::patch(bool arm) {
+    struct span
+    {
+        size_t first;
+        size_t last;
+        uint64_t start;
+        size_t size;
+        size_t offset;
+    };
+    std::vector<size_t> targets;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (arm ? !test_bit(owned, i) : test_bit(armed, i)) {
+            targets.push_back(i);
+        }
+    }
+
+    std::vector<span> spans;
+    size_t storage_size = 0;
+    for (size_t t = 0; t < targets.size(); t++) {
+        uint64_t address = blocks[targets[t]];
+        if (!spans.empty()) {
+            span& current = spans.back();
+            uint64_t end = current.start + current.size;
+            if (address - end < COVERAGE_MAX_GAP && address + 1 - current.start <= COVERAGE_MAX_SPAN) {
+                storage_size += static_cast<size_t>(address + 1 - end);
+                current.size = static_cast<size_t>(address + 1 - current.start);
+                current.last = t;
+                continue;
+            }
+        }
+        spans.push_back(span{t, t, address, 1, storage_size});
+        storage_size++;
+    }
+
+    std::vector<uint8_t> storage(storage_size);
+    std::vector<uint8_t> changed(targets.size(), 0);
+    std::vector<code_patch> patches;
+    std::vector<size_t> patched_spans;
+    for (size_t s = 0; s < spans.size(); s++) {
+        const span& current = spans[s];
+        if (!source->read_memory(current.start, storage.data() + current.offset, current.size)) {
+            continue;
+        }
+        bool any = false;
+        for (size_t t = current.first; t <= current.last; t++) {
+            size_t i = targets[t];
+            uint8_t& byte = storage[current.offset + static_cast<size_t>(blocks[i] - current.start)];
+            if (arm) {
+                // Someone else's int3: leave the block out rather than take it over.
+                if (byte == INT3) {
+                    continue;
+                }
+                originals[i] = byte;
+                byte = INT3;
+            }
+            else {
+                byte = originals[i];
+            }
+            changed[t] = 1;
+            any = true;
+        }
+        if (any) {
+            patches.push_back(code_patch{current.start, storage.data() + current.offset, current.size});
+            patched_spans.push_back(s);
+        }
+    }
+
+    std::vector<bool> written(patches.size(), true);
+    if (!patches.empty() && !source->write_code(patches.data(), patches.size())) {
+        for (size_t p = 0; p < patches.size(); p++) {
+            written[p] = source->write_code(&patches[p], 1);
+        }
+    }
+
+    size_t count = 0;
+    for (size_t p = 0; p < patches.size(); p++) {
+        if (!written[p]) {
+            continue;
+        }
+        const span& current = spans[patched_spans[p]];
+        for (size_t t = current.first; t <= current.last; t++) {
+            if (!changed[t]) {
+                continue;
+            }
+            if (arm) {
+                set_bit(owned, targets[t], true);
+            }
+            set_bit(armed, targets[t], arm);
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t coverage_collector::start(const module_range& target, std::vector<uint64_t> block_addresses) {
+    stop();
+    std::sort(block_addresses.begin(), block_addresses.end());
+    block_addresses.erase(std::unique(block_addresses.begin(), block_addresses.end()), block_addresses.end());
+    block_addresses.erase(std::remove_if(block_addresses.begin(), block_addresses.end(), [&] (uint64_t address) {
+        return address - target.base >= target.size;
+    }), block_addresses.end());
+
+    module = target;
+    blocks = std::move(block_addresses);
+    originals.assign(blocks.size(), 0);
+    size_t words = (blocks.size() + 63) / 64;
+    owned.assign(words, 0);
+    armed.assign(words, 0);
+    hit.assign(words, 0);
+    hits.store(0);
+    if (!source) {
+        armed_count.store(0);
+        return 0;
+    }
+    size_t count = patch(true);
+    armed_count.store(count);
+    return count;
+}
+
+size_t coverage_collector::stop() {
+    if (!source || !armed_count.load()) {
+        return 0;
+    }
+    size_t count = patch(false);
+    armed_count.store(armed_count.load() - count);
+    return count;
+}
+
+bool coverage_collector::on_exception(const debug_event& event) {
+    if (event.code != DEBUG_EXCEPTION_BREAKPOINT || blocks.empty()) {
+        return false;
+    }
+    size_t index = find(event.address);
+    if (index == NO_BLOCK || !test_bit(owned, index)) {
+        return false;
+    }
+    // Another thread may have reached the int3 before the first hit removed it; it only
+    // needs rewinding.
+    if (test_bit(armed, index)) {
+        code_patch restore = { blocks[index], &originals[index], 1 };
+        if (!source->write_code(&restore, 1)) {
+            return false;
+        }
+        set_bit(armed, index, false);
+        armed_count.store(armed_count.load() - 1);
+    }
+    if (!test_bit(hit, index)) {
+        set_bit(hit, index, true);
+        hits.store(hits.load() + 1);
+    }
+    thread_registers registers;
+    if (source->get_registers(event.tid, registers)) {
+        registers.rip = blocks[index];
+        source->set_registers(event.tid, registers);
+    }
+    return true;
+}
+
+coverage_map coverage_collector::snapshot() const {
+    coverage_map map;
+    map.module = module.name;
+    map.offsets.reserve(blocks.size());
+    for (uint64_t block : blocks) {
+        map.offsets.push_back(static_cast<uint32_t>(block - module.base));
+    }
+    map.bits = hit;
+    return map;
+}
@@ -0,0 +1,70 @@
+#ifndef COVERAGE_H
+#define COVERAGE_H
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "debug_event_source.h"
+#include "modules.h"
+
+// Which blocks of a module one run reached: block offsets from the module base, sorted, and
+// one bit per block. Two maps of the same block list diff by XOR.
+struct coverage_map
+{
+    std::string module;
+    std::vector<uint32_t> offsets;
+    std::vector<uint64_t> bits;
+
+    bool is_hit(size_t index) const { return (bits[index / 64] >> (index % 64)) & 1; }
+    size_t count() const;
+    bool save(const std::string& path) const;
+    bool load(const std::string& path);
+};
+
+// Blocks hit in exactly one of the maps, split by side. False when the block lists differ.
+bool coverage_diff(const coverage_map& a, const coverage_map& b, std::vector<uint32_t>& only_a, std::vector<uint32_t>& only_b);
+
+// Block lists: one hex offset from the module base per line, '#' starts a comment.
+bool load_block_list(const std::string& path, uint64_t module_base, std::vector<uint64_t>& blocks);
+
+// Basic-block coverage with one-shot int3s. Every block start gets an int3; the first hit
+// puts the original byte back, rewinds the thread onto it and sets the block's bit, so each
+// block costs one event at most. Arming and disarming read and write nearby blocks as one
+// patch. Debugger thread only (through execute()), apart from get_hits().
+class coverage_collector
+{
+    debug_event_source* source;
+    module_range module;
+    std::vector<uint64_t> blocks;
+    std::vector<uint8_t> originals;
+    // Blocks that carry (or carried) our int3, blocks that still do, blocks hit.
+    std::vector<uint64_t> owned;
+    std::vector<uint64_t> armed;
+    std::vector<uint64_t> hit;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> armed_count;
+
+    size_t patch(bool arm);
+    size_t find(uint64_t address) const;
+public:
+    coverage_collector() : source(nullptr), hits(0), armed_count(0) {}
+
+    void bind(debug_event_source* event_source);
+    // Removes every int3 still armed and forgets the run.
+    void unbind();
+
+    // Replaces the previous run. Returns how many blocks were armed; addresses outside the
+    // module, unreadable ones and ones already holding an int3 are skipped.
+    size_t start(const module_range& target, std::vector<uint64_t> block_addresses);
+    // Removes the int3s not hit yet; the map stays until the next start().
+    size_t stop();
+
+    // Exception handler: true for int3s this collector placed.
+    bool on_exception(const debug_event& event);
+
+    uint64_t get_hits() const { return hits.load(); }
+    uint64_t get_armed() const { return armed_count.load(); }
+    size_t get_blocks() const { return blocks.size(); }
+    coverage_map snapshot() const;
+};
+#endif // !COVERAGE_H
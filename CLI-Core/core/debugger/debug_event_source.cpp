@@ -0,0 +1,71 @@
+#include "debug_event_source.h"
+
+#if defined(_WIN32) && defined(_M_X64)
+std::unique_ptr<debug_event_source> create_win32_event_source();
+#elif defined(__linux__) && defined(__x86_64__)
+std::unique_ptr<debug_event_source> create_ptrace_event_source();
+#endif
+
+std::unique_ptr<debug_event_source> create_debug_event_source() {
+#if defined(_WIN32) && defined(_M_X64)
+    return create_win32_event_source();
+#elif defined(__linux__) && defined(__x86_64__)
+    return create_ptrace_event_source();
+#else
+    return nullptr;
+#endif
+}
+
+const char* debug_event_type_name(debug_event_type type) {
+    switch (type) {
+    case debug_event_type::create_process: return "create_process";
+    case debug_event_type::exit_process: return "exit_process";
+    case debug_event_type::create_thread: return "create_thread";
+    case debug_event_type::exit_thread: return "exit_thread";
+    case debug_event_type::load_module: return "load_module";
+    case debug_event_type::unload_module: return "unload_module";
+    case debug_event_type::output_string: return "output_string";
+    case debug_event_type::exception: return "exception";
+    case debug_event_type::signal: return "signal";
+    default: return "unknown";
+    }
+}
+
+const char* debug_exception_name(uint32_t code) {
+    switch (code) {
+    case DEBUG_EXCEPTION_GUARD_PAGE: return "guard_page";
+    case DEBUG_EXCEPTION_DATATYPE_MISALIGNMENT: return "datatype_misalignment";
+    case DEBUG_EXCEPTION_BREAKPOINT: return "breakpoint";
+    case DEBUG_EXCEPTION_SINGLE_STEP: return "single_step";
+    case DEBUG_EXCEPTION_ACCESS_VIOLATION: return "access_violation";
+    case DEBUG_EXCEPTION_ILLEGAL_INSTRUCTION: return "illegal_instruction";
+    case DEBUG_EXCEPTION_INT_DIVIDE_BY_ZERO: return "int_divide_by_zero";
+    case DEBUG_EXCEPTION_STACK_OVERFLOW: return "stack_overflow";
+    default: return nullptr;
+    }
+}
+
+void debug_event_dispatcher::register_handler(debug_event_type type, debug_event_handler handler) {
+    handlers[static_cast<size_t>(type)].push_back(std::move(handler));
+}
+
+continue_action debug_event_dispatcher::dispatch(const debug_event& event) {
+    bool owned = false;
+    for (auto& handler : handlers[static_cast<size_t>(event.type)]) {
+        owned |= handler(event);
+    }
+    return owned ? continue_action::handled : default_action(event);
+}
+
+continue_action debug_event_dispatcher::default_action(const debug_event& event) {
+    if (event.type == debug_event_type::signal) {
+        return continue_action::not_handled;
+    }
+    if (event.type != debug_event_type::exception) {
+        return continue_action::handled;
+    }
+    if (event.code == DEBUG_EXCEPTION_BREAKPOINT || event.code == DEBUG_EXCEPTION_SINGLE_STEP) {
+        return continue_action::handled;
+    }
+    return event.first_chance ? continue_action::not_handled : continue_action::handled;
+}
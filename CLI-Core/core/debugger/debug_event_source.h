@@ -0,0 +1,170 @@
+#ifndef DEBUG_EVENT_SOURCE_H
+#define DEBUG_EVENT_SOURCE_H
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Exception codes in debug_event::code. These are the Win32 values; the Linux
+// source maps the matching signals onto them.
+const uint32_t DEBUG_EXCEPTION_GUARD_PAGE = 0x80000001;
+const uint32_t DEBUG_EXCEPTION_DATATYPE_MISALIGNMENT = 0x80000002;
+const uint32_t DEBUG_EXCEPTION_BREAKPOINT = 0x80000003;
+const uint32_t DEBUG_EXCEPTION_SINGLE_STEP = 0x80000004;
+const uint32_t DEBUG_EXCEPTION_ACCESS_VIOLATION = 0xC0000005;
+const uint32_t DEBUG_EXCEPTION_ILLEGAL_INSTRUCTION = 0xC000001D;
+const uint32_t DEBUG_EXCEPTION_INT_DIVIDE_BY_ZERO = 0xC0000094;
+const uint32_t DEBUG_EXCEPTION_STACK_OVERFLOW = 0xC00000FD;
+
+enum class debug_event_type
+{
+    create_process,
+    exit_process,
+    create_thread,
+    exit_thread,
+    load_module,
+    unload_module,
+    output_string,
+    exception,
+    signal,             // Linux: a signal with no exception equivalent; code is the signal number
+    unknown,
+    count
+};
+
+enum class continue_action
+{
+    handled,            // resume the thread; the target never sees the exception
+    not_handled         // pass the exception (or signal) on to the target
+};
+
+enum class wait_status
+{
+    event,
+    woken,
+    timeout,
+    failed
+};
+
+const uint32_t WAIT_FOREVER = 0xFFFFFFFF;
+
+struct debug_event
+{
+    debug_event_type type;
+    uint32_t pid;
+    uint32_t tid;
+    // exception: faulting instruction (the int3 itself for breakpoints); create_process,
+    // load_module, unload_module: image base; create_thread: start address (Windows);
+    // output_string: string address in the target.
+    uint64_t address;
+    // exception: access violation or guard page target (data address), otherwise 0.
+    uint64_t fault_address;
+    // exception: DEBUG_EXCEPTION_*; signal: signal number; exit_*: exit code.
+    uint32_t code;
+    bool first_chance;
+    // DEBUG_EVENT* on Windows, null elsewhere. Valid until resume().
+    const void* native;
+};
+
+enum class x86_register : uint8_t
+{
+    rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+    r8, r9, r10, r11, r12, r13, r14, r15
+};
+
+// Integer registers of a stopped thread; gpr is in instruction-encoding order.
+struct thread_registers
+{
+    uint64_t gpr[16];
+    uint64_t rip;
+    uint64_t rflags;
+
+    uint64_t& operator[](x86_register reg) { return gpr[static_cast<size_t>(reg)]; }
+};
+
+// Dr0-Dr3 and Dr7 as the hardware encodes them.
+struct debug_registers
+{
+    uint64_t address[4];
+    uint64_t control;
+};
+
+typedef std::function<void(size_t index, const thread_registers& registers)> thread_sample_callback;
+
+struct code_patch
+{
+    uint64_t address;
+    const uint8_t* data;
+    size_t size;
+};
+
+// One traced process. Every call except wake() must come from the thread that called attach()
+// (ptrace and the Win32 debug API both tie the debuggee to that thread).
+class debug_event_source
+{
+public:
+    virtual ~debug_event_source() {}
+
+    virtual bool attach(uint32_t pid) = 0;
+    virtual bool detach() = 0;
+    // Blocks until the target reports an event, wake() is called or timeout_ms passes.
+    virtual wait_status wait(debug_event& event, uint32_t timeout_ms) = 0;
+    wait_status wait(debug_event& event) { return wait(event, WAIT_FOREVER); }
+    // Lets the thread that reported event run again. Every event from wait() must be resumed.
+    virtual bool resume(const debug_event& event, continue_action action) = 0;
+    // Thread-safe. The pending or next wait() returns wait_status::woken.
+    virtual void wake() = 0;
+
+    virtual bool read_memory(uint64_t address, void* buffer, size_t size) = 0;
+    virtual bool write_memory(uint64_t address, const void* buffer, size_t size) = 0;
+    // Writes code regardless of page protection; the whole batch shares one instruction-cache flush.
+    virtual bool write_code(const code_patch* patches, size_t count) = 0;
+    // Moves the thread stopped at the current event to address and makes it trap after one
+    // instruction (a DEBUG_EXCEPTION_SINGLE_STEP event) once resumed.
+    virtual bool step_from(uint32_t tid, uint64_t address) = 0;
+    // Makes a thread, running or stopped at the current event, report a
+    // DEBUG_EXCEPTION_SINGLE_STEP after its next instruction.
+    virtual bool request_step(uint32_t tid) = 0;
+    // Registers of the thread stopped at the current event.
+    virtual bool get_registers(uint32_t tid, thread_registers& registers) = 0;
+    virtual bool set_registers(uint32_t tid, const thread_registers& registers) = 0;
+
+    // Threads of the target seen so far (creation events may still be queued).
+    virtual std::vector<uint32_t> get_threads() = 0;
+    // Loads registers (Dr6 cleared) into each listed thread as one batch: running threads are
+    // suspended first and resumed after the last write. written[i] reports tids[i].
+    virtual size_t set_debug_registers(const uint32_t* tids, size_t count, const debug_registers& registers, bool* written) = 0;
+    // Suspends every listed thread as one batch, calls back with each one's registers (index
+    // into tids) while all of them are still held, then lets them run again. The callback may
+    // read memory, so stacks are walked before any thread moves. Returns the threads sampled.
+    virtual size_t sample_threads(const uint32_t* tids, size_t count, const thread_sample_callback& callback) = 0;
+    // Reads and clears Dr6 of the thread stopped at the current event.
+    virtual bool take_debug_status(uint32_t tid, uint64_t& status) = 0;
+
+    // Makes the pages covering [address, address + size) fault on their next access, or puts
+    // back the protection they had. A fault on a guarded page is reported as
+    // DEBUG_EXCEPTION_GUARD_PAGE and unguards that page, like PAGE_GUARD on Windows.
+    virtual bool guard_pages(uint64_t address, size_t size, bool guard) = 0;
+};
+
+// Win32 debug API on x64 Windows, ptrace on x86-64 Linux, null elsewhere (32-bit builds
+// included: the sources read x64 registers).
+std::unique_ptr<debug_event_source> create_debug_event_source();
+
+const char* debug_event_type_name(debug_event_type type);
+// Name of a DEBUG_EXCEPTION_* code, or null for any other.
+const char* debug_exception_name(uint32_t code);
+
+// Handlers return true when they own the event (a breakpoint they set, say). An exception
+// nobody owns gets the default policy: breakpoints and single steps are continued, other
+// first-chance exceptions and signals go to the target.
+typedef std::function<bool(const debug_event&)> debug_event_handler;
+
+class debug_event_dispatcher
+{
+    std::vector<debug_event_handler> handlers[static_cast<size_t>(debug_event_type::count)];
+public:
+    void register_handler(debug_event_type type, debug_event_handler handler);
+    continue_action dispatch(const debug_event& event);
+    static continue_action default_action(const debug_event& event);
+};
+#endif // !DEBUG_EVENT_SOURCE_H
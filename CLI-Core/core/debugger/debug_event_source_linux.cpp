@@ -0,0 +1,871 @@
+#if defined(__linux__) && defined(__x86_64__)
+#include "debug_event_source.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <deque>
+#include <vector>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <dirent.h>
+#include <fcntl.h>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/user.h>
+#include <utility>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    // Threads are seized (PTRACE_SEIZE), so attaching does not stop the target and clones are
+    // traced automatically. wait() blocks in waitpid; wake() sends the target SIGURG, whose
+    // signal-delivery stop the source swallows and turns into woken. Only a SIGURG this process
+    // sent with kill() is taken for a wake (its siginfo says so); the target's own, such as Go's
+    // preemption signal, are passed on. SIGURG is ignored by default, so one that arrives after
+    // detach is harmless. A target that blocks SIGURG never stops for it, so wake() also sends
+    // the thread waiting in wait() INTERRUPT_SIGNAL, whose handler does nothing and is installed
+    // without SA_RESTART: waitpid returns EINTR and wait() sees the request. A finite timeout
+    // arms a timer that sends the same signal to that thread, then again every millisecond
+    // until wait() returns, in case one lands just before waitpid.
+    //
+    // waitpid(-1) reaps any child of this process: the source must be the only such waiter.
+    const int WAKE_SIGNAL = SIGURG;
+    const uint64_t PAGE = 0x1000;
+
+    int interrupt_signal() {
+        return SIGRTMIN;
+    }
+
+    void on_interrupt(int) {
+    }
+
+    class ptrace_event_source : public debug_event_source
+    {
+        std::atomic<pid_t> pid{0};
+        std::atomic<bool> wake_requested{false};
+        // The thread that attached, which every wait() runs on.
+        std::atomic<pid_t> waiter{0};
+        timer_t timeout_timer = {};
+        bool has_timer = false;
+        std::set<pid_t> threads;
+        std::deque<debug_event> pending;
+        // Stops collected while interrupting threads for set_debug_registers, not yet translated.
+        std::deque<std::pair<pid_t, int>> deferred;
+        pid_t stopped_tid = 0;
+        int stopped_signal = 0;
+        bool step_on_resume = false;
+        // Registers of stopped_tid, read once per stop.
+        user_regs_struct stopped_regs = {};
+        // Threads resumed with PTRACE_SINGLESTEP whose step has not been reported yet.
+        std::set<pid_t> stepping;
+        // Threads interrupted by request_step: their interrupt stop becomes a single step.
+        std::set<pid_t> step_requests;
+        // /proc/<pid>/mem: reads and writes code pages regardless of their protection.
+        int memory_fd = -1;
+        // Watched page -> the PROT_* flags it had and whether it is guarded right now. A page
+        // a fault unguarded keeps its entry so guarding it again skips /proc/<pid>/maps.
+        struct guarded_page
+        {
+            int protection;
+            bool armed;
+        };
+        std::map<uint64_t, guarded_page> guarded;
+        // A syscall instruction in the target (in the vDSO) for injected mprotect calls.
+        uint64_t syscall_address = 0;
+
+    public:
+        bool attach(uint32_t target_pid) override {
+            pid_t process = static_cast<pid_t>(target_pid);
+            long options = PTRACE_O_TRACECLONE;
+
+            // Threads can start while the task list is read; repeat until a pass seizes nothing new.
+            bool added = true;
+            while (added) {
+                added = false;
+                std::string task_path = "/proc/" + std::to_string(process) + "/task";
+                DIR* tasks = opendir(task_path.c_str());
+                if (!tasks) {
+                    return threads.size() > 0;
+                }
+                while (dirent* entry = readdir(tasks)) {
+                    pid_t tid = static_cast<pid_t>(atoi(entry->d_name));
+                    if (tid <= 0 || threads.count(tid)) {
+                        continue;
+                    }
+                    if (ptrace(PTRACE_SEIZE, tid, nullptr, reinterpret_cast<void*>(options)) == 0) {
+                        threads.insert(tid);
+                        added = true;
+                    }
+                }
+                closedir(tasks);
+            }
+            if (!threads.count(process)) {
+                return false;
+            }
+
+            // Mirror what Windows reports on attach: the process, then its other threads.
+            debug_event event = debug_event{};
+            event.type = debug_event_type::create_process;
+            event.pid = event.tid = static_cast<uint32_t>(process);
+            pending.push_back(event);
+            for (pid_t tid : threads) {
+                if (tid != process) {
+                    event.type = debug_event_type::create_thread;
+                    event.tid = static_cast<uint32_t>(tid);
+                    pending.push_back(event);
+                }
+            }
+            memory_fd = open(("/proc/" + std::to_string(process) + "/mem").c_str(), O_RDWR | O_CLOEXEC);
+            struct sigaction action = {};
+            action.sa_handler = on_interrupt;
+            sigemptyset(&action.sa_mask);
+            sigaction(interrupt_signal(), &action, nullptr);
+            waiter.store(static_cast<pid_t>(syscall(SYS_gettid)));
+            struct sigevent notify = {};
+            notify.sigev_notify = SIGEV_THREAD_ID;
+            notify.sigev_signo = interrupt_signal();
+            notify._sigev_un._tid = waiter.load();
+            has_timer = timer_create(CLOCK_MONOTONIC, &notify, &timeout_timer) == 0;
+            pid.store(process);
+            return true;
+        }
+
+        ~ptrace_event_source() {
+            if (memory_fd >= 0) {
+                close(memory_fd);
+            }
+            if (has_timer) {
+                timer_delete(timeout_timer);
+            }
+        }
+
+        // Detaches every thread from a stop, handing back any signal that was about to be
+        // delivered. Threads whose stop was already reaped (the current event, stops deferred
+        // while holding threads) are not reported again after an interrupt, so they are let go
+        // from that stop first; only the others are interrupted and waited for.
+        bool detach() override {
+            if (!guarded.empty()) {
+                guard_pages(guarded.begin()->first, static_cast<size_t>(guarded.rbegin()->first + PAGE - guarded.begin()->first), false);
+            }
+            for (const auto& stop : deferred) {
+                if (WIFSTOPPED(stop.second) && (stop.second >> 16) == PTRACE_EVENT_CLONE) {
+                    unsigned long child = 0;
+                    ptrace(PTRACE_GETEVENTMSG, stop.first, nullptr, &child);
+                    threads.insert(static_cast<pid_t>(child));
+                }
+            }
+            if (stopped_tid && threads.count(stopped_tid)) {
+                detach_stopped(stopped_tid, stopped_signal, true);
+            }
+            stopped_tid = 0;
+            for (const auto& stop : deferred) {
+                if (!threads.count(stop.first)) {
+                    continue;
+                }
+                if (WIFSTOPPED(stop.second)) {
+                    detach_stopped(stop.first, WSTOPSIG(stop.second), (stop.second >> 16) == 0);
+                }
+                else {
+                    threads.erase(stop.first);
+                }
+            }
+            for (pid_t tid : threads) {
+                ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr);
+            }
+            while (!threads.empty()) {
+                int status = 0;
+                pid_t tid = waitpid(-1, &status, __WALL);
+                if (tid < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                if (!WIFSTOPPED(status)) {
+                    threads.erase(tid);
+                    continue;
+                }
+                detach_stopped(tid, WSTOPSIG(status), (status >> 16) == 0);
+            }
+            pid.store(0);
+            waiter.store(0);
+            if (has_timer) {
+                timer_delete(timeout_timer);
+                has_timer = false;
+            }
+            pending.clear();
+            deferred.clear();
+            guarded.clear();
+            syscall_address = 0;
+            stepping.clear();
+            step_requests.clear();
+            if (memory_fd >= 0) {
+                close(memory_fd);
+                memory_fd = -1;
+            }
+            return threads.empty();
+        }
+
+        wait_status wait(debug_event& event, uint32_t timeout_ms) override {
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            bool armed = false;
+            wait_status status = wait_until(event, timeout_ms == WAIT_FOREVER ? nullptr : &deadline, armed);
+            if (armed) {
+                struct itimerspec off = {};
+                timer_settime(timeout_timer, 0, &off, nullptr);
+            }
+            return status;
+        }
+
+        wait_status wait_until(debug_event& event, const std::chrono::steady_clock::time_point* deadline, bool& armed) {
+            for (;;) {
+                if (wake_requested.exchange(false)) {
+                    return wait_status::woken;
+                }
+                if (!pending.empty()) {
+                    event = pending.front();
+                    pending.pop_front();
+                    return wait_status::event;
+                }
+                if (!deferred.empty()) {
+                    std::pair<pid_t, int> stop = deferred.front();
+                    deferred.pop_front();
+                    if (translate(stop.first, stop.second, event)) {
+                        return wait_status::event;
+                    }
+                    continue;
+                }
+
+                int status = 0;
+                int options = __WALL;
+                if (deadline) {
+                    auto remaining = std::chrono::duration_cast<std::chrono::nanoseconds>(*deadline - std::chrono::steady_clock::now()).count();
+                    if (remaining <= 0) {
+                        return wait_status::timeout;
+                    }
+                    if (!has_timer) {
+                        options |= WNOHANG;
+                    }
+                    else if (!armed) {
+                        struct itimerspec when = {};
+                        when.it_value.tv_sec = static_cast<time_t>(remaining / 1000000000);
+                        when.it_value.tv_nsec = static_cast<long>(remaining % 1000000000);
+                        when.it_interval.tv_nsec = 1000000;
+                        armed = timer_settime(timeout_timer, 0, &when, nullptr) == 0;
+                        if (!armed) {
+                            options |= WNOHANG;
+                        }
+                    }
+                }
+                pid_t tid = waitpid(-1, &status, options);
+                if (tid == 0) {
+                    // WNOHANG without a timer: nothing yet, poll again shortly.
+                    usleep(100);
+                    continue;
+                }
+                if (tid < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return wait_status::failed;
+                }
+                if (translate(tid, status, event)) {
+                    return wait_status::event;
+                }
+            }
+        }
+
+        bool resume(const debug_event& event, continue_action action) override {
+            if (stopped_tid == 0 || static_cast<pid_t>(event.tid) != stopped_tid) {
+                return true;
+            }
+            long signal = action == continue_action::not_handled ? stopped_signal : 0;
+            pid_t tid = stopped_tid;
+            stopped_tid = 0;
+            if (step_on_resume) {
+                step_on_resume = false;
+                stepping.insert(tid);
+                return ptrace(PTRACE_SINGLESTEP, tid, nullptr, reinterpret_cast<void*>(signal)) == 0;
+            }
+            return ptrace(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(signal)) == 0;
+        }
+
+        void wake() override {
+            wake_requested.store(true);
+            pid_t process = pid.load();
+            if (!process) {
+                return;
+            }
+            kill(process, WAKE_SIGNAL);
+            pid_t thread = waiter.load();
+            if (thread) {
+                syscall(SYS_tgkill, getpid(), thread, interrupt_signal());
+            }
+        }
+
+        bool read_memory(uint64_t address, void* buffer, size_t size) override {
+            return pread(memory_fd, buffer, size, static_cast<off_t>(address)) == static_cast<ssize_t>(size);
+        }
+
+        bool write_memory(uint64_t address, const void* buffer, size_t size) override {
+            return pwrite(memory_fd, buffer, size, static_cast<off_t>(address)) == static_cast<ssize_t>(size);
+        }
+
+        bool write_code(const code_patch* patches, size_t count) override {
+            bool written_all = true;
+            for (size_t i = 0; i < count; i++) {
+                written_all &= pwrite(memory_fd, patches[i].data, patches[i].size,
+                                      static_cast<off_t>(patches[i].address)) == static_cast<ssize_t>(patches[i].size);
+            }
+            return written_all;
+        }
+
+        bool step_from(uint32_t tid, uint64_t address) override {
+            if (static_cast<pid_t>(tid) != stopped_tid) {
+                return false;
+            }
+            // Tracing steps from where the thread already is; that needs no write.
+            if (address != stopped_regs.rip &&
+                ptrace(PTRACE_POKEUSER, stopped_tid, reinterpret_cast<void*>(offsetof(user_regs_struct, rip)),
+                       reinterpret_cast<void*>(address)) != 0) {
+                return false;
+            }
+            stopped_regs.rip = address;
+            step_on_resume = true;
+            return true;
+        }
+
+        bool request_step(uint32_t tid) override {
+            pid_t thread = static_cast<pid_t>(tid);
+            if (thread == stopped_tid) {
+                step_on_resume = true;
+                return true;
+            }
+            if (!threads.count(thread) || ptrace(PTRACE_INTERRUPT, thread, nullptr, nullptr) != 0) {
+                return false;
+            }
+            step_requests.insert(thread);
+            return true;
+        }
+
+        bool get_registers(uint32_t tid, thread_registers& registers) override {
+            if (static_cast<pid_t>(tid) != stopped_tid) {
+                return false;
+            }
+            to_registers(stopped_regs, registers);
+            return true;
+        }
+
+        bool set_registers(uint32_t tid, const thread_registers& registers) override {
+            if (static_cast<pid_t>(tid) != stopped_tid) {
+                return false;
+            }
+            user_regs_struct& regs = stopped_regs;
+            unsigned long long* fields[16] = { &regs.rax, &regs.rcx, &regs.rdx, &regs.rbx, &regs.rsp, &regs.rbp, &regs.rsi, &regs.rdi,
+                                               &regs.r8, &regs.r9, &regs.r10, &regs.r11, &regs.r12, &regs.r13, &regs.r14, &regs.r15 };
+            for (size_t i = 0; i < 16; i++) {
+                *fields[i] = registers.gpr[i];
+            }
+            regs.rip = registers.rip;
+            regs.eflags = registers.rflags;
+            return ptrace(PTRACE_SETREGS, stopped_tid, nullptr, &regs) == 0;
+        }
+
+        std::vector<uint32_t> get_threads() override {
+            return std::vector<uint32_t>(threads.begin(), threads.end());
+        }
+
+        // ptrace can only write a stopped thread's debug registers: interrupt the running ones,
+        // write everything, then continue the ones that stopped for the interrupt.
+        size_t set_debug_registers(const uint32_t* tids, size_t count, const debug_registers& registers, bool* written) override {
+            held_threads held;
+            hold_threads(tids, count, held);
+            size_t written_count = 0;
+            for (size_t i = 0; i < count; i++) {
+                written[i] = held.stopped[i] && write_debug_registers(static_cast<pid_t>(tids[i]), registers);
+                written_count += written[i] ? 1 : 0;
+            }
+            release_threads(tids, count, held);
+            return written_count;
+        }
+
+        size_t sample_threads(const uint32_t* tids, size_t count, const thread_sample_callback& callback) override {
+            held_threads held;
+            hold_threads(tids, count, held);
+            size_t sampled = 0;
+            for (size_t i = 0; i < count; i++) {
+                pid_t tid = static_cast<pid_t>(tids[i]);
+                user_regs_struct regs = stopped_regs;
+                if (!held.stopped[i] || (tid != stopped_tid && ptrace(PTRACE_GETREGS, tid, nullptr, &regs) != 0)) {
+                    continue;
+                }
+                thread_registers registers;
+                to_registers(regs, registers);
+                callback(i, registers);
+                sampled++;
+            }
+            release_threads(tids, count, held);
+            return sampled;
+        }
+
+        bool take_debug_status(uint32_t tid, uint64_t& status) override {
+            if (static_cast<pid_t>(tid) != stopped_tid) {
+                return false;
+            }
+            errno = 0;
+            long value = ptrace(PTRACE_PEEKUSER, stopped_tid, reinterpret_cast<void*>(debug_register_offset(6)), nullptr);
+            if (errno != 0) {
+                return false;
+            }
+            status = static_cast<uint64_t>(value);
+            ptrace(PTRACE_POKEUSER, stopped_tid, reinterpret_cast<void*>(debug_register_offset(6)), nullptr);
+            return true;
+        }
+
+        // mprotect runs inside the target: see inject_syscall. Pages stay readable through
+        // /proc/<pid>/mem. The kernel's own accesses to a guarded page (a read() into it, say)
+        // fail with EFAULT instead of faulting.
+        bool guard_pages(uint64_t address, size_t size, bool guard) override {
+            uint64_t first = address & ~(PAGE - 1);
+            uint64_t end = (address + size + PAGE - 1) & ~(PAGE - 1);
+            if (guard) {
+                std::vector<int> protections;
+                if (!read_protections(first, end, protections)) {
+                    return false;
+                }
+                if (!with_stopped_thread([&] (pid_t tid) { return protect(tid, first, end - first, PROT_NONE); })) {
+                    return false;
+                }
+                for (uint64_t page = first; page < end; page += PAGE) {
+                    guarded[page] = guarded_page{protections[(page - first) / PAGE], true};
+                }
+                return true;
+            }
+
+            // Put back runs of pages that had the same protection with one call each.
+            return with_stopped_thread([&] (pid_t tid) {
+                bool restored = true;
+                auto page = guarded.lower_bound(first);
+                while (page != guarded.end() && page->first < end) {
+                    uint64_t run_start = page->first;
+                    int protection = page->second.protection;
+                    auto next = page;
+                    uint64_t run_end = run_start;
+                    while (next != guarded.end() && next->first == run_end && next->first < end && next->second.protection == protection) {
+                        run_end += PAGE;
+                        ++next;
+                    }
+                    restored &= protect(tid, run_start, run_end - run_start, protection);
+                    page = guarded.erase(page, next);
+                }
+                return restored;
+            });
+        }
+
+    private:
+        // PROT_* flags of each page in [first, end), from /proc/<pid>/maps.
+        bool read_protections(uint64_t first, uint64_t end, std::vector<int>& protections) {
+            protections.assign(static_cast<size_t>((end - first) / PAGE), -1);
+            bool known = true;
+            for (uint64_t page = first; page < end && known; page += PAGE) {
+                auto entry = guarded.find(page);
+                known = entry != guarded.end();
+                if (known) {
+                    protections[(page - first) / PAGE] = entry->second.protection;
+                }
+            }
+            if (known) {
+                return true;
+            }
+
+            FILE* maps = fopen(("/proc/" + std::to_string(pid.load()) + "/maps").c_str(), "r");
+            if (!maps) {
+                return false;
+            }
+            char line[512];
+            while (fgets(line, sizeof(line), maps)) {
+                unsigned long long low = 0, high = 0;
+                char permissions[8] = {};
+                if (sscanf(line, "%llx-%llx %7s", &low, &high, permissions) != 3 || high <= first || low >= end) {
+                    continue;
+                }
+                int protection = (permissions[0] == 'r' ? PROT_READ : 0) | (permissions[1] == 'w' ? PROT_WRITE : 0) |
+                                 (permissions[2] == 'x' ? PROT_EXEC : 0);
+                for (uint64_t page = (std::max)(static_cast<uint64_t>(low), first); page < (std::min)(static_cast<uint64_t>(high), end); page += PAGE) {
+                    protections[(page - first) / PAGE] = protection;
+                }
+            }
+            fclose(maps);
+            // A guarded page keeps the protection recorded when it was first guarded.
+            for (uint64_t page = first; page < end; page += PAGE) {
+                auto entry = guarded.find(page);
+                if (entry != guarded.end()) {
+                    protections[(page - first) / PAGE] = entry->second.protection;
+                }
+            }
+            return std::find(protections.begin(), protections.end(), -1) == protections.end();
+        }
+
+        bool protect(pid_t tid, uint64_t address, uint64_t size, int protection) {
+            unsigned long long args[3] = { address, size, static_cast<unsigned long long>(protection) };
+            long long result = -1;
+            return inject_syscall(tid, SYS_mprotect, args, 3, result) && result == 0;
+        }
+
+        bool find_syscall_instruction() {
+            FILE* maps = fopen(("/proc/" + std::to_string(pid.load()) + "/maps").c_str(), "r");
+            if (!maps) {
+                return false;
+            }
+            unsigned long long low = 0, high = 0;
+            char line[512];
+            bool found = false;
+            while (!found && fgets(line, sizeof(line), maps)) {
+                found = strstr(line, "[vdso]") && sscanf(line, "%llx-%llx", &low, &high) == 2;
+            }
+            fclose(maps);
+            if (!found) {
+                return false;
+            }
+            std::vector<uint8_t> image(static_cast<size_t>(high - low));
+            if (!read_memory(low, image.data(), image.size())) {
+                return false;
+            }
+            for (size_t i = 0; i + 1 < image.size(); i++) {
+                if (image[i] == 0x0F && image[i + 1] == 0x05) {
+                    syscall_address = low + i;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Runs one system call in a stopped thread: point it at the vDSO's syscall instruction
+        // with the arguments loaded, single-step, collect rax, put every register back.
+        // orig_rax = -1 keeps the kernel from restarting a syscall the thread was stopped in.
+        bool inject_syscall(pid_t tid, long number, const unsigned long long* args, size_t count, long long& result) {
+            if (!syscall_address && !find_syscall_instruction()) {
+                return false;
+            }
+            user_regs_struct saved = {};
+            if (ptrace(PTRACE_GETREGS, tid, nullptr, &saved) != 0) {
+                return false;
+            }
+            user_regs_struct regs = saved;
+            unsigned long long* slots[6] = { &regs.rdi, &regs.rsi, &regs.rdx, &regs.r10, &regs.r8, &regs.r9 };
+            for (size_t i = 0; i < count && i < 6; i++) {
+                *slots[i] = args[i];
+            }
+            regs.rax = static_cast<unsigned long long>(number);
+            regs.orig_rax = static_cast<unsigned long long>(-1);
+            regs.rip = syscall_address;
+            if (ptrace(PTRACE_SETREGS, tid, nullptr, &regs) != 0 || ptrace(PTRACE_SINGLESTEP, tid, nullptr, nullptr) != 0) {
+                ptrace(PTRACE_SETREGS, tid, nullptr, &saved);
+                return false;
+            }
+
+            int status = 0;
+            pid_t waited;
+            do {
+                waited = waitpid(tid, &status, __WALL);
+            } while (waited < 0 && errno == EINTR);
+            if (waited != tid || !WIFSTOPPED(status)) {
+                deferred.push_back(std::make_pair(tid, status));
+                return false;
+            }
+            bool stepped = WSTOPSIG(status) == SIGTRAP && (status >> 16) == 0;
+            if (stepped && ptrace(PTRACE_GETREGS, tid, nullptr, &regs) == 0) {
+                result = static_cast<long long>(regs.rax);
+            }
+            ptrace(PTRACE_SETREGS, tid, nullptr, &saved);
+            if (!stepped) {
+                // A signal arrived first; wait() reports it once the registers are back.
+                deferred.push_back(std::make_pair(tid, status));
+            }
+            return stepped;
+        }
+
+        // Calls work with a thread in a ptrace stop: the one at the current event, one with an
+        // untranslated stop, or the main thread, interrupted for the call.
+        bool with_stopped_thread(const std::function<bool(pid_t)>& work) {
+            if (stopped_tid) {
+                return work(stopped_tid);
+            }
+            for (const auto& stop : deferred) {
+                if (WIFSTOPPED(stop.second)) {
+                    return work(stop.first);
+                }
+            }
+            if (threads.empty()) {
+                return false;
+            }
+            pid_t tid = threads.count(pid.load()) ? pid.load() : *threads.begin();
+            if (ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) != 0) {
+                return false;
+            }
+            int status = 0;
+            pid_t waited;
+            do {
+                waited = waitpid(tid, &status, __WALL);
+            } while (waited < 0 && errno == EINTR);
+            if (waited != tid) {
+                return false;
+            }
+            if (!WIFSTOPPED(status) || (status >> 16) != PTRACE_EVENT_STOP) {
+                deferred.push_back(std::make_pair(tid, status));
+                return WIFSTOPPED(status) && work(tid);
+            }
+            bool done = work(tid);
+            resume_stop(tid, WSTOPSIG(status));
+            return done;
+        }
+
+        static size_t debug_register_offset(int index) {
+            return offsetof(struct user, u_debugreg) + index * sizeof(unsigned long);
+        }
+
+        // Dr7 goes to zero first so the kernel checks each address against a disabled slot.
+        static bool write_debug_registers(pid_t tid, const debug_registers& registers) {
+            if (ptrace(PTRACE_POKEUSER, tid, reinterpret_cast<void*>(debug_register_offset(7)), nullptr) != 0) {
+                return false;
+            }
+            for (int i = 0; i < 4; i++) {
+                if (ptrace(PTRACE_POKEUSER, tid, reinterpret_cast<void*>(debug_register_offset(i)),
+                           reinterpret_cast<void*>(registers.address[i])) != 0) {
+                    return false;
+                }
+            }
+            return ptrace(PTRACE_POKEUSER, tid, reinterpret_cast<void*>(debug_register_offset(7)),
+                          reinterpret_cast<void*>(registers.control)) == 0;
+        }
+
+        static void to_registers(const user_regs_struct& regs, thread_registers& registers) {
+            uint64_t values[16] = { regs.rax, regs.rcx, regs.rdx, regs.rbx, regs.rsp, regs.rbp, regs.rsi, regs.rdi,
+                                    regs.r8, regs.r9, regs.r10, regs.r11, regs.r12, regs.r13, regs.r14, regs.r15 };
+            std::copy(values, values + 16, registers.gpr);
+            registers.rip = regs.rip;
+            registers.rflags = regs.eflags;
+        }
+
+        // stopped: the thread can be read and written now. interrupted: hold_threads stopped it
+        // and release_threads continues it.
+        struct held_threads
+        {
+            std::vector<bool> stopped;
+            std::vector<bool> interrupted;
+            std::vector<int> stop_signal;
+        };
+
+        // Interrupts every listed thread that runs, then waits for them in turn, so they all
+        // stop in parallel. Other stops collected on the way are kept for wait().
+        void hold_threads(const uint32_t* tids, size_t count, held_threads& held) {
+            held.stopped.assign(count, false);
+            held.interrupted.assign(count, false);
+            held.stop_signal.assign(count, SIGTRAP);
+            for (size_t i = 0; i < count; i++) {
+                pid_t tid = static_cast<pid_t>(tids[i]);
+                if (tid == stopped_tid || is_deferred(tid)) {
+                    held.stopped[i] = true;
+                }
+                else if (threads.count(tid) && ptrace(PTRACE_INTERRUPT, tid, nullptr, nullptr) == 0) {
+                    held.interrupted[i] = true;
+                }
+            }
+            for (size_t i = 0; i < count; i++) {
+                if (!held.interrupted[i]) {
+                    continue;
+                }
+                pid_t tid = static_cast<pid_t>(tids[i]);
+                int status = 0;
+                pid_t waited;
+                do {
+                    waited = waitpid(tid, &status, __WALL);
+                } while (waited < 0 && errno == EINTR);
+                if (waited != tid) {
+                    held.interrupted[i] = false;
+                    continue;
+                }
+                if (WIFSTOPPED(status) && (status >> 16) == PTRACE_EVENT_STOP) {
+                    held.stopped[i] = true;
+                    held.stop_signal[i] = WSTOPSIG(status);
+                    continue;
+                }
+                // Something else stopped it first (or it exited); the interrupt stays pending
+                // and is continued by translate() when it arrives.
+                held.interrupted[i] = false;
+                held.stopped[i] = WIFSTOPPED(status);
+                deferred.push_back(std::make_pair(tid, status));
+            }
+        }
+
+        void release_threads(const uint32_t* tids, size_t count, const held_threads& held) {
+            for (size_t i = 0; i < count; i++) {
+                if (held.interrupted[i]) {
+                    resume_stop(static_cast<pid_t>(tids[i]), held.stop_signal[i]);
+                }
+            }
+        }
+
+        static bool is_wake(const siginfo_t& info) {
+            return info.si_signo == WAKE_SIGNAL && info.si_code == SI_USER && info.si_pid == getpid();
+        }
+
+        static bool is_wake(pid_t tid) {
+            siginfo_t info = {};
+            return ptrace(PTRACE_GETSIGINFO, tid, nullptr, &info) == 0 && is_wake(info);
+        }
+
+        // Our own traps and wakes are not handed back.
+        void detach_stopped(pid_t tid, int signal, bool delivery_stop) {
+            if (!delivery_stop || signal == SIGTRAP || (signal == WAKE_SIGNAL && is_wake(tid))) {
+                signal = 0;
+            }
+            ptrace(PTRACE_DETACH, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal)));
+            threads.erase(tid);
+        }
+
+        bool is_deferred(pid_t tid) const {
+            for (const auto& stop : deferred) {
+                if (stop.first == tid && WIFSTOPPED(stop.second)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Leaves a PTRACE_EVENT_STOP: group stops keep the thread stopped, interrupts continue it.
+        static void resume_stop(pid_t tid, int signal) {
+            if (signal == SIGSTOP || signal == SIGTSTP || signal == SIGTTIN || signal == SIGTTOU) {
+                ptrace(PTRACE_LISTEN, tid, nullptr, nullptr);
+            }
+            else {
+                cont(tid, 0);
+            }
+        }
+
+        static void cont(pid_t tid, int signal) {
+            ptrace(PTRACE_CONT, tid, nullptr, reinterpret_cast<void*>(static_cast<long>(signal)));
+        }
+
+        // Returns false for stops the source handles itself (clone children starting,
+        // group stops, wake signals).
+        bool translate(pid_t tid, int status, debug_event& event) {
+            event = debug_event{};
+            event.pid = static_cast<uint32_t>(pid.load());
+            event.tid = static_cast<uint32_t>(tid);
+
+            if (WIFEXITED(status) || WIFSIGNALED(status)) {
+                threads.erase(tid);
+                stepping.erase(tid);
+                step_requests.erase(tid);
+                event.type = tid == pid.load() ? debug_event_type::exit_process : debug_event_type::exit_thread;
+                event.code = WIFEXITED(status) ? WEXITSTATUS(status) : WTERMSIG(status);
+                return true;
+            }
+            if (!WIFSTOPPED(status)) {
+                return false;
+            }
+
+            int signal = WSTOPSIG(status);
+            int ptrace_event = status >> 16;
+            if (ptrace_event == PTRACE_EVENT_CLONE) {
+                unsigned long child = 0;
+                ptrace(PTRACE_GETEVENTMSG, tid, nullptr, &child);
+                threads.insert(static_cast<pid_t>(child));
+                cont(tid, 0);
+                event.type = debug_event_type::create_thread;
+                event.tid = static_cast<uint32_t>(child);
+                return true;
+            }
+            if (ptrace_event == PTRACE_EVENT_STOP) {
+                // A seized clone's first stop and interrupts report SIGTRAP; anything else is a group stop.
+                if (signal == SIGTRAP && step_requests.erase(tid)) {
+                    stepping.insert(tid);
+                    ptrace(PTRACE_SINGLESTEP, tid, nullptr, nullptr);
+                    return false;
+                }
+                resume_stop(tid, signal);
+                return false;
+            }
+            if (ptrace_event != 0) {
+                cont(tid, 0);
+                return false;
+            }
+
+            // A trap right after our own single step needs no siginfo to classify.
+            bool stepped = signal == SIGTRAP && stepping.erase(tid) != 0;
+            siginfo_t info = {};
+            if (!stepped) {
+                ptrace(PTRACE_GETSIGINFO, tid, nullptr, &info);
+            }
+            if (signal == WAKE_SIGNAL && is_wake(info)) {
+                cont(tid, 0);
+                return false;
+            }
+            user_regs_struct& regs = stopped_regs;
+            ptrace(PTRACE_GETREGS, tid, nullptr, &regs);
+
+            stopped_tid = tid;
+            stopped_signal = signal;
+            event.type = debug_event_type::exception;
+            event.first_chance = true;
+            event.address = regs.rip;
+
+            switch (signal) {
+            case SIGTRAP:
+                if (stepped || info.si_code == TRAP_TRACE || info.si_code == TRAP_HWBKPT) {
+                    event.code = DEBUG_EXCEPTION_SINGLE_STEP;
+                }
+                else {
+                    // int3 stops after the instruction; report the int3 itself, like Windows.
+                    event.code = DEBUG_EXCEPTION_BREAKPOINT;
+                    event.address = regs.rip - 1;
+                }
+                break;
+            case SIGSEGV: {
+                event.code = DEBUG_EXCEPTION_ACCESS_VIOLATION;
+                event.fault_address = reinterpret_cast<uint64_t>(info.si_addr);
+                auto page = guarded.find(event.fault_address & ~(PAGE - 1));
+                if (page != guarded.end() && page->second.armed) {
+                    // One-shot, like PAGE_GUARD: the page is usable again when the thread resumes.
+                    event.code = DEBUG_EXCEPTION_GUARD_PAGE;
+                    protect(tid, page->first, PAGE, page->second.protection);
+                    page->second.armed = false;
+                }
+                break;
+            }
+            case SIGBUS:
+                event.code = DEBUG_EXCEPTION_DATATYPE_MISALIGNMENT;
+                event.fault_address = reinterpret_cast<uint64_t>(info.si_addr);
+                break;
+            case SIGILL:
+                event.code = DEBUG_EXCEPTION_ILLEGAL_INSTRUCTION;
+                break;
+            case SIGFPE:
+                event.code = DEBUG_EXCEPTION_INT_DIVIDE_BY_ZERO;
+                break;
+            default:
+                event.type = debug_event_type::signal;
+                event.code = static_cast<uint32_t>(signal);
+                break;
+            }
+            return true;
+        }
+    };
+}
+
+std::unique_ptr<debug_event_source> create_ptrace_event_source() {
+    return std::unique_ptr<debug_event_source>(new ptrace_event_source());
+}
+#endif // __linux__ && __x86_64__
@@ -0,0 +1,382 @@
+#if defined(_WIN32) && defined(_M_X64)
+#include "debug_event_source.h"
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // WaitForDebugEvent cannot be interrupted, so wait() waits in slices of WAKE_POLL_MS and
+    // checks for a wake() between them; nothing is injected into the target. DebugActiveProcess
+    // raises a breakpoint on attach, which is reported like any other event.
+    const DWORD WAKE_POLL_MS = 10;
+
+    class win32_event_source : public debug_event_source
+    {
+        DWORD pid = 0;
+        std::atomic<HANDLE> process{nullptr};
+        std::atomic<bool> wake_requested{false};
+        DEBUG_EVENT current = {};
+        // Thread handles from create events; the system closes them after the exit event.
+        std::unordered_map<DWORD, HANDLE> thread_handles;
+
+        static void to_registers(const CONTEXT& context, thread_registers& registers) {
+            const DWORD64 values[16] = { context.Rax, context.Rcx, context.Rdx, context.Rbx, context.Rsp, context.Rbp, context.Rsi, context.Rdi,
+                                         context.R8, context.R9, context.R10, context.R11, context.R12, context.R13, context.R14, context.R15 };
+            for (size_t i = 0; i < 16; i++) {
+                registers.gpr[i] = values[i];
+            }
+            registers.rip = context.Rip;
+            registers.rflags = context.EFlags;
+        }
+
+    public:
+        ~win32_event_source() {
+            HANDLE handle = process.exchange(nullptr);
+            if (handle) {
+                CloseHandle(handle);
+            }
+        }
+
+        bool attach(uint32_t target_pid) override {
+            if (!DebugActiveProcess(target_pid)) {
+                return false;
+            }
+            pid = target_pid;
+            thread_handles.clear();
+            process.store(OpenProcess(PROCESS_ALL_ACCESS, FALSE, target_pid));
+            return true;
+        }
+
+        bool detach() override {
+            BOOL stopped = DebugActiveProcessStop(pid);
+            HANDLE handle = process.exchange(nullptr);
+            if (handle) {
+                CloseHandle(handle);
+            }
+            return stopped != FALSE;
+        }
+
+        wait_status wait(debug_event& event, uint32_t timeout_ms) override {
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+            for (;;) {
+                if (wake_requested.exchange(false)) {
+                    return wait_status::woken;
+                }
+                DWORD slice = WAKE_POLL_MS;
+                if (timeout_ms != WAIT_FOREVER) {
+                    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+                    if (remaining <= 0) {
+                        return wait_status::timeout;
+                    }
+                    slice = (std::min)(slice, static_cast<DWORD>(remaining));
+                }
+                if (WaitForDebugEvent(&current, slice)) {
+                    translate(event);
+                    return wait_status::event;
+                }
+                if (GetLastError() != ERROR_SEM_TIMEOUT) {
+                    return wait_status::failed;
+                }
+            }
+        }
+
+        bool resume(const debug_event& event, continue_action action) override {
+            close_file_handle();
+            DWORD status = event.type == debug_event_type::exception && action == continue_action::not_handled
+                ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
+            return ContinueDebugEvent(event.pid, event.tid, status) != FALSE;
+        }
+
+        void wake() override {
+            wake_requested.store(true);
+        }
+
+        bool read_memory(uint64_t address, void* buffer, size_t size) override {
+            SIZE_T read = 0;
+            return ReadProcessMemory(process.load(), reinterpret_cast<LPCVOID>(address), buffer, size, &read) && read == size;
+        }
+
+        bool write_memory(uint64_t address, const void* buffer, size_t size) override {
+            SIZE_T written = 0;
+            return WriteProcessMemory(process.load(), reinterpret_cast<LPVOID>(address), buffer, size, &written) && written == size;
+        }
+
+        bool write_code(const code_patch* patches, size_t count) override {
+            HANDLE handle = process.load();
+            bool written_all = true;
+            for (size_t i = 0; i < count; i++) {
+                LPVOID address = reinterpret_cast<LPVOID>(patches[i].address);
+                SIZE_T written = 0;
+                if (WriteProcessMemory(handle, address, patches[i].data, patches[i].size, &written) && written == patches[i].size) {
+                    continue;
+                }
+                DWORD protection = 0;
+                if (!VirtualProtectEx(handle, address, patches[i].size, PAGE_EXECUTE_READWRITE, &protection)) {
+                    written_all = false;
+                    continue;
+                }
+                written_all &= WriteProcessMemory(handle, address, patches[i].data, patches[i].size, &written) && written == patches[i].size;
+                VirtualProtectEx(handle, address, patches[i].size, protection, &protection);
+            }
+            FlushInstructionCache(handle, nullptr, 0);
+            return written_all;
+        }
+
+        bool step_from(uint32_t tid, uint64_t address) override {
+            auto thread = thread_handles.find(tid);
+            if (thread == thread_handles.end()) {
+                return false;
+            }
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_CONTROL;
+            if (!GetThreadContext(thread->second, &context)) {
+                return false;
+            }
+            context.Rip = address;
+            context.EFlags |= 0x100;    // trap flag
+            return SetThreadContext(thread->second, &context) != FALSE;
+        }
+
+        bool request_step(uint32_t tid) override {
+            auto thread = thread_handles.find(tid);
+            if (thread == thread_handles.end() || SuspendThread(thread->second) == static_cast<DWORD>(-1)) {
+                return false;
+            }
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_CONTROL;
+            bool requested = GetThreadContext(thread->second, &context) != FALSE;
+            if (requested) {
+                context.EFlags |= 0x100;    // trap flag
+                requested = SetThreadContext(thread->second, &context) != FALSE;
+            }
+            ResumeThread(thread->second);
+            return requested;
+        }
+
+        bool get_registers(uint32_t tid, thread_registers& registers) override {
+            auto thread = thread_handles.find(tid);
+            if (thread == thread_handles.end()) {
+                return false;
+            }
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+            if (!GetThreadContext(thread->second, &context)) {
+                return false;
+            }
+            to_registers(context, registers);
+            return true;
+        }
+
+        bool set_registers(uint32_t tid, const thread_registers& registers) override {
+            auto thread = thread_handles.find(tid);
+            if (thread == thread_handles.end()) {
+                return false;
+            }
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+            if (!GetThreadContext(thread->second, &context)) {
+                return false;
+            }
+            DWORD64* fields[16] = { &context.Rax, &context.Rcx, &context.Rdx, &context.Rbx, &context.Rsp, &context.Rbp, &context.Rsi, &context.Rdi,
+                                    &context.R8, &context.R9, &context.R10, &context.R11, &context.R12, &context.R13, &context.R14, &context.R15 };
+            for (size_t i = 0; i < 16; i++) {
+                *fields[i] = registers.gpr[i];
+            }
+            context.Rip = registers.rip;
+            context.EFlags = static_cast<DWORD>(registers.rflags);
+            return SetThreadContext(thread->second, &context) != FALSE;
+        }
+
+        std::vector<uint32_t> get_threads() override {
+            std::vector<uint32_t> tids;
+            tids.reserve(thread_handles.size());
+            for (const auto& thread : thread_handles) {
+                tids.push_back(thread.first);
+            }
+            return tids;
+        }
+
+        // Only CONTEXT_DEBUG_REGISTERS is set, so no context has to be read first.
+        size_t set_debug_registers(const uint32_t* tids, size_t count, const debug_registers& registers, bool* written) override {
+            std::vector<HANDLE> suspended(count, nullptr);
+            for (size_t i = 0; i < count; i++) {
+                auto thread = thread_handles.find(tids[i]);
+                if (thread != thread_handles.end() && SuspendThread(thread->second) != static_cast<DWORD>(-1)) {
+                    suspended[i] = thread->second;
+                }
+            }
+
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+            context.Dr0 = registers.address[0];
+            context.Dr1 = registers.address[1];
+            context.Dr2 = registers.address[2];
+            context.Dr3 = registers.address[3];
+            context.Dr7 = registers.control;
+            size_t written_count = 0;
+            for (size_t i = 0; i < count; i++) {
+                written[i] = suspended[i] && SetThreadContext(suspended[i], &context);
+                written_count += written[i] ? 1 : 0;
+            }
+
+            for (HANDLE thread : suspended) {
+                if (thread) {
+                    ResumeThread(thread);
+                }
+            }
+            return written_count;
+        }
+
+        // All threads are suspended before the first context is read, so the callback sees
+        // one instant of the process.
+        size_t sample_threads(const uint32_t* tids, size_t count, const thread_sample_callback& callback) override {
+            std::vector<HANDLE> suspended(count, nullptr);
+            for (size_t i = 0; i < count; i++) {
+                auto thread = thread_handles.find(tids[i]);
+                if (thread != thread_handles.end() && SuspendThread(thread->second) != static_cast<DWORD>(-1)) {
+                    suspended[i] = thread->second;
+                }
+            }
+
+            size_t sampled = 0;
+            for (size_t i = 0; i < count; i++) {
+                CONTEXT context = {};
+                context.ContextFlags = CONTEXT_CONTROL | CONTEXT_INTEGER;
+                if (!suspended[i] || !GetThreadContext(suspended[i], &context)) {
+                    continue;
+                }
+                thread_registers registers;
+                to_registers(context, registers);
+                callback(i, registers);
+                sampled++;
+            }
+
+            for (HANDLE thread : suspended) {
+                if (thread) {
+                    ResumeThread(thread);
+                }
+            }
+            return sampled;
+        }
+
+        bool take_debug_status(uint32_t tid, uint64_t& status) override {
+            auto thread = thread_handles.find(tid);
+            if (thread == thread_handles.end()) {
+                return false;
+            }
+            CONTEXT context = {};
+            context.ContextFlags = CONTEXT_DEBUG_REGISTERS;
+            if (!GetThreadContext(thread->second, &context)) {
+                return false;
+            }
+            status = context.Dr6;
+            context.Dr6 = 0;
+            SetThreadContext(thread->second, &context);
+            return true;
+        }
+
+        // Works a region (pages of equal protection) at a time.
+        bool guard_pages(uint64_t address, size_t size, bool guard) override {
+            HANDLE handle = process.load();
+            uint64_t page = address & ~0xFFFull;
+            uint64_t end = (address + size + 0xFFF) & ~0xFFFull;
+            while (page < end) {
+                MEMORY_BASIC_INFORMATION info = {};
+                if (!VirtualQueryEx(handle, reinterpret_cast<LPCVOID>(page), &info, sizeof(info)) || info.State != MEM_COMMIT) {
+                    return false;
+                }
+                uint64_t region_end = reinterpret_cast<uint64_t>(info.BaseAddress) + info.RegionSize;
+                uint64_t run_end = (std::min)(region_end, end);
+                DWORD protection = guard ? (info.Protect | PAGE_GUARD) : (info.Protect & ~PAGE_GUARD);
+                DWORD old_protection = 0;
+                if (protection != info.Protect &&
+                    !VirtualProtectEx(handle, reinterpret_cast<LPVOID>(page), static_cast<SIZE_T>(run_end - page), protection, &old_protection)) {
+                    return false;
+                }
+                page = run_end;
+            }
+            return true;
+        }
+
+    private:
+        void close_file_handle() {
+            HANDLE file = NULL;
+            if (current.dwDebugEventCode == CREATE_PROCESS_DEBUG_EVENT) {
+                file = current.u.CreateProcessInfo.hFile;
+                current.u.CreateProcessInfo.hFile = NULL;
+            }
+            else if (current.dwDebugEventCode == LOAD_DLL_DEBUG_EVENT) {
+                file = current.u.LoadDll.hFile;
+                current.u.LoadDll.hFile = NULL;
+            }
+            if (file != NULL) {
+                CloseHandle(file);
+            }
+        }
+
+        void translate(debug_event& event) {
+            event = debug_event{};
+            event.pid = current.dwProcessId;
+            event.tid = current.dwThreadId;
+            event.native = &current;
+
+            switch (current.dwDebugEventCode) {
+            case EXCEPTION_DEBUG_EVENT: {
+                const EXCEPTION_RECORD& record = current.u.Exception.ExceptionRecord;
+                event.type = debug_event_type::exception;
+                event.code = record.ExceptionCode;
+                event.address = reinterpret_cast<uint64_t>(record.ExceptionAddress);
+                event.first_chance = current.u.Exception.dwFirstChance != 0;
+                if ((record.ExceptionCode == EXCEPTION_ACCESS_VIOLATION || record.ExceptionCode == EXCEPTION_GUARD_PAGE) &&
+                    record.NumberParameters >= 2) {
+                    event.fault_address = record.ExceptionInformation[1];
+                }
+                break;
+            }
+            case CREATE_THREAD_DEBUG_EVENT:
+                thread_handles[current.dwThreadId] = current.u.CreateThread.hThread;
+                event.type = debug_event_type::create_thread;
+                event.address = reinterpret_cast<uint64_t>(current.u.CreateThread.lpStartAddress);
+                break;
+            case CREATE_PROCESS_DEBUG_EVENT:
+                thread_handles[current.dwThreadId] = current.u.CreateProcessInfo.hThread;
+                event.type = debug_event_type::create_process;
+                event.address = reinterpret_cast<uint64_t>(current.u.CreateProcessInfo.lpBaseOfImage);
+                break;
+            case EXIT_THREAD_DEBUG_EVENT:
+                thread_handles.erase(current.dwThreadId);
+                event.type = debug_event_type::exit_thread;
+                event.code = current.u.ExitThread.dwExitCode;
+                break;
+            case EXIT_PROCESS_DEBUG_EVENT:
+                event.type = debug_event_type::exit_process;
+                event.code = current.u.ExitProcess.dwExitCode;
+                break;
+            case LOAD_DLL_DEBUG_EVENT:
+                event.type = debug_event_type::load_module;
+                event.address = reinterpret_cast<uint64_t>(current.u.LoadDll.lpBaseOfDll);
+                break;
+            case UNLOAD_DLL_DEBUG_EVENT:
+                event.type = debug_event_type::unload_module;
+                event.address = reinterpret_cast<uint64_t>(current.u.UnloadDll.lpBaseOfDll);
+                break;
+            case OUTPUT_DEBUG_STRING_EVENT:
+                event.type = debug_event_type::output_string;
+                event.address = reinterpret_cast<uint64_t>(current.u.DebugString.lpDebugStringData);
+                break;
+            default:
+                event.type = debug_event_type::unknown;
+                event.code = current.dwDebugEventCode;
+                break;
+            }
+        }
+    };
+}
+
+std::unique_ptr<debug_event_source> create_win32_event_source() {
+    return std::unique_ptr<debug_event_source>(new win32_event_source());
+}
+#endif // _WIN32 && _M_X64
@@ -1,6 +1,234 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include "debugger.h"
 #include "output_pipe/output_pipe.h"
+#include "../trace_recorder/trace_recorder.h"
+#include <chrono>
+#include <future>
+
+static void log_exception(const debug_event& event) {
+    DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Exception caught: 0x%X at address 0x%llX (first chance: %s)",
+              event.code, event.address, event.first_chance ? "yes" : "no");
+
+    switch (event.code) {
+    case DEBUG_EXCEPTION_BREAKPOINT:
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Breakpoint exception");
+        break;
+    case DEBUG_EXCEPTION_SINGLE_STEP:
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Single step exception");
+        break;
+    case DEBUG_EXCEPTION_ACCESS_VIOLATION:
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Access violation at 0x%llX", event.address);
+        break;
+    case DEBUG_EXCEPTION_DATATYPE_MISALIGNMENT:
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Datatype misalignment");
+        break;
+    case DEBUG_EXCEPTION_ILLEGAL_INSTRUCTION:
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Illegal instruction");
+        break;
+    case DEBUG_EXCEPTION_STACK_OVERFLOW:
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Stack overflow");
+        break;
+    default:
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Unhandled exception: 0x%X", event.code);
+        break;
+    }
+}
+
+core_debugger::core_debugger() : target_pid(0), target_handle(0), current_debug_event({}), is_thread_running(false) {
+    register_log_handlers();
+    register_handler(debug_event_type::create_process, [this] (const debug_event& event) {
+        return modules.on_create_process(event);
+    });
+    register_handler(debug_event_type::load_module, [this] (const debug_event& event) {
+        return modules.on_load_module(event);
+    });
+    register_handler(debug_event_type::unload_module, [this] (const debug_event& event) {
+        return modules.on_unload_module(event);
+    });
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        return breakpoints.on_exception(event);
+    });
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        return hardware_breakpoints.on_exception(event);
+    });
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        return page_watches.on_exception(event);
+    });
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        return coverage.on_exception(event);
+    });
+    // After the managers above, so a traced thread steps on from wherever they left it.
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        return stepper.on_exception(event);
+    });
+    register_handler(debug_event_type::exit_thread, [this] (const debug_event& event) {
+        return stepper.on_exit_thread(event);
+    });
+    register_handler(debug_event_type::create_thread, [this] (const debug_event& event) {
+        return hardware_breakpoints.on_create_thread(event);
+    });
+    register_handler(debug_event_type::exit_thread, [this] (const debug_event& event) {
+        return hardware_breakpoints.on_exit_thread(event);
+    });
+}
+
+void core_debugger::register_log_handlers() {
+    register_handler(debug_event_type::create_process, [] (const debug_event&) {
+        DEBUG_LOG(INFO, DEBUGGER, "[debugger] Process created");
+        return false;
+    });
+    register_handler(debug_event_type::create_thread, [] (const debug_event&) {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Thread created");
+        return false;
+    });
+    register_handler(debug_event_type::exit_thread, [] (const debug_event&) {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Thread exited");
+        return false;
+    });
+    register_handler(debug_event_type::exit_process, [this] (const debug_event& event) {
+        DEBUG_LOG(INFO, DEBUGGER, "[debugger] Process exited");
+        if (event.pid == target_pid) {
+            DEBUG_LOG(INFO, DEBUGGER, "[debugger] Target process has exited");
+        }
+        return false;
+    });
+    register_handler(debug_event_type::load_module, [] (const debug_event&) {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] DLL loaded");
+        return false;
+    });
+    register_handler(debug_event_type::unload_module, [] (const debug_event&) {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] DLL unloaded");
+        return false;
+    });
+    register_handler(debug_event_type::output_string, [] (const debug_event&) {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Debug string output");
+        return false;
+    });
+    register_handler(debug_event_type::exception, [this] (const debug_event& event) {
+        log_exception(event);
+        if (!event.first_chance) {
+            log_stack(event);
+        }
+        return false;
+    });
+    register_handler(debug_event_type::unknown, [] (const debug_event& event) {
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Unknown event: %d", event.code);
+        return false;
+    });
+}
+
+// The target is about to die of this exception: say where it was.
+void core_debugger::log_stack(const debug_event& event) {
+    thread_registers registers;
+    if (!event_source || !event_source->get_registers(event.tid, registers)) {
+        return;
+    }
+    walker.set_modules(*modules.snapshot());
+    uint64_t frames[STACK_WALK_MAX_FRAMES];
+    size_t count = walker.walk(registers, frames, STACK_WALK_MAX_FRAMES);
+    for (size_t i = 0; i < count; i++) {
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger]   #%u %s", static_cast<unsigned>(i), format_address(walker.get_modules(), frames[i]).c_str());
+    }
+}
+
+void core_debugger::register_handler(debug_event_type type, debug_event_handler handler) {
+    dispatcher.register_handler(type, std::move(handler));
+}
+
+breakpoint_manager* core_debugger::get_breakpoints() {
+    return &breakpoints;
+}
+
+hardware_breakpoint_manager* core_debugger::get_hardware_breakpoints() {
+    return &hardware_breakpoints;
+}
+
+page_watch_manager* core_debugger::get_page_watches() {
+    return &page_watches;
+}
+
+access_tracer* core_debugger::get_access_tracer() {
+    return &tracer;
+}
+
+step_tracer* core_debugger::get_step_tracer() {
+    return &stepper;
+}
+
+coverage_collector* core_debugger::get_coverage() {
+    return &coverage;
+}
+
+stack_walker* core_debugger::get_stack_walker() {
+    return &walker;
+}
+
+module_map* core_debugger::get_module_map() {
+    return &modules;
+}
+
+event_journal* core_debugger::get_event_journal() {
+    return &journal;
+}
+
+exception_stats* core_debugger::get_exception_stats() {
+    return &exception_statistics;
+}
+
+std::shared_ptr<const std::vector<module_range>> core_debugger::get_modules(uint32_t pid) {
+    std::shared_ptr<const std::vector<module_range>> map = modules.snapshot();
+    if (pid && modules.get_pid() == pid && !map->empty()) {
+        return map;
+    }
+    return std::make_shared<std::vector<module_range>>(enumerate_modules(pid));
+}
+
+sampling_profiler* core_debugger::get_profiler() {
+    return &profiler;
+}
+
+debug_event_source* core_debugger::get_event_source() {
+    return event_source.get();
+}
+
+bool core_debugger::execute(std::function<bool()> task) {
+    auto result = std::make_shared<std::promise<bool>>();
+    std::future<bool> finished = result->get_future();
+    std::shared_ptr<debug_event_source> source;
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        if (!is_thread_running || !event_source) {
+            return false;
+        }
+        source = event_source;
+        tasks.push_back([task, result] {
+            result->set_value(task());
+        });
+    }
+    source->wake();
+
+    if (finished.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        return false;
+    }
+    try {
+        return finished.get();
+    }
+    catch (...) {
+        // The debugger thread exited and dropped the task.
+        return false;
+    }
+}
+
+void core_debugger::run_tasks() {
+    std::vector<std::function<void()>> pending;
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        pending.swap(tasks);
+    }
+    for (auto& task : pending) {
+        task();
+    }
+}
 
 bool core_debugger::enable_debug_privelege() {
     HANDLE token;
@@ -61,215 +289,177 @@ bool core_debugger::detach() {
     return true;
 }
 
-DEBUG_EVENT core_debugger::get_current_debug_event() {
+debug_event core_debugger::get_current_debug_event() {
     return current_debug_event;
 }
 
-void core_debugger::handler() {
+void core_debugger::handler(std::shared_ptr<debug_event_source> source) {
+    trace_recorder::instance()->set_thread_name("debugger");
     debug::start();
-    debug::print("[debugger] Handler started.\n");
+    DEBUG_LOG(INFO, DEBUGGER, "[debugger] Handler started.");
+
+    if (!source) {
+        DEBUG_LOG(ERR, DEBUGGER, "[debugger] No debug event source for this platform");
+        finish_handler();
+        return;
+    }
 
     if (target_pid == 0) {
-        debug::print_fmt("[debugger] Invalid target PID: %d", target_pid);
+        DEBUG_LOG(ERR, DEBUGGER, "[debugger] Invalid target PID: %d", target_pid);
+        finish_handler();
         return;
     }
 
     if (!is_target_process_running()) {
-        debug::print_fmt("[debugger] Process %d does not exist", target_pid);
+        DEBUG_LOG(ERR, DEBUGGER, "[debugger] Process %d does not exist", target_pid);
+        finish_handler();
         return;
     }
 
-    debug::print_fmt("[debugger] Attaching to process %d", target_pid);
+    DEBUG_LOG(INFO, DEBUGGER, "[debugger] Attaching to process %d", target_pid);
 
     bool is_attached = false;
 
-    if (!DebugActiveProcess(target_pid)) {
+    if (!source->attach(target_pid)) {
         DWORD error = GetLastError();
-        debug::print_fmt("[debugger] Failed to attach debugger. Error: %d\n", error);
+        DEBUG_LOG(ERR, DEBUGGER, "[debugger] Failed to attach debugger. Error: %d", error);
+        finish_handler();
         return;
     }
 
     is_attached = true;
-    debug::print_fmt("[debugger] Successfully attached to process %d", target_pid);
-
-    while (true) {
-        if (!is_thread_running) {
-            debug::print("[debugger] Thread stop requested");
+    DEBUG_LOG(INFO, DEBUGGER, "[debugger] Successfully attached to process %d", target_pid);
+    breakpoints.bind(source.get());
+    hardware_breakpoints.bind(source.get());
+    page_watches.bind(source.get());
+    stepper.bind(source.get());
+    coverage.bind(source.get());
+    modules.bind(source.get());
+    journal.bind(source.get());
+    walker.bind(source.get());
+    profiler.bind(source.get(), &walker);
+
+    // wait() blocks until the target reports something, a profiler tick is due or
+    // stop_handler wakes it.
+    while (is_thread_running) {
+        profiler.on_timer();
+        debug_event event;
+        wait_status status = source->wait(event, profiler.due_in());
+        if (status == wait_status::timeout) {
+            continue;
+        }
+        if (status == wait_status::woken) {
+            run_tasks();
+            continue;
+        }
+        if (status == wait_status::failed) {
+            DWORD error = GetLastError();
+            DEBUG_LOG(ERR, DEBUGGER, "[debugger] Waiting for debug events failed: %d", error);
             break;
         }
 
-        if (WaitForDebugEvent(&current_debug_event, 100)) {
-            DWORD event_code = current_debug_event.dwDebugEventCode;
-            DWORD process_id = current_debug_event.dwProcessId;
-            DWORD thread_id = current_debug_event.dwThreadId;
-
-            debug::print_fmt("[debugger] Caught Event: %d from process %d, thread %d",
-                             event_code, process_id, thread_id);
-
-            switch (event_code) {
-            case CREATE_PROCESS_DEBUG_EVENT:
-                debug::print("[debugger] Process created");
-                if (current_debug_event.u.CreateProcessInfo.hFile != NULL) {
-                    CloseHandle(current_debug_event.u.CreateProcessInfo.hFile);
-                }
-                break;
-
-            case CREATE_THREAD_DEBUG_EVENT:
-                debug::print("[debugger] Thread created");
-                break;
-
-            case EXIT_THREAD_DEBUG_EVENT:
-                debug::print("[debugger] Thread exited");
-                break;
-
-            case EXIT_PROCESS_DEBUG_EVENT:
-                debug::print("[debugger] Process exited");
-                if (process_id == target_pid) {
-                    is_attached = false;
-                    debug::print("[debugger] Target process has exited");
-                }
-                break;
-
-            case LOAD_DLL_DEBUG_EVENT:
-                debug::print("[debugger] DLL loaded");
-                if (current_debug_event.u.LoadDll.hFile != NULL) {
-                    CloseHandle(current_debug_event.u.LoadDll.hFile);
-                }
-                break;
-
-            case UNLOAD_DLL_DEBUG_EVENT:
-                debug::print("[debugger] DLL unloaded");
-                break;
-
-            case OUTPUT_DEBUG_STRING_EVENT:
-                debug::print("[debugger] Debug string output");
-                break;
-
-            case EXCEPTION_DEBUG_EVENT:
-            {
-                DWORD exception_code_ = current_debug_event.u.Exception.ExceptionRecord.ExceptionCode;
-                DWORD64 exception_address = (DWORD64)current_debug_event.u.Exception.ExceptionRecord.ExceptionAddress;
-                bool first_chance = current_debug_event.u.Exception.dwFirstChance != 0;
-
-                debug::print_fmt("[debugger] Exception caught: 0x%X at address 0x%llX (first chance: %s)",
-                                 exception_code_, exception_address, first_chance ? "yes" : "no");
-
-                DWORD continue_status = DBG_EXCEPTION_NOT_HANDLED;
-
-                switch (exception_code_) {
-                case EXCEPTION_BREAKPOINT:
-                    debug::print("[debugger] Breakpoint exception");
-                    continue_status = DBG_CONTINUE;
-                    break;
-
-                case EXCEPTION_SINGLE_STEP:
-                    debug::print("[debugger] Single step exception");
-                    continue_status = DBG_CONTINUE;
-                    break;
-
-                case EXCEPTION_ACCESS_VIOLATION:
-                    debug::print_fmt("[debugger] Access violation at 0x%llX", exception_address);
-                    continue_status = first_chance ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
-                    break;
-
-                case EXCEPTION_DATATYPE_MISALIGNMENT:
-                    debug::print("[debugger] Datatype misalignment");
-                    continue_status = first_chance ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
-                    break;
-
-                case EXCEPTION_ILLEGAL_INSTRUCTION:
-                    debug::print("[debugger] Illegal instruction");
-                    continue_status = first_chance ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
-                    break;
-
-                case EXCEPTION_STACK_OVERFLOW:
-                    debug::print("[debugger] Stack overflow");
-                    continue_status = first_chance ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
-                    break;
-
-                default:
-                    debug::print_fmt("[debugger] Unhandled exception: 0x%X", exception_code_);
-                    continue_status = first_chance ? DBG_EXCEPTION_NOT_HANDLED : DBG_CONTINUE;
-                    break;
-                }
-
-                if (!ContinueDebugEvent(current_debug_event.dwProcessId,
-                    current_debug_event.dwThreadId,
-                    continue_status)) {
-                    DWORD error = GetLastError();
-                    debug::print_fmt("[debugger] Failed to continue debug event: %d", error);
-                }
-
-                continue;
+        // Statistics mode: count the exception and resume it by policy, nothing else.
+        continue_action counted_action = continue_action::handled;
+        if (event.type == debug_event_type::exception && exception_statistics.is_enabled() &&
+            exception_statistics.record(event, counted_action)) {
+            if (!source->resume(event, counted_action)) {
+                DWORD error = GetLastError();
+                DEBUG_LOG(ERR, DEBUGGER, "[debugger] Failed to continue debug event: %d", error);
             }
-            break;
+            continue;
+        }
 
-            default:
-                debug::print_fmt("[debugger] Unknown event: %d", event_code);
-                break;
-            }
+        TRACE_SCOPE_ARG(debug_event_type_name(event.type), event.tid);
+        current_debug_event = event;
+        journal.record(event);
 
-            if (process_id == target_pid || process_id == 0) {
-                if (!ContinueDebugEvent(process_id, thread_id, DBG_CONTINUE)) {
-                    DWORD error = GetLastError();
-                    debug::print_fmt("[debugger] Failed to continue debug event: %d", error);
-                }
-            }
-            else {
-                debug::print_fmt("[debugger] Ignoring event from unknown process: %d", process_id);
-            }
-        }
-        else {
+        DEBUG_LOG(DEBUG, DEBUGGER, "[debugger] Caught Event: %s from process %d, thread %d",
+                  debug_event_type_name(event.type), event.pid, event.tid);
+
+        continue_action action = dispatcher.dispatch(event);
+        if (!source->resume(event, action)) {
             DWORD error = GetLastError();
-            if (error != ERROR_SEM_TIMEOUT) {
-                debug::print_fmt("[debugger] WaitForDebugEvent failed: %d", error);
-                break;
-            }
+            DEBUG_LOG(ERR, DEBUGGER, "[debugger] Failed to continue debug event: %d", error);
         }
+
+        if (event.type == debug_event_type::exit_process && event.pid == target_pid) {
+            is_attached = false;
+            break;
+        }
+    }
+
+    if (!is_thread_running) {
+        DEBUG_LOG(INFO, DEBUGGER, "[debugger] Thread stop requested");
     }
 
+    // Puts every original byte, debug register and page protection back while the target can
+    // still be written.
+    tracer.stop(hardware_breakpoints);
+    breakpoints.unbind();
+    hardware_breakpoints.unbind();
+    page_watches.unbind();
+    stepper.unbind();
+    coverage.unbind();
+    profiler.unbind();
+    walker.unbind();
+    modules.unbind();
+    journal.unbind();
+
     if (is_attached) {
-        debug::print_fmt("[debugger] Attempting to detach from process %d...", target_pid);
+        DEBUG_LOG(INFO, DEBUGGER, "[debugger] Attempting to detach from process %d...", target_pid);
 
         if (!is_target_process_running()) {
             DWORD error = GetLastError();
-            debug::print_fmt("[debugger] Process %d no longer exists (error: %d)", target_pid, error);
+            DEBUG_LOG(WARN, DEBUGGER, "[debugger] Process %d no longer exists (error: %d)", target_pid, error);
             is_attached = false;
         }
         else {
-            if (!DebugActiveProcessStop(target_pid)) {
+            if (!source->detach()) {
                 DWORD error = GetLastError();
-                debug::print_fmt("[debugger] Failed to detach debugger. Error: %d\n", error);
+                DEBUG_LOG(ERR, DEBUGGER, "[debugger] Failed to detach debugger. Error: %d", error);
             }
             else {
-                debug::print("[debugger] Successfully detached debugger");
+                DEBUG_LOG(INFO, DEBUGGER, "[debugger] Successfully detached debugger");
             }
         }
     }
     else {
-        debug::print("[debugger] No need to detach, process already exited");
+        DEBUG_LOG(INFO, DEBUGGER, "[debugger] No need to detach, process already exited");
     }
 
-    debug::print("[debugger] Handler stopped.");
+    finish_handler();
+}
+
+void core_debugger::finish_handler() {
+    DEBUG_LOG(INFO, DEBUGGER, "[debugger] Handler stopped.");
     debug::stop();
+    {
+        std::lock_guard<std::mutex> lock(task_mutex);
+        is_thread_running = false;
+        tasks.clear();
+    }
     target_pid = 0;
     target_handle = 0;
 }
 
 void core_debugger::run_handler() {
+    event_source = create_debug_event_source();
     is_thread_running = true;
-    debugger_thread = std::thread(&core_debugger::handler, this);
+    debugger_thread = std::thread(&core_debugger::handler, this, event_source);
     debugger_thread.detach();
 }
 
 void core_debugger::stop_handler() {
     is_thread_running = false;
+    if (event_source) {
+        event_source->wake();
+    }
 }
 
 bool core_debugger::is_target_process_running() {
     HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION, FALSE, target_pid);
     if (hProcess == NULL) {
-        debug::print_fmt("[debugger] Process %d does not exist, disabling debugger.", target_pid);
+        DEBUG_LOG(WARN, DEBUGGER, "[debugger] Process %d does not exist, disabling debugger.", target_pid);
         return false;
     }
     CloseHandle(hProcess);
@@ -4,16 +4,52 @@
 #include <Windows.h>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <functional>
+#include "debug_event_source.h"
+#include "breakpoints.h"
+#include "hardware_breakpoints.h"
+#include "access_tracer.h"
+#include "page_watches.h"
+#include "step_tracer.h"
+#include "coverage.h"
+#include "profiler.h"
+#include "stack_walker.h"
+#include "event_journal.h"
+#include "exception_stats.h"
 
 class core_debugger
 {
     DWORD target_pid;
     HANDLE target_handle;
-    DEBUG_EVENT current_debug_event;
+    debug_event current_debug_event;
     std::thread debugger_thread;
     std::atomic<bool> is_thread_running;
+    std::shared_ptr<debug_event_source> event_source;
+    debug_event_dispatcher dispatcher;
+    breakpoint_manager breakpoints;
+    hardware_breakpoint_manager hardware_breakpoints;
+    access_tracer tracer;
+    page_watch_manager page_watches;
+    step_tracer stepper;
+    coverage_collector coverage;
+    module_map modules;
+    event_journal journal;
+    exception_stats exception_statistics;
+    stack_walker walker;
+    sampling_profiler profiler;
+    std::mutex task_mutex;
+    std::vector<std::function<void()>> tasks;
+
+    void register_log_handlers();
+    void log_stack(const debug_event& event);
+    void run_tasks();
+    // Every exit of handler() ends here, so execute() never queues work for a dead thread.
+    void finish_handler();
 public:
-    core_debugger() : target_pid(0), current_debug_event({}) {};
+    core_debugger();
     static core_debugger* instance() {
         static core_debugger singleton;
         return &singleton;
@@ -21,8 +57,32 @@ public:
     bool enable_debug_privelege();
     bool attach(DWORD pid, HANDLE handle);
     bool detach();
-    DEBUG_EVENT get_current_debug_event();
-    void handler();
+    debug_event get_current_debug_event();
+    // Handlers run on the debugger thread; register them before attaching.
+    void register_handler(debug_event_type type, debug_event_handler handler);
+    // Runs task on the debugger thread, which owns the target (ptrace, int3 writes), and
+    // waits for it. False if the debugger is not attached, the task failed or timed out.
+    bool execute(std::function<bool()> task);
+    breakpoint_manager* get_breakpoints();
+    hardware_breakpoint_manager* get_hardware_breakpoints();
+    page_watch_manager* get_page_watches();
+    // Debugger thread only (through execute()).
+    access_tracer* get_access_tracer();
+    step_tracer* get_step_tracer();
+    coverage_collector* get_coverage();
+    stack_walker* get_stack_walker();
+    module_map* get_module_map();
+    // Any thread; kept after detach.
+    event_journal* get_event_journal();
+    // Any thread; clear() through execute() while attached.
+    exception_stats* get_exception_stats();
+    // The attached target's module map, or a one-shot enumeration of pid when the debugger
+    // does not follow it. Any thread.
+    std::shared_ptr<const std::vector<module_range>> get_modules(uint32_t pid);
+    sampling_profiler* get_profiler();
+    // The attached target's memory and threads; null when detached.
+    debug_event_source* get_event_source();
+    void handler(std::shared_ptr<debug_event_source> source);
     void run_handler();
     void stop_handler();
 
@@ -0,0 +1,209 @@
+#include "event_journal.h"
+#include <algorithm>
+#include <chrono>
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+static const uint8_t JOURNAL_FIRST_CHANCE = 0x80;
+
+uint64_t journal_now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef _WIN32
+// OUTPUT_DEBUG_STRING_INFO: the text is in the target, ANSI or UTF-16, length with the null.
+static bool read_debug_string(debug_event_source* source, const debug_event& event, std::string& text) {
+    const DEBUG_EVENT* native = static_cast<const DEBUG_EVENT*>(event.native);
+    if (!source || !native || native->dwDebugEventCode != OUTPUT_DEBUG_STRING_EVENT) {
+        return false;
+    }
+    const OUTPUT_DEBUG_STRING_INFO& info = native->u.DebugString;
+    size_t length = (std::min)(static_cast<size_t>(info.nDebugStringLength), EVENT_JOURNAL_MAX_STRING);
+    if (info.fUnicode) {
+        std::vector<wchar_t> wide(length + 1, L'\0');
+        if (!length || !source->read_memory(event.address, wide.data(), length * sizeof(wchar_t))) {
+            return false;
+        }
+        char narrow[EVENT_JOURNAL_MAX_STRING * 2 + 1] = {};
+        WideCharToMultiByte(CP_ACP, 0, wide.data(), -1, narrow, sizeof(narrow), nullptr, nullptr);
+        text = narrow;
+    }
+    else {
+        text.assign(length, '\0');
+        if (!length || !source->read_memory(event.address, &text[0], length)) {
+            return false;
+        }
+        text.resize(text.find('\0') == std::string::npos ? length : text.find('\0'));
+    }
+    text.erase(text.find_last_not_of("\r\n") + 1);
+    return true;
+}
+#else
+// ptrace reports no debug strings.
+static bool read_debug_string(debug_event_source*, const debug_event&, std::string&) {
+    return false;
+}
+#endif
+
+event_journal::event_journal(size_t rows) : source(nullptr), capacity((std::max)(rows, static_cast<size_t>(1))), recorded(0) {
+    timestamps.resize(capacity);
+    types.resize(capacity);
+    pids.resize(capacity);
+    tids.resize(capacity);
+    addresses.resize(capacity);
+    codes.resize(capacity);
+    strings.resize(capacity);
+}
+
+void event_journal::bind(debug_event_source* event_source) {
+    source = event_source;
+}
+
+void event_journal::unbind() {
+    source = nullptr;
+}
+
+uint32_t event_journal::intern(std::string text) {
+    auto known = intern_index.find(text);
+    if (known != intern_index.end()) {
+        return known->second;
+    }
+    if (interned.size() >= EVENT_JOURNAL_MAX_STRINGS) {
+        return EVENT_NO_STRING;
+    }
+    uint32_t id = static_cast<uint32_t>(interned.size());
+    interned.push_back(text);
+    intern_index.emplace(std::move(text), id);
+    return id;
+}
+
+void event_journal::record(const debug_event& event) {
+    uint64_t timestamp = journal_now();
+    // Read before taking the lock: it is a call into the target.
+    std::string text;
+    bool has_text = event.type == debug_event_type::output_string && read_debug_string(source, event, text);
+    std::lock_guard<std::mutex> lock(mutex);
+    uint32_t string = has_text ? intern(std::move(text)) : EVENT_NO_STRING;
+    uint64_t row = recorded.load();
+    size_t slot = static_cast<size_t>(row % capacity);
+    timestamps[slot] = timestamp;
+    types[slot] = static_cast<uint8_t>(static_cast<uint8_t>(event.type) | (event.first_chance ? JOURNAL_FIRST_CHANCE : 0));
+    pids[slot] = event.pid;
+    tids[slot] = event.tid;
+    addresses[slot] = event.address;
+    codes[slot] = event.code;
+    strings[slot] = string;
+    recorded.store(row + 1);
+}
+
+void event_journal::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    recorded.store(0);
+    interned.clear();
+    intern_index.clear();
+}
+
+size_t event_journal::get_kept() const {
+    return static_cast<size_t>((std::min)(recorded.load(), static_cast<uint64_t>(capacity)));
+}
+
+size_t event_journal::get_strings() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return interned.size();
+}
+
+std::string event_journal::get_string(uint32_t id) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return id < interned.size() ? interned[id] : std::string();
+}
+
+uint64_t event_journal::first_since(uint64_t timestamp) const {
+    uint64_t end = recorded.load();
+    uint64_t low = end - (std::min)(end, static_cast<uint64_t>(capacity));
+    uint64_t high = end;
+    while (low < high) {
+        uint64_t middle = low + (high - low) / 2;
+        if (timestamps[static_cast<size_t>(middle % capacity)] < timestamp) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+journal_counts event_journal::count(uint64_t since) const {
+    journal_counts counts = {};
+    std::unordered_map<uint32_t, uint64_t> by_code;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t end = recorded.load();
+    for (uint64_t row = first_since(since); row < end; row++) {
+        size_t slot = static_cast<size_t>(row % capacity);
+        uint8_t type = types[slot] & ~JOURNAL_FIRST_CHANCE;
+        counts.by_type[type < static_cast<uint8_t>(debug_event_type::count) ? type : static_cast<uint8_t>(debug_event_type::unknown)]++;
+        if (type == static_cast<uint8_t>(debug_event_type::exception)) {
+            by_code[codes[slot]]++;
+        }
+        counts.events++;
+    }
+    counts.by_code.assign(by_code.begin(), by_code.end());
+    std::sort(counts.by_code.begin(), counts.by_code.end(), [] (const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return counts;
+}
+
+std::vector<journal_site> event_journal::top(uint64_t since, uint32_t code, size_t max) const {
+    struct site_key
+    {
+        uint32_t code;
+        uint64_t address;
+        bool operator==(const site_key& other) const { return code == other.code && address == other.address; }
+    };
+    struct site_hash
+    {
+        size_t operator()(const site_key& key) const {
+            return std::hash<uint64_t>()(key.address * 0x9E3779B97F4A7C15ull ^ key.code);
+        }
+    };
+    std::unordered_map<site_key, uint64_t, site_hash> sites;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        uint64_t end = recorded.load();
+        const uint8_t exception = static_cast<uint8_t>(debug_event_type::exception);
+        for (uint64_t row = first_since(since); row < end; row++) {
+            size_t slot = static_cast<size_t>(row % capacity);
+            if ((types[slot] & ~JOURNAL_FIRST_CHANCE) != exception || (code && codes[slot] != code)) {
+                continue;
+            }
+            sites[site_key{codes[slot], addresses[slot]}]++;
+        }
+    }
+    std::vector<journal_site> sorted;
+    sorted.reserve(sites.size());
+    for (const auto& site : sites) {
+        sorted.push_back(journal_site{site.first.code, site.first.address, site.second});
+    }
+    std::sort(sorted.begin(), sorted.end(), [] (const journal_site& a, const journal_site& b) {
+        return a.events != b.events ? a.events > b.events : a.address < b.address;
+    });
+    sorted.resize((std::min)(sorted.size(), max));
+    return sorted;
+}
+
+std::vector<journal_event> event_journal::since(uint64_t since, size_t max) const {
+    std::vector<journal_event> events;
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t end = recorded.load();
+    uint64_t row = (std::max)(first_since(since), end - (std::min)(end, static_cast<uint64_t>(max)));
+    for (; row < end; row++) {
+        size_t slot = static_cast<size_t>(row % capacity);
+        events.push_back(journal_event{timestamps[slot], static_cast<debug_event_type>(types[slot] & ~JOURNAL_FIRST_CHANCE),
+                                       (types[slot] & JOURNAL_FIRST_CHANCE) != 0, pids[slot], tids[slot], addresses[slot],
+                                       codes[slot], strings[slot]});
+    }
+    return events;
+}
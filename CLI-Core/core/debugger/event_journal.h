@@ -0,0 +1,95 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "debug_event_source.h"
+
+const size_t EVENT_JOURNAL_CAPACITY = 1 << 16;
+const uint32_t EVENT_NO_STRING = 0xFFFFFFFF;
+// Distinct debug strings kept, and the length each is cut to.
+const size_t EVENT_JOURNAL_MAX_STRINGS = 4096;
+const size_t EVENT_JOURNAL_MAX_STRING = 1024;
+
+// One journal row.
+struct journal_event
+{
+    uint64_t timestamp;
+    debug_event_type type;
+    bool first_chance;
+    uint32_t pid;
+    uint32_t tid;
+    uint64_t address;
+    uint32_t code;
+    uint32_t string;        // output_string: interned text, else EVENT_NO_STRING
+};
+
+// Exceptions at one address with one code.
+struct journal_site
+{
+    uint32_t code;
+    uint64_t address;
+    uint64_t events;
+};
+
+struct journal_counts
+{
+    uint64_t events;
+    uint64_t by_type[static_cast<size_t>(debug_event_type::count)];
+    // Exceptions per code, most first.
+    std::vector<std::pair<uint32_t, uint64_t>> by_code;
+};
+
+// The journal's clock: steady nanoseconds.
+uint64_t journal_now();
+
+// Every debug event the debugger sees, newest capacity kept, stored by column (timestamp,
+// type, pid, tid, address, code, string) so queries scan only the columns they aggregate.
+// Debug strings are read once and interned; the column holds the id. The debugger thread
+// records; queries may run on any thread, also after detach.
+class event_journal
+{
+    debug_event_source* source;
+    size_t capacity;
+    mutable std::mutex mutex;
+    // Row n lives at n % capacity; rows [recorded - kept, recorded) are valid.
+    std::vector<uint64_t> timestamps;
+    std::vector<uint8_t> types;     // debug_event_type, JOURNAL_FIRST_CHANCE set for first chances
+    std::vector<uint32_t> pids;
+    std::vector<uint32_t> tids;
+    std::vector<uint64_t> addresses;
+    std::vector<uint32_t> codes;
+    std::vector<uint32_t> strings;
+    std::atomic<uint64_t> recorded;
+    std::vector<std::string> interned;
+    std::unordered_map<std::string, uint32_t> intern_index;
+
+    uint32_t intern(std::string text);
+    // First valid row at or after timestamp; rows are in time order.
+    uint64_t first_since(uint64_t timestamp) const;
+public:
+    explicit event_journal(size_t rows = EVENT_JOURNAL_CAPACITY);
+
+    // The source debug strings are read from. Unbinding keeps the journal.
+    void bind(debug_event_source* event_source);
+    void unbind();
+    void record(const debug_event& event);
+    void clear();
+
+    uint64_t get_recorded() const { return recorded.load(); }
+    size_t get_kept() const;
+    size_t get_capacity() const { return capacity; }
+    size_t get_strings() const;
+    std::string get_string(uint32_t id) const;
+
+    // Over the events recorded at or after since (0: every event kept).
+    journal_counts count(uint64_t since) const;
+    // Exception sites, most events first; code 0 takes every code.
+    std::vector<journal_site> top(uint64_t since, uint32_t code, size_t max) const;
+    // The newest max events at or after since, oldest first.
+    std::vector<journal_event> since(uint64_t since, size_t max) const;
+};
+#endif // !EVENT_JOURNAL_H
@@ -0,0 +1,115 @@
+#include "exception_stats.h"
+#include <algorithm>
+
+static const size_t MAX_PROBES = 64;
+static const uint64_t POLICY_USED = 1ull << 32;
+static const uint64_t POLICY_NOT_HANDLED = 1ull << 33;
+static const uint64_t POLICY_DISPATCH = 1ull << 34;
+
+static size_t policy_index(uint32_t code) {
+    return static_cast<size_t>((code * 0x9E3779B1u) >> 26) % EXCEPTION_POLICY_SLOTS;
+}
+
+static size_t site_index(uint32_t code, uint64_t address) {
+    return static_cast<size_t>(((address ^ (static_cast<uint64_t>(code) << 20)) * 0x9E3779B97F4A7C15ull) >> 40) % EXCEPTION_STATS_SLOTS;
+}
+
+exception_stats::exception_stats() : enabled(false), slots(new slot[EXCEPTION_STATS_SLOTS]), total(0), dropped(0), sites(0) {
+    for (auto& policy : policies) {
+        policy.store(0);
+    }
+    clear();
+    // The codes the managers own still reach them.
+    set_policy(DEBUG_EXCEPTION_BREAKPOINT, exception_policy{continue_action::handled, true});
+    set_policy(DEBUG_EXCEPTION_SINGLE_STEP, exception_policy{continue_action::handled, true});
+    set_policy(DEBUG_EXCEPTION_GUARD_PAGE, exception_policy{continue_action::not_handled, true});
+}
+
+bool exception_stats::set_policy(uint32_t code, exception_policy policy) {
+    uint64_t entry = code | POLICY_USED | (policy.action == continue_action::not_handled ? POLICY_NOT_HANDLED : 0) |
+                     (policy.dispatch ? POLICY_DISPATCH : 0);
+    for (size_t probe = 0, i = policy_index(code); probe < EXCEPTION_POLICY_SLOTS; probe++, i = (i + 1) % EXCEPTION_POLICY_SLOTS) {
+        uint64_t current = policies[i].load();
+        if (!(current & POLICY_USED) || static_cast<uint32_t>(current) == code) {
+            policies[i].store(entry);
+            return true;
+        }
+    }
+    return false;
+}
+
+exception_policy exception_stats::policy_for(uint32_t code) const {
+    for (size_t probe = 0, i = policy_index(code); probe < EXCEPTION_POLICY_SLOTS; probe++, i = (i + 1) % EXCEPTION_POLICY_SLOTS) {
+        uint64_t entry = policies[i].load(std::memory_order_relaxed);
+        if (!(entry & POLICY_USED)) {
+            break;
+        }
+        if (static_cast<uint32_t>(entry) == code) {
+            return exception_policy{entry & POLICY_NOT_HANDLED ? continue_action::not_handled : continue_action::handled,
+                                    (entry & POLICY_DISPATCH) != 0};
+        }
+    }
+    return exception_policy{continue_action::not_handled, false};
+}
+
+bool exception_stats::record(const debug_event& event, continue_action& action) {
+    total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    slot* found = nullptr;
+    for (size_t probe = 0, i = site_index(event.code, event.address); probe < MAX_PROBES; probe++, i = (i + 1) % EXCEPTION_STATS_SLOTS) {
+        slot& current = slots[i];
+        if (!current.used.load(std::memory_order_relaxed)) {
+            current.code.store(event.code, std::memory_order_relaxed);
+            current.address.store(event.address, std::memory_order_relaxed);
+            // Readers check used before the key.
+            current.used.store(1, std::memory_order_release);
+            sites.store(sites.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            found = &current;
+            break;
+        }
+        if (current.code.load(std::memory_order_relaxed) == event.code && current.address.load(std::memory_order_relaxed) == event.address) {
+            found = &current;
+            break;
+        }
+    }
+    // Only this thread writes, so a load and a store count without a locked instruction.
+    std::atomic<uint64_t>* counter = found ? (event.first_chance ? &found->first_chance : &found->second_chance) : &dropped;
+    counter->store(counter->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (!event.first_chance) {
+        return false;
+    }
+    exception_policy policy = policy_for(event.code);
+    action = policy.action;
+    return !policy.dispatch;
+}
+
+void exception_stats::clear() {
+    for (size_t i = 0; i < EXCEPTION_STATS_SLOTS; i++) {
+        slots[i].used.store(0);
+        slots[i].first_chance.store(0);
+        slots[i].second_chance.store(0);
+    }
+    total.store(0);
+    dropped.store(0);
+    sites.store(0);
+}
+
+std::vector<exception_site> exception_stats::top(size_t max) const {
+    std::vector<exception_site> found;
+    for (size_t i = 0; i < EXCEPTION_STATS_SLOTS; i++) {
+        const slot& current = slots[i];
+        if (!current.used.load(std::memory_order_acquire)) {
+            continue;
+        }
+        found.push_back(exception_site{current.code.load(std::memory_order_relaxed), current.address.load(std::memory_order_relaxed),
+                                       current.first_chance.load(std::memory_order_relaxed),
+                                       current.second_chance.load(std::memory_order_relaxed)});
+    }
+    std::sort(found.begin(), found.end(), [] (const exception_site& a, const exception_site& b) {
+        uint64_t a_total = a.first_chance + a.second_chance;
+        uint64_t b_total = b.first_chance + b.second_chance;
+        return a_total != b_total ? a_total > b_total : a.address < b.address;
+    });
+    found.resize((std::min)(found.size(), max));
+    return found;
+}
@@ -0,0 +1,75 @@
+#ifndef EXCEPTION_STATS_H
+#define EXCEPTION_STATS_H
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "debug_event_source.h"
+
+const size_t EXCEPTION_STATS_SLOTS = 1 << 14;
+const size_t EXCEPTION_POLICY_SLOTS = 64;
+
+struct exception_site
+{
+    uint32_t code;
+    uint64_t address;
+    uint64_t first_chance;
+    uint64_t second_chance;
+};
+
+// What statistics mode does with a first-chance exception of one code: resume it with action
+// straight away, or dispatch it to the handlers (the managers own breakpoints, single steps
+// and guard pages). Second chances are always dispatched.
+struct exception_policy
+{
+    continue_action action;
+    bool dispatch;
+};
+
+// Statistics mode for targets that raise exceptions by the thousand: the debugger thread
+// counts each exception under (code, address) in an open-addressed table and resumes it with
+// the action a small policy table holds for its code, without logging, journaling or
+// dispatching it. Nothing is formatted until someone asks. Lock-free: the debugger thread is
+// the only writer, any thread may read.
+class exception_stats
+{
+    struct slot
+    {
+        std::atomic<uint32_t> used;
+        std::atomic<uint32_t> code;
+        std::atomic<uint64_t> address;
+        std::atomic<uint64_t> first_chance;
+        std::atomic<uint64_t> second_chance;
+    };
+
+    std::atomic<bool> enabled;
+    std::unique_ptr<slot[]> slots;
+    // Code, used bit, not_handled bit and dispatch bit in one word each.
+    std::atomic<uint64_t> policies[EXCEPTION_POLICY_SLOTS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> sites;
+public:
+    exception_stats();
+
+    void set_enabled(bool enable) { enabled.store(enable); }
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Codes without an entry are passed to the target undispatched, as the dispatcher's
+    // default would. One thread at a time.
+    bool set_policy(uint32_t code, exception_policy policy);
+    exception_policy policy_for(uint32_t code) const;
+
+    // Debugger thread. Counts the exception; true with action set when it needs no dispatch.
+    bool record(const debug_event& event, continue_action& action);
+    // Debugger thread (through execute()), or while detached.
+    void clear();
+
+    uint64_t get_total() const { return total.load(); }
+    // Exceptions at sites the table had no room for.
+    uint64_t get_dropped() const { return dropped.load(); }
+    uint64_t get_sites() const { return sites.load(); }
+    // Most exceptions first.
+    std::vector<exception_site> top(size_t max) const;
+};
+#endif // !EXCEPTION_STATS_H
@@ -0,0 +1,226 @@
+#include "hardware_breakpoints.h"
+#include <cstring>
+#include <memory>
+
+static const uint64_t RESUME_FLAG = 0x10000;
+
+static uint64_t length_bits(uint8_t length) {
+    switch (length) {
+    case 2: return 1;
+    case 8: return 2;
+    case 4: return 3;
+    default: return 0;
+    }
+}
+
+static bool same_registers(const debug_registers& a, const debug_registers& b) {
+    return memcmp(&a, &b, sizeof(debug_registers)) == 0;
+}
+
+debug_registers hardware_breakpoint_manager::wanted() const {
+    debug_registers registers = {};
+    for (int i = 0; i < HARDWARE_BREAKPOINT_SLOTS; i++) {
+        const hardware_breakpoint& slot = slots[i];
+        if (!slot.active) {
+            continue;
+        }
+        registers.address[i] = slot.address;
+        registers.control |= 1ull << (i * 2);
+        registers.control |= static_cast<uint64_t>(slot.condition) << (16 + i * 4);
+        registers.control |= length_bits(slot.length) << (18 + i * 4);
+    }
+    return registers;
+}
+
+bool hardware_breakpoint_manager::any_active() const {
+    for (const auto& slot : slots) {
+        if (slot.active) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void hardware_breakpoint_manager::reset_slots() {
+    for (int i = 0; i < HARDWARE_BREAKPOINT_SLOTS; i++) {
+        slots[i] = hardware_breakpoint{};
+        hit_handlers[i] = nullptr;
+    }
+}
+
+size_t hardware_breakpoint_manager::apply(const std::vector<uint32_t>& tids) {
+    debug_registers registers = wanted();
+    std::vector<uint32_t> stale;
+    for (uint32_t tid : tids) {
+        auto cached = applied.find(tid);
+        // A thread never written holds zeros.
+        bool current = cached != applied.end() ? same_registers(cached->second, registers) : registers.control == 0;
+        if (!current) {
+            stale.push_back(tid);
+        }
+    }
+    if (stale.empty()) {
+        return 0;
+    }
+
+    std::unique_ptr<bool[]> written(new bool[stale.size()]);
+    size_t count = source->set_debug_registers(stale.data(), stale.size(), registers, written.get());
+    for (size_t i = 0; i < stale.size(); i++) {
+        if (written[i]) {
+            applied[stale[i]] = registers;
+        }
+    }
+    return count;
+}
+
+void hardware_breakpoint_manager::bind(debug_event_source* event_source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    source = event_source;
+    applied.clear();
+    reset_slots();
+}
+
+void hardware_breakpoint_manager::unbind() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (source) {
+        reset_slots();
+        apply(source->get_threads());
+    }
+    applied.clear();
+    source = nullptr;
+}
+
+int hardware_breakpoint_manager::set(uint64_t address, hardware_condition condition, uint8_t length, hardware_hit_handler on_hit) {
+    if (length != 1 && length != 2 && length != 4 && length != 8) {
+        return -1;
+    }
+    if ((address & (length - 1)) != 0 || (condition == hardware_condition::execute && length != 1)) {
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source) {
+        return -1;
+    }
+    int free_slot = -1;
+    for (int i = 0; i < HARDWARE_BREAKPOINT_SLOTS; i++) {
+        const hardware_breakpoint& slot = slots[i];
+        if (slot.active && slot.address == address && slot.condition == condition && slot.length == length) {
+            return i;
+        }
+        if (!slot.active && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+
+    slots[free_slot] = hardware_breakpoint{address, 0, condition, length, true};
+    std::vector<uint32_t> threads = source->get_threads();
+    if (apply(threads) == 0 && !threads.empty()) {
+        slots[free_slot] = hardware_breakpoint{};
+        return -1;
+    }
+    hit_handlers[free_slot] = std::move(on_hit);
+    return free_slot;
+}
+
+bool hardware_breakpoint_manager::clear(int slot) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source || slot < 0 || slot >= HARDWARE_BREAKPOINT_SLOTS || !slots[slot].active) {
+        return false;
+    }
+    slots[slot] = hardware_breakpoint{};
+    hit_handlers[slot] = nullptr;
+    apply(source->get_threads());
+    return true;
+}
+
+void hardware_breakpoint_manager::clear_all() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source) {
+        return;
+    }
+    reset_slots();
+    apply(source->get_threads());
+}
+
+bool hardware_breakpoint_manager::on_create_thread(const debug_event& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // New threads start with clear debug registers.
+    applied.erase(event.tid);
+    if (source && any_active()) {
+        apply(std::vector<uint32_t>{ event.tid });
+    }
+    return false;
+}
+
+bool hardware_breakpoint_manager::on_exit_thread(const debug_event& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    applied.erase(event.tid);
+    return false;
+}
+
+bool hardware_breakpoint_manager::on_exception(const debug_event& event) {
+    if (event.code != DEBUG_EXCEPTION_SINGLE_STEP) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    uint64_t status = 0;
+    if (!source || !any_active() || !source->take_debug_status(event.tid, status)) {
+        return false;
+    }
+
+    bool owned = false;
+    bool executed = false;
+    for (int i = 0; i < HARDWARE_BREAKPOINT_SLOTS; i++) {
+        if (slots[i].active && (status & (1ull << i))) {
+            slots[i].hits++;
+            owned = true;
+            executed |= slots[i].condition == hardware_condition::execute;
+            if (hit_handlers[i]) {
+                hit_handlers[i](event);
+            }
+        }
+    }
+    if (executed) {
+        // An execute breakpoint faults before the instruction; the resume flag lets it run once.
+        thread_registers registers;
+        if (source->get_registers(event.tid, registers) && !(registers.rflags & RESUME_FLAG)) {
+            registers.rflags |= RESUME_FLAG;
+            source->set_registers(event.tid, registers);
+        }
+    }
+    return owned;
+}
+
+std::vector<hardware_breakpoint> hardware_breakpoint_manager::list() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::vector<hardware_breakpoint>(slots, slots + HARDWARE_BREAKPOINT_SLOTS);
+}
+
+const char* hardware_condition_name(hardware_condition condition) {
+    switch (condition) {
+    case hardware_condition::execute: return "x";
+    case hardware_condition::write: return "w";
+    case hardware_condition::read_write: return "rw";
+    default: return "?";
+    }
+}
+
+bool parse_hardware_condition(const std::string& text, hardware_condition& condition) {
+    if (text == "x") {
+        condition = hardware_condition::execute;
+    }
+    else if (text == "w") {
+        condition = hardware_condition::write;
+    }
+    else if (text == "rw") {
+        condition = hardware_condition::read_write;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
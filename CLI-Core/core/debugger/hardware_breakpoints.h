@@ -0,0 +1,76 @@
+#ifndef HARDWARE_BREAKPOINTS_H
+#define HARDWARE_BREAKPOINTS_H
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "debug_event_source.h"
+
+const int HARDWARE_BREAKPOINT_SLOTS = 4;
+
+// Values are the Dr7 R/W field.
+enum class hardware_condition : uint8_t
+{
+    execute = 0,
+    write = 1,
+    read_write = 3
+};
+
+// Called on the debugger thread for every hit of a slot; event.address is the instruction after
+// a data access, or the executed one.
+typedef std::function<void(const debug_event&)> hardware_hit_handler;
+
+struct hardware_breakpoint
+{
+    uint64_t address;
+    uint64_t hits;
+    hardware_condition condition;
+    uint8_t length;
+    bool active;
+};
+
+// Debug-register breakpoints for one bound event source, applied to every thread of the target
+// and to threads created later. The manager owns Dr0-Dr3 and Dr7 and remembers what each
+// thread holds, so a change writes only the threads that differ and never reads a context.
+// Everything but list() runs on the debugger thread.
+class hardware_breakpoint_manager
+{
+    std::mutex mutex;
+    hardware_breakpoint slots[HARDWARE_BREAKPOINT_SLOTS];
+    hardware_hit_handler hit_handlers[HARDWARE_BREAKPOINT_SLOTS];
+    std::unordered_map<uint32_t, debug_registers> applied;
+    debug_event_source* source;
+
+    debug_registers wanted() const;
+    bool any_active() const;
+    void reset_slots();
+    // Writes wanted() to the listed threads whose cached registers differ.
+    size_t apply(const std::vector<uint32_t>& tids);
+public:
+    hardware_breakpoint_manager() : slots(), source(nullptr) {}
+
+    void bind(debug_event_source* event_source);
+    // Clears the debug registers of every thread it wrote.
+    void unbind();
+
+    // Length is 1, 2, 4 or 8 and the address must be aligned to it; execute takes length 1.
+    // Returns the slot, or -1 when the breakpoint is invalid, all slots are taken or no
+    // thread took it.
+    int set(uint64_t address, hardware_condition condition, uint8_t length, hardware_hit_handler on_hit = nullptr);
+    bool clear(int slot);
+    void clear_all();
+
+    bool on_create_thread(const debug_event& event);
+    bool on_exit_thread(const debug_event& event);
+    // True for the single steps a slot raised.
+    bool on_exception(const debug_event& event);
+
+    // Indexed by slot.
+    std::vector<hardware_breakpoint> list();
+};
+
+const char* hardware_condition_name(hardware_condition condition);
+bool parse_hardware_condition(const std::string& text, hardware_condition& condition);
+#endif // !HARDWARE_BREAKPOINTS_H
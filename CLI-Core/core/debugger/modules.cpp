@@ -0,0 +1,415 @@
+#include "modules.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifdef _WIN32
+#include <Windows.h>
+#include <TlHelp32.h>
+#else
+#include <map>
+#endif
+
+#ifdef _WIN32
+std::vector<module_range> enumerate_modules(uint32_t pid) {
+    std::vector<module_range> modules;
+    HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPMODULE | TH32CS_SNAPMODULE32, pid);
+    if (snapshot == INVALID_HANDLE_VALUE) {
+        return modules;
+    }
+    MODULEENTRY32 entry = {};
+    entry.dwSize = sizeof(entry);
+    for (BOOL more = Module32First(snapshot, &entry); more; more = Module32Next(snapshot, &entry)) {
+        modules.push_back(module_range{reinterpret_cast<uint64_t>(entry.modBaseAddr), entry.modBaseSize, entry.szModule});
+    }
+    CloseHandle(snapshot);
+
+    std::sort(modules.begin(), modules.end(), [] (const module_range& a, const module_range& b) {
+        return a.base < b.base;
+    });
+    return modules;
+}
+#else
+std::vector<module_range> enumerate_modules(uint32_t pid) {
+    std::vector<module_range> modules;
+    FILE* maps = fopen(("/proc/" + std::to_string(pid) + "/maps").c_str(), "r");
+    if (!maps) {
+        return modules;
+    }
+
+    // A file is mapped as several segments; its range runs from the first to the last.
+    std::map<std::string, std::pair<uint64_t, uint64_t>> files;
+    char line[4096];
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long long low = 0, high = 0;
+        int path_offset = 0;
+        if (sscanf(line, "%llx-%llx %*s %*s %*s %*s %n", &low, &high, &path_offset) < 2 || line[path_offset] != '/') {
+            continue;
+        }
+        std::string path(line + path_offset);
+        path.erase(path.find_last_not_of("\r\n") + 1);
+        auto file = files.find(path);
+        if (file == files.end()) {
+            files[path] = std::make_pair(static_cast<uint64_t>(low), static_cast<uint64_t>(high));
+        }
+        else {
+            file->second.first = (std::min)(file->second.first, static_cast<uint64_t>(low));
+            file->second.second = (std::max)(file->second.second, static_cast<uint64_t>(high));
+        }
+    }
+    fclose(maps);
+
+    for (const auto& file : files) {
+        size_t slash = file.first.find_last_of('/');
+        modules.push_back(module_range{file.second.first, file.second.second - file.second.first, file.first.substr(slash + 1)});
+    }
+    std::sort(modules.begin(), modules.end(), [] (const module_range& a, const module_range& b) {
+        return a.base < b.base;
+    });
+    return modules;
+}
+#endif
+
+const module_range* find_module(const std::vector<module_range>& modules, uint64_t address) {
+    auto next = std::upper_bound(modules.begin(), modules.end(), address, [] (uint64_t value, const module_range& module) {
+        return value < module.base;
+    });
+    if (next == modules.begin()) {
+        return nullptr;
+    }
+    const module_range& module = *(next - 1);
+    return address - module.base < module.size ? &module : nullptr;
+}
+
+std::string format_address(const std::vector<module_range>& modules, uint64_t address) {
+    char text[MAX_ADDRESS_TEXT];
+    size_t length = module_resolver(modules).format(address, text, sizeof(text));
+    return std::string(text, length);
+}
+
+const module_range* module_resolver::find(uint64_t address) {
+    if (last && address - last->base < last->size) {
+        return last;
+    }
+    const module_range* module = find_module(modules, address);
+    last = module ? module : last;
+    return module;
+}
+
+// Uppercase hex without leading zeros; snprintf costs more than the lookup itself.
+static size_t write_hex(uint64_t value, char* out) {
+    char digits[16];
+    size_t count = 0;
+    do {
+        digits[count++] = "0123456789ABCDEF"[value & 0xF];
+        value >>= 4;
+    } while (value);
+    for (size_t i = 0; i < count; i++) {
+        out[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+size_t module_resolver::format(uint64_t address, char* buffer, size_t size) {
+    const module_range* module = find(address);
+    size_t name_size = module ? (std::min)(module->name.size(), MAX_ADDRESS_TEXT - 20) : 0;
+    // The longest result: the name, "+0x" and 16 digits, and the terminator.
+    if (size < name_size + 20) {
+        if (size) {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+    size_t length = 0;
+    uint64_t value = address;
+    if (module) {
+        memcpy(buffer, module->name.data(), name_size);
+        length = name_size;
+        buffer[length++] = '+';
+        value = address - module->base;
+    }
+    buffer[length++] = '0';
+    buffer[length++] = 'x';
+    length += write_hex(value, buffer + length);
+    buffer[length] = '\0';
+    return length;
+}
+
+template<typename T>
+static bool read_value(debug_event_source* source, uint64_t address, T& value) {
+    return source->read_memory(address, &value, sizeof(value));
+}
+
+// IMAGE_DIRECTORY_ENTRY_EXCEPTION: RUNTIME_FUNCTION {BeginAddress, EndAddress, UnwindData}.
+static void read_pe_unwind_table(debug_event_source* source, const module_range& module, std::vector<unwind_entry>& entries) {
+    uint32_t nt_offset = 0;
+    uint16_t magic = 0;
+    uint32_t directory[2] = {};
+    if (!read_value(source, module.base + 0x3C, nt_offset) || !read_value(source, module.base + nt_offset + 0x18, magic) ||
+        magic != 0x20B) {
+        return;
+    }
+    // PE32+ optional header: data directories start at 0x70, the exception one is the fourth.
+    if (!read_value(source, module.base + nt_offset + 0x18 + 0x70 + 3 * 8, directory) || !directory[0] || directory[1] < 12) {
+        return;
+    }
+    std::vector<uint32_t> table(directory[1] / 4);
+    if (!source->read_memory(module.base + directory[0], table.data(), table.size() * 4)) {
+        return;
+    }
+    for (size_t i = 0; i + 2 < table.size(); i += 3) {
+        entries.push_back(unwind_entry{module.base + table[i], module.base + table[i + 1], module.base + table[i + 2]});
+    }
+}
+
+static size_t encoded_size(uint8_t encoding) {
+    switch (encoding & 0x0F) {
+    case 0x02: case 0x0A: return 2;
+    case 0x03: case 0x0B: return 4;
+    case 0x04: case 0x0C: return 8;
+    default: return 0;
+    }
+}
+
+// PT_GNU_EH_FRAME: version, eh_frame_ptr encoding, fde_count encoding, table encoding, the
+// eh_frame pointer, the FDE count, then (initial location, FDE) pairs sorted by location.
+static void read_elf_unwind_table(debug_event_source* source, const module_range& module, std::vector<unwind_entry>& entries) {
+    uint64_t header_offset = 0;
+    uint16_t header_count = 0;
+    if (!read_value(source, module.base + 0x20, header_offset) || !read_value(source, module.base + 0x38, header_count)) {
+        return;
+    }
+    struct program_header
+    {
+        uint32_t type;
+        uint32_t flags;
+        uint64_t offset;
+        uint64_t address;
+        uint64_t physical_address;
+        uint64_t file_size;
+        uint64_t memory_size;
+        uint64_t alignment;
+    };
+    std::vector<program_header> headers(header_count);
+    if (!header_count || !source->read_memory(module.base + header_offset, headers.data(), headers.size() * sizeof(program_header))) {
+        return;
+    }
+    uint64_t first_load = UINT64_MAX;
+    uint64_t eh_frame_hdr = 0;
+    for (const auto& header : headers) {
+        if (header.type == 1) {
+            first_load = (std::min)(first_load, header.address & ~static_cast<uint64_t>(0xFFF));
+        }
+        else if (header.type == 0x6474E550) {
+            eh_frame_hdr = header.address;
+        }
+    }
+    if (!eh_frame_hdr || first_load == UINT64_MAX) {
+        return;
+    }
+    uint64_t hdr = module.base - first_load + eh_frame_hdr;
+
+    uint8_t encodings[4] = {};
+    if (!read_value(source, hdr, encodings) || encodings[0] != 1) {
+        return;
+    }
+    size_t pointer_size = encoded_size(encodings[1]);
+    uint32_t count = 0;
+    // Only the layout every toolchain emits: udata4 count, datarel sdata4 table.
+    if (!pointer_size || encodings[2] != 0x03 || encodings[3] != 0x3B || !read_value(source, hdr + 4 + pointer_size, count) || !count) {
+        return;
+    }
+    std::vector<int32_t> table(static_cast<size_t>(count) * 2);
+    if (!source->read_memory(hdr + 4 + pointer_size + 4, table.data(), table.size() * 4)) {
+        return;
+    }
+    for (size_t i = 0; i < table.size(); i += 2) {
+        entries.push_back(unwind_entry{hdr + static_cast<int64_t>(table[i]), 0, hdr + static_cast<int64_t>(table[i + 1])});
+    }
+}
+
+image_format read_unwind_table(debug_event_source* source, const module_range& module, std::vector<unwind_entry>& entries) {
+    uint8_t magic[4] = {};
+    if (!read_value(source, module.base, magic)) {
+        return image_format::unknown;
+    }
+    image_format format = image_format::unknown;
+    if (magic[0] == 'M' && magic[1] == 'Z') {
+        format = image_format::pe;
+        read_pe_unwind_table(source, module, entries);
+    }
+    else if (magic[0] == 0x7F && magic[1] == 'E' && magic[2] == 'L' && magic[3] == 'F') {
+        format = image_format::elf;
+        read_elf_unwind_table(source, module, entries);
+    }
+
+    std::sort(entries.begin(), entries.end(), [] (const unwind_entry& a, const unwind_entry& b) {
+        return a.start < b.start;
+    });
+    entries.erase(std::unique(entries.begin(), entries.end(), [] (const unwind_entry& a, const unwind_entry& b) {
+        return a.start == b.start;
+    }), entries.end());
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [&] (const unwind_entry& entry) {
+        return entry.start - module.base >= module.size;
+    }), entries.end());
+    return format;
+}
+
+std::vector<uint64_t> discover_functions(debug_event_source* source, const module_range& module) {
+    std::vector<unwind_entry> entries;
+    read_unwind_table(source, module, entries);
+    std::vector<uint64_t> functions;
+    functions.reserve(entries.size());
+    for (const unwind_entry& entry : entries) {
+        functions.push_back(entry.start);
+    }
+    return functions;
+}
+
+#ifdef _WIN32
+// The name and extent of the image a create_process or load_module event reports: the file
+// name from the event's file handle (or the image name the loader left in the target), the
+// size from the image's PE header.
+static bool describe_image(debug_event_source* source, const debug_event& event, module_range& module) {
+    const DEBUG_EVENT* native = static_cast<const DEBUG_EVENT*>(event.native);
+    if (!native) {
+        return false;
+    }
+    bool is_process = native->dwDebugEventCode == CREATE_PROCESS_DEBUG_EVENT;
+    HANDLE file = is_process ? native->u.CreateProcessInfo.hFile : native->u.LoadDll.hFile;
+    uint64_t image_name = reinterpret_cast<uint64_t>(is_process ? native->u.CreateProcessInfo.lpImageName : native->u.LoadDll.lpImageName);
+    bool unicode = (is_process ? native->u.CreateProcessInfo.fUnicode : native->u.LoadDll.fUnicode) != 0;
+
+    uint32_t nt_offset = 0;
+    uint32_t image_size = 0;
+    // SizeOfImage sits at the same offset in PE32 and PE32+ optional headers.
+    if (!read_value(source, event.address + 0x3C, nt_offset) || !read_value(source, event.address + nt_offset + 0x18 + 0x38, image_size) ||
+        !image_size) {
+        return false;
+    }
+
+    std::string path;
+    char buffer[MAX_PATH * 2] = {};
+    if (file && GetFinalPathNameByHandleA(file, buffer, sizeof(buffer), FILE_NAME_NORMALIZED) - 1 < sizeof(buffer) - 1) {
+        path = buffer;
+    }
+    uint64_t name_address = 0;
+    if (path.empty() && image_name && read_value(source, image_name, name_address) && name_address) {
+        if (unicode) {
+            wchar_t wide[MAX_PATH] = {};
+            for (size_t i = 0; i + 1 < MAX_PATH && read_value(source, name_address + i * 2, wide[i]) && wide[i]; i++) {}
+            WideCharToMultiByte(CP_ACP, 0, wide, -1, buffer, sizeof(buffer), nullptr, nullptr);
+        }
+        else {
+            for (size_t i = 0; i + 1 < MAX_PATH && read_value(source, name_address + i, buffer[i]) && buffer[i]; i++) {}
+        }
+        path = buffer;
+    }
+    if (path.empty()) {
+        snprintf(buffer, sizeof(buffer), "image_%llX", static_cast<unsigned long long>(event.address));
+        path = buffer;
+    }
+    module = module_range{event.address, image_size, path.substr(path.find_last_of("\\/") + 1)};
+    return true;
+}
+#endif
+
+void module_map::publish(std::shared_ptr<const std::vector<module_range>> updated) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ranges = std::move(updated);
+}
+
+void module_map::bind(debug_event_source* event_source) {
+    source = event_source;
+}
+
+void module_map::unbind() {
+    source = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pid = 0;
+    }
+    publish(std::make_shared<std::vector<module_range>>());
+}
+
+bool module_map::on_create_process(const debug_event& event) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pid = event.pid;
+    }
+#ifdef _WIN32
+    module_range image;
+    if (source && describe_image(source, event, image)) {
+        add(image);
+    }
+#else
+    refresh();
+#endif
+    return false;
+}
+
+bool module_map::on_load_module(const debug_event& event) {
+#ifdef _WIN32
+    module_range image;
+    if (source && describe_image(source, event, image)) {
+        add(image);
+    }
+#else
+    (void)event;
+#endif
+    return false;
+}
+
+bool module_map::on_unload_module(const debug_event& event) {
+    remove(event.address);
+    return false;
+}
+
+bool module_map::refresh() {
+    uint32_t target = get_pid();
+    if (!target) {
+        return false;
+    }
+    publish(std::make_shared<std::vector<module_range>>(enumerate_modules(target)));
+    return true;
+}
+
+void module_map::add(const module_range& module) {
+    std::shared_ptr<const std::vector<module_range>> current = snapshot();
+    auto updated = std::make_shared<std::vector<module_range>>();
+    updated->reserve(current->size() + 1);
+    for (const module_range& existing : *current) {
+        if (existing.base < module.base + module.size && module.base < existing.base + existing.size) {
+            continue;
+        }
+        updated->push_back(existing);
+    }
+    auto position = std::upper_bound(updated->begin(), updated->end(), module.base, [] (uint64_t value, const module_range& range) {
+        return value < range.base;
+    });
+    updated->insert(position, module);
+    publish(std::move(updated));
+}
+
+bool module_map::remove(uint64_t base) {
+    std::shared_ptr<const std::vector<module_range>> current = snapshot();
+    auto updated = std::make_shared<std::vector<module_range>>(*current);
+    auto module = std::find_if(updated->begin(), updated->end(), [base] (const module_range& range) {
+        return range.base == base;
+    });
+    if (module == updated->end()) {
+        return false;
+    }
+    updated->erase(module);
+    publish(std::move(updated));
+    return true;
+}
+
+uint32_t module_map::get_pid() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pid;
+}
+
+std::shared_ptr<const std::vector<module_range>> module_map::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return ranges;
+}
@@ -0,0 +1,102 @@
+#ifndef MODULES_H
+#define MODULES_H
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "debug_event_source.h"
+
+struct module_range
+{
+    uint64_t base;
+    uint64_t size;
+    std::string name;
+};
+
+// One-shot snapshot of the modules loaded in a process, sorted by base. Windows: the toolhelp
+// module list; Linux: file-backed mappings of /proc/<pid>/maps, one range per file.
+std::vector<module_range> enumerate_modules(uint32_t pid);
+
+// The module containing address, or null.
+const module_range* find_module(const std::vector<module_range>& modules, uint64_t address);
+
+enum class image_format
+{
+    unknown,
+    pe,
+    elf
+};
+
+// One function of an image's unwind table. PE: a RUNTIME_FUNCTION, unwind is its UNWIND_INFO;
+// ELF: an .eh_frame_hdr entry, unwind is its FDE and end is 0 (the FDE holds the length).
+struct unwind_entry
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t unwind;
+};
+
+// The unwind table of a loaded image, read from the target: .pdata for PE, the .eh_frame_hdr
+// search table for ELF. Sorted by start, one entry per start, only starts inside the module.
+image_format read_unwind_table(debug_event_source* source, const module_range& module, std::vector<unwind_entry>& entries);
+
+// Function starts of a loaded image: the starts of its unwind table. Sorted; empty when the
+// image has neither table.
+std::vector<uint64_t> discover_functions(debug_event_source* source, const module_range& module);
+
+// Buffer size that holds any formatted address; longer module names are cut to fit.
+const size_t MAX_ADDRESS_TEXT = 320;
+
+// "name+0xOFF", or "0xADDR" outside every module.
+std::string format_address(const std::vector<module_range>& modules, uint64_t address);
+
+// Resolves addresses against one sorted module list, trying the module of the previous address
+// before searching: addresses listed in order mostly fall in the same module as the one before.
+class module_resolver
+{
+    const std::vector<module_range>& modules;
+    const module_range* last;
+public:
+    explicit module_resolver(const std::vector<module_range>& sorted) : modules(sorted), last(nullptr) {}
+
+    const module_range* find(uint64_t address);
+    // format_address into buffer without allocating; returns the length written.
+    size_t format(uint64_t address, char* buffer, size_t size);
+};
+
+// The target's modules as a sorted interval array, kept up to date from create_process,
+// load_module and unload_module events on the debugger thread. Windows names and sizes each
+// image from its event (the file handle, the PE header); ptrace reports no loads, so on Linux
+// the process event enumerates /proc/<pid>/maps once and refresh() does it again. Readers on
+// any thread take a snapshot, which is never modified, and resolve against it without locking.
+class module_map
+{
+    debug_event_source* source;
+    uint32_t pid;
+    mutable std::mutex mutex;
+    std::shared_ptr<const std::vector<module_range>> ranges;
+
+    void publish(std::shared_ptr<const std::vector<module_range>> updated);
+public:
+    module_map() : source(nullptr), pid(0), ranges(std::make_shared<std::vector<module_range>>()) {}
+
+    void bind(debug_event_source* event_source);
+    // Forgets every module.
+    void unbind();
+
+    bool on_create_process(const debug_event& event);
+    bool on_load_module(const debug_event& event);
+    bool on_unload_module(const debug_event& event);
+
+    // Replaces the map with a fresh enumeration of the bound target.
+    bool refresh();
+    // Inserts module, dropping any range it overlaps (an image unloaded without an event).
+    void add(const module_range& module);
+    bool remove(uint64_t base);
+
+    // The pid the map follows, 0 while unbound.
+    uint32_t get_pid() const;
+    std::shared_ptr<const std::vector<module_range>> snapshot() const;
+};
+#endif // !MODULES_H
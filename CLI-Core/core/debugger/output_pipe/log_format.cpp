@@ -0,0 +1,301 @@
+#include "log_format.h"
+#include <cstdio>
+#include <thread>
+
+namespace debug {
+
+    static const uint32_t PENDING_ID = FormatRegistry::INVALID_ID - 1;
+    static const size_t REGISTRY_SLOTS = LOG_MAX_FORMATS * 2;
+
+    FormatRegistry::FormatRegistry() : next_id_(0) {
+        for (size_t i = 0; i < REGISTRY_SLOTS; i++) {
+            keys_[i].store(nullptr, std::memory_order_relaxed);
+            ids_[i].store(PENDING_ID, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < LOG_MAX_FORMATS; i++) {
+            formats_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    FormatRegistry& FormatRegistry::instance() {
+        static FormatRegistry instance;
+        return instance;
+    }
+
+    uint32_t FormatRegistry::id_for(const char* format) {
+        uint64_t hash = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(format)) * 0x9E3779B97F4A7C15ull;
+        size_t slot = static_cast<size_t>(hash >> 32) & (REGISTRY_SLOTS - 1);
+
+        for (size_t probe = 0; probe < REGISTRY_SLOTS; probe++, slot = (slot + 1) & (REGISTRY_SLOTS - 1)) {
+            const char* key = keys_[slot].load(std::memory_order_acquire);
+            if (key == nullptr) {
+                if (keys_[slot].compare_exchange_strong(key, format, std::memory_order_acq_rel)) {
+                    uint32_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+                    if (id >= LOG_MAX_FORMATS) {
+                        ids_[slot].store(INVALID_ID, std::memory_order_release);
+                        return INVALID_ID;
+                    }
+                    formats_[id].store(format, std::memory_order_release);
+                    ids_[slot].store(id, std::memory_order_release);
+                    return id;
+                }
+                // Lost the slot; key now holds the winner's format.
+            }
+
+            if (key == format) {
+                uint32_t id;
+                while ((id = ids_[slot].load(std::memory_order_acquire)) == PENDING_ID) {
+                    std::this_thread::yield();
+                }
+                return id;
+            }
+        }
+        return INVALID_ID;
+    }
+
+    const char* FormatRegistry::format_for(uint32_t id) {
+        if (id >= LOG_MAX_FORMATS) {
+            return nullptr;
+        }
+        return formats_[id].load(std::memory_order_acquire);
+    }
+
+    namespace {
+        struct DecodedArg
+        {
+            ArgTag tag;
+            uint64_t bits;
+            double real;
+            const char* text;
+            uint16_t text_length;
+        };
+
+        bool next_arg(const uint8_t*& cursor, const uint8_t* end, DecodedArg& arg) {
+            if (cursor >= end) {
+                return false;
+            }
+            arg.tag = static_cast<ArgTag>(*cursor++);
+            arg.bits = 0;
+            arg.real = 0.0;
+            arg.text = nullptr;
+            arg.text_length = 0;
+
+            size_t size = 0;
+            switch (arg.tag) {
+            case ArgTag::I32: {
+                int32_t v;
+                size = sizeof(v);
+                if (cursor + size > end) return false;
+                memcpy(&v, cursor, size);
+                arg.bits = static_cast<uint64_t>(static_cast<int64_t>(v));
+                break;
+            }
+            case ArgTag::U32: {
+                uint32_t v;
+                size = sizeof(v);
+                if (cursor + size > end) return false;
+                memcpy(&v, cursor, size);
+                arg.bits = v;
+                break;
+            }
+            case ArgTag::I64:
+            case ArgTag::U64:
+            case ArgTag::PTR:
+                size = sizeof(uint64_t);
+                if (cursor + size > end) return false;
+                memcpy(&arg.bits, cursor, size);
+                break;
+            case ArgTag::F64:
+                size = sizeof(double);
+                if (cursor + size > end) return false;
+                memcpy(&arg.real, cursor, size);
+                break;
+            case ArgTag::STR:
+                if (cursor + sizeof(uint16_t) > end) return false;
+                memcpy(&arg.text_length, cursor, sizeof(uint16_t));
+                cursor += sizeof(uint16_t);
+                size = arg.text_length;
+                if (cursor + size > end) return false;
+                arg.text = reinterpret_cast<const char*>(cursor);
+                break;
+            default:
+                return false;
+            }
+            cursor += size;
+            return true;
+        }
+
+        bool is_32bit(ArgTag tag) {
+            return tag == ArgTag::I32 || tag == ArgTag::U32;
+        }
+
+        // Integers are re-interpreted at the width they were passed with, which is what
+        // printf would have done with the original va_list (e.g. DWORD 0xFFFFFFFF via %d is -1).
+        long long as_signed(const DecodedArg& arg) {
+            if (arg.tag == ArgTag::F64) return static_cast<long long>(arg.real);
+            if (is_32bit(arg.tag)) return static_cast<int32_t>(static_cast<uint32_t>(arg.bits));
+            return static_cast<long long>(arg.bits);
+        }
+
+        unsigned long long as_unsigned(const DecodedArg& arg) {
+            if (arg.tag == ArgTag::F64) return static_cast<unsigned long long>(arg.real);
+            if (is_32bit(arg.tag)) return static_cast<uint32_t>(arg.bits);
+            return arg.bits;
+        }
+
+        double as_double(const DecodedArg& arg) {
+            if (arg.tag == ArgTag::F64) return arg.real;
+            if (arg.tag == ArgTag::I32 || arg.tag == ArgTag::I64) return static_cast<double>(as_signed(arg));
+            return static_cast<double>(as_unsigned(arg));
+        }
+
+        template<typename T>
+        void append_formatted(std::string& out, const std::string& spec, T value) {
+            char buffer[128];
+            int size = snprintf(buffer, sizeof(buffer), spec.c_str(), value);
+            if (size < 0) {
+                return;
+            }
+            if (static_cast<size_t>(size) < sizeof(buffer)) {
+                out.append(buffer, size);
+                return;
+            }
+            std::string large(size + 1, '\0');
+            snprintf(&large[0], size + 1, spec.c_str(), value);
+            out.append(large.c_str(), size);
+        }
+    }
+
+    std::string format_event(const char* format, const uint8_t* args, size_t length) {
+        std::string out;
+        const uint8_t* cursor = args;
+        const uint8_t* end = args + length;
+
+        for (const char* p = format; *p; p++) {
+            if (*p != '%') {
+                out.push_back(*p);
+                continue;
+            }
+            if (p[1] == '%') {
+                out.push_back('%');
+                p++;
+                continue;
+            }
+
+            // %[flags][width][.precision][length]conversion; width and precision taken
+            // from '*' consume an argument just like printf.
+            std::string spec = "%";
+            p++;
+            while (*p && strchr("-+ #0", *p)) spec.push_back(*p++);
+
+            DecodedArg star;
+            if (*p == '*') {
+                if (!next_arg(cursor, end, star)) return out + "<missing>";
+                spec += std::to_string(as_signed(star));
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') spec.push_back(*p++);
+            if (*p == '.') {
+                spec.push_back(*p++);
+                if (*p == '*') {
+                    if (!next_arg(cursor, end, star)) return out + "<missing>";
+                    spec += std::to_string(as_signed(star));
+                    p++;
+                }
+                while (*p >= '0' && *p <= '9') spec.push_back(*p++);
+            }
+
+            // Length modifiers (including MSVC's I32/I64) are dropped; the argument tag decides the width.
+            while (*p && strchr("hljztLqI", *p)) {
+                if (*p == 'I' && ((p[1] == '3' && p[2] == '2') || (p[1] == '6' && p[2] == '4'))) {
+                    p += 2;
+                }
+                p++;
+            }
+            if (!*p) {
+                break;
+            }
+
+            char conversion = *p;
+            DecodedArg arg;
+            if (conversion != 'n' && !next_arg(cursor, end, arg)) {
+                out += "<missing>";
+                continue;
+            }
+
+            switch (conversion) {
+            case 'd':
+            case 'i':
+                append_formatted(out, spec + "lld", as_signed(arg));
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+            case 'o':
+                append_formatted(out, spec + "ll" + conversion, as_unsigned(arg));
+                break;
+            case 'c':
+                append_formatted(out, spec + 'c', static_cast<int>(as_signed(arg)));
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                append_formatted(out, spec + conversion, as_double(arg));
+                break;
+            case 's':
+                if (arg.tag == ArgTag::STR) {
+                    std::string text(arg.text, arg.text_length);
+                    append_formatted(out, spec + 's', text.c_str());
+                }
+                else {
+                    out += "<bad string>";
+                }
+                break;
+            case 'p':
+                append_formatted(out, spec + 'p', reinterpret_cast<void*>(static_cast<uintptr_t>(arg.bits)));
+                break;
+            case 'n':
+                break;
+            default:
+                out.push_back('%');
+                out.push_back(conversion);
+                break;
+            }
+        }
+        return out;
+    }
+
+    bool LogDecoder::define(const uint8_t* payload, size_t length) {
+        uint32_t id;
+        if (length < sizeof(id)) {
+            return false;
+        }
+        memcpy(&id, payload, sizeof(id));
+        if (id >= LOG_MAX_FORMATS) {
+            return false;
+        }
+        if (formats_.size() <= id) {
+            formats_.resize(id + 1);
+        }
+        formats_[id].assign(reinterpret_cast<const char*>(payload + sizeof(id)), length - sizeof(id));
+        return true;
+    }
+
+    std::string LogDecoder::render(const uint8_t* payload, size_t length) {
+        uint32_t id;
+        if (length < sizeof(id)) {
+            return "<malformed event>";
+        }
+        memcpy(&id, payload, sizeof(id));
+        if (id >= formats_.size() || formats_[id].empty()) {
+            return "<unknown format " + std::to_string(id) + ">";
+        }
+        return format_event(formats_[id].c_str(), payload + sizeof(id), length - sizeof(id));
+    }
+
+}
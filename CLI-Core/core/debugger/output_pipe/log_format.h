@@ -0,0 +1,231 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Binary log protocol shared by the writer (output_pipe.cpp) and the console.
+// Kept free of Win32 headers so the console and benchmarks build on any platform.
+//
+// Each transport frame (log_transport.h) is one batch. In text mode a batch is a run
+// of NUL-terminated lines.
+// After connecting in binary mode the writer sends the NUL-terminated handshake
+// LOG_BINARY_HANDSHAKE; every following frame is a batch of wire records:
+//
+//   WireHeader { uint8 kind; uint8 message_type; uint16 length; } + length bytes
+//
+//   TEXT    payload: message text (no NUL)
+//   FORMAT  payload: uint32 format id + format string; sent once, before the first EVENT using it
+//   EVENT   payload: uint32 format id + encoded arguments (ArgTag + value each)
+namespace debug {
+
+    const char LOG_BINARY_HANDSHAKE[] = "MEMSCAPE_LOG_BINARY_V1";
+
+    enum class WireKind : uint8_t
+    {
+        TEXT = 0,
+        FORMAT = 1,
+        EVENT = 2
+    };
+
+    struct WireHeader
+    {
+        uint8_t kind;
+        uint8_t message_type;
+        uint16_t length;
+    };
+
+    enum class ArgTag : uint8_t
+    {
+        I32 = 1,
+        U32,
+        I64,
+        U64,
+        F64,
+        PTR,
+        STR     // uint16 length + bytes
+    };
+
+    const size_t LOG_MAX_FORMATS = 1024;
+
+    // Assigns ids to format literals by address. Lookups are lock-free; a format is
+    // registered the first time its call site runs and keeps its id for the process lifetime.
+    class FormatRegistry
+    {
+    private:
+        std::atomic<const char*> keys_[LOG_MAX_FORMATS * 2];
+        std::atomic<uint32_t> ids_[LOG_MAX_FORMATS * 2];
+        std::atomic<const char*> formats_[LOG_MAX_FORMATS];
+        std::atomic<uint32_t> next_id_;
+
+        FormatRegistry();
+
+    public:
+        static const uint32_t INVALID_ID = 0xFFFFFFFF;
+
+        static FormatRegistry& instance();
+        uint32_t id_for(const char* format);
+        const char* format_for(uint32_t id);
+    };
+
+    // Encodes printf arguments into an EVENT payload. Strings are copied and
+    // truncated to what still fits; encode() returns false if nothing fits.
+    class ArgEncoder
+    {
+    private:
+        uint8_t* data_;
+        size_t capacity_;
+        size_t length_;
+        bool overflow_;
+
+        void put(ArgTag tag, const void* value, size_t size) {
+            if (length_ + 1 + size > capacity_) {
+                overflow_ = true;
+                return;
+            }
+            data_[length_++] = static_cast<uint8_t>(tag);
+            memcpy(data_ + length_, value, size);
+            length_ += size;
+        }
+
+        void put_string(const char* text, size_t size) {
+            if (length_ + 3 > capacity_) {
+                overflow_ = true;
+                return;
+            }
+            if (size > capacity_ - length_ - 3) {
+                size = capacity_ - length_ - 3;
+            }
+            if (size > 0xFFFF) {
+                size = 0xFFFF;
+            }
+            uint16_t length = static_cast<uint16_t>(size);
+            data_[length_++] = static_cast<uint8_t>(ArgTag::STR);
+            memcpy(data_ + length_, &length, sizeof(length));
+            length_ += sizeof(length);
+            memcpy(data_ + length_, text, size);
+            length_ += size;
+        }
+
+        template<typename T>
+        typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type encode_one(T value) {
+            if (sizeof(T) <= 4) {
+                if (std::is_signed<T>::value) {
+                    int32_t v = static_cast<int32_t>(value);
+                    put(ArgTag::I32, &v, sizeof(v));
+                }
+                else {
+                    uint32_t v = static_cast<uint32_t>(value);
+                    put(ArgTag::U32, &v, sizeof(v));
+                }
+            }
+            else if (std::is_signed<T>::value) {
+                int64_t v = static_cast<int64_t>(value);
+                put(ArgTag::I64, &v, sizeof(v));
+            }
+            else {
+                uint64_t v = static_cast<uint64_t>(value);
+                put(ArgTag::U64, &v, sizeof(v));
+            }
+        }
+
+        template<typename T>
+        typename std::enable_if<std::is_floating_point<T>::value>::type encode_one(T value) {
+            double v = static_cast<double>(value);
+            put(ArgTag::F64, &v, sizeof(v));
+        }
+
+        void encode_one(const char* text) {
+            put_string(text ? text : "(null)", text ? strlen(text) : 6);
+        }
+
+        void encode_one(char* text) {
+            encode_one(static_cast<const char*>(text));
+        }
+
+        void encode_one(const std::string& text) {
+            put_string(text.data(), text.size());
+        }
+
+        template<typename T>
+        void encode_one(T* pointer) {
+            uint64_t v = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(pointer));
+            put(ArgTag::PTR, &v, sizeof(v));
+        }
+
+        void encode_all() {}
+
+        template<typename First, typename... Rest>
+        void encode_all(First&& first, Rest&&... rest) {
+            encode_one(first);
+            encode_all(std::forward<Rest>(rest)...);
+        }
+
+    public:
+        ArgEncoder(uint8_t* data, size_t capacity) : data_(data), capacity_(capacity), length_(0), overflow_(false) {}
+
+        template<typename... Args>
+        bool encode(Args&&... args) {
+            encode_all(std::forward<Args>(args)...);
+            return !overflow_;
+        }
+
+        size_t length() const {
+            return length_;
+        }
+    };
+
+    // Rebuilds text from an EVENT payload using printf conversions on the consumer side.
+    std::string format_event(const char* format, const uint8_t* args, size_t length);
+
+    // Consumer-side state: remembers FORMAT records and renders EVENT records.
+    class LogDecoder
+    {
+    private:
+        std::vector<std::string> formats_;
+
+    public:
+        // Decodes every record in [data, data + size) and calls on_message(message_type, text)
+        // for TEXT and EVENT records. Returns false on a malformed buffer.
+        template<typename OnMessage>
+        bool decode(const uint8_t* data, size_t size, OnMessage&& on_message) {
+            size_t offset = 0;
+            while (offset + sizeof(WireHeader) <= size) {
+                WireHeader header;
+                memcpy(&header, data + offset, sizeof(header));
+                offset += sizeof(header);
+                if (offset + header.length > size) {
+                    return false;
+                }
+
+                const uint8_t* payload = data + offset;
+                offset += header.length;
+
+                switch (static_cast<WireKind>(header.kind)) {
+                case WireKind::TEXT:
+                    on_message(header.message_type, std::string(reinterpret_cast<const char*>(payload), header.length));
+                    break;
+                case WireKind::FORMAT:
+                    if (!define(payload, header.length)) {
+                        return false;
+                    }
+                    break;
+                case WireKind::EVENT:
+                    on_message(header.message_type, render(payload, header.length));
+                    break;
+                default:
+                    return false;
+                }
+            }
+            return offset == size;
+        }
+
+        bool define(const uint8_t* payload, size_t length);
+        std::string render(const uint8_t* payload, size_t length);
+    };
+
+}
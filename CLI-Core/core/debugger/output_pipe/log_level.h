@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Leveled, categorized log sites. DEBUG_LOG checks the level twice before touching
+// its arguments: against a compile-time floor (sites below it are dead code) and
+// against a runtime mask that is zero while no console is attached, so a disabled
+// site costs one relaxed load and evaluates none of its arguments.
+//
+// Compile-time floors are LogLevel numbers (0 = TRACE ... 5 = OFF). Define
+// DEBUG_LOG_MIN_LEVEL for all categories or DEBUG_LOG_MIN_LEVEL_<CATEGORY> for one.
+#ifndef DEBUG_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define DEBUG_LOG_MIN_LEVEL 1
+#else
+#define DEBUG_LOG_MIN_LEVEL 0
+#endif
+#endif // !DEBUG_LOG_MIN_LEVEL
+
+#ifndef DEBUG_LOG_MIN_LEVEL_DEBUGGER
+#define DEBUG_LOG_MIN_LEVEL_DEBUGGER DEBUG_LOG_MIN_LEVEL
+#endif
+#ifndef DEBUG_LOG_MIN_LEVEL_SCANNER
+#define DEBUG_LOG_MIN_LEVEL_SCANNER DEBUG_LOG_MIN_LEVEL
+#endif
+#ifndef DEBUG_LOG_MIN_LEVEL_CORE
+#define DEBUG_LOG_MIN_LEVEL_CORE DEBUG_LOG_MIN_LEVEL
+#endif
+
+namespace debug {
+
+    // ERR rather than ERROR: windows.h defines ERROR and these names are pasted by DEBUG_LOG.
+    enum class LogLevel
+    {
+        TRACE,
+        DEBUG,
+        INFO,
+        WARN,
+        ERR,
+        OFF
+    };
+
+    enum class LogCategory
+    {
+        DEBUGGER,
+        SCANNER,
+        CORE,
+        COUNT
+    };
+
+    constexpr int compiled_min_level(LogCategory category) {
+        return category == LogCategory::DEBUGGER ? DEBUG_LOG_MIN_LEVEL_DEBUGGER :
+               category == LogCategory::SCANNER ? DEBUG_LOG_MIN_LEVEL_SCANNER :
+               DEBUG_LOG_MIN_LEVEL_CORE;
+    }
+
+    template<LogLevel Level, LogCategory Category>
+    struct LogSite
+    {
+        static constexpr bool compiled = static_cast<int>(Level) >= compiled_min_level(Category);
+        static constexpr uint32_t bit = 1u << (static_cast<uint32_t>(Category) * 8 + static_cast<uint32_t>(Level));
+    };
+
+    // Bit (category * 8 + level) is set in active_mask when that level logs for that
+    // category; user_mask holds the configured levels and is copied in on connect.
+    struct LogFilter
+    {
+        static std::atomic<uint32_t> active_mask;
+        static std::atomic<uint32_t> user_mask;
+
+        static void set_level(LogCategory category, LogLevel level);
+        static LogLevel get_level(LogCategory category);
+        static void set_active(bool active);
+    };
+
+    const char* log_level_name(LogLevel level);
+    bool parse_log_level(const std::string& name, LogLevel& level);
+    const char* log_category_name(LogCategory category);
+    bool parse_log_category(const std::string& name, LogCategory& category);
+
+}
+
+#define DEBUG_LOG(level, category, ...) \
+    do { \
+        typedef ::debug::LogSite< ::debug::LogLevel::level, ::debug::LogCategory::category> debug_log_site; \
+        if (debug_log_site::compiled && \
+            (::debug::LogFilter::active_mask.load(std::memory_order_relaxed) & debug_log_site::bit) != 0) { \
+            ::debug::log_write(::debug::LogLevel::level, __VA_ARGS__); \
+        } \
+    } while (0)
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace debug {
+
+    // Bounded multi-producer queue (Vyukov). Every cell carries a sequence number, so
+    // producers and the consumer only contend on their own position counter.
+    // Dequeue is also safe from producers, which is how DROP_OLDEST evicts.
+    template<typename T>
+    class LogRing
+    {
+    private:
+        struct Cell
+        {
+            std::atomic<size_t> sequence;
+            T data;
+        };
+
+        alignas(64) std::atomic<size_t> enqueue_pos_;
+        alignas(64) std::atomic<size_t> dequeue_pos_;
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_;
+
+    public:
+        // capacity must be a power of two
+        explicit LogRing(size_t capacity) : enqueue_pos_(0), dequeue_pos_(0), cells_(new Cell[capacity]), mask_(capacity - 1) {
+            for (size_t i = 0; i < capacity; i++) {
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        LogRing(const LogRing&) = delete;
+        LogRing& operator=(const LogRing&) = delete;
+
+        size_t capacity() const {
+            return mask_ + 1;
+        }
+
+        // Claims a slot and lets fill() write the payload in place.
+        template<typename Fill>
+        bool try_push(Fill&& fill) {
+            size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell& cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+                if (diff == 0) {
+                    if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        fill(cell.data);
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;
+                }
+                else {
+                    pos = enqueue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Hands the oldest record to consume() while the slot is still owned, then releases it.
+        template<typename Consume>
+        bool try_pop(Consume&& consume) {
+            size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+            for (;;) {
+                Cell& cell = cells_[pos & mask_];
+                size_t sequence = cell.sequence.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+                if (diff == 0) {
+                    if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        consume(cell.data);
+                        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0) {
+                    return false;
+                }
+                else {
+                    pos = dequeue_pos_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        // Records queued now; approximate while producers or the consumer are active.
+        size_t size() const {
+            size_t dequeued = dequeue_pos_.load(std::memory_order_acquire);
+            size_t enqueued = enqueue_pos_.load(std::memory_order_acquire);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        bool empty() const {
+            return dequeue_pos_.load(std::memory_order_acquire) >= enqueue_pos_.load(std::memory_order_acquire);
+        }
+    };
+
+}
@@ -0,0 +1,972 @@
+#include "log_transport.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <climits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace debug {
+
+    namespace {
+        uint64_t now_ns() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // Milliseconds left until deadline_ns, never negative.
+        uint32_t remaining_ms(uint64_t deadline_ns) {
+            uint64_t now = now_ns();
+            return now >= deadline_ns ? 0 : static_cast<uint32_t>((deadline_ns - now + 999999) / 1000000);
+        }
+
+        uint64_t deadline_after(uint32_t timeout_ms) {
+            return now_ns() + static_cast<uint64_t>(timeout_ms) * 1000000;
+        }
+
+        bool apply_control(const ControlMessage& message, uint32_t& credits, bool& hello) {
+            if (message.magic != LOG_CONTROL_MAGIC) {
+                return false;
+            }
+            if (message.kind == static_cast<uint32_t>(ControlKind::HELLO)) {
+                credits = message.frames;
+                hello = true;
+                return true;
+            }
+            if (message.kind == static_cast<uint32_t>(ControlKind::CREDIT)) {
+                credits += message.frames;
+                return true;
+            }
+            return false;
+        }
+
+        // Console side: credit for a frame goes back once the next read shows the
+        // previous frame was handled, batched to half a window per control message.
+        class CreditReturn
+        {
+        private:
+            uint32_t window_ = 0;
+            uint32_t consumed_ = 0;
+            bool pending_ = false;
+
+        public:
+            void reset(uint32_t window) {
+                window_ = window;
+                consumed_ = 0;
+                pending_ = false;
+            }
+
+            template<typename Send>
+            void before_read(Send&& send) {
+                if (pending_) {
+                    consumed_++;
+                    pending_ = false;
+                }
+                uint32_t batch = window_ / 2 ? window_ / 2 : 1;
+                if (consumed_ < batch) {
+                    return;
+                }
+                ControlMessage message = { LOG_CONTROL_MAGIC, static_cast<uint32_t>(ControlKind::CREDIT), consumed_ };
+                consumed_ = 0;
+                // Fails once the CLI has closed its end; frames it sent before that are still readable.
+                send(message);
+            }
+
+            void after_read() {
+                pending_ = true;
+            }
+        };
+    }
+
+    TransportStats LogTransport::stats() const {
+        TransportStats result;
+        result.frames = frames_.load();
+        result.bytes = bytes_.load();
+        result.credit_waits = credit_waits_.load();
+        result.credit_wait_ns = credit_wait_ns_.load();
+        return result;
+    }
+
+    const char* transport_kind_name(TransportKind kind) {
+        switch (kind) {
+        case TransportKind::NAMED_PIPE: return "pipe";
+        case TransportKind::UNIX_SOCKET: return "uds";
+        case TransportKind::SHARED_MEMORY: return "shm";
+        default: return "unknown";
+        }
+    }
+
+    bool parse_transport_kind(const std::string& name, TransportKind& kind) {
+        if (name == "pipe") {
+            kind = TransportKind::NAMED_PIPE;
+        }
+        else if (name == "uds") {
+            kind = TransportKind::UNIX_SOCKET;
+        }
+        else if (name == "shm") {
+            kind = TransportKind::SHARED_MEMORY;
+        }
+        else {
+            return false;
+        }
+        return true;
+    }
+
+    bool transport_supported(TransportKind kind) {
+#ifdef _WIN32
+        return kind == TransportKind::NAMED_PIPE || kind == TransportKind::SHARED_MEMORY;
+#else
+        return kind == TransportKind::UNIX_SOCKET || kind == TransportKind::SHARED_MEMORY;
+#endif
+    }
+
+    TransportKind default_transport_kind() {
+#ifdef _WIN32
+        return TransportKind::NAMED_PIPE;
+#else
+        return TransportKind::UNIX_SOCKET;
+#endif
+    }
+
+    std::string default_endpoint(TransportKind kind) {
+#ifdef _WIN32
+        std::string pid = std::to_string(GetCurrentProcessId());
+        if (kind == TransportKind::SHARED_MEMORY) {
+            return "Local\\debugger_log_" + pid;
+        }
+        return "\\\\.\\pipe\\debugger_pipe_" + pid;
+#else
+        std::string pid = std::to_string(getpid());
+        if (kind == TransportKind::SHARED_MEMORY) {
+            return "/debugger_log_" + pid;
+        }
+        return "/tmp/debugger_pipe_" + pid + ".sock";
+#endif
+    }
+
+    // ---- shared-memory ring (both platforms) ----
+
+    namespace {
+        const uint32_t SHM_MAGIC = 0x52474F4C;  // "LOGR"
+
+        enum class ShmChannel
+        {
+            DATA,
+            SPACE,
+            STATE,
+            COUNT
+        };
+
+        // head/tail count bytes ever written/consumed; a frame is uint32 length + bytes and
+        // may wrap around the end of the data area. Each channel has a sequence word that
+        // is bumped on every notify and doubles as the futex word on Linux.
+        struct ShmRingHeader
+        {
+            uint32_t magic;
+            uint32_t capacity;
+            alignas(64) std::atomic<uint64_t> head;
+            alignas(64) std::atomic<uint64_t> tail;
+            alignas(64) std::atomic<uint32_t> sequence[static_cast<int>(ShmChannel::COUNT)];
+            std::atomic<uint32_t> consumer_state;   // 0 not attached, 1 ready, 2 gone
+            std::atomic<uint32_t> producer_closed;
+        };
+
+        const size_t SHM_DATA_OFFSET = (sizeof(ShmRingHeader) + 63) & ~static_cast<size_t>(63);
+
+        class ShmMapping
+        {
+        private:
+#ifdef _WIN32
+            HANDLE mapping_ = NULL;
+            HANDLE events_[static_cast<int>(ShmChannel::COUNT)] = {};
+#endif
+            std::string name_;
+            bool owner_ = false;
+            void* view_ = nullptr;
+            size_t size_ = 0;
+
+        public:
+            ~ShmMapping() {
+                close();
+            }
+
+            ShmRingHeader* header() {
+                return static_cast<ShmRingHeader*>(view_);
+            }
+
+            uint8_t* data() {
+                return static_cast<uint8_t*>(view_) + SHM_DATA_OFFSET;
+            }
+
+            bool open(const std::string& name, size_t size, bool create) {
+                name_ = name;
+                owner_ = create;
+                size_ = size;
+#ifdef _WIN32
+                if (create) {
+                    mapping_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                                  static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), name.c_str());
+                }
+                else {
+                    mapping_ = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+                }
+                if (mapping_ == NULL) {
+                    return false;
+                }
+                view_ = MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size);
+                if (view_ == NULL) {
+                    return false;
+                }
+                const char* suffixes[] = { "_data", "_space", "_state" };
+                for (int i = 0; i < static_cast<int>(ShmChannel::COUNT); i++) {
+                    events_[i] = CreateEventA(NULL, FALSE, FALSE, (name + suffixes[i]).c_str());
+                    if (events_[i] == NULL) {
+                        return false;
+                    }
+                }
+#else
+                int fd = shm_open(name.c_str(), create ? (O_CREAT | O_RDWR | O_TRUNC) : O_RDWR, 0600);
+                if (fd < 0) {
+                    return false;
+                }
+                if (create && ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    ::close(fd);
+                    return false;
+                }
+                void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd);
+                if (view == MAP_FAILED) {
+                    return false;
+                }
+                view_ = view;
+#endif
+                return true;
+            }
+
+            void close() {
+#ifdef _WIN32
+                for (auto& event : events_) {
+                    if (event != NULL) {
+                        CloseHandle(event);
+                        event = NULL;
+                    }
+                }
+                if (view_ != nullptr) {
+                    UnmapViewOfFile(view_);
+                }
+                if (mapping_ != NULL) {
+                    CloseHandle(mapping_);
+                    mapping_ = NULL;
+                }
+#else
+                if (view_ != nullptr) {
+                    munmap(view_, size_);
+                }
+                if (owner_ && !name_.empty()) {
+                    shm_unlink(name_.c_str());
+                }
+#endif
+                view_ = nullptr;
+                name_.clear();
+            }
+
+            void notify(ShmChannel channel) {
+                std::atomic<uint32_t>& word = header()->sequence[static_cast<int>(channel)];
+                word.fetch_add(1, std::memory_order_release);
+#ifdef _WIN32
+                SetEvent(events_[static_cast<int>(channel)]);
+#else
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+            }
+
+            // Sleeps until the channel's sequence moves past seen or timeout_ms passes.
+            void wait(ShmChannel channel, uint32_t seen, uint32_t timeout_ms) {
+                std::atomic<uint32_t>& word = header()->sequence[static_cast<int>(channel)];
+                if (word.load(std::memory_order_acquire) != seen) {
+                    return;
+                }
+#ifdef _WIN32
+                WaitForSingleObject(events_[static_cast<int>(channel)], timeout_ms);
+#else
+                timespec timeout;
+                timeout.tv_sec = timeout_ms / 1000;
+                timeout.tv_nsec = static_cast<long>(timeout_ms % 1000) * 1000000;
+                syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &timeout, nullptr, 0);
+#endif
+            }
+
+            uint32_t sequence(ShmChannel channel) {
+                return header()->sequence[static_cast<int>(channel)].load(std::memory_order_acquire);
+            }
+        };
+
+        void ring_copy_in(uint8_t* ring, uint32_t capacity, uint64_t position, const void* source, size_t length) {
+            size_t offset = static_cast<size_t>(position & (capacity - 1));
+            size_t first = length < capacity - offset ? length : capacity - offset;
+            memcpy(ring + offset, source, first);
+            memcpy(ring, static_cast<const uint8_t*>(source) + first, length - first);
+        }
+
+        void ring_copy_out(const uint8_t* ring, uint32_t capacity, uint64_t position, void* destination, size_t length) {
+            size_t offset = static_cast<size_t>(position & (capacity - 1));
+            size_t first = length < capacity - offset ? length : capacity - offset;
+            memcpy(destination, ring + offset, first);
+            memcpy(static_cast<uint8_t*>(destination) + first, ring, length - first);
+        }
+
+        class SharedMemoryTransport : public LogTransport
+        {
+        private:
+            ShmMapping mapping_;
+            bool open_ = false;
+
+        public:
+            ~SharedMemoryTransport() {
+                close();
+            }
+
+            bool listen(const std::string& endpoint) override {
+                if (!mapping_.open(endpoint, SHM_DATA_OFFSET + LOG_SHM_RING_SIZE, true)) {
+                    return false;
+                }
+                ShmRingHeader* header = new (mapping_.header()) ShmRingHeader();
+                header->capacity = static_cast<uint32_t>(LOG_SHM_RING_SIZE);
+                header->head.store(0);
+                header->tail.store(0);
+                for (auto& sequence : header->sequence) {
+                    sequence.store(0);
+                }
+                header->consumer_state.store(0);
+                header->producer_closed.store(0);
+                std::atomic_thread_fence(std::memory_order_release);
+                header->magic = SHM_MAGIC;
+                open_ = true;
+                return true;
+            }
+
+            bool accept(uint32_t timeout_ms) override {
+                ShmRingHeader* header = mapping_.header();
+                uint64_t deadline = deadline_after(timeout_ms);
+                for (;;) {
+                    uint32_t seen = mapping_.sequence(ShmChannel::STATE);
+                    uint32_t state = header->consumer_state.load(std::memory_order_acquire);
+                    if (state == 1) {
+                        return true;
+                    }
+                    if (state == 2 || remaining_ms(deadline) == 0) {
+                        return false;
+                    }
+                    mapping_.wait(ShmChannel::STATE, seen, remaining_ms(deadline));
+                }
+            }
+
+            bool write(const char* data, size_t length) override {
+                ShmRingHeader* header = mapping_.header();
+                uint32_t capacity = header->capacity;
+                uint64_t need = sizeof(uint32_t) + length;
+                if (need > capacity) {
+                    return false;
+                }
+
+                uint64_t head = header->head.load(std::memory_order_relaxed);
+                if (capacity - (head - header->tail.load(std::memory_order_acquire)) < need) {
+                    uint64_t start = now_ns();
+                    uint64_t deadline = deadline_after(LOG_CREDIT_TIMEOUT_MS);
+                    credit_waits_.fetch_add(1, std::memory_order_relaxed);
+                    for (;;) {
+                        uint32_t seen = mapping_.sequence(ShmChannel::SPACE);
+                        if (capacity - (head - header->tail.load(std::memory_order_acquire)) >= need) {
+                            break;
+                        }
+                        if (header->consumer_state.load(std::memory_order_acquire) == 2 || remaining_ms(deadline) == 0) {
+                            credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                            return false;
+                        }
+                        mapping_.wait(ShmChannel::SPACE, seen, remaining_ms(deadline));
+                    }
+                    credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                }
+
+                uint32_t frame_length = static_cast<uint32_t>(length);
+                ring_copy_in(mapping_.data(), capacity, head, &frame_length, sizeof(frame_length));
+                ring_copy_in(mapping_.data(), capacity, head + sizeof(frame_length), data, length);
+                header->head.store(head + need, std::memory_order_release);
+                mapping_.notify(ShmChannel::DATA);
+
+                frames_.fetch_add(1, std::memory_order_relaxed);
+                bytes_.fetch_add(length, std::memory_order_relaxed);
+                return true;
+            }
+
+            void close() override {
+                if (!open_) {
+                    return;
+                }
+                mapping_.header()->producer_closed.store(1, std::memory_order_release);
+                mapping_.notify(ShmChannel::DATA);
+                mapping_.close();
+                open_ = false;
+            }
+
+            TransportKind kind() const override {
+                return TransportKind::SHARED_MEMORY;
+            }
+        };
+
+        class SharedMemorySource : public LogSource
+        {
+        private:
+            ShmMapping mapping_;
+            bool open_ = false;
+
+        public:
+            ~SharedMemorySource() {
+                close();
+            }
+
+            bool connect(const std::string& endpoint, uint32_t) override {
+                if (!mapping_.open(endpoint, SHM_DATA_OFFSET + LOG_SHM_RING_SIZE, false)) {
+                    return false;
+                }
+                if (mapping_.header()->magic != SHM_MAGIC) {
+                    mapping_.close();
+                    return false;
+                }
+                open_ = true;
+                mapping_.header()->consumer_state.store(1, std::memory_order_release);
+                mapping_.notify(ShmChannel::STATE);
+                return true;
+            }
+
+            bool read(std::vector<char>& frame) override {
+                ShmRingHeader* header = mapping_.header();
+                uint32_t capacity = header->capacity;
+                for (;;) {
+                    uint32_t seen = mapping_.sequence(ShmChannel::DATA);
+                    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+                    uint64_t head = header->head.load(std::memory_order_acquire);
+                    if (head - tail >= sizeof(uint32_t)) {
+                        uint32_t length;
+                        ring_copy_out(mapping_.data(), capacity, tail, &length, sizeof(length));
+                        frame.resize(length);
+                        ring_copy_out(mapping_.data(), capacity, tail + sizeof(length), frame.data(), length);
+                        header->tail.store(tail + sizeof(length) + length, std::memory_order_release);
+                        mapping_.notify(ShmChannel::SPACE);
+                        return true;
+                    }
+                    if (header->producer_closed.load(std::memory_order_acquire)) {
+                        return false;
+                    }
+                    // The slice only matters if the CLI dies without closing the ring.
+                    mapping_.wait(ShmChannel::DATA, seen, 100);
+                }
+            }
+
+            void close() override {
+                if (!open_) {
+                    return;
+                }
+                mapping_.header()->consumer_state.store(2, std::memory_order_release);
+                mapping_.notify(ShmChannel::STATE);
+                mapping_.notify(ShmChannel::SPACE);
+                mapping_.close();
+                open_ = false;
+            }
+        };
+    }
+
+#ifdef _WIN32
+    // ---- named pipe (Windows) ----
+
+    namespace {
+        class NamedPipeTransport : public LogTransport
+        {
+        private:
+            HANDLE pipe_ = INVALID_HANDLE_VALUE;
+            HANDLE event_ = NULL;
+            uint32_t credits_ = 0;
+
+            // Finishes an overlapped call; cancels it if it does not complete in time.
+            bool wait_io(BOOL started, OVERLAPPED& overlapped, uint32_t timeout_ms, DWORD& transferred) {
+                if (!started && GetLastError() != ERROR_IO_PENDING) {
+                    return false;
+                }
+                if (WaitForSingleObject(event_, timeout_ms) != WAIT_OBJECT_0) {
+                    CancelIoEx(pipe_, &overlapped);
+                    GetOverlappedResult(pipe_, &overlapped, &transferred, TRUE);
+                    return false;
+                }
+                return GetOverlappedResult(pipe_, &overlapped, &transferred, FALSE) != FALSE;
+            }
+
+            bool receive_control(uint32_t timeout_ms, bool& hello) {
+                ControlMessage message;
+                OVERLAPPED overlapped = {};
+                overlapped.hEvent = event_;
+                DWORD transferred = 0;
+                BOOL started = ReadFile(pipe_, &message, sizeof(message), NULL, &overlapped);
+                if (!wait_io(started, overlapped, timeout_ms, transferred) || transferred != sizeof(message)) {
+                    return false;
+                }
+                return apply_control(message, credits_, hello);
+            }
+
+        public:
+            ~NamedPipeTransport() {
+                close();
+            }
+
+            bool listen(const std::string& endpoint) override {
+                event_ = CreateEventA(NULL, TRUE, FALSE, NULL);
+                pipe_ = CreateNamedPipeA(
+                    endpoint.c_str(),
+                    PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                    PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                    1,
+                    static_cast<DWORD>(LOG_MAX_FRAME_SIZE),
+                    sizeof(ControlMessage) * LOG_CREDIT_WINDOW,
+                    0,
+                    NULL
+                );
+                return event_ != NULL && pipe_ != INVALID_HANDLE_VALUE;
+            }
+
+            bool accept(uint32_t timeout_ms) override {
+                uint64_t deadline = deadline_after(timeout_ms);
+                OVERLAPPED overlapped = {};
+                overlapped.hEvent = event_;
+                DWORD transferred = 0;
+                BOOL connected = ConnectNamedPipe(pipe_, &overlapped);
+                if (!connected && GetLastError() != ERROR_PIPE_CONNECTED &&
+                    !wait_io(connected, overlapped, remaining_ms(deadline), transferred)) {
+                    return false;
+                }
+
+                bool hello = false;
+                while (!hello) {
+                    if (!receive_control(remaining_ms(deadline), hello)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            bool write(const char* data, size_t length) override {
+                bool hello = false;
+                // Grants are only read when needed; ones already queued do not count as a wait.
+                while (credits_ == 0 && receive_control(0, hello)) {}
+                if (credits_ == 0) {
+                    uint64_t start = now_ns();
+                    uint64_t deadline = deadline_after(LOG_CREDIT_TIMEOUT_MS);
+                    credit_waits_.fetch_add(1, std::memory_order_relaxed);
+                    while (credits_ == 0) {
+                        if (!receive_control(remaining_ms(deadline), hello)) {
+                            credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                            return false;
+                        }
+                    }
+                    credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                }
+
+                OVERLAPPED overlapped = {};
+                overlapped.hEvent = event_;
+                DWORD transferred = 0;
+                BOOL started = WriteFile(pipe_, data, static_cast<DWORD>(length), NULL, &overlapped);
+                if (!wait_io(started, overlapped, LOG_CREDIT_TIMEOUT_MS, transferred)) {
+                    return false;
+                }
+                credits_--;
+                frames_.fetch_add(1, std::memory_order_relaxed);
+                bytes_.fetch_add(length, std::memory_order_relaxed);
+                return true;
+            }
+
+            void close() override {
+                if (pipe_ != INVALID_HANDLE_VALUE) {
+                    FlushFileBuffers(pipe_);
+                    DisconnectNamedPipe(pipe_);
+                    CloseHandle(pipe_);
+                    pipe_ = INVALID_HANDLE_VALUE;
+                }
+                if (event_ != NULL) {
+                    CloseHandle(event_);
+                    event_ = NULL;
+                }
+            }
+
+            TransportKind kind() const override {
+                return TransportKind::NAMED_PIPE;
+            }
+        };
+
+        class NamedPipeSource : public LogSource
+        {
+        private:
+            HANDLE pipe_ = INVALID_HANDLE_VALUE;
+            CreditReturn credit_;
+
+            bool send(const ControlMessage& message) {
+                DWORD written;
+                return WriteFile(pipe_, &message, sizeof(message), &written, NULL) != FALSE;
+            }
+
+        public:
+            ~NamedPipeSource() {
+                close();
+            }
+
+            bool connect(const std::string& endpoint, uint32_t window) override {
+                pipe_ = CreateFileA(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+                if (pipe_ == INVALID_HANDLE_VALUE) {
+                    return false;
+                }
+                DWORD mode = PIPE_READMODE_MESSAGE;
+                if (!SetNamedPipeHandleState(pipe_, &mode, NULL, NULL)) {
+                    return false;
+                }
+                credit_.reset(window);
+                ControlMessage hello = { LOG_CONTROL_MAGIC, static_cast<uint32_t>(ControlKind::HELLO), window };
+                return send(hello);
+            }
+
+            bool read(std::vector<char>& frame) override {
+                credit_.before_read([this] (const ControlMessage& message) { return send(message); });
+                frame.resize(LOG_MAX_FRAME_SIZE);
+                size_t total = 0;
+                for (;;) {
+                    DWORD bytes_read = 0;
+                    BOOL result = ReadFile(pipe_, frame.data() + total, static_cast<DWORD>(frame.size() - total), &bytes_read, NULL);
+                    total += bytes_read;
+                    if (result) {
+                        break;
+                    }
+                    if (GetLastError() != ERROR_MORE_DATA) {
+                        return false;
+                    }
+                    frame.resize(frame.size() * 2);
+                }
+                frame.resize(total);
+                credit_.after_read();
+                return true;
+            }
+
+            void close() override {
+                if (pipe_ != INVALID_HANDLE_VALUE) {
+                    CloseHandle(pipe_);
+                    pipe_ = INVALID_HANDLE_VALUE;
+                }
+            }
+        };
+    }
+#else
+    // ---- Unix-domain socket (POSIX) ----
+
+    namespace {
+        // SOCK_SEQPACKET keeps frame boundaries, like a message-mode pipe.
+        bool make_address(const std::string& endpoint, sockaddr_un& address) {
+            memset(&address, 0, sizeof(address));
+            address.sun_family = AF_UNIX;
+            if (endpoint.size() >= sizeof(address.sun_path)) {
+                return false;
+            }
+            memcpy(address.sun_path, endpoint.c_str(), endpoint.size() + 1);
+            return true;
+        }
+
+        bool poll_fd(int fd, uint32_t timeout_ms) {
+            pollfd entry = { fd, POLLIN, 0 };
+            int result;
+            do {
+                result = poll(&entry, 1, static_cast<int>(timeout_ms));
+            } while (result < 0 && errno == EINTR);
+            return result > 0;
+        }
+
+        class UnixSocketTransport : public LogTransport
+        {
+        private:
+            int listen_fd_ = -1;
+            int fd_ = -1;
+            std::string path_;
+            uint32_t credits_ = 0;
+
+            bool receive_control(uint32_t timeout_ms, bool& hello) {
+                if (!poll_fd(fd_, timeout_ms)) {
+                    return false;
+                }
+                ControlMessage message;
+                ssize_t received = recv(fd_, &message, sizeof(message), 0);
+                if (received != sizeof(message)) {
+                    return false;
+                }
+                return apply_control(message, credits_, hello);
+            }
+
+        public:
+            ~UnixSocketTransport() {
+                close();
+            }
+
+            bool listen(const std::string& endpoint) override {
+                sockaddr_un address;
+                if (!make_address(endpoint, address)) {
+                    return false;
+                }
+                listen_fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                if (listen_fd_ < 0) {
+                    return false;
+                }
+                unlink(endpoint.c_str());
+                if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listen_fd_, 1) != 0) {
+                    return false;
+                }
+                path_ = endpoint;
+                return true;
+            }
+
+            bool accept(uint32_t timeout_ms) override {
+                uint64_t deadline = deadline_after(timeout_ms);
+                if (!poll_fd(listen_fd_, timeout_ms)) {
+                    return false;
+                }
+                fd_ = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (fd_ < 0) {
+                    return false;
+                }
+                int buffer_size = static_cast<int>(LOG_MAX_FRAME_SIZE * 4);
+                setsockopt(fd_, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof(buffer_size));
+
+                // Only one console per session; the path can go as soon as it is attached.
+                ::close(listen_fd_);
+                listen_fd_ = -1;
+                unlink(path_.c_str());
+                path_.clear();
+
+                bool hello = false;
+                while (!hello) {
+                    if (!receive_control(remaining_ms(deadline), hello)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            bool write(const char* data, size_t length) override {
+                bool hello = false;
+                // Grants are only read when needed; ones already queued do not count as a wait.
+                while (credits_ == 0 && receive_control(0, hello)) {}
+                if (credits_ == 0) {
+                    uint64_t start = now_ns();
+                    uint64_t deadline = deadline_after(LOG_CREDIT_TIMEOUT_MS);
+                    credit_waits_.fetch_add(1, std::memory_order_relaxed);
+                    while (credits_ == 0) {
+                        if (!receive_control(remaining_ms(deadline), hello)) {
+                            credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                            return false;
+                        }
+                    }
+                    credit_wait_ns_.fetch_add(now_ns() - start, std::memory_order_relaxed);
+                }
+
+                ssize_t sent;
+                do {
+                    sent = send(fd_, data, length, MSG_NOSIGNAL);
+                } while (sent < 0 && errno == EINTR);
+                if (sent != static_cast<ssize_t>(length)) {
+                    return false;
+                }
+                credits_--;
+                frames_.fetch_add(1, std::memory_order_relaxed);
+                bytes_.fetch_add(length, std::memory_order_relaxed);
+                return true;
+            }
+
+            void close() override {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+                if (listen_fd_ >= 0) {
+                    ::close(listen_fd_);
+                    listen_fd_ = -1;
+                }
+                if (!path_.empty()) {
+                    unlink(path_.c_str());
+                    path_.clear();
+                }
+            }
+
+            TransportKind kind() const override {
+                return TransportKind::UNIX_SOCKET;
+            }
+        };
+
+        class UnixSocketSource : public LogSource
+        {
+        private:
+            int fd_ = -1;
+            CreditReturn credit_;
+
+            bool send_control(const ControlMessage& message) {
+                return send(fd_, &message, sizeof(message), MSG_NOSIGNAL) == sizeof(message);
+            }
+
+        public:
+            ~UnixSocketSource() {
+                close();
+            }
+
+            bool connect(const std::string& endpoint, uint32_t window) override {
+                sockaddr_un address;
+                if (!make_address(endpoint, address)) {
+                    return false;
+                }
+                fd_ = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+                if (fd_ < 0 || ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                    return false;
+                }
+                int buffer_size = static_cast<int>(LOG_MAX_FRAME_SIZE * 4);
+                setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+                credit_.reset(window);
+                ControlMessage hello = { LOG_CONTROL_MAGIC, static_cast<uint32_t>(ControlKind::HELLO), window };
+                return send_control(hello);
+            }
+
+            bool read(std::vector<char>& frame) override {
+                credit_.before_read([this] (const ControlMessage& message) { return send_control(message); });
+                frame.resize(LOG_MAX_FRAME_SIZE);
+                ssize_t received;
+                do {
+                    received = recv(fd_, frame.data(), frame.size(), 0);
+                } while (received < 0 && errno == EINTR);
+                if (received <= 0) {
+                    return false;
+                }
+                frame.resize(static_cast<size_t>(received));
+                credit_.after_read();
+                return true;
+            }
+
+            void close() override {
+                if (fd_ >= 0) {
+                    ::close(fd_);
+                    fd_ = -1;
+                }
+            }
+        };
+    }
+#endif
+
+    std::unique_ptr<LogTransport> create_transport(TransportKind kind) {
+        switch (kind) {
+#ifdef _WIN32
+        case TransportKind::NAMED_PIPE: return std::unique_ptr<LogTransport>(new NamedPipeTransport());
+#else
+        case TransportKind::UNIX_SOCKET: return std::unique_ptr<LogTransport>(new UnixSocketTransport());
+#endif
+        case TransportKind::SHARED_MEMORY: return std::unique_ptr<LogTransport>(new SharedMemoryTransport());
+        default: return nullptr;
+        }
+    }
+
+    std::unique_ptr<LogSource> create_source(TransportKind kind) {
+        switch (kind) {
+#ifdef _WIN32
+        case TransportKind::NAMED_PIPE: return std::unique_ptr<LogSource>(new NamedPipeSource());
+#else
+        case TransportKind::UNIX_SOCKET: return std::unique_ptr<LogSource>(new UnixSocketSource());
+#endif
+        case TransportKind::SHARED_MEMORY: return std::unique_ptr<LogSource>(new SharedMemorySource());
+        default: return nullptr;
+        }
+    }
+
+    std::string executable_directory() {
+#ifdef _WIN32
+        char buffer[MAX_PATH];
+        GetModuleFileNameA(NULL, buffer, MAX_PATH);
+        std::string path(buffer);
+#else
+        char buffer[PATH_MAX];
+        ssize_t length = readlink("/proc/self/exe", buffer, sizeof(buffer) - 1);
+        std::string path(buffer, length > 0 ? static_cast<size_t>(length) : 0);
+#endif
+        size_t pos = path.find_last_of("\\/");
+        return path.substr(0, pos + 1);
+    }
+
+    bool spawn_console(const std::string& path, const std::vector<std::string>& args) {
+#ifdef _WIN32
+        DWORD file_attr = GetFileAttributesA(path.c_str());
+        if (file_attr == INVALID_FILE_ATTRIBUTES) {
+            std::cerr << "Error: Debugger console file not found: " << path << std::endl;
+            return false;
+        }
+
+        std::string command_line = "\"" + path + "\"";
+        for (auto& arg : args) {
+            command_line += " \"" + arg + "\"";
+        }
+
+        STARTUPINFOA si = {0};
+        PROCESS_INFORMATION pi = {0};
+        si.cb = sizeof(STARTUPINFOA);
+
+        if (!CreateProcessA(NULL, &command_line[0], NULL, NULL, FALSE, CREATE_NEW_CONSOLE, NULL, NULL, &si, &pi)) {
+            std::cerr << "Error launching debugger console: " << GetLastError() << std::endl;
+            return false;
+        }
+
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+        return true;
+#else
+        if (access(path.c_str(), X_OK) != 0) {
+            std::cerr << "Error: Debugger console file not found: " << path << std::endl;
+            return false;
+        }
+
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(path.c_str()));
+        for (auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+
+        pid_t pid;
+        int result = posix_spawn(&pid, path.c_str(), nullptr, nullptr, argv.data(), environ);
+        if (result != 0) {
+            std::cerr << "Error launching debugger console: " << result << std::endl;
+            return false;
+        }
+
+        // Reap the console when it exits so it does not linger as a zombie.
+        std::thread([pid] () {
+            int status;
+            waitpid(pid, &status, 0);
+        }).detach();
+        return true;
+#endif
+    }
+
+}
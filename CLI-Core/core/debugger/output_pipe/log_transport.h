@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Moves log frames (one writer batch each) from the CLI to the console.
+//
+// The CLI owns the endpoint: it creates it, starts the console with the endpoint
+// on the command line and waits for the console's HELLO. Readiness is that message
+// arriving, not a timer. HELLO carries the credit window: the number of frames the
+// CLI may have in flight. The console returns credit as it consumes frames and the
+// CLI blocks (up to LOG_CREDIT_TIMEOUT_MS) once the window is used up, so a slow
+// console bounds memory and latency instead of growing the pipe buffer.
+//
+// The shared-memory ring has no control channel; its free space is the credit.
+namespace debug {
+
+    enum class TransportKind
+    {
+        NAMED_PIPE,
+        UNIX_SOCKET,
+        SHARED_MEMORY
+    };
+
+    const char* transport_kind_name(TransportKind kind);
+    bool parse_transport_kind(const std::string& name, TransportKind& kind);
+    bool transport_supported(TransportKind kind);
+    TransportKind default_transport_kind();
+    std::string default_endpoint(TransportKind kind);
+
+    const uint32_t LOG_CONTROL_MAGIC = 0x474F4C4D;     // "MLOG"
+    const uint32_t LOG_CREDIT_WINDOW = 16;
+    const uint32_t LOG_READY_TIMEOUT_MS = 5000;
+    const uint32_t LOG_CREDIT_TIMEOUT_MS = 5000;
+    const size_t LOG_MAX_FRAME_SIZE = 256 * 1024;
+    const size_t LOG_SHM_RING_SIZE = 4 * 1024 * 1024;
+
+    enum class ControlKind : uint32_t
+    {
+        HELLO = 1,
+        CREDIT = 2
+    };
+
+    // Console -> CLI. HELLO: frames = initial window. CREDIT: frames = frames consumed.
+    struct ControlMessage
+    {
+        uint32_t magic;
+        uint32_t kind;
+        uint32_t frames;
+    };
+
+    struct TransportStats
+    {
+        uint64_t frames;
+        uint64_t bytes;
+        uint64_t credit_waits;
+        uint64_t credit_wait_ns;
+    };
+
+    // CLI side.
+    class LogTransport
+    {
+    public:
+        virtual ~LogTransport() {}
+
+        // Creates the endpoint; the console can be started once this returns.
+        virtual bool listen(const std::string& endpoint) = 0;
+        // Blocks until the console has attached and said HELLO, or timeout_ms passes.
+        virtual bool accept(uint32_t timeout_ms) = 0;
+        // Sends one frame, waiting for credit first if the window is used up.
+        virtual bool write(const char* data, size_t length) = 0;
+        virtual void close() = 0;
+        virtual TransportKind kind() const = 0;
+
+        TransportStats stats() const;
+
+    protected:
+        std::atomic<uint64_t> frames_{0};
+        std::atomic<uint64_t> bytes_{0};
+        std::atomic<uint64_t> credit_waits_{0};
+        std::atomic<uint64_t> credit_wait_ns_{0};
+    };
+
+    // Console side.
+    class LogSource
+    {
+    public:
+        virtual ~LogSource() {}
+
+        // Attaches to the CLI's endpoint and sends HELLO with the given window.
+        virtual bool connect(const std::string& endpoint, uint32_t window) = 0;
+        // Blocks for the next frame; false once the CLI has closed the endpoint.
+        virtual bool read(std::vector<char>& frame) = 0;
+        virtual void close() = 0;
+    };
+
+    std::unique_ptr<LogTransport> create_transport(TransportKind kind);
+    std::unique_ptr<LogSource> create_source(TransportKind kind);
+
+    // Directory of the running executable, with a trailing separator.
+    std::string executable_directory();
+    // Starts the console detached from this process (its own window on Windows).
+    bool spawn_console(const std::string& path, const std::vector<std::string>& args);
+
+}
@@ -1,159 +1,558 @@
 #include "output_pipe.h"
+#include "log_ring.h"
+#include "log_transport.h"
+#include <condition_variable>
+#include <vector>
 #ifdef ERROR
 #undef ERROR
 #endif // ERROR
 
 namespace debug {
 
-    const std::string PIPE_NAME = "\\\\.\\pipe\\debugger_pipe";
+    const size_t LOG_RING_CAPACITY = 4096;
 
+    // TEXT records carry a finished message; EVENT records carry a format id and encoded arguments.
+    struct LogRecord
+    {
+        WireKind kind;
+        MessageType type;
+        uint16_t length;
+        char text[LOG_RECORD_TEXT_SIZE];
+    };
+
+    static const char* message_prefix(MessageType type) {
+        switch (type) {
+        case MessageType::ERROR: return "ERROR: ";
+        case MessageType::WARNING: return "WARNING: ";
+        case MessageType::SUCCESS: return "SUCCESS: ";
+        default: return "";
+        }
+    }
+
+    const char* overflow_policy_name(OverflowPolicy policy) {
+        switch (policy) {
+        case OverflowPolicy::DROP_OLDEST: return "drop-oldest";
+        case OverflowPolicy::DROP_NEW: return "drop-new";
+        case OverflowPolicy::BLOCK: return "block";
+        default: return "unknown";
+        }
+    }
+
+    static const uint32_t LOG_LEVELS_MASK = (1u << static_cast<uint32_t>(LogLevel::OFF)) - 1;
+
+    static uint32_t category_bits(LogCategory category, LogLevel level) {
+        uint32_t levels = LOG_LEVELS_MASK & ~((1u << static_cast<uint32_t>(level)) - 1);
+        return levels << (static_cast<uint32_t>(category) * 8);
+    }
+
+    // INFO and above in every category.
+    static const uint32_t DEFAULT_LOG_MASK = 0x001C1C1C;
+
+    std::atomic<uint32_t> LogFilter::active_mask(0);
+    std::atomic<uint32_t> LogFilter::user_mask(DEFAULT_LOG_MASK);
+    static std::mutex log_filter_mutex;
+    static bool log_filter_active = false;
+
+    void LogFilter::set_level(LogCategory category, LogLevel level) {
+        std::lock_guard<std::mutex> lock(log_filter_mutex);
+        uint32_t mask = user_mask.load() & ~category_bits(category, LogLevel::TRACE);
+        mask |= category_bits(category, level);
+        user_mask.store(mask);
+        if (log_filter_active) {
+            active_mask.store(mask);
+        }
+    }
+
+    LogLevel LogFilter::get_level(LogCategory category) {
+        uint32_t levels = (user_mask.load() >> (static_cast<uint32_t>(category) * 8)) & LOG_LEVELS_MASK;
+        for (uint32_t i = 0; i < static_cast<uint32_t>(LogLevel::OFF); i++) {
+            if (levels & (1u << i)) {
+                return static_cast<LogLevel>(i);
+            }
+        }
+        return LogLevel::OFF;
+    }
+
+    void LogFilter::set_active(bool active) {
+        std::lock_guard<std::mutex> lock(log_filter_mutex);
+        log_filter_active = active;
+        active_mask.store(active ? user_mask.load() : 0);
+    }
+
+    static const char* const LOG_LEVEL_NAMES[] = { "trace", "debug", "info", "warn", "error", "off" };
+    static const char* const LOG_CATEGORY_NAMES[] = { "debugger", "scanner", "core" };
+
+    const char* log_level_name(LogLevel level) {
+        return LOG_LEVEL_NAMES[static_cast<size_t>(level)];
+    }
+
+    bool parse_log_level(const std::string& name, LogLevel& level) {
+        for (size_t i = 0; i <= static_cast<size_t>(LogLevel::OFF); i++) {
+            if (name == LOG_LEVEL_NAMES[i]) {
+                level = static_cast<LogLevel>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const char* log_category_name(LogCategory category) {
+        return category < LogCategory::COUNT ? LOG_CATEGORY_NAMES[static_cast<size_t>(category)] : "unknown";
+    }
+
+    bool parse_log_category(const std::string& name, LogCategory& category) {
+        for (size_t i = 0; i < static_cast<size_t>(LogCategory::COUNT); i++) {
+            if (name == LOG_CATEGORY_NAMES[i]) {
+                category = static_cast<LogCategory>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Producers (debugger thread, CLI) only copy their message into the ring;
+    // the writer thread owns the transport and does every write.
     class DebuggerImpl
     {
     public:
-        DebuggerImpl() : h_pipe(INVALID_HANDLE_VALUE), connected(false) {
-            char buffer[MAX_PATH];
-            GetModuleFileNameA(NULL, buffer, MAX_PATH);
-            std::string path(buffer);
-            size_t pos = path.find_last_of("\\/");
-            debugger_path = path.substr(0, pos + 1) + "debugger_console.exe";
+        DebuggerImpl() : connected(false), writer_running(false), writer_sleeping(false), batch_pending(false),
+                         policy(OverflowPolicy::DROP_OLDEST), wire_mode(WireMode::TEXT), active_wire_mode(WireMode::TEXT),
+                         flush_policy(FlushPolicy{LOG_BATCH_BYTES, LOG_BATCH_LATENCY_US}), transport_kind(default_transport_kind()),
+                         ring(LOG_RING_CAPACITY) {
+#ifdef _WIN32
+            debugger_path = executable_directory() + "debugger_console.exe";
+#else
+            debugger_path = executable_directory() + "debugger_console";
+#endif
         }
 
         ~DebuggerImpl() {
             disconnect();
         }
 
-        bool start_debugger_console() {
-            DWORD file_attr = GetFileAttributesA(debugger_path.c_str());
-            if (file_attr == INVALID_FILE_ATTRIBUTES) {
-                std::cerr << "Error: Debugger console file not found: " << debugger_path << std::endl;
-                return false;
+        // The endpoint exists before the console starts, so the console attaches on its
+        // first try and its HELLO is the readiness signal; no fixed sleeps or retries.
+        bool connect() {
+            std::lock_guard<std::mutex> lock(pipe_mutex);
+
+            if (connected) {
+                return true;
+            }
+
+            // A previous session may have lost its console; reap its writer and endpoint first.
+            stop_writer();
+            if (transport) {
+                transport->close();
             }
 
-            STARTUPINFOA si = {0};
-            PROCESS_INFORMATION pi = {0};
-            si.cb = sizeof(STARTUPINFOA);
-
-            if (!CreateProcessA(
-                NULL,                           
-                const_cast<char*>(debugger_path.c_str()), 
-                NULL,                           
-                NULL,                           
-                FALSE,                          
-                CREATE_NEW_CONSOLE,             
-                NULL,                          
-                NULL,                          
-                &si,                            
-                &pi                            
-                )) {
-                std::cerr << "Error launching debugger console: " << GetLastError() << std::endl;
+            TransportKind kind = transport_kind.load();
+            std::unique_ptr<LogTransport> candidate = create_transport(kind);
+            if (!candidate) {
+                std::cerr << "Error: " << transport_kind_name(kind) << " log transport is not available on this platform." << std::endl;
                 return false;
             }
 
-            CloseHandle(pi.hProcess);
-            CloseHandle(pi.hThread);
+            std::string endpoint = default_endpoint(kind);
+            if (!candidate->listen(endpoint)) {
+                std::cerr << "Error: Could not create log endpoint: " << endpoint << std::endl;
+                candidate->close();
+                return false;
+            }
 
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            std::vector<std::string> args = { transport_kind_name(kind), endpoint };
+            args.insert(args.end(), console_args.begin(), console_args.end());
+            if (!spawn_console(debugger_path, args) || !candidate->accept(LOG_READY_TIMEOUT_MS)) {
+                candidate->close();
+                std::cerr << "Failed to connect to debugger console." << std::endl;
+                return false;
+            }
 
+            transport = std::move(candidate);
+            connected = true;
+            active_wire_mode = wire_mode.load();
+            start_writer();
+            LogFilter::set_active(true);
             return true;
         }
 
-        bool connect() {
+        void disconnect() {
             std::lock_guard<std::mutex> lock(pipe_mutex);
 
+            LogFilter::set_active(false);
             if (connected) {
-                return true;
+                enqueue(MessageType::INFO, "EXIT_DEBUGGER", OverflowPolicy::BLOCK);
             }
 
-            for (int i = 0; i < 10; i++) {
-                h_pipe = CreateFileA(
-                    PIPE_NAME.c_str(),           
-                    GENERIC_WRITE,            
-                    0,                           
-                    NULL,                        
-                    OPEN_EXISTING,             
-                    0,                           
-                    NULL                         
-                );
-
-                if (h_pipe != INVALID_HANDLE_VALUE) {
-                    DWORD mode = PIPE_READMODE_MESSAGE;
-                    if (SetNamedPipeHandleState(h_pipe, &mode, NULL, NULL)) {
-                        connected = true;
-                        return true;
-                    }
-                    else {
-                        CloseHandle(h_pipe);
-                        h_pipe = INVALID_HANDLE_VALUE;
-                    }
-                }
+            // The writer drains whatever is queued (including EXIT_DEBUGGER) before it returns.
+            stop_writer();
 
-                if (i == 0) {
-                    start_debugger_console();
-                }
+            connected = false;
+            // The closed transport is kept until the next connect so its counters stay readable.
+            if (transport) {
+                transport->close();
+            }
+        }
+
+        bool print(MessageType type, const std::string& message) {
+            if (!connected) {
+                return false;
+            }
+            return enqueue(type, message, policy.load(std::memory_order_relaxed));
+        }
+
+        bool print_event(MessageType type, const char* format, const uint8_t* args, size_t length) {
+            if (!connected) {
+                return false;
+            }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            uint32_t id = FormatRegistry::instance().id_for(format);
+            if (id == FormatRegistry::INVALID_ID || length > LOG_EVENT_ARGS_SIZE) {
+                // Format table is full: fall back to formatting on this thread.
+                return enqueue(type, format_event(format, args, length), policy.load(std::memory_order_relaxed));
             }
 
-            std::cerr << "Failed to connect to debugger console." << std::endl;
-            return false;
+            auto fill = [&] (LogRecord& record) {
+                record.kind = WireKind::EVENT;
+                record.type = type;
+                record.length = static_cast<uint16_t>(sizeof(id) + length);
+                memcpy(record.text, &id, sizeof(id));
+                memcpy(record.text + sizeof(id), args, length);
+            };
+            if (!push(fill, policy.load(std::memory_order_relaxed))) {
+                return false;
+            }
+            stats.deferred.fetch_add(1, std::memory_order_relaxed);
+            return true;
         }
 
-        void disconnect() {
+        void set_wire_mode(WireMode mode) {
+            wire_mode = mode;
+        }
 
-            if (connected && h_pipe != INVALID_HANDLE_VALUE) {
-                try {
-                    print("EXIT_DEBUGGER");
+        WireMode get_wire_mode() {
+            return wire_mode;
+        }
 
-                    if (h_pipe != INVALID_HANDLE_VALUE) {
-                        CloseHandle(h_pipe);
-                        h_pipe = INVALID_HANDLE_VALUE;
-                    }
+        void set_flush_policy(FlushPolicy new_policy) {
+            flush_policy = new_policy;
+            wake_writer();
+        }
+
+        FlushPolicy get_flush_policy() {
+            return flush_policy;
+        }
+
+        void set_transport(TransportKind kind) {
+            transport_kind = kind;
+        }
+
+        TransportKind get_transport() {
+            return transport_kind;
+        }
+
+        void set_console(const std::string& path, const std::vector<std::string>& args) {
+            std::lock_guard<std::mutex> lock(pipe_mutex);
+            debugger_path = path;
+            console_args = args;
+        }
+
+        void set_overflow_policy(OverflowPolicy new_policy) {
+            policy = new_policy;
+        }
+
+        OverflowPolicy get_overflow_policy() {
+            return policy;
+        }
+
+        LogStats get_stats() {
+            LogStats result;
+            result.enqueued = stats.enqueued.load();
+            result.written = stats.written.load();
+            result.dropped_oldest = stats.dropped_oldest.load();
+            result.dropped_new = stats.dropped_new.load();
+            result.blocked = stats.blocked.load();
+            result.write_calls = stats.write_calls.load();
+            result.truncated = stats.truncated.load();
+            result.deferred = stats.deferred.load();
+            result.bytes_written = stats.bytes_written.load();
+            result.flushes_size = stats.flushes_size.load();
+            result.flushes_timer = stats.flushes_timer.load();
+
+            std::lock_guard<std::mutex> lock(pipe_mutex);
+            TransportStats transport_stats = {};
+            if (transport) {
+                transport_stats = transport->stats();
+            }
+            result.credit_waits = transport_stats.credit_waits;
+            result.credit_wait_ns = transport_stats.credit_wait_ns;
+            return result;
+        }
+
+    private:
+        struct AtomicLogStats
+        {
+            std::atomic<uint64_t> enqueued{0};
+            std::atomic<uint64_t> written{0};
+            std::atomic<uint64_t> dropped_oldest{0};
+            std::atomic<uint64_t> dropped_new{0};
+            std::atomic<uint64_t> blocked{0};
+            std::atomic<uint64_t> write_calls{0};
+            std::atomic<uint64_t> truncated{0};
+            std::atomic<uint64_t> deferred{0};
+            std::atomic<uint64_t> bytes_written{0};
+            std::atomic<uint64_t> flushes_size{0};
+            std::atomic<uint64_t> flushes_timer{0};
+        };
+
+        bool enqueue(MessageType type, const std::string& message, OverflowPolicy overflow) {
+            auto fill = [&] (LogRecord& record) {
+                size_t length = message.size();
+                if (length > LOG_RECORD_TEXT_SIZE) {
+                    length = LOG_RECORD_TEXT_SIZE;
+                    stats.truncated.fetch_add(1, std::memory_order_relaxed);
+                }
+                record.kind = WireKind::TEXT;
+                record.type = type;
+                record.length = static_cast<uint16_t>(length);
+                memcpy(record.text, message.data(), length);
+            };
+            return push(fill, overflow);
+        }
+
+        template<typename Fill>
+        bool push(Fill& fill, OverflowPolicy overflow) {
+            bool was_blocked = false;
+            while (!ring.try_push(fill)) {
+                if (overflow == OverflowPolicy::DROP_NEW) {
+                    stats.dropped_new.fetch_add(1, std::memory_order_relaxed);
+                    return false;
                 }
-                catch (...) {
-                    if (h_pipe != INVALID_HANDLE_VALUE) {
-                        CloseHandle(h_pipe);
-                        h_pipe = INVALID_HANDLE_VALUE;
+
+                if (overflow == OverflowPolicy::DROP_OLDEST) {
+                    if (ring.try_pop([] (LogRecord&) {})) {
+                        stats.dropped_oldest.fetch_add(1, std::memory_order_relaxed);
                     }
+                    continue;
+                }
+
+                if (!was_blocked) {
+                    stats.blocked.fetch_add(1, std::memory_order_relaxed);
+                    was_blocked = true;
                 }
+                if (!writer_running) {
+                    return false;
+                }
+                wake_writer();
+                std::this_thread::yield();
             }
 
-            connected = false;
-            if (h_pipe != INVALID_HANDLE_VALUE) {
-                CloseHandle(h_pipe);
-                h_pipe = INVALID_HANDLE_VALUE;
+            stats.enqueued.fetch_add(1, std::memory_order_relaxed);
+            // The writer needs waking to start a batch or to send a full one; while a batch
+            // ages it wakes itself when max_latency_us runs out.
+            size_t queued = ring.size();
+            if ((queued <= 1 && !batch_pending.load(std::memory_order_acquire)) || queued >= wake_threshold()) {
+                wake_writer();
             }
+            return true;
         }
 
-        bool print(const std::string& message) {
-            std::lock_guard<std::mutex> lock(pipe_mutex);
+        // Records that may fill a batch: each takes at most sizeof(LogRecord) on the wire.
+        size_t wake_threshold() {
+            size_t records = flush_policy.load(std::memory_order_relaxed).max_bytes / sizeof(LogRecord);
+            return (std::max)(static_cast<size_t>(1), (std::min)(records, ring.capacity() / 2));
+        }
 
-            if (!connected) {
-                return false;
+        void wake_writer() {
+            if (writer_sleeping.load(std::memory_order_acquire)) {
+                writer_cv.notify_one();
             }
+        }
 
-            DWORD bytes_written;
-            if (!WriteFile(
-                h_pipe,
-                message.c_str(),
-                static_cast<DWORD>(message.length() + 1),
-                &bytes_written,
-                NULL
-                )) {
+        void start_writer() {
+            writer_running = true;
+            writer_thread = std::thread(&DebuggerImpl::writer_loop, this);
+        }
+
+        void stop_writer() {
+            if (!writer_thread.joinable()) {
+                return;
+            }
+            writer_running = false;
+            writer_cv.notify_one();
+            writer_thread.join();
+        }
 
-                CloseHandle(h_pipe);
-                h_pipe = INVALID_HANDLE_VALUE;
+        bool write_message(const char* data, size_t length) {
+            stats.write_calls.fetch_add(1, std::memory_order_relaxed);
+            if (!transport->write(data, length)) {
                 connected = false;
+                LogFilter::set_active(false);
                 return false;
             }
+            return true;
+        }
+
+        static void append_wire_record(std::string& wire, WireKind kind, MessageType type, const char* data, size_t length) {
+            WireHeader header;
+            header.kind = static_cast<uint8_t>(kind);
+            header.message_type = static_cast<uint8_t>(type);
+            header.length = static_cast<uint16_t>(length);
+            wire.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            wire.append(data, length);
+        }
+
+        // Appends one record to the batch. Text mode: a NUL-terminated line. Binary mode: wire
+        // records, preceded by the FORMAT record the first time an id goes out on this connection.
+        void serialize(const LogRecord& record, std::string& batch) {
+            if (active_wire_mode == WireMode::TEXT) {
+                batch.append(message_prefix(record.type));
+                if (record.kind == WireKind::EVENT) {
+                    uint32_t id;
+                    memcpy(&id, record.text, sizeof(id));
+                    batch += format_event(FormatRegistry::instance().format_for(id),
+                                          reinterpret_cast<const uint8_t*>(record.text) + sizeof(id), record.length - sizeof(id));
+                }
+                else {
+                    batch.append(record.text, record.length);
+                }
+                batch.push_back('\0');
+                return;
+            }
+
+            if (record.kind == WireKind::EVENT) {
+                uint32_t id;
+                memcpy(&id, record.text, sizeof(id));
+                if (!sent_formats[id]) {
+                    const char* format = FormatRegistry::instance().format_for(id);
+                    std::string definition(reinterpret_cast<const char*>(&id), sizeof(id));
+                    definition.append(format, strnlen(format, 0xFFFF - sizeof(id)));
+                    append_wire_record(batch, WireKind::FORMAT, record.type, definition.data(), definition.size());
+                    sent_formats[id] = true;
+                }
+            }
+            append_wire_record(batch, record.kind, record.type, record.text, record.length);
+        }
 
+        bool report_drops(std::string& batch) {
+            uint64_t dropped = stats.dropped_oldest.load(std::memory_order_relaxed) + stats.dropped_new.load(std::memory_order_relaxed);
+            if (dropped == reported_drops) {
+                return false;
+            }
+            std::string text = std::to_string(dropped - reported_drops) + " log messages dropped (" +
+                overflow_policy_name(policy.load(std::memory_order_relaxed)) + ")";
+            reported_drops = dropped;
+
+            LogRecord record;
+            record.kind = WireKind::TEXT;
+            record.type = MessageType::WARNING;
+            record.length = static_cast<uint16_t>(text.size());
+            memcpy(record.text, text.data(), text.size());
+            serialize(record, batch);
             return true;
         }
 
-    private:
-        HANDLE h_pipe;
-        bool connected;
+        bool flush_batch(std::string& batch, uint64_t& batch_count, std::atomic<uint64_t>& reason) {
+            if (batch.empty()) {
+                return true;
+            }
+            bool result = write_message(batch.data(), batch.size());
+            if (result) {
+                stats.written.fetch_add(batch_count, std::memory_order_relaxed);
+                stats.bytes_written.fetch_add(batch.size(), std::memory_order_relaxed);
+                reason.fetch_add(1, std::memory_order_relaxed);
+            }
+            batch.clear();
+            batch_count = 0;
+            batch_pending.store(false, std::memory_order_release);
+            return result;
+        }
+
+        // Records are packed into one transport frame until the batch reaches max_bytes or
+        // its oldest record has waited max_latency_us; a zero latency flushes as soon as
+        // the ring runs dry, so an idle debugger never waits on the timer.
+        void writer_loop() {
+            std::string batch;
+            uint64_t batch_count = 0;
+            std::chrono::steady_clock::time_point batch_start;
+            auto append_record = [&] (LogRecord& record) {
+                serialize(record, batch);
+            };
+
+            sent_formats.assign(LOG_MAX_FORMATS, false);
+            if (active_wire_mode == WireMode::BINARY) {
+                write_message(LOG_BINARY_HANDSHAKE, sizeof(LOG_BINARY_HANDSHAKE));
+            }
+
+            while (connected) {
+                FlushPolicy flush = flush_policy.load(std::memory_order_relaxed);
+                if (batch.capacity() < flush.max_bytes + LOG_RECORD_TEXT_SIZE) {
+                    batch.reserve(flush.max_bytes + LOG_RECORD_TEXT_SIZE);
+                }
+
+                bool was_empty = batch.empty();
+                if (ring.try_pop(append_record)) {
+                    if (was_empty) {
+                        batch_start = std::chrono::steady_clock::now();
+                        batch_pending.store(true, std::memory_order_release);
+                    }
+                    batch_count++;
+                    if (report_drops(batch)) {
+                        batch_count++;
+                    }
+                    if (batch.size() >= flush.max_bytes && !flush_batch(batch, batch_count, stats.flushes_size)) {
+                        break;
+                    }
+                    continue;
+                }
+
+                std::chrono::microseconds wait(1000);
+                if (!batch.empty()) {
+                    auto age = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - batch_start);
+                    if (!writer_running || age.count() >= static_cast<long long>(flush.max_latency_us)) {
+                        if (!flush_batch(batch, batch_count, stats.flushes_timer)) {
+                            break;
+                        }
+                        continue;
+                    }
+                    wait = (std::min)(wait, std::chrono::microseconds(flush.max_latency_us) - age);
+                }
+                else if (!writer_running) {
+                    break;
+                }
+
+                std::unique_lock<std::mutex> lock(writer_mutex);
+                writer_sleeping.store(true, std::memory_order_release);
+                // A producer may miss the sleeping flag; the timeout bounds that latency.
+                writer_cv.wait_for(lock, wait);
+                writer_sleeping.store(false, std::memory_order_relaxed);
+            }
+
+            // Console is gone: discard the rest so blocked producers can finish.
+            while (ring.try_pop([] (LogRecord&) {})) {}
+        }
+
+        std::unique_ptr<LogTransport> transport;
+        std::atomic<bool> connected;
         std::mutex pipe_mutex;
         std::string debugger_path;
+        std::vector<std::string> console_args;
+
+        std::thread writer_thread;
+        std::atomic<bool> writer_running;
+        std::atomic<bool> writer_sleeping;
+        // The writer holds records it has not flushed yet.
+        std::atomic<bool> batch_pending;
+        std::mutex writer_mutex;
+        std::condition_variable writer_cv;
+        std::atomic<OverflowPolicy> policy;
+        std::atomic<WireMode> wire_mode;
+        WireMode active_wire_mode;
+        std::atomic<FlushPolicy> flush_policy;
+        std::atomic<TransportKind> transport_kind;
+        std::vector<bool> sent_formats;
+        LogRing<LogRecord> ring;
+        AtomicLogStats stats;
+        uint64_t reported_drops = 0;
     };
 
     Debugger& Debugger::instance() {
@@ -175,18 +574,11 @@ namespace debug {
     }
 
     bool Debugger::print(const std::string& message) {
-        return impl_ == nullptr ? 0 : impl_->print(message);
+        return impl_ == nullptr ? 0 : impl_->print(MessageType::INFO, message);
     }
 
     bool Debugger::print(MessageType type, const std::string& message) {
-        std::string prefix;
-        switch (type) {
-        case MessageType::ERROR: prefix = "ERROR: "; break;
-        case MessageType::WARNING: prefix = "WARNING: "; break;
-        case MessageType::SUCCESS: prefix = "SUCCESS: "; break;
-        default: prefix = ""; break;
-        }
-        return impl_ == nullptr ? 0 : impl_->print(prefix + message);
+        return impl_ == nullptr ? 0 : impl_->print(type, message);
     }
 
     bool Debugger::error(const std::string& message) {
@@ -201,4 +593,48 @@ namespace debug {
         return print(MessageType::SUCCESS, message);
     }
 
+    void Debugger::set_overflow_policy(OverflowPolicy policy) {
+        impl_->set_overflow_policy(policy);
+    }
+
+    OverflowPolicy Debugger::get_overflow_policy() {
+        return impl_->get_overflow_policy();
+    }
+
+    bool Debugger::print_event(MessageType type, const char* format, const uint8_t* args, size_t length) {
+        return impl_ == nullptr ? 0 : impl_->print_event(type, format, args, length);
+    }
+
+    void Debugger::set_wire_mode(WireMode mode) {
+        impl_->set_wire_mode(mode);
+    }
+
+    WireMode Debugger::get_wire_mode() {
+        return impl_->get_wire_mode();
+    }
+
+    void Debugger::set_flush_policy(FlushPolicy policy) {
+        impl_->set_flush_policy(policy);
+    }
+
+    FlushPolicy Debugger::get_flush_policy() {
+        return impl_->get_flush_policy();
+    }
+
+    void Debugger::set_transport(TransportKind kind) {
+        impl_->set_transport(kind);
+    }
+
+    TransportKind Debugger::get_transport() {
+        return impl_->get_transport();
+    }
+
+    void Debugger::set_console(const std::string& path, const std::vector<std::string>& args) {
+        impl_->set_console(path, args);
+    }
+
+    LogStats Debugger::get_stats() {
+        return impl_->get_stats();
+    }
+
 }
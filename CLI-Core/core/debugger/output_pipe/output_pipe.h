@@ -1,12 +1,20 @@
 #pragma once
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <thread>
 #include <mutex>
 #include <iostream>
 #include <memory>
 #include <functional>
+#include <vector>
+#include "log_format.h"
+#include "log_transport.h"
+#include "log_level.h"
 
 #ifdef ERROR
 #undef ERROR
@@ -22,6 +30,55 @@ namespace debug {
         SUCCESS
     };
 
+    // What print does when the log ring is full.
+    enum class OverflowPolicy
+    {
+        DROP_OLDEST,
+        DROP_NEW,
+        BLOCK
+    };
+
+    // What goes to the console. TEXT sends formatted lines; BINARY sends the format once
+    // and then only raw arguments, leaving formatting to the console. Applied on connect.
+    enum class WireMode
+    {
+        TEXT,
+        BINARY
+    };
+
+    // Messages longer than this are truncated when queued.
+    const size_t LOG_RECORD_TEXT_SIZE = 500;
+    const size_t LOG_EVENT_ARGS_SIZE = LOG_RECORD_TEXT_SIZE - sizeof(uint32_t);
+
+    // The writer packs records into one frame and flushes at whichever limit comes first.
+    struct FlushPolicy
+    {
+        uint32_t max_bytes;
+        uint32_t max_latency_us;
+    };
+
+    const uint32_t LOG_BATCH_BYTES = 64 * 1024;
+    const uint32_t LOG_BATCH_LATENCY_US = 2000;
+
+    struct LogStats
+    {
+        uint64_t enqueued;
+        uint64_t written;
+        uint64_t dropped_oldest;
+        uint64_t dropped_new;
+        uint64_t blocked;
+        uint64_t write_calls;
+        uint64_t truncated;
+        uint64_t deferred;
+        uint64_t bytes_written;
+        uint64_t flushes_size;
+        uint64_t flushes_timer;
+        uint64_t credit_waits;
+        uint64_t credit_wait_ns;
+    };
+
+    const char* overflow_policy_name(OverflowPolicy policy);
+
     class DebuggerImpl;
 
     class Debugger
@@ -46,6 +103,23 @@ namespace debug {
         bool warning(const std::string& message);
         bool success(const std::string& message);
 
+        // Queues a format literal and its encoded arguments; formatting happens later,
+        // on the writer thread (TEXT) or in the console (BINARY).
+        bool print_event(MessageType type, const char* format, const uint8_t* args, size_t length);
+
+        void set_overflow_policy(OverflowPolicy policy);
+        OverflowPolicy get_overflow_policy();
+        LogStats get_stats();
+        void set_wire_mode(WireMode mode);
+        WireMode get_wire_mode();
+        void set_flush_policy(FlushPolicy policy);
+        FlushPolicy get_flush_policy();
+        // Both take effect on the next connect.
+        void set_transport(TransportKind kind);
+        TransportKind get_transport();
+        // Console executable and extra arguments passed after <transport> <endpoint>.
+        void set_console(const std::string& path, const std::vector<std::string>& args);
+
         static Debugger& instance();
     };
     template<typename... Args>
@@ -64,6 +138,48 @@ namespace debug {
         return buffer;
     }
 
+    template<typename... Args>
+    inline bool print_deferred(MessageType type, const char* format, Args&&... args) {
+        uint8_t payload[LOG_EVENT_ARGS_SIZE];
+        ArgEncoder encoder(payload, sizeof(payload));
+        if (!encoder.encode(std::forward<Args>(args)...)) {
+            return Debugger::instance().print(type, format_string(format, std::forward<Args>(args)...));
+        }
+        return Debugger::instance().print_event(type, format, payload, encoder.length());
+    }
+
+    // String literals take the deferred path: the literal's address is its format id, so only
+    // the arguments are copied. Mutable buffers and std::string formats are formatted right away.
+    template<size_t N, typename... Args>
+    inline void print_fmt(const char (&format)[N], Args&&... args) {
+        print_deferred(MessageType::INFO, format, std::forward<Args>(args)...);
+    }
+
+    template<size_t N, typename... Args>
+    inline void print_fmt(MessageType type, const char (&format)[N], Args&&... args) {
+        print_deferred(type, format, std::forward<Args>(args)...);
+    }
+
+    template<size_t N, typename... Args>
+    inline void error_fmt(const char (&format)[N], Args&&... args) {
+        print_deferred(MessageType::ERROR, format, std::forward<Args>(args)...);
+    }
+
+    template<size_t N, typename... Args>
+    inline void warning_fmt(const char (&format)[N], Args&&... args) {
+        print_deferred(MessageType::WARNING, format, std::forward<Args>(args)...);
+    }
+
+    template<size_t N, typename... Args>
+    inline void success_fmt(const char (&format)[N], Args&&... args) {
+        print_deferred(MessageType::SUCCESS, format, std::forward<Args>(args)...);
+    }
+
+    template<size_t N, typename... Args>
+    inline void print_fmt(char (&format)[N], Args&&... args) {
+        Debugger::instance().print(format_string(format, std::forward<Args>(args)...));
+    }
+
     template<typename... Args>
     inline void print_fmt(const std::string& format, Args&&... args) {
         Debugger::instance().print(format_string(format, std::forward<Args>(args)...));
@@ -89,6 +205,25 @@ namespace debug {
         Debugger::instance().success(format_string(format, std::forward<Args>(args)...));
     }
 
+    inline MessageType message_type_for(LogLevel level) {
+        switch (level) {
+        case LogLevel::WARN: return MessageType::WARNING;
+        case LogLevel::ERR: return MessageType::ERROR;
+        default: return MessageType::INFO;
+        }
+    }
+
+    // Targets of DEBUG_LOG; call that instead so disabled levels skip their arguments.
+    template<size_t N, typename... Args>
+    inline void log_write(LogLevel level, const char (&format)[N], Args&&... args) {
+        print_deferred(message_type_for(level), format, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    inline void log_write(LogLevel level, const std::string& format, Args&&... args) {
+        Debugger::instance().print(message_type_for(level), format_string(format, std::forward<Args>(args)...));
+    }
+
     inline void print(const std::string& message) {
         Debugger::instance().print(message);
     }
@@ -109,6 +244,30 @@ namespace debug {
         Debugger::instance().success(message);
     }
 
+    inline void set_overflow_policy(OverflowPolicy policy) {
+        Debugger::instance().set_overflow_policy(policy);
+    }
+
+    inline void set_wire_mode(WireMode mode) {
+        Debugger::instance().set_wire_mode(mode);
+    }
+
+    inline void set_flush_policy(uint32_t max_bytes, uint32_t max_latency_us) {
+        Debugger::instance().set_flush_policy(FlushPolicy{max_bytes, max_latency_us});
+    }
+
+    inline void set_transport(TransportKind kind) {
+        Debugger::instance().set_transport(kind);
+    }
+
+    inline void set_log_level(LogCategory category, LogLevel level) {
+        LogFilter::set_level(category, level);
+    }
+
+    inline LogStats get_stats() {
+        return Debugger::instance().get_stats();
+    }
+
     inline bool start() {
         return Debugger::instance().connect();
     }
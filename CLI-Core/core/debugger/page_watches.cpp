@@ -0,0 +1,157 @@
+#include "page_watches.h"
+#include <chrono>
+
+static const uint64_t WATCH_PAGE_SIZE = 0x1000;
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+bool page_watch_manager::is_covered(uint64_t page) const {
+    for (const auto& watch : watches) {
+        if (watch.address < page + WATCH_PAGE_SIZE && page < watch.address + watch.size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool page_watch_manager::is_stepped_over(uint64_t page) const {
+    for (const auto& step : stepping) {
+        if (step.second.page == page) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void page_watch_manager::bind(debug_event_source* event_source) {
+    std::lock_guard<std::mutex> lock(mutex);
+    source = event_source;
+}
+
+void page_watch_manager::unbind() {
+    clear();
+    std::lock_guard<std::mutex> lock(mutex);
+    stepping.clear();
+    source = nullptr;
+}
+
+uint32_t page_watch_manager::add(uint64_t address, uint64_t size) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!source || size == 0 || address + size < address) {
+        return 0;
+    }
+    if (!source->guard_pages(address, static_cast<size_t>(size), true)) {
+        return 0;
+    }
+
+    uint64_t first = address & ~(WATCH_PAGE_SIZE - 1);
+    for (uint64_t page = first; page < address + size; page += WATCH_PAGE_SIZE) {
+        if (!pages.count(page)) {
+            pages[page] = watched_page{page, 0, 0, 0};
+        }
+    }
+    watches.push_back(page_watch{next_id, address, size, 0});
+    return next_id++;
+}
+
+bool page_watch_manager::remove(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto watch = watches.begin();
+    while (watch != watches.end() && watch->id != id) {
+        ++watch;
+    }
+    if (watch == watches.end()) {
+        return false;
+    }
+    uint64_t first = watch->address & ~(WATCH_PAGE_SIZE - 1);
+    uint64_t end = watch->address + watch->size;
+    watches.erase(watch);
+
+    for (uint64_t page = first; page < end; page += WATCH_PAGE_SIZE) {
+        if (is_covered(page)) {
+            continue;
+        }
+        pages.erase(page);
+        if (source) {
+            source->guard_pages(page, WATCH_PAGE_SIZE, false);
+        }
+    }
+    return true;
+}
+
+void page_watch_manager::clear() {
+    std::vector<uint32_t> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& watch : watches) {
+            ids.push_back(watch.id);
+        }
+    }
+    for (uint32_t id : ids) {
+        remove(id);
+    }
+}
+
+bool page_watch_manager::on_exception(const debug_event& event) {
+    if (event.code == DEBUG_EXCEPTION_GUARD_PAGE) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto page = pages.find(event.fault_address & ~(WATCH_PAGE_SIZE - 1));
+        if (!source || page == pages.end()) {
+            return false;
+        }
+        bool hit = false;
+        for (auto& watch : watches) {
+            if (event.fault_address - watch.address < watch.size) {
+                watch.hits++;
+                hit = true;
+            }
+        }
+        if (hit) {
+            page->second.hits++;
+        }
+        else {
+            page->second.false_hits++;
+        }
+        // The fault opened the page; let the access through and close it after.
+        stepping[event.tid] = page_step{page->first, now_ns()};
+        source->step_from(event.tid, event.address);
+        return true;
+    }
+
+    if (event.code == DEBUG_EXCEPTION_SINGLE_STEP) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto step = stepping.find(event.tid);
+        if (step == stepping.end()) {
+            return false;
+        }
+        page_step done = step->second;
+        stepping.erase(step);
+        auto page = pages.find(done.page);
+        if (page != pages.end() && !is_stepped_over(done.page)) {
+            source->guard_pages(done.page, WATCH_PAGE_SIZE, true);
+        }
+        if (page != pages.end()) {
+            page->second.stall_ns += now_ns() - done.started_ns;
+        }
+        return true;
+    }
+    return false;
+}
+
+std::vector<page_watch> page_watch_manager::list() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return watches;
+}
+
+std::vector<watched_page> page_watch_manager::page_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<watched_page> stats;
+    stats.reserve(pages.size());
+    for (const auto& page : pages) {
+        stats.push_back(page.second);
+    }
+    return stats;
+}
@@ -0,0 +1,67 @@
+#ifndef PAGE_WATCHES_H
+#define PAGE_WATCHES_H
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "debug_event_source.h"
+
+struct page_watch
+{
+    uint32_t id;
+    uint64_t address;
+    uint64_t size;
+    uint64_t hits;
+};
+
+struct watched_page
+{
+    uint64_t page;
+    uint64_t hits;              // faults inside a watched range
+    uint64_t false_hits;        // faults on the page outside every range
+    uint64_t stall_ns;          // fault to re-guard, summed: what the watches on this page cost
+};
+
+// Watchpoints of any size through page protection, for ranges the debug registers cannot
+// cover. Every access to a watched page faults; the fault is counted against the ranges it
+// falls in (or as a false hit of the page), the thread steps over the access with the page
+// open and the step's trap guards the page again. Accesses by other threads during that step
+// are not seen. Everything but the listings runs on the debugger thread.
+class page_watch_manager
+{
+    struct page_step
+    {
+        uint64_t page;
+        uint64_t started_ns;
+    };
+
+    std::mutex mutex;
+    std::vector<page_watch> watches;
+    std::map<uint64_t, watched_page> pages;
+    // Thread -> page it is stepping over.
+    std::unordered_map<uint32_t, page_step> stepping;
+    debug_event_source* source;
+    uint32_t next_id;
+
+    bool is_covered(uint64_t page) const;
+    bool is_stepped_over(uint64_t page) const;
+public:
+    page_watch_manager() : source(nullptr), next_id(1) {}
+
+    void bind(debug_event_source* event_source);
+    // Unguards every page and forgets all watches.
+    void unbind();
+
+    // Returns the watch id, or 0 when the pages could not be guarded.
+    uint32_t add(uint64_t address, uint64_t size);
+    bool remove(uint32_t id);
+    void clear();
+
+    // Exception handler: true for guard-page faults on watched pages and the steps after them.
+    bool on_exception(const debug_event& event);
+
+    std::vector<page_watch> list();
+    std::vector<watched_page> page_stats();
+};
+#endif // !PAGE_WATCHES_H
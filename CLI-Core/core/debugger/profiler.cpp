@@ -0,0 +1,179 @@
+#include "profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <unordered_map>
+
+static uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Short module name that folded stacks can carry: no directories, spaces or semicolons.
+static std::string frame_module_name(const module_range& module) {
+    std::string name = module.name.substr(module.name.find_last_of("/\\") + 1);
+    std::replace(name.begin(), name.end(), ' ', '_');
+    std::replace(name.begin(), name.end(), ';', '_');
+    return name;
+}
+
+static std::vector<profile_count> sorted_counts(const std::unordered_map<std::string, uint64_t>& counts) {
+    std::vector<profile_count> sorted;
+    sorted.reserve(counts.size());
+    for (const auto& count : counts) {
+        sorted.push_back(profile_count{count.first, count.second});
+    }
+    std::sort(sorted.begin(), sorted.end(), [] (const profile_count& a, const profile_count& b) {
+        return a.samples != b.samples ? a.samples > b.samples : a.name < b.name;
+    });
+    return sorted;
+}
+
+bool save_folded(const profile_report& report, const std::string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    bool written = true;
+    for (const profile_count& stack : report.stacks) {
+        written = fprintf(file, "%s %llu\n", stack.name.c_str(), static_cast<unsigned long long>(stack.samples)) > 0 && written;
+    }
+    return fclose(file) == 0 && written;
+}
+
+void sampling_profiler::bind(debug_event_source* event_source, stack_walker* stack_walker) {
+    source = event_source;
+    walker = stack_walker;
+}
+
+void sampling_profiler::unbind() {
+    source = nullptr;
+    walker = nullptr;
+    scheduled.store(false);
+}
+
+void sampling_profiler::start(bool with_stacks) {
+    walk_stacks = with_stacks;
+    samples.clear();
+    frames.clear();
+    ticks.store(0);
+    sample_count.store(0);
+    held_ns.store(0);
+}
+
+size_t sampling_profiler::sample() {
+    if (!source) {
+        return 0;
+    }
+    std::vector<uint32_t> tids = source->get_threads();
+    uint64_t before = now_ns();
+    uint64_t stack[PROFILE_MAX_DEPTH];
+    size_t sampled = source->sample_threads(tids.data(), tids.size(), [&] (size_t index, const thread_registers& registers) {
+        size_t depth = walk_stacks && walker ? walker->walk(registers, stack, PROFILE_MAX_DEPTH) : 0;
+        if (!depth) {
+            stack[0] = registers.rip;
+            depth = 1;
+        }
+        samples.push_back(profile_sample{tids[index], static_cast<uint32_t>(frames.size()), static_cast<uint32_t>(depth)});
+        frames.insert(frames.end(), stack, stack + depth);
+    });
+    held_ns.store(held_ns.load() + now_ns() - before);
+    ticks.store(ticks.load() + 1);
+    sample_count.store(sample_count.load() + sampled);
+    return sampled;
+}
+
+void sampling_profiler::schedule(uint32_t duration_ms, uint32_t hz) {
+    next_tick = std::chrono::steady_clock::now();
+    end = next_tick + std::chrono::milliseconds(duration_ms);
+    period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::seconds(1)) / (std::max)(hz, 1u);
+    scheduled.store(true);
+}
+
+uint32_t sampling_profiler::due_in() const {
+    if (!scheduled.load()) {
+        return WAIT_FOREVER;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (next_tick <= now) {
+        return 0;
+    }
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(next_tick - now).count();
+    return static_cast<uint32_t>((remaining + 999) / 1000);
+}
+
+void sampling_profiler::on_timer() {
+    if (!scheduled.load()) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now < next_tick) {
+        return;
+    }
+    if (now >= end) {
+        scheduled.store(false);
+        return;
+    }
+    sample();
+    next_tick += period;
+    if (next_tick <= now) {
+        next_tick = now + period;
+    }
+}
+
+profile_report sampling_profiler::report(const std::vector<module_range>& modules) const {
+    // Function tables are read once per module, names once per address.
+    std::unordered_map<const module_range*, std::vector<uint64_t>> functions;
+    std::unordered_map<uint64_t, std::pair<std::string, std::string>> names;
+    auto resolve = [&] (uint64_t address) -> const std::pair<std::string, std::string>& {
+        auto known = names.find(address);
+        if (known != names.end()) {
+            return known->second;
+        }
+        std::pair<std::string, std::string>& name = names[address];
+        const module_range* module = find_module(modules, address);
+        if (!module) {
+            name = std::make_pair(std::string("[unknown]"), std::string("[unknown]"));
+            return name;
+        }
+        auto table = functions.find(module);
+        if (table == functions.end()) {
+            table = functions.emplace(module, source ? discover_functions(source, *module) : std::vector<uint64_t>()).first;
+        }
+        auto next = std::upper_bound(table->second.begin(), table->second.end(), address);
+        uint64_t start = next == table->second.begin() ? address : *(next - 1);
+        char offset[32];
+        snprintf(offset, sizeof(offset), "+0x%llX", static_cast<unsigned long long>(start - module->base));
+        name.first = frame_module_name(*module);
+        name.second = name.first + offset;
+        return name;
+    };
+
+    std::unordered_map<std::string, uint64_t> module_counts;
+    std::unordered_map<std::string, uint64_t> function_counts;
+    std::unordered_map<std::string, uint64_t> stack_counts;
+    std::string stack;
+    for (const profile_sample& sample : samples) {
+        const auto& leaf = resolve(frames[sample.first]);
+        module_counts[leaf.first]++;
+        function_counts[leaf.second]++;
+
+        // Return addresses point past the call, which may already be the next function.
+        stack.clear();
+        for (uint32_t i = sample.depth; i-- > 0;) {
+            uint64_t address = frames[sample.first + i];
+            stack += resolve(i ? address - 1 : address).second;
+            if (i) {
+                stack += ';';
+            }
+        }
+        stack_counts[stack]++;
+    }
+
+    profile_report report;
+    report.samples = samples.size();
+    report.modules = sorted_counts(module_counts);
+    report.functions = sorted_counts(function_counts);
+    report.stacks = sorted_counts(stack_counts);
+    return report;
+}
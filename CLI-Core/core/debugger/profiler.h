@@ -0,0 +1,90 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "debug_event_source.h"
+#include "modules.h"
+#include "stack_walker.h"
+
+const uint32_t PROFILE_MAX_DEPTH = 64;
+
+// One thread at one tick. frames[first] is its rip, the next depth - 1 frames its callers'
+// return addresses, innermost first.
+struct profile_sample
+{
+    uint32_t tid;
+    uint32_t first;
+    uint32_t depth;
+};
+
+struct profile_count
+{
+    std::string name;
+    uint64_t samples;
+};
+
+// Most samples first. Functions count the samples whose rip is in them (self time); stacks
+// are "outermost;...;innermost" per distinct stack, the folded format flamegraph tools read.
+struct profile_report
+{
+    uint64_t samples;
+    std::vector<profile_count> modules;
+    std::vector<profile_count> functions;
+    std::vector<profile_count> stacks;
+};
+
+// "stack count" per line.
+bool save_folded(const profile_report& report, const std::string& path);
+
+// Sampling profiler: each tick suspends every thread of the target as one batch, records its
+// rip and optionally walks its stack, then resumes them all. Debugger thread only (through
+// execute()), apart from the counters and is_scheduled(). A schedule is clocked by the
+// debugger loop, which waits no longer than due_in() and calls on_timer(), so no tick has to
+// wake it.
+class sampling_profiler
+{
+    debug_event_source* source;
+    stack_walker* walker;
+    bool walk_stacks;
+    std::chrono::steady_clock::time_point next_tick;
+    std::chrono::steady_clock::time_point end;
+    std::chrono::steady_clock::duration period;
+    std::atomic<bool> scheduled;
+    std::vector<profile_sample> samples;
+    std::vector<uint64_t> frames;
+    std::atomic<uint64_t> ticks;
+    std::atomic<uint64_t> sample_count;
+    // Time the threads spent held, over all ticks.
+    std::atomic<uint64_t> held_ns;
+public:
+    sampling_profiler() : source(nullptr), walker(nullptr), walk_stacks(false), period(0), scheduled(false), ticks(0), sample_count(0), held_ns(0) {}
+
+    // Stacks are walked with stack_walker, against the modules it was last given.
+    void bind(debug_event_source* event_source, stack_walker* stack_walker);
+    void unbind();
+
+    // Drops the previous samples.
+    void start(bool with_stacks);
+    // One tick; returns the threads sampled.
+    size_t sample();
+
+    // Ticks at hz for duration_ms from now, the first one right away.
+    void schedule(uint32_t duration_ms, uint32_t hz);
+    // Milliseconds until the next scheduled tick, rounded up; WAIT_FOREVER without a schedule.
+    uint32_t due_in() const;
+    // Takes the tick that is due, if any, and ends the schedule after its last one. A tick
+    // that comes too late to keep the rate is dropped rather than taken in a burst.
+    void on_timer();
+    bool is_scheduled() const { return scheduled.load(); }
+
+    uint64_t get_ticks() const { return ticks.load(); }
+    uint64_t get_samples() const { return sample_count.load(); }
+    uint64_t get_held_ns() const { return held_ns.load(); }
+
+    // Resolves the samples to modules and to the functions the module's unwind tables list.
+    profile_report report(const std::vector<module_range>& modules) const;
+};
+#endif // !PROFILER_H
@@ -0,0 +1,934 @@
+#include "stack_walker.h"
+#include <algorithm>
+#include <cstring>
+
+static const size_t RSP_INDEX = static_cast<size_t>(x86_register::rsp);
+// DWARF numbers x86-64 registers rax, rdx, rcx, rbx, rsi, rdi, rbp, rsp, r8-r15, then the
+// return address; gpr is in instruction-encoding order.
+static const uint8_t DWARF_TO_GPR[16] = { 0, 2, 1, 3, 6, 7, 5, 4, 8, 9, 10, 11, 12, 13, 14, 15 };
+static const uint32_t DWARF_RETURN_ADDRESS = 16;
+static const uint32_t DWARF_REGISTERS = 17;
+static const size_t MAX_CFI_ENTRY = 64 * 1024;
+static const size_t MAX_REMEMBERED_STATES = 16;
+static const size_t MAX_EXPRESSION_STACK = 16;
+static const int MAX_PE_CHAIN = 32;
+static const uint8_t UNW_FLAG_CHAININFO = 0x4;
+
+void stack_walk_memory::reset(debug_event_source* event_source) {
+    source = event_source;
+    for (page& slot : pages) {
+        slot.valid = false;
+    }
+}
+
+bool stack_walk_memory::read(uint64_t address, void* buffer, size_t size) {
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    while (size) {
+        uint64_t base = address & ~(STACK_WALK_PAGE_SIZE - 1);
+        size_t offset = static_cast<size_t>(address - base);
+        size_t chunk = (std::min)(size, static_cast<size_t>(STACK_WALK_PAGE_SIZE) - offset);
+        page& slot = pages[static_cast<size_t>((base / STACK_WALK_PAGE_SIZE) % pages.size())];
+        if (!slot.valid || slot.address != base) {
+            if (!source->read_memory(base, slot.data, sizeof(slot.data))) {
+                // Part of the page may be unreadable (a guard page next to it, say).
+                slot.valid = false;
+                return source->read_memory(address, out, size);
+            }
+            slot.address = base;
+            slot.valid = true;
+        }
+        memcpy(out, slot.data + offset, chunk);
+        out += chunk;
+        address += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+// A function that calls nothing has no unwind record: its return address is at rsp.
+static bool pop_return(stack_walk_memory& memory, thread_registers& registers) {
+    uint64_t return_address = 0;
+    if (!memory.read(registers.gpr[RSP_INDEX], return_address)) {
+        return false;
+    }
+    registers.rip = return_address;
+    registers.gpr[RSP_INDEX] += 8;
+    return true;
+}
+
+static const unwind_entry* find_entry(const std::vector<unwind_entry>& entries, uint64_t address) {
+    auto next = std::upper_bound(entries.begin(), entries.end(), address, [] (uint64_t value, const unwind_entry& entry) {
+        return value < entry.start;
+    });
+    if (next == entries.begin()) {
+        return nullptr;
+    }
+    const unwind_entry& entry = *(next - 1);
+    return !entry.end || address < entry.end ? &entry : nullptr;
+}
+
+void stack_walker::bind(debug_event_source* event_source) {
+    source = event_source;
+}
+
+void stack_walker::unbind() {
+    source = nullptr;
+    modules.clear();
+    tables.clear();
+}
+
+void stack_walker::set_modules(const std::vector<module_range>& loaded) {
+    modules = loaded;
+    for (auto table = tables.begin(); table != tables.end();) {
+        const module_range* module = find_module(modules, table->first);
+        bool same = module && module->base == table->first && module->size == table->second.module.size &&
+                    module->name == table->second.module.name;
+        table = same ? std::next(table) : tables.erase(table);
+    }
+}
+
+stack_walker::module_unwind* stack_walker::table_for(uint64_t address) {
+    const module_range* module = find_module(modules, address);
+    if (!module) {
+        return nullptr;
+    }
+    auto table = tables.find(module->base);
+    if (table != tables.end()) {
+        return &table->second;
+    }
+    module_unwind& created = tables[module->base];
+    created.module = *module;
+    created.format = read_unwind_table(source, *module, created.entries);
+    return &created;
+}
+
+size_t stack_walker::walk(const thread_registers& registers, uint64_t* frames, size_t max_frames) {
+    if (!source || !max_frames) {
+        return 0;
+    }
+    memory.reset(source);
+    thread_registers current = registers;
+    size_t count = 0;
+    frames[count++] = current.rip;
+    // The first rip is the instruction itself; the others are return addresses, which can
+    // already belong to the next function, so they are looked up one byte back.
+    bool exact = true;
+    while (count < max_frames) {
+        uint64_t lookup = exact ? current.rip : current.rip - 1;
+        uint64_t rsp = current.gpr[RSP_INDEX];
+        module_unwind* table = table_for(lookup);
+        const unwind_entry* entry = table ? find_entry(table->entries, lookup) : nullptr;
+        bool signal_frame = false;
+        bool unwound = false;
+        if (entry && table->format == image_format::pe) {
+            unwound = unwind_pe(*table, *entry, current);
+        }
+        else if (entry && table->format == image_format::elf) {
+            unwound = unwind_dwarf(*table, *entry, exact, current, signal_frame);
+        }
+        // On Windows every function without a record is a leaf; elsewhere only trust that for
+        // the frame the thread stopped in.
+        else if (count == 1 || (table && table->format == image_format::pe)) {
+            unwound = pop_return(memory, current);
+        }
+        // Frames only move up the stack, except into the code a signal interrupted.
+        if (!unwound || !current.rip || (current.gpr[RSP_INDEX] <= rsp && !signal_frame)) {
+            break;
+        }
+        frames[count++] = current.rip;
+        exact = signal_frame;
+    }
+    return count;
+}
+
+bool stack_walker::decode_pe(uint64_t base, uint64_t unwind_address, pe_unwind_record& record) {
+    record = pe_unwind_record{0, 0, 0, {}, 0};
+    uint64_t address = unwind_address;
+    bool primary = true;
+    for (int depth = 0; depth < MAX_PE_CHAIN; depth++) {
+        // An odd UnwindData points at the RUNTIME_FUNCTION whose record this function shares.
+        if ((address - base) & 1) {
+            uint32_t shared[3] = {};
+            if (!memory.read(address & ~static_cast<uint64_t>(1), shared)) {
+                return false;
+            }
+            address = base + shared[2];
+            continue;
+        }
+        uint8_t header[4] = {};
+        if (!memory.read(address, header)) {
+            return false;
+        }
+        uint8_t version = header[0] & 0x7;
+        uint8_t flags = header[0] >> 3;
+        if (version != 1 && version != 2) {
+            return false;
+        }
+        size_t count = header[2];
+        size_t first = record.codes.size();
+        record.codes.resize(first + count);
+        if (count && !memory.read(address + 4, record.codes.data() + first, count * sizeof(uint16_t))) {
+            return false;
+        }
+        if (primary) {
+            record.prolog_size = header[1];
+            record.primary_codes = count;
+            primary = false;
+        }
+        if (!record.frame_register && (header[3] & 0xF)) {
+            record.frame_register = header[3] & 0xF;
+            record.frame_offset = header[3] >> 4;
+        }
+        if (!(flags & UNW_FLAG_CHAININFO)) {
+            return true;
+        }
+        // The chained RUNTIME_FUNCTION follows the codes, padded to an even count.
+        uint32_t chained[3] = {};
+        if (!memory.read(address + 4 + ((count + 1) & ~static_cast<size_t>(1)) * sizeof(uint16_t), chained)) {
+            return false;
+        }
+        address = base + chained[2];
+    }
+    return false;
+}
+
+// Epilogs have no unwind codes; RtlVirtualUnwind recognizes them by their shape instead:
+// an optional "add rsp, imm" or "lea rsp, [frame + disp]", pops, then ret or a tail jump.
+bool stack_walker::unwind_pe_epilog(const unwind_entry& entry, thread_registers& registers) {
+    uint8_t code[32] = {};
+    if (!memory.read(registers.rip, code)) {
+        return false;
+    }
+    thread_registers result = registers;
+    uint64_t& rsp = result.gpr[RSP_INDEX];
+    size_t i = 0;
+    if (code[0] == 0x48 && code[1] == 0x83 && code[2] == 0xC4) {
+        rsp += static_cast<int8_t>(code[3]);
+        i = 4;
+    }
+    else if (code[0] == 0x48 && code[1] == 0x81 && code[2] == 0xC4) {
+        int32_t displacement = 0;
+        memcpy(&displacement, code + 3, sizeof(displacement));
+        rsp += displacement;
+        i = 7;
+    }
+    else if ((code[0] & 0xFE) == 0x48 && code[1] == 0x8D && (code[2] & 0x38) == 0x20 && (code[2] & 0x7) != 4 &&
+             ((code[2] >> 6) == 1 || (code[2] >> 6) == 2)) {
+        size_t base = (code[2] & 0x7) | ((code[0] & 1) << 3);
+        int32_t displacement = 0;
+        if ((code[2] >> 6) == 1) {
+            displacement = static_cast<int8_t>(code[3]);
+            i = 4;
+        }
+        else {
+            memcpy(&displacement, code + 3, sizeof(displacement));
+            i = 7;
+        }
+        rsp = registers.gpr[base] + displacement;
+    }
+
+    while (i + 2 < sizeof(code)) {
+        size_t reg = 0;
+        if (code[i] >= 0x58 && code[i] <= 0x5F) {
+            reg = code[i] - 0x58;
+            i += 1;
+        }
+        else if (code[i] == 0x41 && code[i + 1] >= 0x58 && code[i + 1] <= 0x5F) {
+            reg = 8 + code[i + 1] - 0x58;
+            i += 2;
+        }
+        else {
+            break;
+        }
+        if (!memory.read(rsp, result.gpr[reg])) {
+            return false;
+        }
+        rsp += 8;
+    }
+
+    bool ends = false;
+    if (i + 5 <= sizeof(code)) {
+        int32_t relative = 0;
+        memcpy(&relative, code + i + 1, sizeof(relative));
+        uint64_t target = registers.rip + i + 5 + relative;
+        ends = code[i] == 0xC3 || (code[i] == 0xF3 && code[i + 1] == 0xC3) ||
+               (code[i] == 0xE9 && (target < entry.start || target >= entry.end)) ||
+               (code[i] == 0xFF && code[i + 1] == 0x25) || (code[i] == 0x48 && code[i + 1] == 0xFF && code[i + 2] == 0x25);
+    }
+    if (!ends || !pop_return(memory, result)) {
+        return false;
+    }
+    registers = result;
+    return true;
+}
+
+bool stack_walker::unwind_pe(module_unwind& table, const unwind_entry& entry, thread_registers& registers) {
+    auto found = table.pe_records.find(entry.start);
+    if (found == table.pe_records.end()) {
+        pe_unwind_record record;
+        if (!decode_pe(table.module.base, entry.unwind, record)) {
+            return false;
+        }
+        found = table.pe_records.emplace(entry.start, std::move(record)).first;
+    }
+    const pe_unwind_record& record = found->second;
+    uint64_t offset = registers.rip - entry.start;
+    if (offset >= record.prolog_size && unwind_pe_epilog(entry, registers)) {
+        return true;
+    }
+
+    uint64_t* gpr = registers.gpr;
+    // Saved registers are addressed from the fixed frame: the frame register once the prolog
+    // has set it, rsp before that.
+    uint64_t frame = record.frame_register && offset >= record.prolog_size ?
+                     gpr[record.frame_register] - record.frame_offset * 16ull : gpr[RSP_INDEX];
+    const std::vector<uint16_t>& codes = record.codes;
+    for (size_t i = 0; i < codes.size();) {
+        uint8_t prolog_offset = codes[i] & 0xFF;
+        uint8_t op = (codes[i] >> 8) & 0xF;
+        uint8_t info = codes[i] >> 12;
+        size_t slots = op == 1 ? (info ? 3 : 2) : op == 4 || op == 6 || op == 8 ? 2 : op == 5 || op == 7 || op == 9 ? 3 : 1;
+        if (i + slots > codes.size()) {
+            return false;
+        }
+        // Prolog codes of the primary record count once their instruction has run; chained
+        // records describe code the function has already passed.
+        bool applies = i >= record.primary_codes || prolog_offset <= offset;
+        uint32_t operand = slots > 1 ? codes[i + 1] : 0;
+        if (slots == 3) {
+            operand |= static_cast<uint32_t>(codes[i + 2]) << 16;
+        }
+        i += slots;
+        if (!applies) {
+            continue;
+        }
+        switch (op) {
+        case 0:     // UWOP_PUSH_NONVOL
+            if (!memory.read(gpr[RSP_INDEX], gpr[info])) {
+                return false;
+            }
+            gpr[RSP_INDEX] += 8;
+            break;
+        case 1:     // UWOP_ALLOC_LARGE
+            gpr[RSP_INDEX] += info ? operand : operand * 8ull;
+            break;
+        case 2:     // UWOP_ALLOC_SMALL
+            gpr[RSP_INDEX] += info * 8ull + 8;
+            break;
+        case 3:     // UWOP_SET_FPREG
+            gpr[RSP_INDEX] = gpr[record.frame_register] - record.frame_offset * 16ull;
+            break;
+        case 4:     // UWOP_SAVE_NONVOL
+        case 5:     // UWOP_SAVE_NONVOL_FAR
+            if (!memory.read(frame + (op == 4 ? operand * 8ull : operand), gpr[info])) {
+                return false;
+            }
+            break;
+        case 10: {  // UWOP_PUSH_MACHFRAME: rip and rsp come from the interrupt frame
+            uint64_t machine_frame = gpr[RSP_INDEX] + (info ? 8 : 0);
+            uint64_t rsp = 0;
+            if (!memory.read(machine_frame, registers.rip) || !memory.read(machine_frame + 24, rsp)) {
+                return false;
+            }
+            gpr[RSP_INDEX] = rsp;
+            return true;
+        }
+        default:    // epilog descriptions and xmm saves
+            break;
+        }
+    }
+    return pop_return(memory, registers);
+}
+
+namespace {
+    // Reads CFI bytes copied out of the target; address is where start lives in the target,
+    // for pc-relative pointers.
+    struct cfi_cursor
+    {
+        const uint8_t* start;
+        const uint8_t* p;
+        const uint8_t* end;
+        uint64_t address;
+
+        template<typename T>
+        bool fixed(T& value) {
+            if (static_cast<size_t>(end - p) < sizeof(T)) {
+                return false;
+            }
+            memcpy(&value, p, sizeof(T));
+            p += sizeof(T);
+            return true;
+        }
+
+        bool uleb(uint64_t& value) {
+            value = 0;
+            for (int shift = 0; p < end && shift < 64; shift += 7) {
+                uint8_t byte = *p++;
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool sleb(int64_t& value) {
+            uint64_t result = 0;
+            int shift = 0;
+            uint8_t byte = 0x80;
+            while (p < end && shift < 64 && (byte & 0x80)) {
+                byte = *p++;
+                result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                shift += 7;
+            }
+            if (byte & 0x80) {
+                return false;
+            }
+            if (shift < 64 && (byte & 0x40)) {
+                result |= ~0ull << shift;
+            }
+            value = static_cast<int64_t>(result);
+            return true;
+        }
+
+        // DW_EH_PE_* pointer: format in the low nibble, pcrel and indirect applications.
+        bool encoded(uint8_t encoding, stack_walk_memory& memory, uint64_t& value) {
+            uint64_t field = address + static_cast<uint64_t>(p - start);
+            bool read = false;
+            switch (encoding & 0x0F) {
+            case 0x00: { uint64_t v = 0; read = fixed(v); value = v; break; }
+            case 0x01: read = uleb(value); break;
+            case 0x02: { uint16_t v = 0; read = fixed(v); value = v; break; }
+            case 0x03: { uint32_t v = 0; read = fixed(v); value = v; break; }
+            case 0x04: { uint64_t v = 0; read = fixed(v); value = v; break; }
+            case 0x09: { int64_t v = 0; read = sleb(v); value = static_cast<uint64_t>(v); break; }
+            case 0x0A: { int16_t v = 0; read = fixed(v); value = static_cast<uint64_t>(static_cast<int64_t>(v)); break; }
+            case 0x0B: { int32_t v = 0; read = fixed(v); value = static_cast<uint64_t>(static_cast<int64_t>(v)); break; }
+            case 0x0C: { int64_t v = 0; read = fixed(v); value = static_cast<uint64_t>(v); break; }
+            default: return false;
+            }
+            if (!read) {
+                return false;
+            }
+            switch (encoding & 0x70) {
+            case 0x00: break;
+            case 0x10: value += field; break;
+            default: return false;
+            }
+            return !(encoding & 0x80) || memory.read(value, value);
+        }
+    };
+
+    // Copies one CIE or FDE (after its length) out of the target. 64-bit DWARF is not emitted
+    // into .eh_frame by any x86-64 toolchain and is refused.
+    bool read_cfi_entry(stack_walk_memory& memory, uint64_t address, std::vector<uint8_t>& body, uint64_t& body_address) {
+        uint32_t length = 0;
+        if (!memory.read(address, length) || !length || length == 0xFFFFFFFF || length > MAX_CFI_ENTRY) {
+            return false;
+        }
+        body.resize(length);
+        body_address = address + 4;
+        return memory.read(body_address, body.data(), body.size());
+    }
+
+    enum class cfi_rule_kind : uint8_t
+    {
+        same,
+        undefined,
+        offset,             // saved at cfa + value
+        value_offset,       // is cfa + value
+        register_copy,      // is in register value
+        expression,         // saved at the address the expression computes
+        value_expression    // is what the expression computes
+    };
+
+    struct cfi_rule
+    {
+        cfi_rule_kind kind;
+        int64_t value;
+        const uint8_t* expression;
+        size_t expression_size;
+    };
+
+    struct cfi_state
+    {
+        uint32_t cfa_register;
+        int64_t cfa_offset;
+        const uint8_t* cfa_expression;
+        size_t cfa_expression_size;
+        cfi_rule rules[DWARF_REGISTERS];
+    };
+
+    uint64_t dwarf_register(const thread_registers& registers, uint32_t number) {
+        return number < 16 ? registers.gpr[DWARF_TO_GPR[number]] : registers.rip;
+    }
+
+    // The DW_OP_* subset unwind expressions use (glibc's PLT CFA is one of them).
+    bool evaluate_expression(const uint8_t* code, size_t size, const thread_registers& registers, stack_walk_memory& memory,
+                             const uint64_t* initial, uint64_t& result) {
+        uint64_t stack[MAX_EXPRESSION_STACK];
+        size_t depth = 0;
+        if (initial) {
+            stack[depth++] = *initial;
+        }
+        cfi_cursor cursor = { code, code, code + size, 0 };
+        while (cursor.p < cursor.end) {
+            uint8_t op = *cursor.p++;
+            uint64_t value = 0;
+            bool push = true;
+            if (op >= 0x30 && op <= 0x4F) {
+                value = op - 0x30;
+            }
+            else if (op >= 0x50 && op <= 0x6F) {
+                if (op - 0x50u > DWARF_RETURN_ADDRESS) {
+                    return false;
+                }
+                value = dwarf_register(registers, op - 0x50);
+            }
+            else if (op >= 0x70 && op <= 0x8F) {
+                int64_t offset = 0;
+                if (op - 0x70u > DWARF_RETURN_ADDRESS || !cursor.sleb(offset)) {
+                    return false;
+                }
+                value = dwarf_register(registers, op - 0x70) + offset;
+            }
+            else {
+                push = false;
+                switch (op) {
+                case 0x08: { uint8_t v; if (!cursor.fixed(v)) return false; value = v; push = true; break; }
+                case 0x09: { int8_t v; if (!cursor.fixed(v)) return false; value = static_cast<uint64_t>(static_cast<int64_t>(v)); push = true; break; }
+                case 0x0A: { uint16_t v; if (!cursor.fixed(v)) return false; value = v; push = true; break; }
+                case 0x0B: { int16_t v; if (!cursor.fixed(v)) return false; value = static_cast<uint64_t>(static_cast<int64_t>(v)); push = true; break; }
+                case 0x0C: { uint32_t v; if (!cursor.fixed(v)) return false; value = v; push = true; break; }
+                case 0x0D: { int32_t v; if (!cursor.fixed(v)) return false; value = static_cast<uint64_t>(static_cast<int64_t>(v)); push = true; break; }
+                case 0x0E:
+                case 0x0F: { uint64_t v; if (!cursor.fixed(v)) return false; value = v; push = true; break; }
+                case 0x10: if (!cursor.uleb(value)) return false; push = true; break;
+                case 0x11: { int64_t v; if (!cursor.sleb(v)) return false; value = static_cast<uint64_t>(v); push = true; break; }
+                case 0x12: if (!depth) return false; value = stack[depth - 1]; push = true; break;
+                case 0x13: if (!depth) return false; depth--; break;
+                case 0x16: if (depth < 2) return false; std::swap(stack[depth - 1], stack[depth - 2]); break;
+                case 0x06:
+                    if (!depth || !memory.read(stack[depth - 1], stack[depth - 1])) {
+                        return false;
+                    }
+                    break;
+                case 0x23: {
+                    uint64_t addend = 0;
+                    if (!depth || !cursor.uleb(addend)) {
+                        return false;
+                    }
+                    stack[depth - 1] += addend;
+                    break;
+                }
+                case 0x96:
+                    break;
+                default: {
+                    if (depth < 2) {
+                        return false;
+                    }
+                    uint64_t b = stack[--depth];
+                    uint64_t& a = stack[depth - 1];
+                    switch (op) {
+                    case 0x1A: a &= b; break;
+                    case 0x1C: a -= b; break;
+                    case 0x1E: a *= b; break;
+                    case 0x21: a |= b; break;
+                    case 0x22: a += b; break;
+                    case 0x24: a <<= (b & 63); break;
+                    case 0x25: a >>= (b & 63); break;
+                    case 0x27: a ^= b; break;
+                    case 0x29: a = a == b; break;
+                    case 0x2A: a = static_cast<int64_t>(a) >= static_cast<int64_t>(b); break;
+                    case 0x2B: a = static_cast<int64_t>(a) > static_cast<int64_t>(b); break;
+                    case 0x2C: a = static_cast<int64_t>(a) <= static_cast<int64_t>(b); break;
+                    case 0x2D: a = static_cast<int64_t>(a) < static_cast<int64_t>(b); break;
+                    case 0x2E: a = a != b; break;
+                    default: return false;
+                    }
+                    break;
+                }
+                }
+            }
+            if (push) {
+                if (depth == MAX_EXPRESSION_STACK) {
+                    return false;
+                }
+                stack[depth++] = value;
+            }
+        }
+        if (!depth) {
+            return false;
+        }
+        result = stack[depth - 1];
+        return true;
+    }
+
+    // Runs a CFA program up to the row that covers pc. initial is the state after the CIE's
+    // instructions, which DW_CFA_restore goes back to.
+    bool run_cfa_program(const dwarf_unwind_record& record, const std::vector<uint8_t>& program, uint64_t pc,
+                         stack_walk_memory& memory, const cfi_state* initial, cfi_state& state, bool& reached) {
+        std::vector<cfi_state> remembered;
+        uint64_t location = record.start;
+        cfi_cursor cursor = { program.data(), program.data(), program.data() + program.size(), 0 };
+        auto set_rule = [&state] (uint64_t reg, cfi_rule_kind kind, int64_t value) {
+            if (reg < DWARF_REGISTERS) {
+                state.rules[reg] = cfi_rule{kind, value, nullptr, 0};
+            }
+        };
+        auto advance = [&] (uint64_t delta) {
+            location += delta * record.code_alignment;
+            reached = location > pc;
+        };
+        reached = false;
+        while (cursor.p < cursor.end && !reached) {
+            uint8_t op = *cursor.p++;
+            uint8_t operand = op & 0x3F;
+            uint64_t reg = 0;
+            uint64_t value = 0;
+            int64_t signed_value = 0;
+            switch (op & 0xC0) {
+            case 0x40:
+                advance(operand);
+                continue;
+            case 0x80:
+                if (!cursor.uleb(value)) {
+                    return false;
+                }
+                set_rule(operand, cfi_rule_kind::offset, static_cast<int64_t>(value) * record.data_alignment);
+                continue;
+            case 0xC0:
+                if (operand < DWARF_REGISTERS) {
+                    state.rules[operand] = initial ? initial->rules[operand] : cfi_rule{cfi_rule_kind::same, 0, nullptr, 0};
+                }
+                continue;
+            }
+            switch (op) {
+            case 0x00:
+                break;
+            case 0x01:
+                if (!cursor.encoded(record.pointer_encoding, memory, value)) {
+                    return false;
+                }
+                location = value;
+                reached = location > pc;
+                break;
+            case 0x02: { uint8_t delta; if (!cursor.fixed(delta)) return false; advance(delta); break; }
+            case 0x03: { uint16_t delta; if (!cursor.fixed(delta)) return false; advance(delta); break; }
+            case 0x04: { uint32_t delta; if (!cursor.fixed(delta)) return false; advance(delta); break; }
+            case 0x05:
+            case 0x14:
+            case 0x2F:
+                if (!cursor.uleb(reg) || !cursor.uleb(value)) {
+                    return false;
+                }
+                set_rule(reg, op == 0x14 ? cfi_rule_kind::value_offset : cfi_rule_kind::offset,
+                         (op == 0x2F ? -static_cast<int64_t>(value) : static_cast<int64_t>(value)) * record.data_alignment);
+                break;
+            case 0x11:
+            case 0x15:
+                if (!cursor.uleb(reg) || !cursor.sleb(signed_value)) {
+                    return false;
+                }
+                set_rule(reg, op == 0x15 ? cfi_rule_kind::value_offset : cfi_rule_kind::offset, signed_value * record.data_alignment);
+                break;
+            case 0x06:
+                if (!cursor.uleb(reg)) {
+                    return false;
+                }
+                if (reg < DWARF_REGISTERS) {
+                    state.rules[reg] = initial ? initial->rules[reg] : cfi_rule{cfi_rule_kind::same, 0, nullptr, 0};
+                }
+                break;
+            case 0x07:
+            case 0x08:
+                if (!cursor.uleb(reg)) {
+                    return false;
+                }
+                set_rule(reg, op == 0x07 ? cfi_rule_kind::undefined : cfi_rule_kind::same, 0);
+                break;
+            case 0x09:
+                if (!cursor.uleb(reg) || !cursor.uleb(value)) {
+                    return false;
+                }
+                set_rule(reg, cfi_rule_kind::register_copy, static_cast<int64_t>(value));
+                break;
+            case 0x0A:
+                if (remembered.size() == MAX_REMEMBERED_STATES) {
+                    return false;
+                }
+                remembered.push_back(state);
+                break;
+            case 0x0B:
+                if (remembered.empty()) {
+                    return false;
+                }
+                state = remembered.back();
+                remembered.pop_back();
+                break;
+            case 0x0C:
+            case 0x12:
+                if (!cursor.uleb(reg)) {
+                    return false;
+                }
+                if (op == 0x0C) {
+                    if (!cursor.uleb(value)) {
+                        return false;
+                    }
+                    signed_value = static_cast<int64_t>(value);
+                }
+                else {
+                    if (!cursor.sleb(signed_value)) {
+                        return false;
+                    }
+                    signed_value *= record.data_alignment;
+                }
+                state.cfa_register = static_cast<uint32_t>(reg);
+                state.cfa_offset = signed_value;
+                state.cfa_expression = nullptr;
+                break;
+            case 0x0D:
+                if (!cursor.uleb(reg)) {
+                    return false;
+                }
+                state.cfa_register = static_cast<uint32_t>(reg);
+                state.cfa_expression = nullptr;
+                break;
+            case 0x0E:
+                if (!cursor.uleb(value)) {
+                    return false;
+                }
+                state.cfa_offset = static_cast<int64_t>(value);
+                break;
+            case 0x13:
+                if (!cursor.sleb(signed_value)) {
+                    return false;
+                }
+                state.cfa_offset = signed_value * record.data_alignment;
+                break;
+            case 0x0F:
+                if (!cursor.uleb(value) || value > static_cast<uint64_t>(cursor.end - cursor.p)) {
+                    return false;
+                }
+                state.cfa_expression = cursor.p;
+                state.cfa_expression_size = static_cast<size_t>(value);
+                cursor.p += value;
+                break;
+            case 0x10:
+            case 0x16:
+                if (!cursor.uleb(reg) || !cursor.uleb(value) || value > static_cast<uint64_t>(cursor.end - cursor.p)) {
+                    return false;
+                }
+                if (reg < DWARF_REGISTERS) {
+                    state.rules[reg] = cfi_rule{op == 0x10 ? cfi_rule_kind::expression : cfi_rule_kind::value_expression, 0,
+                                                cursor.p, static_cast<size_t>(value)};
+                }
+                cursor.p += value;
+                break;
+            case 0x2E:
+                if (!cursor.uleb(value)) {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool stack_walker::decode_dwarf(uint64_t fde_address, dwarf_unwind_record& record) {
+    std::vector<uint8_t> fde;
+    uint64_t fde_body = 0;
+    uint32_t cie_pointer = 0;
+    if (!read_cfi_entry(memory, fde_address, fde, fde_body) || fde.size() < 4) {
+        return false;
+    }
+    memcpy(&cie_pointer, fde.data(), sizeof(cie_pointer));
+    std::vector<uint8_t> cie;
+    uint64_t cie_body = 0;
+    if (!cie_pointer || !read_cfi_entry(memory, fde_body - cie_pointer, cie, cie_body)) {
+        return false;
+    }
+
+    record = dwarf_unwind_record{0, 0, 1, 1, DWARF_RETURN_ADDRESS, 0, false, {}, {}};
+    cfi_cursor cursor = { cie.data(), cie.data(), cie.data() + cie.size(), cie_body };
+    uint32_t cie_id = 0;
+    uint8_t version = 0;
+    if (!cursor.fixed(cie_id) || cie_id != 0 || !cursor.fixed(version)) {
+        return false;
+    }
+    const char* augmentation = reinterpret_cast<const char*>(cursor.p);
+    while (cursor.p < cursor.end && *cursor.p) {
+        cursor.p++;
+    }
+    if (cursor.p++ >= cursor.end) {
+        return false;
+    }
+    if (version >= 4) {
+        cursor.p += 2;      // address and segment selector sizes
+    }
+    int64_t data_alignment = 0;
+    if (!cursor.uleb(record.code_alignment) || !cursor.sleb(data_alignment)) {
+        return false;
+    }
+    record.data_alignment = data_alignment;
+    if (version == 1) {
+        uint8_t reg = 0;
+        if (!cursor.fixed(reg)) {
+            return false;
+        }
+        record.return_register = reg;
+    }
+    else {
+        uint64_t reg = 0;
+        if (!cursor.uleb(reg)) {
+            return false;
+        }
+        record.return_register = static_cast<uint32_t>(reg);
+    }
+    bool has_augmentation_data = augmentation[0] == 'z';
+    if (has_augmentation_data) {
+        uint64_t size = 0;
+        if (!cursor.uleb(size) || size > static_cast<uint64_t>(cursor.end - cursor.p)) {
+            return false;
+        }
+        const uint8_t* data_end = cursor.p + size;
+        for (const char* c = augmentation + 1; *c; c++) {
+            uint8_t encoding = 0;
+            uint64_t ignored = 0;
+            if (*c == 'R') {
+                if (!cursor.fixed(record.pointer_encoding)) {
+                    return false;
+                }
+            }
+            else if (*c == 'P') {
+                if (!cursor.fixed(encoding) || !cursor.encoded(encoding & 0x7F, memory, ignored)) {
+                    return false;
+                }
+            }
+            else if (*c == 'L') {
+                if (!cursor.fixed(encoding)) {
+                    return false;
+                }
+            }
+            else if (*c == 'S') {
+                record.signal_frame = true;
+            }
+            else {
+                break;
+            }
+        }
+        cursor.p = data_end;
+    }
+    else if (augmentation[0]) {
+        return false;
+    }
+    record.initial_instructions.assign(cursor.p, cursor.end);
+
+    cursor = cfi_cursor{ fde.data(), fde.data() + 4, fde.data() + fde.size(), fde_body };
+    uint64_t length = 0;
+    if (!cursor.encoded(record.pointer_encoding, memory, record.start) || !cursor.encoded(record.pointer_encoding & 0x0F, memory, length)) {
+        return false;
+    }
+    record.end = record.start + length;
+    if (has_augmentation_data) {
+        uint64_t size = 0;
+        if (!cursor.uleb(size) || size > static_cast<uint64_t>(cursor.end - cursor.p)) {
+            return false;
+        }
+        cursor.p += size;
+    }
+    record.instructions.assign(cursor.p, cursor.end);
+    return true;
+}
+
+bool stack_walker::unwind_dwarf(module_unwind& table, const unwind_entry& entry, bool exact, thread_registers& registers, bool& signal_frame) {
+    auto found = table.dwarf_records.find(entry.start);
+    if (found == table.dwarf_records.end()) {
+        dwarf_unwind_record record;
+        if (!decode_dwarf(entry.unwind, record)) {
+            return false;
+        }
+        found = table.dwarf_records.emplace(entry.start, std::move(record)).first;
+    }
+    const dwarf_unwind_record& record = found->second;
+    uint64_t pc = exact ? registers.rip : registers.rip - 1;
+    if (pc < record.start || pc >= record.end || record.return_register >= DWARF_REGISTERS) {
+        return false;
+    }
+
+    cfi_state state = {};
+    state.cfa_register = 7;
+    bool reached = false;
+    if (!run_cfa_program(record, record.initial_instructions, UINT64_MAX, memory, nullptr, state, reached)) {
+        return false;
+    }
+    cfi_state initial = state;
+    if (!run_cfa_program(record, record.instructions, pc, memory, &initial, state, reached)) {
+        return false;
+    }
+
+    uint64_t cfa = 0;
+    if (state.cfa_expression) {
+        if (!evaluate_expression(state.cfa_expression, state.cfa_expression_size, registers, memory, nullptr, cfa)) {
+            return false;
+        }
+    }
+    else {
+        if (state.cfa_register > DWARF_RETURN_ADDRESS) {
+            return false;
+        }
+        cfa = dwarf_register(registers, state.cfa_register) + state.cfa_offset;
+    }
+
+    // The outermost frame (_start, a thread's entry) marks its return address undefined.
+    if (state.rules[record.return_register].kind == cfi_rule_kind::undefined) {
+        return false;
+    }
+    uint64_t values[DWARF_REGISTERS];
+    for (uint32_t reg = 0; reg < DWARF_REGISTERS; reg++) {
+        const cfi_rule& rule = state.rules[reg];
+        uint64_t& value = values[reg];
+        value = dwarf_register(registers, reg);
+        uint64_t address = 0;
+        switch (rule.kind) {
+        case cfi_rule_kind::same:
+        case cfi_rule_kind::undefined:
+            break;
+        case cfi_rule_kind::offset:
+            if (!memory.read(cfa + rule.value, value)) {
+                return false;
+            }
+            break;
+        case cfi_rule_kind::value_offset:
+            value = cfa + rule.value;
+            break;
+        case cfi_rule_kind::register_copy:
+            if (rule.value > static_cast<int64_t>(DWARF_RETURN_ADDRESS)) {
+                return false;
+            }
+            value = dwarf_register(registers, static_cast<uint32_t>(rule.value));
+            break;
+        case cfi_rule_kind::expression:
+            if (!evaluate_expression(rule.expression, rule.expression_size, registers, memory, &cfa, address) ||
+                !memory.read(address, value)) {
+                return false;
+            }
+            break;
+        case cfi_rule_kind::value_expression:
+            if (!evaluate_expression(rule.expression, rule.expression_size, registers, memory, &cfa, value)) {
+                return false;
+            }
+            break;
+        }
+    }
+    for (uint32_t reg = 0; reg < 16; reg++) {
+        registers.gpr[DWARF_TO_GPR[reg]] = values[reg];
+    }
+    registers.rip = values[record.return_register];
+    registers.gpr[RSP_INDEX] = cfa;
+    signal_frame = record.signal_frame;
+    return true;
+}
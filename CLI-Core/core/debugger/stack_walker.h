@@ -0,0 +1,101 @@
+#ifndef STACK_WALKER_H
+#define STACK_WALKER_H
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include "debug_event_source.h"
+#include "modules.h"
+
+const size_t STACK_WALK_MAX_FRAMES = 128;
+const uint64_t STACK_WALK_PAGE_SIZE = 0x1000;
+const size_t STACK_WALK_PAGES = 16;
+
+// Target memory for one walk: whole pages, direct-mapped by page number. Stacks and unwind
+// data are read a page at a time instead of eight or sixteen bytes at a time.
+class stack_walk_memory
+{
+    struct page
+    {
+        uint64_t address;
+        bool valid;
+        uint8_t data[STACK_WALK_PAGE_SIZE];
+    };
+    debug_event_source* source;
+    std::vector<page> pages;
+public:
+    stack_walk_memory() : source(nullptr), pages(STACK_WALK_PAGES) {}
+
+    // Forgets every page: stacks change as soon as the threads run again.
+    void reset(debug_event_source* event_source);
+    bool read(uint64_t address, void* buffer, size_t size);
+    template<typename T>
+    bool read(uint64_t address, T& value) { return read(address, &value, sizeof(value)); }
+};
+
+// A PE function's UNWIND_INFO and the ones chained behind it, decoded once.
+struct pe_unwind_record
+{
+    uint8_t prolog_size;
+    uint8_t frame_register;
+    uint8_t frame_offset;           // scaled by 16
+    std::vector<uint16_t> codes;    // the primary record's codes, then each chained record's
+    size_t primary_codes;           // codes that belong to the primary record
+};
+
+// A DWARF CIE and FDE pair as the CFA program needs it.
+struct dwarf_unwind_record
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t code_alignment;
+    int64_t data_alignment;
+    uint32_t return_register;
+    uint8_t pointer_encoding;
+    bool signal_frame;
+    std::vector<uint8_t> initial_instructions;
+    std::vector<uint8_t> instructions;
+};
+
+// x64 stack walker driven by the images' unwind tables: .pdata/.xdata on Windows, .eh_frame on
+// Linux. A module's table is read the first time a walk reaches it and kept as a sorted array
+// for binary search; each function's unwind record is decoded on first use and kept too.
+// Debugger thread only.
+class stack_walker
+{
+    struct module_unwind
+    {
+        module_range module;
+        image_format format;
+        std::vector<unwind_entry> entries;
+        std::unordered_map<uint64_t, pe_unwind_record> pe_records;
+        std::unordered_map<uint64_t, dwarf_unwind_record> dwarf_records;
+    };
+
+    debug_event_source* source;
+    std::vector<module_range> modules;
+    // Module base -> its table, read lazily.
+    std::map<uint64_t, module_unwind> tables;
+    stack_walk_memory memory;
+
+    module_unwind* table_for(uint64_t address);
+    bool unwind_pe(module_unwind& table, const unwind_entry& entry, thread_registers& registers);
+    bool unwind_pe_epilog(const unwind_entry& entry, thread_registers& registers);
+    bool decode_pe(uint64_t base, uint64_t unwind_address, pe_unwind_record& record);
+    bool unwind_dwarf(module_unwind& table, const unwind_entry& entry, bool exact, thread_registers& registers, bool& signal_frame);
+    bool decode_dwarf(uint64_t fde_address, dwarf_unwind_record& record);
+public:
+    stack_walker() : source(nullptr) {}
+
+    void bind(debug_event_source* event_source);
+    void unbind();
+    // The modules frames are resolved against (sorted by base, as enumerate_modules returns
+    // them). Tables of modules still loaded at the same place are kept.
+    void set_modules(const std::vector<module_range>& loaded);
+    const std::vector<module_range>& get_modules() const { return modules; }
+
+    // Fills frames with rip and then the return addresses, innermost first, until the
+    // outermost frame, a frame nothing describes, or max_frames. Returns the frame count.
+    size_t walk(const thread_registers& registers, uint64_t* frames, size_t max_frames);
+};
+#endif // !STACK_WALKER_H
@@ -0,0 +1,290 @@
+#include "step_tracer.h"
+#include <algorithm>
+#include <cstring>
+
+static const char STEP_TRACE_MAGIC[8] = { 'M', 'S', 'S', 'T', 'E', 'P', 'S', '1' };
+static const size_t TRACED_REGISTERS = 17;
+// rip delta, register mask and every register delta at their longest.
+static const size_t MAX_RECORD_SIZE = 10 + 3 + TRACED_REGISTERS * 10;
+
+static uint8_t* put_varint(uint8_t* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<uint8_t>(value) | 0x80;
+        value >>= 7;
+    }
+    *out++ = static_cast<uint8_t>(value);
+    return out;
+}
+
+static bool get_varint(const uint8_t*& cursor, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ (0 - (delta >> 63));
+}
+
+static uint64_t unzigzag(uint64_t value) {
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+static uint64_t& traced_register(thread_registers& registers, size_t index) {
+    return index < 16 ? registers.gpr[index] : registers.rflags;
+}
+
+bool step_trace_writer::open(const std::string& path, uint32_t tid, uint32_t block_count, bool with_registers) {
+    close();
+    file = fopen(path.c_str(), "wb+");
+    if (!file) {
+        return false;
+    }
+    header = step_trace_header{};
+    memcpy(header.magic, STEP_TRACE_MAGIC, sizeof(header.magic));
+    header.block_size = STEP_TRACE_BLOCK_SIZE;
+    header.block_count = (std::max)(block_count, 1u);
+    header.flags = with_registers ? STEP_TRACE_FLAG_REGISTERS : 0;
+    header.tid = tid;
+    payload.assign(STEP_TRACE_BLOCK_SIZE - sizeof(step_block_header), 0);
+    block = step_block_header{0, UINT64_MAX, 0, 0, 0};
+    previous_rip = 0;
+    previous = thread_registers{};
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool step_trace_writer::flush_block() {
+    if (!block.records) {
+        return true;
+    }
+    uint32_t slot = static_cast<uint32_t>(header.blocks_written % header.block_count);
+    block.sequence = header.blocks_written;
+    bool written = fseek(file, static_cast<long>(sizeof(header) + static_cast<uint64_t>(slot) * header.block_size), SEEK_SET) == 0 &&
+                   fwrite(&block, sizeof(block), 1, file) == 1 &&
+                   fwrite(payload.data(), 1, block.size, file) == block.size;
+    header.blocks_written++;
+    block = step_block_header{0, UINT64_MAX, 0, 0, 0};
+    previous_rip = 0;
+    previous = thread_registers{};
+    return written;
+}
+
+bool step_trace_writer::append(uint64_t rip, const thread_registers& registers) {
+    if (!file || (block.size + MAX_RECORD_SIZE > payload.size() && !flush_block())) {
+        return false;
+    }
+
+    uint8_t* start = payload.data() + block.size;
+    uint8_t* out = put_varint(start, zigzag(rip - previous_rip));
+    previous_rip = rip;
+    if (header.flags & STEP_TRACE_FLAG_REGISTERS) {
+        thread_registers current = registers;
+        uint64_t deltas[TRACED_REGISTERS];
+        size_t changed = 0;
+        uint64_t mask = 0;
+        for (size_t i = 0; i < TRACED_REGISTERS; i++) {
+            uint64_t value = traced_register(current, i);
+            uint64_t& old = traced_register(previous, i);
+            if (value != old) {
+                mask |= 1ull << i;
+                deltas[changed++] = zigzag(value - old);
+                old = value;
+            }
+        }
+        out = put_varint(out, mask);
+        for (size_t i = 0; i < changed; i++) {
+            out = put_varint(out, deltas[i]);
+        }
+    }
+
+    block.size += static_cast<uint32_t>(out - start);
+    block.records++;
+    block.low_rip = (std::min)(block.low_rip, rip);
+    block.high_rip = (std::max)(block.high_rip, rip);
+    header.steps++;
+    return true;
+}
+
+bool step_trace_writer::close() {
+    if (!file) {
+        return false;
+    }
+    bool written = flush_block() && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+    written = fclose(file) == 0 && written;
+    file = nullptr;
+    return written;
+}
+
+bool step_trace_reader::open(const std::string& path) {
+    close();
+    file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, STEP_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.block_size <= sizeof(step_block_header) || !header.block_count) {
+        close();
+        return false;
+    }
+
+    uint64_t present = (std::min)(header.blocks_written, static_cast<uint64_t>(header.block_count));
+    for (uint32_t slot = 0; slot < present; slot++) {
+        step_block_header block = {};
+        if (fseek(file, static_cast<long>(sizeof(header) + static_cast<uint64_t>(slot) * header.block_size), SEEK_SET) != 0 ||
+            fread(&block, sizeof(block), 1, file) != 1 || block.size > header.block_size - sizeof(block)) {
+            close();
+            return false;
+        }
+        blocks.push_back(std::make_pair(std::make_pair(block.sequence, slot), block));
+    }
+    std::sort(blocks.begin(), blocks.end(), [] (const decltype(blocks)::value_type& a, const decltype(blocks)::value_type& b) {
+        return a.first < b.first;
+    });
+    return true;
+}
+
+void step_trace_reader::close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    blocks.clear();
+}
+
+bool step_trace_reader::for_each_step(const std::function<void(uint64_t rip, const thread_registers& registers)>& callback,
+                                      uint64_t low, uint64_t high) {
+    if (!file) {
+        return false;
+    }
+    bool with_registers = (header.flags & STEP_TRACE_FLAG_REGISTERS) != 0;
+    std::vector<uint8_t> payload(header.block_size - sizeof(step_block_header));
+    for (const auto& entry : blocks) {
+        const step_block_header& block = entry.second;
+        if (block.high_rip < low || block.low_rip > high) {
+            continue;
+        }
+        uint64_t offset = sizeof(header) + static_cast<uint64_t>(entry.first.second) * header.block_size + sizeof(block);
+        if (fseek(file, static_cast<long>(offset), SEEK_SET) != 0 || fread(payload.data(), 1, block.size, file) != block.size) {
+            return false;
+        }
+
+        const uint8_t* cursor = payload.data();
+        const uint8_t* end = cursor + block.size;
+        uint64_t rip = 0;
+        thread_registers registers = {};
+        for (uint32_t record = 0; record < block.records; record++) {
+            uint64_t delta = 0;
+            if (!get_varint(cursor, end, delta)) {
+                return false;
+            }
+            rip += unzigzag(delta);
+            if (with_registers) {
+                uint64_t mask = 0;
+                if (!get_varint(cursor, end, mask)) {
+                    return false;
+                }
+                for (size_t i = 0; i < TRACED_REGISTERS; i++) {
+                    if (!(mask & (1ull << i))) {
+                        continue;
+                    }
+                    if (!get_varint(cursor, end, delta)) {
+                        return false;
+                    }
+                    traced_register(registers, i) += unzigzag(delta);
+                }
+                registers.rip = rip;
+            }
+            callback(rip, registers);
+        }
+    }
+    return true;
+}
+
+bool step_trace_reader::executed(address_histogram& histogram) {
+    return for_each_step([&] (uint64_t rip, const thread_registers&) {
+        histogram.add(rip);
+    });
+}
+
+void step_tracer::bind(debug_event_source* event_source) {
+    source = event_source;
+}
+
+void step_tracer::unbind() {
+    finish();
+    source = nullptr;
+}
+
+bool step_tracer::start(uint32_t thread, uint64_t step_limit, uint64_t until_address, const std::string& path, bool with_registers) {
+    finish();
+    if (!source || !writer.open(path, thread, STEP_TRACE_RING_BLOCKS, with_registers)) {
+        return false;
+    }
+    if (!source->request_step(thread)) {
+        writer.close();
+        return false;
+    }
+    tid = thread;
+    limit = step_limit;
+    until = until_address;
+    steps.store(0);
+    running.store(true);
+    return true;
+}
+
+void step_tracer::stop() {
+    finish();
+}
+
+void step_tracer::finish() {
+    if (running.exchange(false)) {
+        writer.close();
+    }
+}
+
+bool step_tracer::on_exception(const debug_event& event) {
+    if (event.tid != tid || !running.load(std::memory_order_relaxed) ||
+        (event.code != DEBUG_EXCEPTION_SINGLE_STEP && event.code != DEBUG_EXCEPTION_BREAKPOINT)) {
+        return false;
+    }
+    bool stepped = event.code == DEBUG_EXCEPTION_SINGLE_STEP;
+    thread_registers registers;
+    if (!source->get_registers(event.tid, registers)) {
+        finish();
+        return false;
+    }
+
+    // A step lands on the next instruction. A breakpoint stop only moves the thread when a
+    // manager emulated the instruction under the int3; the step before it recorded the int3.
+    if (stepped || registers.rip != event.address) {
+        if (!writer.append(registers.rip, registers)) {
+            finish();
+            return false;
+        }
+        steps.store(steps.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    if ((limit && steps.load(std::memory_order_relaxed) >= limit) || (until && registers.rip == until)) {
+        finish();
+        return stepped;
+    }
+    source->step_from(event.tid, registers.rip);
+    return stepped;
+}
+
+bool step_tracer::on_exit_thread(const debug_event& event) {
+    if (event.tid == tid) {
+        finish();
+    }
+    return false;
+}
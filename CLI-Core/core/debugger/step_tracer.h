@@ -0,0 +1,115 @@
+#ifndef STEP_TRACER_H
+#define STEP_TRACER_H
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include "debug_event_source.h"
+#include "access_tracer.h"
+
+// Step trace file: a header, then a ring of fixed-size blocks. Each block starts from zero
+// (rip and registers) so it decodes on its own; once the ring is full the oldest block is
+// overwritten. A record is the varint of the zigzagged rip delta and, in register mode, a
+// varint mask of the registers that changed (gpr order, bit 16 rflags) followed by the
+// zigzagged varint delta of each.
+const uint32_t STEP_TRACE_BLOCK_SIZE = 64 * 1024;
+const uint32_t STEP_TRACE_RING_BLOCKS = 1024;
+const uint32_t STEP_TRACE_FLAG_REGISTERS = 1;
+
+struct step_trace_header
+{
+    char magic[8];
+    uint32_t block_size;
+    uint32_t block_count;
+    uint32_t flags;
+    uint32_t tid;
+    uint64_t steps;
+    uint64_t blocks_written;
+};
+
+struct step_block_header
+{
+    uint64_t sequence;
+    uint64_t low_rip;
+    uint64_t high_rip;
+    uint32_t records;
+    uint32_t size;          // payload bytes after this header
+};
+
+class step_trace_writer
+{
+    FILE* file;
+    step_trace_header header;
+    step_block_header block;
+    std::vector<uint8_t> payload;
+    uint64_t previous_rip;
+    thread_registers previous;
+
+    bool flush_block();
+public:
+    step_trace_writer() : file(nullptr), header(), block(), previous_rip(0), previous() {}
+    ~step_trace_writer() { close(); }
+
+    bool open(const std::string& path, uint32_t tid, uint32_t block_count, bool with_registers);
+    // registers is only read in register mode.
+    bool append(uint64_t rip, const thread_registers& registers);
+    bool close();
+    bool is_open() const { return file != nullptr; }
+};
+
+// Streams a trace one block at a time, oldest first; only the block headers are kept.
+class step_trace_reader
+{
+    FILE* file;
+    step_trace_header header;
+    // (sequence, ring slot, header) of every written block.
+    std::vector<std::pair<std::pair<uint64_t, uint32_t>, step_block_header>> blocks;
+public:
+    step_trace_reader() : file(nullptr), header() {}
+    ~step_trace_reader() { close(); }
+
+    bool open(const std::string& path);
+    void close();
+    const step_trace_header& get_header() const { return header; }
+
+    // Calls back for every recorded step (registers are all zero without register mode).
+    // Blocks whose rip range misses [low, high] are not read.
+    bool for_each_step(const std::function<void(uint64_t rip, const thread_registers& registers)>& callback,
+                       uint64_t low = 0, uint64_t high = UINT64_MAX);
+    // "Which instructions executed": execution counts per address.
+    bool executed(address_histogram& histogram);
+};
+
+// Single-steps one thread through the debugger loop into a step trace file, for a number of
+// steps or until it reaches an address. Debugger thread only, apart from the counters.
+class step_tracer
+{
+    debug_event_source* source;
+    step_trace_writer writer;
+    uint32_t tid;
+    uint64_t limit;
+    uint64_t until;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> steps;
+
+    void finish();
+public:
+    step_tracer() : source(nullptr), tid(0), limit(0), until(0), running(false), steps(0) {}
+
+    void bind(debug_event_source* event_source);
+    void unbind();
+
+    // limit 0: no step limit; until 0: no stop address.
+    bool start(uint32_t thread, uint64_t step_limit, uint64_t until_address, const std::string& path, bool with_registers);
+    void stop();
+    bool is_running() const { return running.load(); }
+    uint64_t get_steps() const { return steps.load(); }
+
+    // Exception handler: true for the traced thread's single steps. Register it after the
+    // breakpoint managers so it continues from wherever they left the thread.
+    bool on_exception(const debug_event& event);
+    bool on_exit_thread(const debug_event& event);
+};
+#endif // !STEP_TRACER_H
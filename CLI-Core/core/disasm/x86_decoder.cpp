@@ -0,0 +1,345 @@
+#include "x86_decoder.h"
+#include <algorithm>
+#include <cstring>
+#include "x86_tables.h"
+
+namespace {
+    constexpr opcode_flags ONE_BYTE_FLAGS = x86_build_flags(X86_ONE_BYTE);
+    constexpr opcode_flags TWO_BYTE_FLAGS = x86_build_flags(X86_TWO_BYTE);
+    constexpr opcode_flags THREE_BYTE_38_FLAGS = x86_build_flags(X86_THREE_BYTE_38.specs);
+    constexpr opcode_flags THREE_BYTE_3A_FLAGS = x86_build_flags(X86_THREE_BYTE_3A.specs);
+
+    struct prefix_table
+    {
+        uint8_t bits[256];
+    };
+
+    constexpr prefix_table build_prefixes() {
+        prefix_table table = {};
+        table.bits[0x26] = table.bits[0x2E] = table.bits[0x36] = table.bits[0x3E] = X86_PREFIX_SEGMENT;
+        table.bits[0x64] = table.bits[0x65] = X86_PREFIX_SEGMENT;
+        table.bits[0x66] = X86_PREFIX_OPERAND;
+        table.bits[0x67] = X86_PREFIX_ADDRESS;
+        table.bits[0xF0] = X86_PREFIX_LOCK;
+        table.bits[0xF2] = X86_PREFIX_REPNE;
+        table.bits[0xF3] = X86_PREFIX_REP;
+        return table;
+    }
+
+    constexpr prefix_table PREFIXES = build_prefixes();
+
+    const uint8_t MODRM_SIB = 0x08;
+    const uint8_t MODRM_DISPLACEMENT_SHIFT = 4;
+    static_assert(X86_HAS_MODRM == 0x01 && X86_RIP_RELATIVE == 0x04, "modrm info shares their bits");
+
+    struct modrm_table
+    {
+        uint8_t info[256];
+    };
+
+    // Per modrm byte: the displacement size (before a SIB base of 5 adds one), whether a SIB
+    // follows, and X86_HAS_MODRM/X86_RIP_RELATIVE as they go into the instruction flags.
+    constexpr modrm_table build_modrm_info() {
+        modrm_table table = {};
+        for (int modrm = 0; modrm < 256; modrm++) {
+            int mod = modrm >> 6;
+            int rm = modrm & 7;
+            uint8_t info = X86_HAS_MODRM;
+            if (mod != 3) {
+                info |= (mod == 1 ? 1 : mod == 2 ? 4 : 0) << MODRM_DISPLACEMENT_SHIFT;
+                if (rm == 4) {
+                    info |= MODRM_SIB;
+                }
+                else if (mod == 0 && rm == 5) {
+                    info |= 4 << MODRM_DISPLACEMENT_SHIFT | X86_RIP_RELATIVE;
+                }
+            }
+            table.info[modrm] = info;
+        }
+        return table;
+    }
+
+    constexpr modrm_table MODRM_INFO = build_modrm_info();
+
+    // Immediate size by X86_IMM_* kind and [67][REX.W][66]; REX.W wins over 66.
+    const uint8_t IMMEDIATE_SIZES[8][8] = {
+        { 0, 0, 0, 0, 0, 0, 0, 0 },
+        { 1, 1, 1, 1, 1, 1, 1, 1 },
+        { 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 4, 2, 4, 4, 4, 2, 4, 4 },
+        { 4, 2, 8, 8, 4, 2, 8, 8 },
+        { 3, 3, 3, 3, 3, 3, 3, 3 },
+        { 4, 4, 4, 4, 4, 4, 4, 4 },
+        { 8, 8, 8, 8, 4, 4, 4, 4 },
+    };
+
+    const uint64_t IMMEDIATE_MASKS[9] = {
+        0, 0xFF, 0xFFFF, 0xFFFFFF, 0xFFFFFFFF, 0, 0, 0, ~0ull,
+    };
+
+    // VEX/EVEX/XOP pp field -> the legacy prefix it stands for.
+    const uint8_t IMPLIED_PREFIX[4] = { 0, X86_PREFIX_OPERAND, X86_PREFIX_REP, X86_PREFIX_REPNE };
+
+    static_assert(ONE_BYTE_FLAGS.flags[0xE8] == (X86_OP_RELATIVE | X86_IMM_D << 1 | X86_FLOW_CALL << 12), "call rel32");
+    static_assert(ONE_BYTE_FLAGS.flags[0xC8] == X86_IMM_WB << 1, "enter imm16, imm8");
+    static_assert(ONE_BYTE_FLAGS.flags[0xF7] == (X86_OP_MODRM | X86_IMM_Z << 1 | X86_OP_GROUP3), "group 3");
+    static_assert(TWO_BYTE_FLAGS.flags[0x84] == (X86_OP_RELATIVE | X86_IMM_D << 1 | X86_FLOW_BRANCH << 12), "jcc rel32");
+    static_assert(THREE_BYTE_3A_FLAGS.flags[0x99] == (X86_OP_MODRM | X86_IMM_B << 1), "unnamed 0F 3A");
+
+    // Opcode flags for a VEX, EVEX or XOP map. Their opcodes all take a modrm except for a few
+    // map 1 ones (vzeroupper); map 3 and XOP map 8 add an imm8, XOP map A an imm32.
+    inline bool extended_map_flags(x86_encoding encoding, uint8_t map, uint8_t opcode, uint16_t& flags) {
+        if (encoding == x86_encoding::xop) {
+            flags = map == 8 ? (X86_OP_MODRM | X86_IMM_B << 1) : map == 9 ? X86_OP_MODRM : (X86_OP_MODRM | X86_IMM_D << 1);
+            return map >= 8 && map <= 10;
+        }
+        if (map == 1) {
+            flags = TWO_BYTE_FLAGS.flags[opcode];
+            if (flags & (X86_OP_INVALID | X86_OP_ESCAPE | X86_OP_RELATIVE)) {
+                flags = X86_OP_MODRM;
+            }
+            flags &= ~X86_OP_FLOW;
+            if (encoding == x86_encoding::evex) {
+                flags |= X86_OP_MODRM;
+            }
+            return true;
+        }
+        flags = map == 3 ? (X86_OP_MODRM | X86_IMM_B << 1) : X86_OP_MODRM;
+        return map == 2 || map == 3 || (encoding == x86_encoding::evex && map >= 4 && map <= 7);
+    }
+}
+
+bool x86_decode(const uint8_t* code, size_t size, x86_instruction& instruction) {
+    const uint8_t* p = code;
+    const uint8_t* end = code + (std::min)(size, X86_MAX_LENGTH);
+    uint8_t prefixes = 0;
+    uint8_t segment = 0;
+    uint8_t rex = 0;
+    uint8_t opcode;
+    uint16_t flags;
+    for (;;) {
+        if (p == end) {
+            return false;
+        }
+        opcode = *p++;
+        flags = ONE_BYTE_FLAGS.flags[opcode];
+        if (!(flags & X86_OP_PREFIX)) {
+            break;
+        }
+        // REX only counts right before the opcode; a legacy prefix after it cancels it.
+        if ((opcode & 0xF0) == 0x40) {
+            rex = opcode;
+            continue;
+        }
+        rex = 0;
+        prefixes |= PREFIXES.bits[opcode];
+        if (PREFIXES.bits[opcode] == X86_PREFIX_SEGMENT) {
+            segment = opcode;
+        }
+    }
+
+    // Fields are written in place as they are decoded: gathering them in locals and copying
+    // them out at the end lets the compiler merge the stores into one wide store built a byte
+    // at a time, which costs more than the decoding.
+    instruction.segment = segment;
+    instruction.encoding = x86_encoding::legacy;
+    instruction.map = 0;
+    instruction.vvvv = 0;
+    instruction.vector_length = 0;
+    instruction.mask = 0;
+    if (flags & X86_OP_ESCAPE) {
+        if (p == end) {
+            return false;
+        }
+        if (opcode == 0x0F) {
+            opcode = *p++;
+            instruction.map = 1;
+            if (opcode == 0x38 || opcode == 0x3A) {
+                if (p == end) {
+                    return false;
+                }
+                instruction.map = opcode == 0x38 ? 2 : 3;
+                flags = (opcode == 0x38 ? THREE_BYTE_38_FLAGS : THREE_BYTE_3A_FLAGS).flags[*p];
+                opcode = *p++;
+            }
+            else if (opcode == 0x0F) {
+                // 3DNow!: modrm, then the real opcode as an imm8.
+                flags = X86_OP_MODRM | X86_IMM_B << 1;
+            }
+            else {
+                flags = TWO_BYTE_FLAGS.flags[opcode];
+            }
+        }
+        else if (opcode == 0x8F && (*p & 0x1F) < 8) {
+            // pop r/m64; XOP uses the map numbers from 8 up.
+            flags = X86_OP_MODRM;
+        }
+        else {
+            // VEX, EVEX and XOP exclude REX and the prefixes their pp field replaces.
+            if (rex || (prefixes & (X86_PREFIX_LOCK | X86_PREFIX_REP | X86_PREFIX_REPNE | X86_PREFIX_OPERAND))) {
+                return false;
+            }
+            uint8_t pp;
+            uint8_t map;
+            x86_encoding encoding;
+            if (opcode == 0xC5) {
+                if (end - p < 2) {
+                    return false;
+                }
+                uint8_t b1 = p[0];
+                encoding = x86_encoding::vex;
+                rex = X86_REX | ((~b1 >> 5) & X86_REX_R);
+                instruction.vvvv = (~b1 >> 3) & 0x0F;
+                instruction.vector_length = (b1 >> 2) & 1;
+                pp = b1 & 3;
+                map = 1;
+                opcode = p[1];
+                p += 2;
+            }
+            else if (opcode == 0x62) {
+                if (end - p < 4) {
+                    return false;
+                }
+                uint8_t b1 = p[0], b2 = p[1], b3 = p[2];
+                if (!(b2 & 0x04)) {
+                    return false;
+                }
+                encoding = x86_encoding::evex;
+                rex = X86_REX | ((~b1 >> 5) & (X86_REX_R | X86_REX_X | X86_REX_B)) | ((b2 >> 4) & X86_REX_W) | (~b1 & X86_EVEX_R4);
+                instruction.vvvv = ((~b2 >> 3) & 0x0F) | ((~b3 & 0x08) << 1);
+                instruction.vector_length = (b3 >> 5) & 3;
+                instruction.mask = b3 & 7;
+                pp = b2 & 3;
+                map = b1 & 7;
+                opcode = p[3];
+                p += 4;
+            }
+            else {
+                if (end - p < 3) {
+                    return false;
+                }
+                uint8_t b1 = p[0], b2 = p[1];
+                encoding = opcode == 0xC4 ? x86_encoding::vex : x86_encoding::xop;
+                rex = X86_REX | ((~b1 >> 5) & (X86_REX_R | X86_REX_X | X86_REX_B)) | ((b2 >> 4) & X86_REX_W);
+                instruction.vvvv = (~b2 >> 3) & 0x0F;
+                instruction.vector_length = (b2 >> 2) & 1;
+                pp = b2 & 3;
+                map = b1 & 0x1F;
+                opcode = p[2];
+                p += 3;
+            }
+            prefixes |= IMPLIED_PREFIX[pp];
+            instruction.encoding = encoding;
+            instruction.map = map;
+            if (!extended_map_flags(encoding, map, opcode, flags)) {
+                return false;
+            }
+        }
+    }
+    if (flags & X86_OP_INVALID) {
+        return false;
+    }
+    instruction.prefixes = prefixes;
+    instruction.rex = rex;
+    instruction.opcode = opcode;
+
+    uint8_t instruction_flags = 0;
+    uint8_t modrm = 0;
+    uint8_t displacement_size = 0;
+    instruction.sib = 0;
+    if (flags & X86_OP_MODRM) {
+        if (p == end) {
+            return false;
+        }
+        modrm = *p++;
+        uint8_t info = MODRM_INFO.info[(flags & X86_OP_REGISTER) ? (modrm | 0xC0) : modrm];
+        displacement_size = info >> MODRM_DISPLACEMENT_SHIFT;
+        instruction_flags = info & (X86_HAS_MODRM | X86_RIP_RELATIVE);
+        if (info & MODRM_SIB) {
+            if (p == end) {
+                return false;
+            }
+            uint8_t sib = *p++;
+            instruction.sib = sib;
+            instruction_flags |= X86_HAS_SIB;
+            if (modrm < 0x40 && (sib & 7) == 5) {
+                displacement_size = 4;
+            }
+        }
+        // test is the only group 3 member with an immediate.
+        if ((flags & X86_OP_GROUP3) && (modrm & 0x30)) {
+            flags &= ~X86_OP_IMMEDIATE;
+        }
+    }
+    instruction.modrm = modrm;
+
+    // Displacement and immediate are read with one fixed-size load and narrowed, rather than
+    // branching on their size; only the last bytes of a buffer take the byte-wise path.
+    if (end - p < displacement_size) {
+        return false;
+    }
+    int32_t displacement = 0;
+    if (displacement_size) {
+        int32_t raw;
+        if (end - p >= 4) {
+            memcpy(&raw, p, 4);
+        }
+        else {
+            raw = static_cast<int8_t>(*p);
+        }
+        displacement = displacement_size == 1 ? static_cast<int8_t>(raw) : raw;
+        p += displacement_size;
+    }
+    instruction.displacement = displacement;
+    instruction.displacement_size = displacement_size;
+
+    uint8_t operand_size = ((rex & X86_REX_W) ? 2 : 0) | ((prefixes & X86_PREFIX_OPERAND) ? 1 : 0);
+    uint8_t address_size = (prefixes & X86_PREFIX_ADDRESS) ? 1 : 0;
+    uint8_t immediate_size = IMMEDIATE_SIZES[(flags & X86_OP_IMMEDIATE) >> 1][operand_size | address_size << 2];
+    if (end - p < immediate_size) {
+        return false;
+    }
+    uint64_t immediate;
+    if (end - p >= 8) {
+        memcpy(&immediate, p, 8);
+        immediate &= IMMEDIATE_MASKS[immediate_size];
+    }
+    else {
+        immediate = 0;
+        for (uint8_t i = 0; i < immediate_size; i++) {
+            immediate |= static_cast<uint64_t>(p[i]) << (i * 8);
+        }
+    }
+    p += immediate_size;
+    instruction.immediate = immediate;
+    instruction.immediate_size = immediate_size;
+
+    x86_flow flow = static_cast<x86_flow>((flags & X86_OP_FLOW) >> 12);
+    if (flags & X86_OP_RELATIVE) {
+        instruction_flags |= X86_RELATIVE;
+    }
+    else if (opcode == 0xFF && instruction.map == 0) {
+        uint8_t reg = (modrm >> 3) & 7;
+        flow = reg == 2 || reg == 3 ? x86_flow::call_indirect : reg == 4 || reg == 5 ? x86_flow::jump_indirect : x86_flow::none;
+    }
+    instruction.flow = flow;
+    instruction.flags = instruction_flags;
+    instruction.length = static_cast<uint8_t>(p - code);
+    return true;
+}
+
+bool x86_target(const x86_instruction& instruction, uint64_t address, uint64_t& target) {
+    uint64_t next = address + instruction.length;
+    if (instruction.flags & X86_RELATIVE) {
+        int64_t offset = instruction.immediate_size == 1 ? static_cast<int8_t>(instruction.immediate)
+                       : instruction.immediate_size == 2 ? static_cast<int16_t>(instruction.immediate)
+                       : static_cast<int32_t>(instruction.immediate);
+        target = next + offset;
+        return true;
+    }
+    if (instruction.flags & X86_RIP_RELATIVE) {
+        target = next + static_cast<int64_t>(instruction.displacement);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,89 @@
+#ifndef X86_DECODER_H
+#define X86_DECODER_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+const size_t X86_MAX_LENGTH = 15;
+const size_t X86_MAX_TEXT = 128;
+
+// Legacy prefixes seen; VEX, EVEX and XOP set the 66/F3/F2 bits their pp field implies.
+const uint8_t X86_PREFIX_LOCK = 0x01;
+const uint8_t X86_PREFIX_REP = 0x02;          // F3
+const uint8_t X86_PREFIX_REPNE = 0x04;        // F2
+const uint8_t X86_PREFIX_OPERAND = 0x08;      // 66
+const uint8_t X86_PREFIX_ADDRESS = 0x10;      // 67
+const uint8_t X86_PREFIX_SEGMENT = 0x20;
+
+const uint8_t X86_HAS_MODRM = 0x01;
+const uint8_t X86_HAS_SIB = 0x02;
+const uint8_t X86_RIP_RELATIVE = 0x04;        // modrm memory operand is [rip + displacement]
+const uint8_t X86_RELATIVE = 0x08;            // immediate is a branch displacement
+
+const uint8_t X86_REX = 0x40;
+const uint8_t X86_REX_W = 0x08;
+const uint8_t X86_REX_R = 0x04;
+const uint8_t X86_REX_X = 0x02;
+const uint8_t X86_REX_B = 0x01;
+const uint8_t X86_EVEX_R4 = 0x10;             // EVEX R': bit 4 of a vector modrm.reg
+
+enum class x86_encoding : uint8_t
+{
+    legacy,
+    vex,
+    evex,
+    xop,
+};
+
+enum class x86_flow : uint8_t
+{
+    none,
+    call,
+    jump,
+    branch,             // conditional, loop and jrcxz
+    ret,
+    call_indirect,
+    jump_indirect,
+};
+
+// One decoded instruction; everything but the operand text, which x86_format builds from it.
+struct x86_instruction
+{
+    uint8_t length;
+    uint8_t flags;
+    uint8_t prefixes;
+    uint8_t segment;            // last segment override byte, 0 without one
+    uint8_t rex;                // REX byte, 0 without one; VEX, EVEX and XOP fold their W, R, X and B in
+    x86_encoding encoding;
+    uint8_t map;                // 0 one-byte, 1 0F, 2 0F 38, 3 0F 3A; VEX, EVEX and XOP give theirs
+    uint8_t opcode;
+    uint8_t modrm;
+    uint8_t sib;
+    uint8_t vvvv;               // VEX, EVEX and XOP extra register, already inverted
+    uint8_t vector_length;      // 0 128, 1 256, 2 512 bits
+    uint8_t mask;               // EVEX opmask register
+    uint8_t displacement_size;
+    uint8_t immediate_size;
+    x86_flow flow;
+    int32_t displacement;
+    uint64_t immediate;         // zero-extended; enter keeps imm16 in bits 0-15 and imm8 in 16-23
+};
+
+// Decodes the 64-bit mode instruction at code[0..size). False when the bytes are not a valid
+// instruction or it runs past size; nothing is allocated and no state is kept between calls.
+bool x86_decode(const uint8_t* code, size_t size, x86_instruction& instruction);
+
+// Where a relative branch goes or a rip-relative operand points, for the instruction decoded
+// at address; false when it has neither.
+bool x86_target(const x86_instruction& instruction, uint64_t address, uint64_t& target);
+
+// Intel syntax, e.g. "mov rax, qword ptr [rip+0x1F2A]"; branch targets as absolute addresses.
+// Returns the text length.
+size_t x86_format(const x86_instruction& instruction, uint64_t address, char* buffer, size_t size);
+
+// Walks code the way repeated x86_decode calls would, from begin over the instructions that
+// start before end, stepping one byte past anything that does not decode; bytes up to size may
+// be read. Counts the instructions and appends the offset of each one x86_target gives a target
+// for. Returns where the walk stopped, the first instruction start at or past end.
+size_t x86_sweep(const uint8_t* code, size_t size, size_t begin, size_t end, std::vector<uint32_t>& references, uint64_t& instructions);
+#endif // !X86_DECODER_H
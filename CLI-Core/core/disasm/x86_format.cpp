@@ -0,0 +1,720 @@
+#include "x86_decoder.h"
+#include <cstdlib>
+#include <cstring>
+#include "x86_tables.h"
+
+namespace {
+    const char* const REGISTERS_64[16] = { "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15" };
+    const char* const REGISTERS_32[16] = { "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d" };
+    const char* const REGISTERS_16[16] = { "ax", "cx", "dx", "bx", "sp", "bp", "si", "di", "r8w", "r9w", "r10w", "r11w", "r12w", "r13w", "r14w", "r15w" };
+    const char* const REGISTERS_8[16] = { "al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b" };
+    // Registers 4-7 of an 8-bit operand without any REX prefix.
+    const char* const REGISTERS_8_HIGH[4] = { "ah", "ch", "dh", "bh" };
+    const char* const SEGMENTS[8] = { "es", "cs", "ss", "ds", "fs", "gs", "?", "?" };
+
+    const char* const GROUP_1[8] = { "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp" };
+    const char* const GROUP_2[8] = { "rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar" };
+    const char* const GROUP_3[8] = { "test", "test", "not", "neg", "mul", "imul", "div", "idiv" };
+    const char* const GROUP_4[8] = { "inc", "dec", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    const char* const GROUP_5[8] = { "inc", "dec", "call", "call", "jmp", "jmp", "push", nullptr };
+    const char* const GROUP_6[8] = { "sldt", "str", "lldt", "ltr", "verr", "verw", nullptr, nullptr };
+    const char* const GROUP_7[8] = { "sgdt", "sidt", "lgdt", "lidt", "smsw", nullptr, "lmsw", "invlpg" };
+    const char* const GROUP_8[8] = { nullptr, nullptr, nullptr, nullptr, "bt", "bts", "btr", "btc" };
+    const char* const GROUP_9[8] = { nullptr, "cmpxchg8b", nullptr, "xrstors", "xsavec", "xsaves", "vmptrld", "vmptrst" };
+    const char* const GROUP_12[8] = { nullptr, nullptr, "psrlw", nullptr, "psraw", nullptr, "psllw", nullptr };
+    const char* const GROUP_13[8] = { nullptr, nullptr, "psrld", nullptr, "psrad", nullptr, "pslld", nullptr };
+    const char* const GROUP_14[8] = { nullptr, nullptr, "psrlq", "psrldq", nullptr, nullptr, "psllq", "pslldq" };
+    const char* const GROUP_15[8] = { "fxsave", "fxrstor", "ldmxcsr", "stmxcsr", "xsave", "xrstor", "xsaveopt", "clflush" };
+    const char* const GROUP_16[8] = { "prefetchnta", "prefetcht0", "prefetcht1", "prefetcht2", "nop", "nop", "nop", "nop" };
+    const char* const GROUP_17[8] = { nullptr, "blsr", "blsmsk", "blsi", nullptr, nullptr, nullptr, nullptr };
+    const char* const* const GROUPS[18] = {
+        nullptr, GROUP_1, GROUP_2, GROUP_3, GROUP_4, GROUP_5, GROUP_6, GROUP_7, GROUP_8, GROUP_9,
+        nullptr, nullptr, GROUP_12, GROUP_13, GROUP_14, GROUP_15, GROUP_16, GROUP_17,
+    };
+
+    struct fixed_form
+    {
+        uint8_t opcode;
+        uint8_t modrm;
+        const char* text;
+    };
+
+    // 0F 01 and x87 encodings that take their whole modrm as part of the opcode.
+    const fixed_form FIXED_0F01[] = {
+        { 0x01, 0xC1, "vmcall" }, { 0x01, 0xC2, "vmlaunch" }, { 0x01, 0xC3, "vmresume" }, { 0x01, 0xC4, "vmxoff" },
+        { 0x01, 0xC8, "monitor" }, { 0x01, 0xC9, "mwait" }, { 0x01, 0xCA, "clac" }, { 0x01, 0xCB, "stac" },
+        { 0x01, 0xD0, "xgetbv" }, { 0x01, 0xD1, "xsetbv" }, { 0x01, 0xD5, "xend" }, { 0x01, 0xD6, "xtest" },
+        { 0x01, 0xEE, "rdpkru" }, { 0x01, 0xEF, "wrpkru" }, { 0x01, 0xF8, "swapgs" }, { 0x01, 0xF9, "rdtscp" },
+        { 0x01, 0xFA, "monitorx" }, { 0x01, 0xFB, "mwaitx" }, { 0x01, 0xFC, "clzero" },
+    };
+    const fixed_form FIXED_X87[] = {
+        { 0xD9, 0xD0, "fnop" }, { 0xDA, 0xE9, "fucompp" }, { 0xDB, 0xE2, "fnclex" }, { 0xDB, 0xE3, "fninit" },
+        { 0xDE, 0xD9, "fcompp" }, { 0xDF, 0xE0, "fnstsw ax" },
+    };
+    // D9 E0 to D9 FF.
+    const char* const X87_D9_CONSTANTS[32] = {
+        "fchs", "fabs", nullptr, nullptr, "ftst", "fxam", nullptr, nullptr,
+        "fld1", "fldl2t", "fldl2e", "fldpi", "fldlg2", "fldln2", "fldz", nullptr,
+        "f2xm1", "fyl2x", "fptan", "fpatan", "fxtract", "fprem1", "fdecstp", "fincstp",
+        "fprem", "fyl2xp1", "fsqrt", "fsincos", "frndint", "fscale", "fsin", "fcos",
+    };
+    const char* const X87_MEMORY[8][8] = {
+        { "fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr" },
+        { "fld", nullptr, "fst", "fstp", "fldenv", "fldcw", "fnstenv", "fnstcw" },
+        { "fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr" },
+        { "fild", "fisttp", "fist", "fistp", nullptr, "fld", nullptr, "fstp" },
+        { "fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr" },
+        { "fld", "fisttp", "fst", "fstp", "frstor", nullptr, "fnsave", "fnstsw" },
+        { "fiadd", "fimul", "ficom", "ficomp", "fisub", "fisubr", "fidiv", "fidivr" },
+        { "fild", "fisttp", "fist", "fistp", "fbld", "fild", "fbstp", "fistp" },
+    };
+    const uint8_t X87_MEMORY_SIZE[8][8] = {
+        { 4, 4, 4, 4, 4, 4, 4, 4 },
+        { 4, 0, 4, 4, 0, 2, 0, 2 },
+        { 4, 4, 4, 4, 4, 4, 4, 4 },
+        { 4, 4, 4, 4, 0, 10, 0, 10 },
+        { 8, 8, 8, 8, 8, 8, 8, 8 },
+        { 8, 8, 8, 8, 0, 0, 0, 2 },
+        { 2, 2, 2, 2, 2, 2, 2, 2 },
+        { 2, 2, 2, 2, 10, 8, 10, 8 },
+    };
+    const char* const X87_REGISTER[8][8] = {
+        { "fadd", "fmul", "fcom", "fcomp", "fsub", "fsubr", "fdiv", "fdivr" },
+        { "fld", "fxch", nullptr, nullptr, nullptr, nullptr, nullptr, nullptr },
+        { "fcmovb", "fcmove", "fcmovbe", "fcmovu", nullptr, nullptr, nullptr, nullptr },
+        { "fcmovnb", "fcmovne", "fcmovnbe", "fcmovnu", nullptr, "fucomi", "fcomi", nullptr },
+        { "fadd", "fmul", "fcom", "fcomp", "fsubr", "fsub", "fdivr", "fdiv" },
+        { "ffree", nullptr, "fst", "fstp", "fucom", "fucomp", nullptr, nullptr },
+        { "faddp", "fmulp", nullptr, nullptr, "fsubrp", "fsubp", "fdivrp", "fdivp" },
+        { nullptr, nullptr, nullptr, nullptr, nullptr, "fucomip", "fcomip", nullptr },
+    };
+    // Register form operands per escape byte: st(i) only, "st, st(i)" or "st(i), st".
+    enum class x87_form : uint8_t { single, to_top, from_top };
+    const x87_form X87_REGISTER_FORM[8] = {
+        x87_form::to_top, x87_form::single, x87_form::to_top, x87_form::to_top,
+        x87_form::from_top, x87_form::single, x87_form::from_top, x87_form::to_top,
+    };
+
+    class text_writer
+    {
+        char* buffer;
+        size_t size;
+        size_t length;
+    public:
+        text_writer(char* out, size_t out_size) : buffer(out), size(out_size), length(0) {
+            if (size) {
+                buffer[0] = 0;
+            }
+        }
+
+        void put(char c) {
+            if (length + 1 < size) {
+                buffer[length++] = c;
+                buffer[length] = 0;
+            }
+        }
+
+        void put(const char* text) {
+            while (*text) {
+                put(*text++);
+            }
+        }
+
+        void put_hex(uint64_t value) {
+            char digits[16];
+            size_t count = 0;
+            do {
+                digits[count++] = "0123456789ABCDEF"[value & 0xF];
+                value >>= 4;
+            } while (value);
+            put("0x");
+            while (count) {
+                put(digits[--count]);
+            }
+        }
+
+        void put_signed(int64_t value) {
+            if (value < 0) {
+                put('-');
+                put_hex(0 - static_cast<uint64_t>(value));
+            }
+            else {
+                put_hex(static_cast<uint64_t>(value));
+            }
+        }
+
+        void put_unsigned(unsigned value) {
+            if (value >= 10) {
+                put_unsigned(value / 10);
+            }
+            put(static_cast<char>('0' + value % 10));
+        }
+
+        size_t get_length() const { return length; }
+    };
+
+    unsigned operand_size(const x86_instruction& instruction) {
+        return (instruction.rex & X86_REX_W) ? 8 : (instruction.prefixes & X86_PREFIX_OPERAND) ? 2 : 4;
+    }
+
+    unsigned size_of(char size, const x86_instruction& instruction) {
+        switch (size) {
+        case 'b': return 1;
+        case 'w': return 2;
+        case 'd': return 4;
+        case 'q': return 8;
+        case 'o': return 16;
+        case 'v': return operand_size(instruction);
+        case 'y': return (instruction.rex & X86_REX_W) ? 8 : 4;
+        case 'z': return (instruction.prefixes & X86_PREFIX_OPERAND) ? 2 : 4;
+        case 'x': return 16u << instruction.vector_length;
+        case 't': return 10;
+        case 'f': return (instruction.rex & X86_REX_W) ? 10 : (instruction.prefixes & X86_PREFIX_OPERAND) ? 4 : 6;
+        default: return 0;
+        }
+    }
+
+    const char* size_name(unsigned size) {
+        switch (size) {
+        case 1: return "byte";
+        case 2: return "word";
+        case 4: return "dword";
+        case 6: return "fword";
+        case 8: return "qword";
+        case 10: return "tbyte";
+        case 16: return "xmmword";
+        case 32: return "ymmword";
+        case 64: return "zmmword";
+        default: return nullptr;
+        }
+    }
+
+    const char* general_register(unsigned index, unsigned size, const x86_instruction& instruction) {
+        switch (size) {
+        case 1: return !instruction.rex && index >= 4 && index < 8 ? REGISTERS_8_HIGH[index - 4] : REGISTERS_8[index];
+        case 2: return REGISTERS_16[index];
+        case 4: return REGISTERS_32[index];
+        default: return REGISTERS_64[index];
+        }
+    }
+
+    void put_vector_register(text_writer& out, unsigned index, const x86_instruction& instruction) {
+        out.put(instruction.vector_length == 2 ? "zmm" : instruction.vector_length == 1 ? "ymm" : "xmm");
+        out.put_unsigned(index);
+    }
+
+    unsigned reg_field(const x86_instruction& instruction) {
+        return ((instruction.modrm >> 3) & 7) | ((instruction.rex & X86_REX_R) ? 8 : 0);
+    }
+
+    unsigned rm_field(const x86_instruction& instruction) {
+        return (instruction.modrm & 7) | ((instruction.rex & X86_REX_B) ? 8 : 0);
+    }
+
+    // EVEX reaches registers 16-31: R' on the reg side, X on the r/m side of a register form.
+    unsigned vector_reg_field(const x86_instruction& instruction) {
+        return reg_field(instruction) | ((instruction.rex & X86_EVEX_R4) ? 16 : 0);
+    }
+
+    unsigned vector_rm_field(const x86_instruction& instruction) {
+        bool high = instruction.encoding == x86_encoding::evex && (instruction.rex & X86_REX_X);
+        return rm_field(instruction) | (high ? 16 : 0);
+    }
+
+    bool is_register_form(const x86_instruction& instruction) {
+        return (instruction.modrm >> 6) == 3;
+    }
+
+    void put_memory(text_writer& out, const x86_instruction& instruction, unsigned size) {
+        const char* name = size_name(size);
+        if (name) {
+            out.put(name);
+            out.put(" ptr ");
+        }
+        if (instruction.segment == 0x64 || instruction.segment == 0x65) {
+            out.put(instruction.segment == 0x64 ? "fs:" : "gs:");
+        }
+        out.put('[');
+        const char* const* registers = (instruction.prefixes & X86_PREFIX_ADDRESS) ? REGISTERS_32 : REGISTERS_64;
+        bool any = false;
+        if (instruction.flags & X86_RIP_RELATIVE) {
+            out.put((instruction.prefixes & X86_PREFIX_ADDRESS) ? "eip" : "rip");
+            any = true;
+        }
+        else if (instruction.flags & X86_HAS_SIB) {
+            unsigned base = instruction.sib & 7;
+            unsigned index = ((instruction.sib >> 3) & 7) | ((instruction.rex & X86_REX_X) ? 8 : 0);
+            if (!((instruction.modrm >> 6) == 0 && base == 5)) {
+                out.put(registers[base | ((instruction.rex & X86_REX_B) ? 8 : 0)]);
+                any = true;
+            }
+            if (index != 4) {
+                if (any) {
+                    out.put('+');
+                }
+                out.put(registers[index]);
+                out.put('*');
+                out.put(static_cast<char>('0' + (1 << (instruction.sib >> 6))));
+                any = true;
+            }
+        }
+        else {
+            out.put(registers[rm_field(instruction)]);
+            any = true;
+        }
+        // EVEX scales an 8-bit displacement by the access size (disp8*N); taken here as the
+        // operand's size, which is right for full-vector and scalar forms.
+        int64_t displacement = instruction.displacement;
+        if (instruction.encoding == x86_encoding::evex && instruction.displacement_size == 1 && size) {
+            displacement *= size;
+        }
+        if (!any) {
+            out.put_hex(static_cast<uint64_t>(displacement));
+        }
+        else if (displacement) {
+            if (displacement > 0) {
+                out.put('+');
+            }
+            out.put_signed(displacement);
+        }
+        out.put(']');
+    }
+
+    // Memory size of an SSE scalar operation's W operand: the source type ("ss" or "sd") sits
+    // before the '2' of a conversion and at the end of anything else.
+    unsigned scalar_size(const char* mnemonic) {
+        size_t length = strlen(mnemonic);
+        const char* two = strchr(mnemonic, '2');
+        const char* type = two ? two - 2 : mnemonic + length - 2;
+        if (type < mnemonic || type[0] != 's') {
+            return 0;
+        }
+        return type[1] == 's' ? 4 : type[1] == 'd' ? 8 : 0;
+    }
+
+    struct operand_context
+    {
+        const x86_instruction& instruction;
+        uint64_t address;
+        const char* mnemonic;
+        bool mmx_as_xmm;
+        unsigned immediate_index;
+    };
+
+    void put_operand(text_writer& out, operand_context& context, const char* token, size_t length) {
+        const x86_instruction& instruction = context.instruction;
+        char kind = token[0];
+        char size = length > 1 ? token[1] : 0;
+        if (kind >= 'a' && kind <= 'z') {
+            if (length == 3 && !strncmp(token, "rAX", 3)) {
+                out.put(general_register(0, operand_size(instruction), instruction));
+            }
+            else if (length == 3 && !strncmp(token, "eAX", 3)) {
+                out.put((instruction.prefixes & X86_PREFIX_OPERAND) ? "ax" : "eax");
+            }
+            else {
+                for (size_t i = 0; i < length; i++) {
+                    out.put(token[i]);
+                }
+            }
+            return;
+        }
+        if (kind == '1') {
+            out.put('1');
+            return;
+        }
+
+        bool register_form = is_register_form(instruction);
+        switch (kind) {
+        case 'G':
+            out.put(general_register(reg_field(instruction), size_of(size, instruction), instruction));
+            return;
+        case 'V':
+            put_vector_register(out, vector_reg_field(instruction), instruction);
+            return;
+        case 'H':
+            put_vector_register(out, instruction.vvvv, instruction);
+            return;
+        case 'B':
+            out.put(general_register(instruction.vvvv & 0x0F, size_of(size, instruction), instruction));
+            return;
+        case 'P':
+            if (context.mmx_as_xmm) {
+                put_vector_register(out, vector_reg_field(instruction), instruction);
+            }
+            else {
+                out.put("mm");
+                out.put_unsigned((instruction.modrm >> 3) & 7);
+            }
+            return;
+        case 'S':
+            out.put(SEGMENTS[(instruction.modrm >> 3) & 7]);
+            return;
+        case 'C':
+        case 'D':
+            out.put(kind == 'C' ? "cr" : "dr");
+            out.put_unsigned(reg_field(instruction));
+            return;
+        case 'Z':
+            out.put(general_register((instruction.opcode & 7) | ((instruction.rex & X86_REX_B) ? 8 : 0), size_of(size, instruction), instruction));
+            return;
+        case 'E':
+        case 'R':
+        case 'M':
+            if (register_form) {
+                out.put(general_register(rm_field(instruction), size_of(size ? size : 'v', instruction), instruction));
+            }
+            else {
+                put_memory(out, instruction, size_of(size, instruction));
+            }
+            return;
+        case 'W':
+        case 'U':
+            if (register_form) {
+                put_vector_register(out, vector_rm_field(instruction), instruction);
+            }
+            else {
+                unsigned memory_size = size_of(size, instruction);
+                if (size == 'x' && instruction.map == 1 && (instruction.prefixes & (X86_PREFIX_REP | X86_PREFIX_REPNE | X86_PREFIX_OPERAND))) {
+                    unsigned scalar = scalar_size(context.mnemonic);
+                    memory_size = scalar ? scalar : memory_size;
+                }
+                put_memory(out, instruction, memory_size);
+            }
+            return;
+        case 'Q':
+        case 'N':
+            if (!register_form) {
+                put_memory(out, instruction, context.mmx_as_xmm ? size_of('x', instruction) : 8);
+            }
+            else if (context.mmx_as_xmm) {
+                put_vector_register(out, vector_rm_field(instruction), instruction);
+            }
+            else {
+                out.put("mm");
+                out.put_unsigned(instruction.modrm & 7);
+            }
+            return;
+        case 'I': {
+            uint64_t immediate = instruction.immediate;
+            if (instruction.immediate_size == 3) {
+                immediate = context.immediate_index++ ? (immediate >> 16) & 0xFF : immediate & 0xFFFF;
+            }
+            if (size == 'b' && length > 2) {
+                out.put_signed(static_cast<int8_t>(immediate));
+            }
+            else if (instruction.immediate_size == 4 && operand_size(instruction) == 8) {
+                out.put_signed(static_cast<int32_t>(immediate));
+            }
+            else {
+                out.put_hex(immediate);
+            }
+            return;
+        }
+        case 'J': {
+            uint64_t target = 0;
+            x86_target(instruction, context.address, target);
+            out.put_hex(target);
+            return;
+        }
+        case 'O': {
+            const char* name = size_name(size_of(size, instruction));
+            out.put(name);
+            out.put(" ptr ");
+            if (instruction.segment == 0x64 || instruction.segment == 0x65) {
+                out.put(instruction.segment == 0x64 ? "fs:" : "gs:");
+            }
+            out.put('[');
+            out.put_hex(instruction.immediate);
+            out.put(']');
+            return;
+        }
+        default:
+            out.put('?');
+            return;
+        }
+    }
+
+    // Copies the index-th of the separator-split alternatives in text. False when it is empty.
+    bool pick(const char* text, char separator, unsigned index, char* name, size_t size) {
+        while (index && *text) {
+            if (*text++ == separator) {
+                index--;
+            }
+        }
+        size_t length = 0;
+        while (text[length] && text[length] != separator && length + 1 < size) {
+            name[length] = text[length];
+            length++;
+        }
+        name[length] = 0;
+        return length != 0;
+    }
+
+    void put_x87(text_writer& out, const x86_instruction& instruction) {
+        unsigned escape = instruction.opcode & 7;
+        unsigned reg = (instruction.modrm >> 3) & 7;
+        if (!is_register_form(instruction)) {
+            const char* name = X87_MEMORY[escape][reg];
+            if (!name) {
+                out.put("(bad)");
+                return;
+            }
+            out.put(name);
+            out.put(' ');
+            put_memory(out, instruction, X87_MEMORY_SIZE[escape][reg]);
+            return;
+        }
+        for (const fixed_form& form : FIXED_X87) {
+            if (form.opcode == instruction.opcode && form.modrm == instruction.modrm) {
+                out.put(form.text);
+                return;
+            }
+        }
+        if (instruction.opcode == 0xD9 && instruction.modrm >= 0xE0) {
+            const char* name = X87_D9_CONSTANTS[instruction.modrm - 0xE0];
+            out.put(name ? name : "(bad)");
+            return;
+        }
+        const char* name = X87_REGISTER[escape][reg];
+        if (!name) {
+            out.put("(bad)");
+            return;
+        }
+        unsigned index = instruction.modrm & 7;
+        out.put(name);
+        switch (X87_REGISTER_FORM[escape]) {
+        case x87_form::single:
+            out.put(" st(");
+            break;
+        case x87_form::to_top:
+            out.put(" st, st(");
+            break;
+        case x87_form::from_top:
+            out.put(" st(");
+            break;
+        }
+        out.put_unsigned(index);
+        out.put(X87_REGISTER_FORM[escape] == x87_form::from_top ? "), st" : ")");
+    }
+
+    const opcode_spec* spec_for(const x86_instruction& instruction) {
+        if (instruction.encoding == x86_encoding::xop || instruction.map > 3) {
+            return nullptr;
+        }
+        switch (instruction.map) {
+        case 0: return &X86_ONE_BYTE[instruction.opcode];
+        case 1: return &X86_TWO_BYTE[instruction.opcode];
+        case 2: return &X86_THREE_BYTE_38.specs[instruction.opcode];
+        default: return &X86_THREE_BYTE_3A.specs[instruction.opcode];
+        }
+    }
+
+    void put_opcode_number(text_writer& out, const x86_instruction& instruction) {
+        static const char* const MAPS[4] = { "", "0F ", "0F 38 ", "0F 3A " };
+        out.put('(');
+        if (instruction.encoding == x86_encoding::xop) {
+            out.put("xop ");
+        }
+        else if (instruction.encoding == x86_encoding::vex) {
+            out.put("vex ");
+        }
+        else if (instruction.encoding == x86_encoding::evex) {
+            out.put("evex ");
+        }
+        if (instruction.map < 4) {
+            out.put(MAPS[instruction.map]);
+        }
+        else {
+            out.put("map");
+            out.put_unsigned(instruction.map);
+            out.put(' ');
+        }
+        out.put_hex(instruction.opcode);
+        out.put(')');
+    }
+}
+
+size_t x86_format(const x86_instruction& instruction, uint64_t address, char* buffer, size_t size) {
+    text_writer out(buffer, size);
+    if (instruction.prefixes & X86_PREFIX_LOCK) {
+        out.put("lock ");
+    }
+    if (instruction.encoding == x86_encoding::legacy && instruction.map == 0 && instruction.opcode >= 0xD8 && instruction.opcode <= 0xDF) {
+        put_x87(out, instruction);
+        return out.get_length();
+    }
+    const opcode_spec* spec = spec_for(instruction);
+    if (!spec || !spec->mnemonic) {
+        put_opcode_number(out, instruction);
+        return out.get_length();
+    }
+
+    // Mandatory prefixes pick the mnemonic; anywhere else F3 and F2 are rep prefixes.
+    bool mandatory = strchr(spec->mnemonic, '|') != nullptr;
+    unsigned variant = (instruction.prefixes & X86_PREFIX_REPNE) ? 3 : (instruction.prefixes & X86_PREFIX_REP) ? 2
+                     : (instruction.prefixes & X86_PREFIX_OPERAND) ? 1 : 0;
+    char name[32];
+    bool named = pick(spec->mnemonic, '|', mandatory ? variant : 0, name, sizeof(name));
+    if (named && strchr(name, '/')) {
+        unsigned operand = operand_size(instruction);
+        pick(name, '/', operand == 2 ? 0 : operand == 4 ? 1 : 2, name, sizeof(name));
+    }
+    char variant_operands[32];
+    const char* operands = spec->operands;
+    if (strchr(operands, '|')) {
+        pick(operands, '|', variant, variant_operands, sizeof(variant_operands));
+        operands = variant_operands;
+    }
+    const char* const* group = nullptr;
+    unsigned reg = (instruction.modrm >> 3) & 7;
+    if (named && name[0] == '#') {
+        unsigned number = static_cast<unsigned>(atoi(name + 1));
+        group = number < 18 ? GROUPS[number] : nullptr;
+        named = group && group[reg];
+        if (named) {
+            strncpy(name, group[reg], sizeof(name) - 1);
+            name[sizeof(name) - 1] = 0;
+        }
+    }
+
+    bool register_form = is_register_form(instruction);
+    if (instruction.map == 0) {
+        if ((instruction.prefixes & X86_PREFIX_REP) && instruction.opcode == 0x90) {
+            out.put("pause");
+            return out.get_length();
+        }
+        bool string_op = (instruction.opcode >= 0xA4 && instruction.opcode <= 0xAF && instruction.opcode != 0xA8 && instruction.opcode != 0xA9)
+                      || (instruction.opcode >= 0x6C && instruction.opcode <= 0x6F);
+        if (string_op && (instruction.prefixes & X86_PREFIX_REPNE)) {
+            out.put("repne ");
+        }
+        else if (string_op && (instruction.prefixes & X86_PREFIX_REP)) {
+            out.put((instruction.opcode & 0xF6) == 0xA6 ? "repe " : "rep ");
+        }
+        else if ((instruction.prefixes & X86_PREFIX_REPNE) && (instruction.flags & X86_RELATIVE || instruction.opcode == 0xC3 || instruction.opcode == 0xFF)) {
+            out.put("bnd ");
+        }
+        if (group == GROUP_3 && reg >= 2) {
+            operands = instruction.opcode == 0xF6 ? "Eb" : "Ev";
+        }
+        else if (group == GROUP_5) {
+            operands = reg == 3 || reg == 5 ? "Mf" : reg >= 2 ? "Eq" : "Ev";
+        }
+    }
+    else if (instruction.map == 1 && group) {
+        if (group == GROUP_7 && register_form) {
+            for (const fixed_form& form : FIXED_0F01) {
+                if (form.modrm == instruction.modrm) {
+                    out.put(form.text);
+                    return out.get_length();
+                }
+            }
+            named = false;
+        }
+        else if (group == GROUP_7) {
+            operands = reg == 4 || reg == 6 ? "Ew" : reg == 7 ? "Mb" : "M";
+        }
+        else if (group == GROUP_9) {
+            if (register_form) {
+                const char* random = reg == 6 ? "rdrand" : reg == 7 ? ((instruction.prefixes & X86_PREFIX_REP) ? "rdpid" : "rdseed") : nullptr;
+                named = random != nullptr;
+                if (named) {
+                    strcpy(name, random);
+                }
+                operands = (instruction.prefixes & X86_PREFIX_REP) ? "Rq" : "Rv";
+            }
+            else if (reg == 1) {
+                strcpy(name, (instruction.rex & X86_REX_W) ? "cmpxchg16b" : "cmpxchg8b");
+                operands = (instruction.rex & X86_REX_W) ? "Mo" : "Mq";
+            }
+        }
+        else if (group == GROUP_15) {
+            if (register_form && (instruction.prefixes & X86_PREFIX_REP) && reg < 4) {
+                static const char* const BASES[4] = { "rdfsbase", "rdgsbase", "wrfsbase", "wrgsbase" };
+                strcpy(name, BASES[reg]);
+                operands = "Ry";
+            }
+            else if (register_form) {
+                const char* fence = reg == 5 ? "lfence" : reg == 6 ? "mfence" : reg == 7 ? "sfence" : nullptr;
+                named = fence != nullptr;
+                if (named) {
+                    strcpy(name, fence);
+                }
+                operands = "";
+            }
+            else {
+                operands = reg == 2 || reg == 3 ? "Md" : reg == 7 ? "Mb" : "M";
+            }
+        }
+        else if (group == GROUP_16) {
+            operands = "Mb";
+        }
+    }
+    else if (instruction.map == 1 && instruction.opcode == 0x1E && (instruction.prefixes & X86_PREFIX_REP) && (instruction.modrm == 0xFA || instruction.modrm == 0xFB)) {
+        out.put(instruction.modrm == 0xFA ? "endbr64" : "endbr32");
+        return out.get_length();
+    }
+
+    bool extended = instruction.encoding != x86_encoding::legacy;
+    if (extended && instruction.map == 1 && instruction.opcode == 0x77) {
+        out.put(instruction.vector_length ? "vzeroall" : "vzeroupper");
+        return out.get_length();
+    }
+    // VEX reuses some general-purpose 0F opcodes for mask register instructions (kmov, kand).
+    if (extended && instruction.map == 1 && !strpbrk(operands, "VWUPQN")) {
+        named = false;
+        operands = "";
+    }
+    if (!named || (instruction.map == 1 && instruction.opcode == 0x0F)) {
+        put_opcode_number(out, instruction);
+        if (!*operands) {
+            return out.get_length();
+        }
+    }
+    else {
+        // VEX and EVEX name the vector forms with a v in front; BMI and the like keep theirs.
+        if (extended && strpbrk(operands, "VWUPQN")) {
+            out.put('v');
+        }
+        out.put(name);
+    }
+
+    bool xmm = extended || (instruction.prefixes & (X86_PREFIX_OPERAND | X86_PREFIX_REP | X86_PREFIX_REPNE)) != 0;
+    operand_context context = { instruction, address, name, xmm, 0 };
+    // Specs that leave out H and B predate this table's VEX coverage: their extra register
+    // goes after the destination when there is one (vvvv 0 is also how VEX says "none").
+    bool vvvv_placed = strpbrk(operands, "HB") != nullptr;
+    const char* token = operands;
+    bool first = true;
+    while (*token) {
+        const char* next = strchr(token, ',');
+        size_t length = next ? static_cast<size_t>(next - token) : strlen(token);
+        if (*token != '^' && (extended || (*token != 'H' && *token != 'B'))) {
+            out.put(first ? " " : ", ");
+            put_operand(out, context, token, length);
+            if (first && extended) {
+                if (instruction.mask) {
+                    out.put(" {k");
+                    out.put_unsigned(instruction.mask);
+                    out.put('}');
+                }
+                if (!vvvv_placed && instruction.vvvv) {
+                    out.put(", ");
+                    if (*token == 'G') {
+                        out.put(general_register(instruction.vvvv & 0x0F, size_of('y', instruction), instruction));
+                    }
+                    else {
+                        put_vector_register(out, instruction.vvvv, instruction);
+                    }
+                }
+            }
+            first = false;
+        }
+        if (!next) {
+            break;
+        }
+        token = next + 1;
+    }
+    return out.get_length();
+}
@@ -0,0 +1,359 @@
+#include "x86_decoder.h"
+#include <algorithm>
+#include "x86_tables.h"
+
+// x86_sweep runs a byte-at-a-time state machine instead of calling x86_decode per instruction.
+// Each byte is one table lookup whose row is the state so far, so there is no branch on what
+// the byte turned out to be; x86_decode's branches on prefixes, escapes, modrm and sizes are
+// what limit it on real code, where instruction forms change from one to the next.
+namespace {
+    constexpr opcode_flags ONE_BYTE_FLAGS = x86_build_flags(X86_ONE_BYTE);
+    constexpr opcode_flags TWO_BYTE_FLAGS = x86_build_flags(X86_TWO_BYTE);
+    constexpr opcode_flags THREE_BYTE_38_FLAGS = x86_build_flags(X86_THREE_BYTE_38.specs);
+    constexpr opcode_flags THREE_BYTE_3A_FLAGS = x86_build_flags(X86_THREE_BYTE_3A.specs);
+
+    const uint8_t SWEEP_END = 0x01;             // the byte ends an instruction
+    const uint8_t SWEEP_REFERENCE = 0x02;       // ...which has a branch or rip-relative target
+    const uint8_t SWEEP_INVALID = 0x04;         // x86_decode would reject the instruction
+
+    // Prefix context before the opcode. REX only counts if nothing follows it, and VEX, EVEX
+    // and XOP are invalid after a REX or a 66/F0/F2/F3.
+    const int CONTEXT_OPERAND = 0x01;           // 66
+    const int CONTEXT_ADDRESS = 0x02;           // 67
+    const int CONTEXT_LOCK_REP = 0x04;          // F0, F2, F3
+    const int CONTEXT_REX = 0x08;
+    const int CONTEXT_REX_W = 0x10;
+
+    // Operand context after the opcode: 66, 67 and W are all that change an immediate's size.
+    const int OPERAND_66 = 0x01;
+    const int OPERAND_67 = 0x02;
+    const int OPERAND_W = 0x04;
+
+    // Immediate sizes that can follow a modrm: 0, 1, 2 and 4 bytes.
+    constexpr int immediate_code(int size) {
+        return size == 4 ? 3 : size;
+    }
+
+    constexpr int code_size(int code) {
+        return code == 3 ? 4 : code;
+    }
+
+    // Rows of the transition table. Each state is 256 entries, one per next byte.
+    const int STATE_OPCODE = 0;                 // + 24 prefix contexts; the first is the start state
+    const int STATE_ESCAPE_0F = 24;             // + 8 operand contexts
+    const int STATE_ESCAPE_38 = 32;             // + 8
+    const int STATE_ESCAPE_3A = 40;             // + 8
+    const int STATE_MODRM = 48;                 // + immediate code
+    const int STATE_MODRM_TEST = 52;            // + immediate code; group 3, immediate only for test
+    const int STATE_MODRM_REGISTER = 56;        // + immediate code; mod treated as 3
+    const int STATE_SIB = 60;                   // + mod * 4 + immediate code
+    const int STATE_SKIP = 72;                  // + bytes left - 1, up to 8
+    const int STATE_SKIP_REFERENCE = 80;        // the same for an instruction with a target
+    const int STATE_POP_OR_XOP = 88;            // after 8F
+    const int STATE_POP = 89;                   // after 8F where XOP is not allowed
+    const int STATE_XOP_PAYLOAD = 90;           // + immediate code
+    const int STATE_XOP_OPCODE = 94;            // + immediate code
+    const int STATE_VEX2_PAYLOAD = 98;
+    const int STATE_VEX3_PAYLOAD = 99;
+    const int STATE_VEX3_PAYLOAD_2 = 100;       // + map - 1
+    const int STATE_VEX_MAP_1 = 103;            // + 66 | W << 1
+    const int STATE_VEX_MAP_2 = 107;            // also EVEX maps 2 and 4-7
+    const int STATE_VEX_MAP_3 = 108;
+    const int STATE_EVEX_PAYLOAD = 109;
+    const int STATE_EVEX_PAYLOAD_2 = 110;       // + 0 map 1, 1 map 2 and 4-7, 2 map 3
+    const int STATE_EVEX_PAYLOAD_3 = 113;       // + 66 | W << 1 for map 1, 4 map 2 and 4-7, 5 map 3
+    const int STATE_EVEX_MAP_1 = 119;           // + 66 | W << 1
+    const int STATE_COUNT = 123;
+
+    struct sweep_entry
+    {
+        int state;
+        uint8_t flags;
+    };
+
+    struct sweep_table
+    {
+        uint16_t next[STATE_COUNT * 256];       // next state's row offset, state * 256
+        uint8_t flags[STATE_COUNT * 256];
+    };
+
+    constexpr int opcode_state(int context) {
+        int rex = (context & CONTEXT_REX_W) ? 2 : (context & CONTEXT_REX) ? 1 : 0;
+        return STATE_OPCODE + rex * 8 + (context & (CONTEXT_OPERAND | CONTEXT_ADDRESS | CONTEXT_LOCK_REP));
+    }
+
+    constexpr int operand_context(int context) {
+        return ((context & CONTEXT_OPERAND) ? OPERAND_66 : 0) | ((context & CONTEXT_ADDRESS) ? OPERAND_67 : 0)
+             | ((context & CONTEXT_REX_W) ? OPERAND_W : 0);
+    }
+
+    constexpr int immediate_size(uint16_t flags, int operands) {
+        switch ((flags & X86_OP_IMMEDIATE) >> 1) {
+        case X86_IMM_B:
+            return 1;
+        case X86_IMM_W:
+            return 2;
+        case X86_IMM_Z:
+            return (operands & OPERAND_66) && !(operands & OPERAND_W) ? 2 : 4;
+        case X86_IMM_V:
+            return (operands & OPERAND_W) ? 8 : (operands & OPERAND_66) ? 2 : 4;
+        case X86_IMM_WB:
+            return 3;
+        case X86_IMM_D:
+            return 4;
+        case X86_IMM_O:
+            return (operands & OPERAND_67) ? 4 : 8;
+        default:
+            return 0;
+        }
+    }
+
+    constexpr sweep_entry invalid_entry() {
+        return sweep_entry{ STATE_OPCODE, SWEEP_INVALID };
+    }
+
+    // bytes more to skip before the instruction ends.
+    constexpr sweep_entry skip_entry(int bytes, bool reference) {
+        return bytes == 0 ? sweep_entry{ STATE_OPCODE, static_cast<uint8_t>(SWEEP_END | (reference ? SWEEP_REFERENCE : 0)) }
+             : sweep_entry{ (reference ? STATE_SKIP_REFERENCE : STATE_SKIP) + bytes - 1, 0 };
+    }
+
+    constexpr sweep_entry modrm_entry(uint8_t modrm, int immediate, bool register_only) {
+        int mod = register_only ? 3 : modrm >> 6;
+        int rm = modrm & 7;
+        if (mod == 3) {
+            return skip_entry(immediate, false);
+        }
+        if (rm == 4) {
+            return sweep_entry{ STATE_SIB + mod * 4 + immediate_code(immediate), 0 };
+        }
+        if (mod == 0 && rm == 5) {
+            return skip_entry(4 + immediate, true);
+        }
+        return skip_entry((mod == 1 ? 1 : mod == 2 ? 4 : 0) + immediate, false);
+    }
+
+    // The entry for an opcode byte, from its decoder flags.
+    constexpr sweep_entry opcode_entry(uint16_t flags, int operands) {
+        if (flags & X86_OP_INVALID) {
+            return invalid_entry();
+        }
+        int immediate = immediate_size(flags, operands);
+        if (flags & X86_OP_MODRM) {
+            int state = (flags & X86_OP_REGISTER) ? STATE_MODRM_REGISTER : (flags & X86_OP_GROUP3) ? STATE_MODRM_TEST : STATE_MODRM;
+            return sweep_entry{ state + immediate_code(immediate), 0 };
+        }
+        return skip_entry(immediate, (flags & X86_OP_RELATIVE) != 0);
+    }
+
+    constexpr sweep_entry prefix_entry(int context, uint8_t byte) {
+        if ((byte & 0xF0) == 0x40) {
+            return sweep_entry{ opcode_state((context & ~CONTEXT_REX_W) | CONTEXT_REX | ((byte & X86_REX_W) ? CONTEXT_REX_W : 0)), 0 };
+        }
+        context &= ~(CONTEXT_REX | CONTEXT_REX_W);
+        context |= byte == 0x66 ? CONTEXT_OPERAND : byte == 0x67 ? CONTEXT_ADDRESS
+                 : byte == 0xF0 || byte == 0xF2 || byte == 0xF3 ? CONTEXT_LOCK_REP : 0;
+        return sweep_entry{ opcode_state(context), 0 };
+    }
+
+    constexpr sweep_entry escape_entry(int context, uint8_t byte) {
+        bool extended_allowed = !(context & (CONTEXT_REX | CONTEXT_OPERAND | CONTEXT_LOCK_REP));
+        switch (byte) {
+        case 0x0F:
+            return sweep_entry{ STATE_ESCAPE_0F + operand_context(context), 0 };
+        case 0x8F:
+            return sweep_entry{ extended_allowed ? STATE_POP_OR_XOP : STATE_POP, 0 };
+        case 0xC5:
+            return extended_allowed ? sweep_entry{ STATE_VEX2_PAYLOAD, 0 } : invalid_entry();
+        case 0xC4:
+            return extended_allowed ? sweep_entry{ STATE_VEX3_PAYLOAD, 0 } : invalid_entry();
+        default:
+            return extended_allowed ? sweep_entry{ STATE_EVEX_PAYLOAD, 0 } : invalid_entry();
+        }
+    }
+
+    // Opcode flags for VEX and EVEX map 1, as x86_decode's extended_map_flags gives them.
+    constexpr uint16_t extended_map_1_flags(uint8_t opcode, bool evex) {
+        uint16_t flags = TWO_BYTE_FLAGS.flags[opcode];
+        if (flags & (X86_OP_INVALID | X86_OP_ESCAPE | X86_OP_RELATIVE)) {
+            flags = X86_OP_MODRM;
+        }
+        flags &= ~X86_OP_FLOW;
+        return evex ? static_cast<uint16_t>(flags | X86_OP_MODRM) : flags;
+    }
+
+    constexpr int extended_operands(uint8_t payload) {
+        return ((payload & 3) == 1 ? OPERAND_66 : 0) | ((payload & 0x80) ? OPERAND_W : 0);
+    }
+
+    constexpr sweep_entry transition(int state, uint8_t byte) {
+        if (state < STATE_ESCAPE_0F) {
+            int context = (state & 7) | (state >= 16 ? CONTEXT_REX | CONTEXT_REX_W : state >= 8 ? CONTEXT_REX : 0);
+            uint16_t flags = ONE_BYTE_FLAGS.flags[byte];
+            return (flags & X86_OP_PREFIX) ? prefix_entry(context, byte)
+                 : (flags & X86_OP_ESCAPE) ? escape_entry(context, byte)
+                 : opcode_entry(flags, operand_context(context));
+        }
+        if (state < STATE_ESCAPE_38) {
+            int operands = state - STATE_ESCAPE_0F;
+            return byte == 0x38 ? sweep_entry{ STATE_ESCAPE_38 + operands, 0 }
+                 : byte == 0x3A ? sweep_entry{ STATE_ESCAPE_3A + operands, 0 }
+                 : byte == 0x0F ? sweep_entry{ STATE_MODRM + 1, 0 }       // 3DNow!: modrm and an imm8
+                 : opcode_entry(TWO_BYTE_FLAGS.flags[byte], operands);
+        }
+        if (state < STATE_ESCAPE_3A) {
+            return opcode_entry(THREE_BYTE_38_FLAGS.flags[byte], state - STATE_ESCAPE_38);
+        }
+        if (state < STATE_MODRM) {
+            return opcode_entry(THREE_BYTE_3A_FLAGS.flags[byte], state - STATE_ESCAPE_3A);
+        }
+        if (state < STATE_MODRM_TEST) {
+            return modrm_entry(byte, code_size(state - STATE_MODRM), false);
+        }
+        if (state < STATE_MODRM_REGISTER) {
+            return modrm_entry(byte, (byte & 0x30) ? 0 : code_size(state - STATE_MODRM_TEST), false);
+        }
+        if (state < STATE_SIB) {
+            return modrm_entry(byte, code_size(state - STATE_MODRM_REGISTER), true);
+        }
+        if (state < STATE_SKIP) {
+            int mod = (state - STATE_SIB) / 4;
+            int displacement = mod == 1 ? 1 : mod == 2 ? 4 : (byte & 7) == 5 ? 4 : 0;
+            return skip_entry(displacement + code_size((state - STATE_SIB) % 4), false);
+        }
+        if (state < STATE_SKIP_REFERENCE) {
+            return skip_entry(state - STATE_SKIP, false);
+        }
+        if (state < STATE_POP_OR_XOP) {
+            return skip_entry(state - STATE_SKIP_REFERENCE, true);
+        }
+        if (state <= STATE_POP) {
+            // pop r/m64 when the byte could be its modrm; XOP uses the map numbers from 8 up.
+            int map = byte & 0x1F;
+            return map < 8 ? modrm_entry(byte, 0, false)
+                 : state == STATE_POP ? invalid_entry()
+                 : map == 8 ? sweep_entry{ STATE_XOP_PAYLOAD + 1, 0 }
+                 : map == 9 ? sweep_entry{ STATE_XOP_PAYLOAD, 0 }
+                 : map == 10 ? sweep_entry{ STATE_XOP_PAYLOAD + immediate_code(4), 0 }
+                 : invalid_entry();
+        }
+        if (state < STATE_XOP_OPCODE) {
+            return sweep_entry{ STATE_XOP_OPCODE + state - STATE_XOP_PAYLOAD, 0 };
+        }
+        if (state < STATE_VEX2_PAYLOAD) {
+            return sweep_entry{ STATE_MODRM + state - STATE_XOP_OPCODE, 0 };
+        }
+        if (state == STATE_VEX2_PAYLOAD) {
+            return sweep_entry{ STATE_VEX_MAP_1 + ((byte & 3) == 1 ? OPERAND_66 : 0), 0 };
+        }
+        if (state == STATE_VEX3_PAYLOAD) {
+            int map = byte & 0x1F;
+            return map >= 1 && map <= 3 ? sweep_entry{ STATE_VEX3_PAYLOAD_2 + map - 1, 0 } : invalid_entry();
+        }
+        if (state < STATE_VEX_MAP_1) {
+            int map = state - STATE_VEX3_PAYLOAD_2 + 1;
+            int operands = extended_operands(byte);
+            return sweep_entry{ map == 1 ? STATE_VEX_MAP_1 + (operands & OPERAND_66) + ((operands & OPERAND_W) ? 2 : 0)
+                              : map == 2 ? STATE_VEX_MAP_2 : STATE_VEX_MAP_3, 0 };
+        }
+        if (state < STATE_VEX_MAP_2) {
+            int index = state - STATE_VEX_MAP_1;
+            int operands = ((index & 1) ? OPERAND_66 : 0) | ((index & 2) ? OPERAND_W : 0);
+            return opcode_entry(extended_map_1_flags(byte, false), operands);
+        }
+        if (state == STATE_VEX_MAP_2) {
+            return sweep_entry{ STATE_MODRM, 0 };
+        }
+        if (state == STATE_VEX_MAP_3) {
+            return sweep_entry{ STATE_MODRM + 1, 0 };
+        }
+        if (state == STATE_EVEX_PAYLOAD) {
+            int map = byte & 7;
+            return map == 0 ? invalid_entry()
+                 : sweep_entry{ STATE_EVEX_PAYLOAD_2 + (map == 1 ? 0 : map == 3 ? 2 : 1), 0 };
+        }
+        if (state < STATE_EVEX_PAYLOAD_3) {
+            if (!(byte & 0x04)) {
+                return invalid_entry();
+            }
+            int map = state - STATE_EVEX_PAYLOAD_2;
+            int operands = extended_operands(byte);
+            return sweep_entry{ STATE_EVEX_PAYLOAD_3 + (map == 0 ? (operands & OPERAND_66) + ((operands & OPERAND_W) ? 2 : 0) : map + 3), 0 };
+        }
+        if (state < STATE_EVEX_MAP_1) {
+            int index = state - STATE_EVEX_PAYLOAD_3;
+            return sweep_entry{ index < 4 ? STATE_EVEX_MAP_1 + index : index == 4 ? STATE_VEX_MAP_2 : STATE_VEX_MAP_3, 0 };
+        }
+        int index = state - STATE_EVEX_MAP_1;
+        int operands = ((index & 1) ? OPERAND_66 : 0) | ((index & 2) ? OPERAND_W : 0);
+        return opcode_entry(extended_map_1_flags(byte, true), operands);
+    }
+
+    constexpr sweep_table build_sweep_table() {
+        sweep_table table = {};
+        for (int state = 0; state < STATE_COUNT; state++) {
+            for (int byte = 0; byte < 256; byte++) {
+                sweep_entry entry = transition(state, static_cast<uint8_t>(byte));
+                table.next[state * 256 + byte] = static_cast<uint16_t>(entry.state * 256);
+                table.flags[state * 256 + byte] = entry.flags;
+            }
+        }
+        return table;
+    }
+
+    // Constant-initialized wherever the compiler's constexpr budget stretches to 31K entries;
+    // otherwise built once at startup.
+    const sweep_table SWEEP = build_sweep_table();
+
+    // References found in a block are gathered in a fixed array, written for every byte and
+    // kept only at the ends of instructions that have a target. A block can finish an
+    // instruction begun before it, hence the extra room.
+    const size_t SWEEP_BLOCK = 4096;
+}
+
+size_t x86_sweep(const uint8_t* code, size_t size, size_t begin, size_t end, std::vector<uint32_t>& references, uint64_t& instructions) {
+    uint32_t found[SWEEP_BLOCK + X86_MAX_LENGTH];
+    size_t start = begin;
+    size_t position = begin;
+    size_t state = 0;
+    uint64_t ended = 0;
+    size_t limit = (std::min)(size, end);
+    while (position < limit) {
+        size_t block_end = (std::min)(limit, position + SWEEP_BLOCK);
+        size_t count = 0;
+        for (; position < block_end; position++) {
+            size_t index = state + code[position];
+            uint8_t flags = SWEEP.flags[index];
+            state = SWEEP.next[index];
+            if ((flags & SWEEP_INVALID) || position - start >= X86_MAX_LENGTH) {
+                // Like a failed x86_decode: go again from the byte after the instruction start.
+                position = start++;
+                state = 0;
+                continue;
+            }
+            found[count] = static_cast<uint32_t>(start);
+            count += (flags & SWEEP_REFERENCE) >> 1;
+            ended += flags & SWEEP_END;
+            start = (flags & SWEEP_END) ? position + 1 : start;
+        }
+        references.insert(references.end(), found, found + count);
+    }
+    instructions += ended;
+
+    // The instruction under way at end, or cut off at size, is left to x86_decode; one that
+    // runs past size fails and the walk carries on from the byte after it.
+    x86_instruction instruction;
+    uint64_t target;
+    while (start < end && start < size) {
+        if (!x86_decode(code + start, size - start, instruction)) {
+            start++;
+            continue;
+        }
+        if (x86_target(instruction, 0, target)) {
+            references.push_back(static_cast<uint32_t>(start));
+        }
+        instructions++;
+        start += instruction.length;
+    }
+    return start;
+}
@@ -0,0 +1,322 @@
+#ifndef X86_TABLES_H
+#define X86_TABLES_H
+#include <cstddef>
+#include <cstdint>
+
+// Opcode maps in the Intel manual's operand notation, the one source both the decoder's flag
+// tables (derived at compile time below) and the formatter read.
+//
+// Operands, comma separated: E/G/M/R modrm r/m, reg, memory only, register only (general);
+// V/W/U xmm reg, xmm or memory, xmm register only; P/Q/N the same for mmx (xmm with a 66
+// prefix); S/C/D segment, control, debug reg; F x87 modrm; Z register in the opcode's low bits;
+// H vector and B general register in VEX.vvvv (absent without VEX); I immediate; J relative
+// branch target; O 64-bit absolute address (moffs). Sizes: b, w, d, q, o (16 bytes), v
+// (16/32/64 by prefixes), z (16/32), y (32/64), x (xmm/ymm/zmm by vector length);
+// "Ibs" is a sign-extended byte. Lowercase operands are fixed registers ("al", "cl", "dx",
+// "rAX" sized like v). "~" marks a prefix byte and "^" an escape the decoder handles itself.
+//
+// Mnemonics: "a|b|c|d" are the forms without a mandatory prefix and with 66, F3 and F2 (the
+// operands may split the same way); "a/b/c" the 16, 32 and 64-bit forms; "#n" a group the
+// modrm reg field picks from. A null mnemonic is not valid in 64-bit mode; an empty one is
+// valid but not named here.
+struct opcode_spec
+{
+    const char* mnemonic;
+    const char* operands;
+};
+
+#define X86_INVALID { nullptr, "" }
+#define X86_PREFIX(name) { name, "~" }
+#define X86_ESCAPE { "", "^" }
+
+constexpr opcode_spec X86_ONE_BYTE[256] = {
+    // 00
+    { "add", "Eb,Gb" }, { "add", "Ev,Gv" }, { "add", "Gb,Eb" }, { "add", "Gv,Ev" }, { "add", "al,Ib" }, { "add", "rAX,Iz" }, X86_INVALID, X86_INVALID,
+    { "or", "Eb,Gb" }, { "or", "Ev,Gv" }, { "or", "Gb,Eb" }, { "or", "Gv,Ev" }, { "or", "al,Ib" }, { "or", "rAX,Iz" }, X86_INVALID, X86_ESCAPE,
+    // 10
+    { "adc", "Eb,Gb" }, { "adc", "Ev,Gv" }, { "adc", "Gb,Eb" }, { "adc", "Gv,Ev" }, { "adc", "al,Ib" }, { "adc", "rAX,Iz" }, X86_INVALID, X86_INVALID,
+    { "sbb", "Eb,Gb" }, { "sbb", "Ev,Gv" }, { "sbb", "Gb,Eb" }, { "sbb", "Gv,Ev" }, { "sbb", "al,Ib" }, { "sbb", "rAX,Iz" }, X86_INVALID, X86_INVALID,
+    // 20
+    { "and", "Eb,Gb" }, { "and", "Ev,Gv" }, { "and", "Gb,Eb" }, { "and", "Gv,Ev" }, { "and", "al,Ib" }, { "and", "rAX,Iz" }, X86_PREFIX("es"), X86_INVALID,
+    { "sub", "Eb,Gb" }, { "sub", "Ev,Gv" }, { "sub", "Gb,Eb" }, { "sub", "Gv,Ev" }, { "sub", "al,Ib" }, { "sub", "rAX,Iz" }, X86_PREFIX("cs"), X86_INVALID,
+    // 30
+    { "xor", "Eb,Gb" }, { "xor", "Ev,Gv" }, { "xor", "Gb,Eb" }, { "xor", "Gv,Ev" }, { "xor", "al,Ib" }, { "xor", "rAX,Iz" }, X86_PREFIX("ss"), X86_INVALID,
+    { "cmp", "Eb,Gb" }, { "cmp", "Ev,Gv" }, { "cmp", "Gb,Eb" }, { "cmp", "Gv,Ev" }, { "cmp", "al,Ib" }, { "cmp", "rAX,Iz" }, X86_PREFIX("ds"), X86_INVALID,
+    // 40
+    X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"),
+    X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"), X86_PREFIX("rex"),
+    // 50
+    { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" }, { "push", "Zq" },
+    { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" }, { "pop", "Zq" },
+    // 60
+    X86_INVALID, X86_INVALID, X86_ESCAPE, { "movsxd", "Gv,Ed" }, X86_PREFIX("fs"), X86_PREFIX("gs"), X86_PREFIX("data16"), X86_PREFIX("addr32"),
+    { "push", "Iz" }, { "imul", "Gv,Ev,Iz" }, { "push", "Ibs" }, { "imul", "Gv,Ev,Ibs" }, { "insb", "" }, { "insw/insd/insd", "" }, { "outsb", "" }, { "outsw/outsd/outsd", "" },
+    // 70
+    { "jo", "Jb" }, { "jno", "Jb" }, { "jb", "Jb" }, { "jae", "Jb" }, { "je", "Jb" }, { "jne", "Jb" }, { "jbe", "Jb" }, { "ja", "Jb" },
+    { "js", "Jb" }, { "jns", "Jb" }, { "jp", "Jb" }, { "jnp", "Jb" }, { "jl", "Jb" }, { "jge", "Jb" }, { "jle", "Jb" }, { "jg", "Jb" },
+    // 80
+    { "#1", "Eb,Ib" }, { "#1", "Ev,Iz" }, X86_INVALID, { "#1", "Ev,Ibs" }, { "test", "Eb,Gb" }, { "test", "Ev,Gv" }, { "xchg", "Eb,Gb" }, { "xchg", "Ev,Gv" },
+    { "mov", "Eb,Gb" }, { "mov", "Ev,Gv" }, { "mov", "Gb,Eb" }, { "mov", "Gv,Ev" }, { "mov", "Ev,Sw" }, { "lea", "Gv,M" }, { "mov", "Sw,Ew" }, { "pop", "Eq,^" },
+    // 90
+    { "nop", "" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" }, { "xchg", "Zv,rAX" },
+    { "cbw/cwde/cdqe", "" }, { "cwd/cdq/cqo", "" }, X86_INVALID, { "fwait", "" }, { "pushfw/pushfq/pushfq", "" }, { "popfw/popfq/popfq", "" }, { "sahf", "" }, { "lahf", "" },
+    // A0
+    { "mov", "al,Ob" }, { "mov", "rAX,Ov" }, { "mov", "Ob,al" }, { "mov", "Ov,rAX" }, { "movsb", "" }, { "movsw/movsd/movsq", "" }, { "cmpsb", "" }, { "cmpsw/cmpsd/cmpsq", "" },
+    { "test", "al,Ib" }, { "test", "rAX,Iz" }, { "stosb", "" }, { "stosw/stosd/stosq", "" }, { "lodsb", "" }, { "lodsw/lodsd/lodsq", "" }, { "scasb", "" }, { "scasw/scasd/scasq", "" },
+    // B0
+    { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" }, { "mov", "Zb,Ib" },
+    { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" }, { "mov", "Zv,Iv" },
+    // C0
+    { "#2", "Eb,Ib" }, { "#2", "Ev,Ib" }, { "ret", "Iw" }, { "ret", "" }, X86_ESCAPE, X86_ESCAPE, { "mov", "Eb,Ib" }, { "mov", "Ev,Iz" },
+    { "enter", "Iw,Ib" }, { "leave", "" }, { "retf", "Iw" }, { "retf", "" }, { "int3", "" }, { "int", "Ib" }, X86_INVALID, { "iretw/iretd/iretq", "" },
+    // D0
+    { "#2", "Eb,1" }, { "#2", "Ev,1" }, { "#2", "Eb,cl" }, { "#2", "Ev,cl" }, X86_INVALID, X86_INVALID, X86_INVALID, { "xlatb", "" },
+    { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" }, { "#x87", "F" },
+    // E0
+    { "loopne", "Jb" }, { "loope", "Jb" }, { "loop", "Jb" }, { "jrcxz", "Jb" }, { "in", "al,Ib" }, { "in", "eAX,Ib" }, { "out", "Ib,al" }, { "out", "Ib,eAX" },
+    { "call", "Jz" }, { "jmp", "Jz" }, X86_INVALID, { "jmp", "Jb" }, { "in", "al,dx" }, { "in", "eAX,dx" }, { "out", "dx,al" }, { "out", "dx,eAX" },
+    // F0
+    X86_PREFIX("lock"), { "int1", "" }, X86_PREFIX("repne"), X86_PREFIX("rep"), { "hlt", "" }, { "cmc", "" }, { "#3", "Eb,Ib" }, { "#3", "Ev,Iz" },
+    { "clc", "" }, { "stc", "" }, { "cli", "" }, { "sti", "" }, { "cld", "" }, { "std", "" }, { "#4", "Eb" }, { "#5", "Ev" },
+};
+
+#define X86_PQ(name) { name, "Pq,Hx,Qq" }
+
+constexpr opcode_spec X86_TWO_BYTE[256] = {
+    // 0F 00
+    { "#6", "Ew" }, { "#7", "M" }, { "lar", "Gv,Ew" }, { "lsl", "Gv,Ew" }, X86_INVALID, { "syscall", "" }, { "clts", "" }, { "sysret", "" },
+    { "invd", "" }, { "wbinvd", "" }, X86_INVALID, { "ud2", "" }, X86_INVALID, { "prefetchw", "Mb" }, { "femms", "" }, X86_ESCAPE,
+    // 0F 10
+    { "movups|movupd|movss|movsd", "Vx,Wx" }, { "movups|movupd|movss|movsd", "Wx,Vx" }, { "movlps|movlpd|movsldup|movddup", "Vx,Hx,Wx|Vx,Hx,Wx|Vx,Wx|Vx,Wx" }, { "movlps|movlpd", "Mq,Vx" },
+    { "unpcklps|unpcklpd", "Vx,Hx,Wx" }, { "unpckhps|unpckhpd", "Vx,Hx,Wx" }, { "movhps|movhpd|movshdup", "Vx,Hx,Wx|Vx,Hx,Wx|Vx,Wx" }, { "movhps|movhpd", "Mq,Vx" },
+    { "#16", "M" }, { "nop", "Ev" }, { "nop", "Ev" }, { "nop", "Ev" }, { "nop", "Ev" }, { "nop", "Ev" }, { "nop", "Ev" }, { "nop", "Ev" },
+    // 0F 20
+    { "mov", "Rq,Cq" }, { "mov", "Rq,Dq" }, { "mov", "Cq,Rq" }, { "mov", "Dq,Rq" }, X86_INVALID, X86_INVALID, X86_INVALID, X86_INVALID,
+    { "movaps|movapd", "Vx,Wx" }, { "movaps|movapd", "Wx,Vx" }, { "cvtpi2ps|cvtpi2pd|cvtsi2ss|cvtsi2sd", "Vx,Qq|Vx,Qq|Vx,Hx,Ey|Vx,Hx,Ey" }, { "movntps|movntpd", "Mx,Vx" },
+    { "cvttps2pi|cvttpd2pi|cvttss2si|cvttsd2si", "Gy,Wx" }, { "cvtps2pi|cvtpd2pi|cvtss2si|cvtsd2si", "Gy,Wx" }, { "ucomiss|ucomisd", "Vx,Wx" }, { "comiss|comisd", "Vx,Wx" },
+    // 0F 30
+    { "wrmsr", "" }, { "rdtsc", "" }, { "rdmsr", "" }, { "rdpmc", "" }, { "sysenter", "" }, { "sysexit", "" }, X86_INVALID, { "getsec", "" },
+    X86_ESCAPE, X86_INVALID, X86_ESCAPE, X86_INVALID, X86_INVALID, X86_INVALID, X86_INVALID, X86_INVALID,
+    // 0F 40
+    { "cmovo", "Gv,Ev" }, { "cmovno", "Gv,Ev" }, { "cmovb", "Gv,Ev" }, { "cmovae", "Gv,Ev" }, { "cmove", "Gv,Ev" }, { "cmovne", "Gv,Ev" }, { "cmovbe", "Gv,Ev" }, { "cmova", "Gv,Ev" },
+    { "cmovs", "Gv,Ev" }, { "cmovns", "Gv,Ev" }, { "cmovp", "Gv,Ev" }, { "cmovnp", "Gv,Ev" }, { "cmovl", "Gv,Ev" }, { "cmovge", "Gv,Ev" }, { "cmovle", "Gv,Ev" }, { "cmovg", "Gv,Ev" },
+    // 0F 50
+    { "movmskps|movmskpd", "Gd,Ux" }, { "sqrtps|sqrtpd|sqrtss|sqrtsd", "Vx,Wx|Vx,Wx|Vx,Hx,Wx|Vx,Hx,Wx" }, { "rsqrtps||rsqrtss", "Vx,Wx||Vx,Hx,Wx" }, { "rcpps||rcpss", "Vx,Wx||Vx,Hx,Wx" },
+    { "andps|andpd", "Vx,Hx,Wx" }, { "andnps|andnpd", "Vx,Hx,Wx" }, { "orps|orpd", "Vx,Hx,Wx" }, { "xorps|xorpd", "Vx,Hx,Wx" },
+    { "addps|addpd|addss|addsd", "Vx,Hx,Wx" }, { "mulps|mulpd|mulss|mulsd", "Vx,Hx,Wx" }, { "cvtps2pd|cvtpd2ps|cvtss2sd|cvtsd2ss", "Vx,Wx|Vx,Wx|Vx,Hx,Wx|Vx,Hx,Wx" }, { "cvtdq2ps|cvtps2dq|cvttps2dq", "Vx,Wx" },
+    { "subps|subpd|subss|subsd", "Vx,Hx,Wx" }, { "minps|minpd|minss|minsd", "Vx,Hx,Wx" }, { "divps|divpd|divss|divsd", "Vx,Hx,Wx" }, { "maxps|maxpd|maxss|maxsd", "Vx,Hx,Wx" },
+    // 0F 60
+    X86_PQ("punpcklbw"), X86_PQ("punpcklwd"), X86_PQ("punpckldq"), X86_PQ("packsswb"), X86_PQ("pcmpgtb"), X86_PQ("pcmpgtw"), X86_PQ("pcmpgtd"), X86_PQ("packuswb"),
+    X86_PQ("punpckhbw"), X86_PQ("punpckhwd"), X86_PQ("punpckhdq"), X86_PQ("packssdw"), { "|punpcklqdq", "Vx,Hx,Wx" }, { "|punpckhqdq", "Vx,Hx,Wx" }, { "movd/movd/movq", "Py,Ey" }, { "movq|movdqa|movdqu", "Pq,Qq" },
+    // 0F 70
+    { "pshufw|pshufd|pshufhw|pshuflw", "Pq,Qq,Ib" }, { "#12", "Nq,Ib" }, { "#13", "Nq,Ib" }, { "#14", "Nq,Ib" }, X86_PQ("pcmpeqb"), X86_PQ("pcmpeqw"), X86_PQ("pcmpeqd"), { "emms", "" },
+    { "vmread", "Eq,Gq" }, { "vmwrite", "Gq,Eq" }, X86_INVALID, X86_INVALID, { "|haddpd||haddps", "Vx,Hx,Wx" }, { "|hsubpd||hsubps", "Vx,Hx,Wx" }, { "movd/movd/movq|movd/movd/movq|movq", "Ey,Py|Ey,Py|Vx,Wq" }, { "movq|movdqa|movdqu", "Qq,Pq" },
+    // 0F 80
+    { "jo", "Jz" }, { "jno", "Jz" }, { "jb", "Jz" }, { "jae", "Jz" }, { "je", "Jz" }, { "jne", "Jz" }, { "jbe", "Jz" }, { "ja", "Jz" },
+    { "js", "Jz" }, { "jns", "Jz" }, { "jp", "Jz" }, { "jnp", "Jz" }, { "jl", "Jz" }, { "jge", "Jz" }, { "jle", "Jz" }, { "jg", "Jz" },
+    // 0F 90
+    { "seto", "Eb" }, { "setno", "Eb" }, { "setb", "Eb" }, { "setae", "Eb" }, { "sete", "Eb" }, { "setne", "Eb" }, { "setbe", "Eb" }, { "seta", "Eb" },
+    { "sets", "Eb" }, { "setns", "Eb" }, { "setp", "Eb" }, { "setnp", "Eb" }, { "setl", "Eb" }, { "setge", "Eb" }, { "setle", "Eb" }, { "setg", "Eb" },
+    // 0F A0
+    { "push", "fs" }, { "pop", "fs" }, { "cpuid", "" }, { "bt", "Ev,Gv" }, { "shld", "Ev,Gv,Ib" }, { "shld", "Ev,Gv,cl" }, X86_INVALID, X86_INVALID,
+    { "push", "gs" }, { "pop", "gs" }, { "rsm", "" }, { "bts", "Ev,Gv" }, { "shrd", "Ev,Gv,Ib" }, { "shrd", "Ev,Gv,cl" }, { "#15", "M" }, { "imul", "Gv,Ev" },
+    // 0F B0
+    { "cmpxchg", "Eb,Gb" }, { "cmpxchg", "Ev,Gv" }, { "lss", "Gv,M" }, { "btr", "Ev,Gv" }, { "lfs", "Gv,M" }, { "lgs", "Gv,M" }, { "movzx", "Gv,Eb" }, { "movzx", "Gv,Ew" },
+    { "jmpe||popcnt", "Gv,Ev" }, { "ud1", "Gv,Ev" }, { "#8", "Ev,Ib" }, { "btc", "Ev,Gv" }, { "bsf||tzcnt", "Gv,Ev" }, { "bsr||lzcnt", "Gv,Ev" }, { "movsx", "Gv,Eb" }, { "movsx", "Gv,Ew" },
+    // 0F C0
+    { "xadd", "Eb,Gb" }, { "xadd", "Ev,Gv" }, { "cmpps|cmppd|cmpss|cmpsd", "Vx,Hx,Wx,Ib" }, { "movnti", "My,Gy" },
+    { "pinsrw", "Pq,Hx,Ed,Ib" }, { "pextrw", "Gd,Nq,Ib" }, { "shufps|shufpd", "Vx,Hx,Wx,Ib" }, { "#9", "M" },
+    { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" }, { "bswap", "Zy" },
+    // 0F D0
+    { "|addsubpd||addsubps", "Vx,Hx,Wx" }, X86_PQ("psrlw"), X86_PQ("psrld"), X86_PQ("psrlq"), X86_PQ("paddq"), X86_PQ("pmullw"), { "|movq|movq2dq|movdq2q", "Wq,Vq" }, { "pmovmskb", "Gd,Nq" },
+    X86_PQ("psubusb"), X86_PQ("psubusw"), X86_PQ("pminub"), X86_PQ("pand"), X86_PQ("paddusb"), X86_PQ("paddusw"), X86_PQ("pmaxub"), X86_PQ("pandn"),
+    // 0F E0
+    X86_PQ("pavgb"), X86_PQ("psraw"), X86_PQ("psrad"), X86_PQ("pavgw"), X86_PQ("pmulhuw"), X86_PQ("pmulhw"), { "|cvttpd2dq|cvtdq2pd|cvtpd2dq", "Vx,Wx" }, { "movntq|movntdq", "Mq,Pq|Mx,Vx" },
+    X86_PQ("psubsb"), X86_PQ("psubsw"), X86_PQ("pminsw"), X86_PQ("por"), X86_PQ("paddsb"), X86_PQ("paddsw"), X86_PQ("pmaxsw"), X86_PQ("pxor"),
+    // 0F F0
+    { "|||lddqu", "Vx,M" }, X86_PQ("psllw"), X86_PQ("pslld"), X86_PQ("psllq"), X86_PQ("pmuludq"), X86_PQ("pmaddwd"), X86_PQ("psadbw"), { "maskmovq|maskmovdqu", "Pq,Nq" },
+    X86_PQ("psubb"), X86_PQ("psubw"), X86_PQ("psubd"), X86_PQ("psubq"), X86_PQ("paddb"), X86_PQ("paddw"), X86_PQ("paddd"), { "ud0", "Gv,Ev" },
+};
+
+// 0F 38 and 0F 3A: every opcode takes a modrm (and 0F 3A an imm8); only the common ones are
+// named, the rest decode and print by number.
+struct sparse_spec
+{
+    uint8_t opcode;
+    opcode_spec spec;
+};
+
+constexpr sparse_spec X86_0F38_NAMED[] = {
+    { 0x00, X86_PQ("pshufb") }, { 0x01, X86_PQ("phaddw") }, { 0x02, X86_PQ("phaddd") }, { 0x03, X86_PQ("phaddsw") },
+    { 0x04, X86_PQ("pmaddubsw") }, { 0x05, X86_PQ("phsubw") }, { 0x06, X86_PQ("phsubd") }, { 0x07, X86_PQ("phsubsw") },
+    { 0x08, X86_PQ("psignb") }, { 0x09, X86_PQ("psignw") }, { 0x0A, X86_PQ("psignd") }, { 0x0B, X86_PQ("pmulhrsw") },
+    { 0x10, { "|pblendvb", "Vx,Wx" } }, { 0x14, { "|blendvps", "Vx,Wx" } }, { 0x15, { "|blendvpd", "Vx,Wx" } }, { 0x16, { "|permps", "Vx,Hx,Wx" } }, { 0x17, { "|ptest", "Vx,Wx" } },
+    { 0x18, { "|broadcastss", "Vx,Wd" } }, { 0x19, { "|broadcastsd", "Vx,Wq" } }, { 0x1A, { "|broadcastf128", "Vx,Mo" } },
+    { 0x1C, { "pabsb", "Pq,Qq" } }, { 0x1D, { "pabsw", "Pq,Qq" } }, { 0x1E, { "pabsd", "Pq,Qq" } },
+    { 0x20, { "|pmovsxbw", "Vx,Wq" } }, { 0x21, { "|pmovsxbd", "Vx,Wd" } }, { 0x22, { "|pmovsxbq", "Vx,Ww" } },
+    { 0x23, { "|pmovsxwd", "Vx,Wq" } }, { 0x24, { "|pmovsxwq", "Vx,Wd" } }, { 0x25, { "|pmovsxdq", "Vx,Wq" } },
+    { 0x28, { "|pmuldq", "Vx,Hx,Wx" } }, { 0x29, { "|pcmpeqq", "Vx,Hx,Wx" } }, { 0x2A, { "|movntdqa", "Vx,Mx" } }, { 0x2B, { "|packusdw", "Vx,Hx,Wx" } },
+    { 0x30, { "|pmovzxbw", "Vx,Wq" } }, { 0x31, { "|pmovzxbd", "Vx,Wd" } }, { 0x32, { "|pmovzxbq", "Vx,Ww" } },
+    { 0x33, { "|pmovzxwd", "Vx,Wq" } }, { 0x34, { "|pmovzxwq", "Vx,Wd" } }, { 0x35, { "|pmovzxdq", "Vx,Wq" } }, { 0x36, { "|permd", "Vx,Hx,Wx" } }, { 0x37, { "|pcmpgtq", "Vx,Hx,Wx" } },
+    { 0x38, { "|pminsb", "Vx,Hx,Wx" } }, { 0x39, { "|pminsd", "Vx,Hx,Wx" } }, { 0x3A, { "|pminuw", "Vx,Hx,Wx" } }, { 0x3B, { "|pminud", "Vx,Hx,Wx" } },
+    { 0x3C, { "|pmaxsb", "Vx,Hx,Wx" } }, { 0x3D, { "|pmaxsd", "Vx,Hx,Wx" } }, { 0x3E, { "|pmaxuw", "Vx,Hx,Wx" } }, { 0x3F, { "|pmaxud", "Vx,Hx,Wx" } },
+    { 0x40, { "|pmulld", "Vx,Hx,Wx" } }, { 0x41, { "|phminposuw", "Vx,Wx" } },
+    { 0x45, { "|psrlvd", "Vx,Hx,Wx" } }, { 0x46, { "|psravd", "Vx,Hx,Wx" } }, { 0x47, { "|psllvd", "Vx,Hx,Wx" } },
+    { 0x58, { "|pbroadcastd", "Vx,Wd" } }, { 0x59, { "|pbroadcastq", "Vx,Wq" } }, { 0x5A, { "|broadcasti128", "Vx,Mo" } },
+    { 0x78, { "|pbroadcastb", "Vx,Wb" } }, { 0x79, { "|pbroadcastw", "Vx,Ww" } },
+    { 0xDB, { "|aesimc", "Vx,Wx" } }, { 0xDC, { "|aesenc", "Vx,Hx,Wx" } }, { 0xDD, { "|aesenclast", "Vx,Hx,Wx" } }, { 0xDE, { "|aesdec", "Vx,Hx,Wx" } }, { 0xDF, { "|aesdeclast", "Vx,Hx,Wx" } },
+    { 0xF0, { "movbe|movbe||crc32", "Gv,Ev|Gv,Ev||Gy,Eb" } }, { 0xF1, { "movbe|movbe||crc32", "Ev,Gv|Ev,Gv||Gy,Ev" } }, { 0xF2, { "andn", "Gy,By,Ey" } }, { 0xF3, { "#17", "By,Ey" } },
+    { 0xF5, { "bzhi||pext|pdep", "Gy,Ey,By||Gy,By,Ey|Gy,By,Ey" } }, { 0xF6, { "|adcx|adox|mulx", "|Gy,Ey|Gy,Ey|Gy,By,Ey" } }, { 0xF7, { "bextr|shlx|sarx|shrx", "Gy,Ey,By" } },
+};
+
+constexpr sparse_spec X86_0F3A_NAMED[] = {
+    { 0x00, { "|permq", "Vx,Wx,Ib" } }, { 0x01, { "|permpd", "Vx,Wx,Ib" } }, { 0x02, { "|pblendd", "Vx,Hx,Wx,Ib" } },
+    { 0x04, { "|permilps", "Vx,Wx,Ib" } }, { 0x05, { "|permilpd", "Vx,Wx,Ib" } }, { 0x06, { "|perm2f128", "Vx,Hx,Wx,Ib" } },
+    { 0x08, { "|roundps", "Vx,Wx,Ib" } }, { 0x09, { "|roundpd", "Vx,Wx,Ib" } }, { 0x0A, { "|roundss", "Vx,Hx,Wd,Ib" } }, { 0x0B, { "|roundsd", "Vx,Hx,Wq,Ib" } },
+    { 0x0C, { "|blendps", "Vx,Hx,Wx,Ib" } }, { 0x0D, { "|blendpd", "Vx,Hx,Wx,Ib" } }, { 0x0E, { "|pblendw", "Vx,Hx,Wx,Ib" } }, { 0x0F, { "palignr", "Pq,Hx,Qq,Ib" } },
+    { 0x14, { "|pextrb", "Ed,Vx,Ib" } }, { 0x15, { "|pextrw", "Ed,Vx,Ib" } }, { 0x16, { "|pextrd/pextrd/pextrq", "Ey,Vx,Ib" } }, { 0x17, { "|extractps", "Ed,Vx,Ib" } },
+    { 0x18, { "|insertf128", "Vx,Hx,Wo,Ib" } }, { 0x19, { "|extractf128", "Wo,Vx,Ib" } },
+    { 0x20, { "|pinsrb", "Vx,Hx,Ed,Ib" } }, { 0x21, { "|insertps", "Vx,Hx,Wd,Ib" } }, { 0x22, { "|pinsrd/pinsrd/pinsrq", "Vx,Hx,Ey,Ib" } },
+    { 0x38, { "|inserti128", "Vx,Hx,Wo,Ib" } }, { 0x39, { "|extracti128", "Wo,Vx,Ib" } },
+    { 0x40, { "|dpps", "Vx,Hx,Wx,Ib" } }, { 0x41, { "|dppd", "Vx,Hx,Wx,Ib" } }, { 0x42, { "|mpsadbw", "Vx,Hx,Wx,Ib" } }, { 0x44, { "|pclmulqdq", "Vx,Hx,Wx,Ib" } },
+    { 0x46, { "|perm2i128", "Vx,Hx,Wx,Ib" } }, { 0x4A, { "|blendvps", "Vx,Hx,Wx,Ib" } }, { 0x4B, { "|blendvpd", "Vx,Hx,Wx,Ib" } }, { 0x4C, { "|pblendvb", "Vx,Hx,Wx,Ib" } },
+    { 0x60, { "|pcmpestrm", "Vx,Wx,Ib" } }, { 0x61, { "|pcmpestri", "Vx,Wx,Ib" } }, { 0x62, { "|pcmpistrm", "Vx,Wx,Ib" } }, { 0x63, { "|pcmpistri", "Vx,Wx,Ib" } },
+    { 0xDF, { "|aeskeygenassist", "Vx,Wx,Ib" } }, { 0xF0, { "|||rorx", "Gy,Ey,Ib" } },
+};
+
+#undef X86_PQ
+
+struct opcode_map
+{
+    opcode_spec specs[256];
+};
+
+template<size_t N>
+constexpr opcode_map x86_sparse_map(const sparse_spec (&named)[N], opcode_spec unnamed) {
+    opcode_map map = {};
+    for (size_t i = 0; i < 256; i++) {
+        map.specs[i] = unnamed;
+    }
+    for (size_t i = 0; i < N; i++) {
+        map.specs[named[i].opcode] = named[i].spec;
+    }
+    return map;
+}
+
+constexpr opcode_map X86_THREE_BYTE_38 = x86_sparse_map(X86_0F38_NAMED, opcode_spec{ "", "Vx,Wx" });
+constexpr opcode_map X86_THREE_BYTE_3A = x86_sparse_map(X86_0F3A_NAMED, opcode_spec{ "", "Vx,Wx,Ib" });
+
+// Decoder flags per opcode, derived from the specs at compile time.
+const uint16_t X86_OP_MODRM = 0x0001;
+const uint16_t X86_OP_IMMEDIATE = 0x000E;     // X86_IMM_* << 1
+const uint16_t X86_OP_RELATIVE = 0x0010;
+const uint16_t X86_OP_MOFFS = 0x0020;
+const uint16_t X86_OP_PREFIX = 0x0040;
+const uint16_t X86_OP_INVALID = 0x0080;
+const uint16_t X86_OP_GROUP3 = 0x0100;        // immediate only for modrm.reg 0 and 1 (test)
+const uint16_t X86_OP_ESCAPE = 0x0200;
+const uint16_t X86_OP_REGISTER = 0x0400;      // modrm names registers whatever its mod field says
+const uint16_t X86_OP_FLOW = 0x7000;          // x86_flow << 12
+
+const uint16_t X86_IMM_NONE = 0;
+const uint16_t X86_IMM_B = 1;
+const uint16_t X86_IMM_W = 2;
+const uint16_t X86_IMM_Z = 3;                 // 2 with a 66 prefix, else 4
+const uint16_t X86_IMM_V = 4;                 // 8 with REX.W, 2 with a 66 prefix, else 4
+const uint16_t X86_IMM_WB = 5;                // enter: imm16 then imm8
+const uint16_t X86_IMM_D = 6;
+const uint16_t X86_IMM_O = 7;                 // moffs: 8, 4 with a 67 prefix
+
+const uint16_t X86_FLOW_CALL = 1;
+const uint16_t X86_FLOW_JUMP = 2;
+const uint16_t X86_FLOW_BRANCH = 3;
+const uint16_t X86_FLOW_RET = 4;
+
+constexpr bool x86_starts_with(const char* text, const char* prefix) {
+    for (; *prefix; text++, prefix++) {
+        if (*text != *prefix) {
+            return false;
+        }
+    }
+    return true;
+}
+
+constexpr uint16_t x86_operand_flags(const char* operands) {
+    uint16_t flags = 0;
+    uint16_t immediate = X86_IMM_NONE;
+    bool token_start = true;
+    for (const char* p = operands; *p; p++) {
+        if (*p == ',' || *p == '|') {
+            token_start = true;
+            continue;
+        }
+        if (!token_start) {
+            continue;
+        }
+        token_start = false;
+        char size = p[1];
+        switch (*p) {
+        case 'E': case 'G': case 'M': case 'R': case 'V': case 'W': case 'U':
+        case 'P': case 'Q': case 'N': case 'S': case 'F':
+            flags |= X86_OP_MODRM;
+            break;
+        case 'C': case 'D':
+            flags |= X86_OP_MODRM | X86_OP_REGISTER;
+            break;
+        case 'I':
+            immediate = immediate == X86_IMM_W && size == 'b' ? X86_IMM_WB
+                      : size == 'b' ? X86_IMM_B : size == 'w' ? X86_IMM_W : size == 'z' ? X86_IMM_Z : size == 'v' ? X86_IMM_V : X86_IMM_D;
+            break;
+        case 'J':
+            immediate = size == 'b' ? X86_IMM_B : X86_IMM_D;
+            flags |= X86_OP_RELATIVE;
+            break;
+        case 'O':
+            immediate = X86_IMM_O;
+            flags |= X86_OP_MOFFS;
+            break;
+        case '~':
+            flags |= X86_OP_PREFIX;
+            break;
+        case '^':
+            flags |= X86_OP_ESCAPE;
+            break;
+        default:
+            break;
+        }
+    }
+    return static_cast<uint16_t>(flags | immediate << 1);
+}
+
+constexpr uint16_t x86_mnemonic_flow(const char* mnemonic, bool relative) {
+    return relative && x86_starts_with(mnemonic, "call") ? X86_FLOW_CALL
+         : relative && x86_starts_with(mnemonic, "jmp") ? X86_FLOW_JUMP
+         : relative && (mnemonic[0] == 'j' || x86_starts_with(mnemonic, "loop")) ? X86_FLOW_BRANCH
+         : x86_starts_with(mnemonic, "ret") || x86_starts_with(mnemonic, "iret") ? X86_FLOW_RET
+         : 0;
+}
+
+constexpr uint16_t x86_spec_flags(const opcode_spec& spec) {
+    if (!spec.mnemonic) {
+        return X86_OP_INVALID;
+    }
+    uint16_t flags = x86_operand_flags(spec.operands);
+    if (x86_starts_with(spec.mnemonic, "#3")) {
+        flags |= X86_OP_GROUP3;
+    }
+    return static_cast<uint16_t>(flags | x86_mnemonic_flow(spec.mnemonic, (flags & X86_OP_RELATIVE) != 0) << 12);
+}
+
+struct opcode_flags
+{
+    uint16_t flags[256];
+};
+
+constexpr opcode_flags x86_build_flags(const opcode_spec* specs) {
+    opcode_flags table = {};
+    for (size_t i = 0; i < 256; i++) {
+        table.flags[i] = x86_spec_flags(specs[i]);
+    }
+    return table;
+}
+#endif // !X86_TABLES_H
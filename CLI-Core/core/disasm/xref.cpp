@@ -0,0 +1,473 @@
+#include "xref.h"
+#include "x86_decoder.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char XREF_MAGIC[8] = { 'M', 'S', 'X', 'R', 'E', 'F', '1', 0 };
+static const char* XREF_DIRECTORY = "xref";
+static const size_t XREF_HEADER_PAGE = 0x1000;
+static const size_t XREF_PAGE = 0x1000;
+// Work unit of the parallel sweep; a few per core on typical code sections.
+static const size_t XREF_CHUNK = 256 * 1024;
+
+namespace {
+    struct code_region
+    {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    struct xref_record
+    {
+        uint32_t target;
+        uint32_t source;
+        xref_kind kind;
+    };
+
+    struct sweep_chunk
+    {
+        size_t region;
+        size_t begin;
+        size_t end;
+        size_t stop;
+        uint64_t instructions;
+        std::vector<uint32_t> references;
+        std::vector<xref_record> records;
+    };
+
+    uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash) {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    template<typename T>
+    bool header_value(const std::vector<uint8_t>& header, uint64_t offset, T& value) {
+        if (offset + sizeof(T) > header.size()) {
+            return false;
+        }
+        memcpy(&value, header.data() + offset, sizeof(T));
+        return true;
+    }
+
+    bool read_header_page(const xref_reader& read, const module_range& module, std::vector<uint8_t>& header) {
+        header.resize(static_cast<size_t>((std::min)(static_cast<uint64_t>(XREF_HEADER_PAGE), module.size)));
+        return !header.empty() && read(module.base, header.data(), header.size());
+    }
+
+    // Executable sections (PE) or PF_X load segments (ELF) as offsets from the module base,
+    // cut to the module. Only tables inside the header page are looked at.
+    void find_code(const std::vector<uint8_t>& header, const module_range& module, std::vector<code_region>& regions) {
+        if (header.size() >= 4 && header[0] == 'M' && header[1] == 'Z') {
+            uint32_t nt_offset = 0;
+            uint16_t sections = 0;
+            uint16_t optional_size = 0;
+            if (!header_value(header, 0x3C, nt_offset) || !header_value(header, nt_offset + 6, sections) ||
+                !header_value(header, nt_offset + 0x14, optional_size)) {
+                return;
+            }
+            // IMAGE_SECTION_HEADER: VirtualSize at 8, VirtualAddress at 12, Characteristics at 36.
+            uint64_t table = static_cast<uint64_t>(nt_offset) + 0x18 + optional_size;
+            for (uint16_t i = 0; i < sections; i++) {
+                uint32_t virtual_size = 0;
+                uint32_t virtual_address = 0;
+                uint32_t characteristics = 0;
+                if (!header_value(header, table + i * 40 + 8, virtual_size) || !header_value(header, table + i * 40 + 12, virtual_address) ||
+                    !header_value(header, table + i * 40 + 36, characteristics)) {
+                    return;
+                }
+                if ((characteristics & 0x20000000) && virtual_size) {
+                    regions.push_back(code_region{virtual_address, virtual_size});
+                }
+            }
+        }
+        else if (header.size() >= 4 && header[0] == 0x7F && header[1] == 'E' && header[2] == 'L' && header[3] == 'F') {
+            uint64_t header_offset = 0;
+            uint16_t header_count = 0;
+            if (!header_value(header, 0x20, header_offset) || !header_value(header, 0x38, header_count)) {
+                return;
+            }
+            // Elf64_Phdr: type, flags, offset, vaddr, paddr, filesz, memsz, align.
+            uint64_t first_load = UINT64_MAX;
+            for (uint16_t pass = 0; pass < 2; pass++) {
+                for (uint16_t i = 0; i < header_count; i++) {
+                    uint64_t entry = header_offset + i * 56ull;
+                    uint32_t type = 0;
+                    uint32_t flags = 0;
+                    uint64_t address = 0;
+                    uint64_t memory_size = 0;
+                    if (!header_value(header, entry, type) || !header_value(header, entry + 4, flags) ||
+                        !header_value(header, entry + 0x10, address) || !header_value(header, entry + 0x28, memory_size)) {
+                        return;
+                    }
+                    if (type != 1) {
+                        continue;
+                    }
+                    if (pass == 0) {
+                        first_load = (std::min)(first_load, address & ~static_cast<uint64_t>(0xFFF));
+                    }
+                    else if ((flags & 1) && memory_size) {
+                        regions.push_back(code_region{address - first_load, memory_size});
+                    }
+                }
+            }
+        }
+
+        for (code_region& region : regions) {
+            region.size = region.offset < module.size ? (std::min)(region.size, module.size - region.offset) : 0;
+        }
+        regions.erase(std::remove_if(regions.begin(), regions.end(), [] (const code_region& region) {
+            return region.size == 0;
+        }), regions.end());
+    }
+
+    // A page that cannot be read is left as zeros; the sweep steps over it like any other bytes.
+    void read_region(const xref_reader& read, uint64_t address, std::vector<uint8_t>& code) {
+        if (read(address, code.data(), code.size())) {
+            return;
+        }
+        for (size_t offset = 0; offset < code.size(); offset += XREF_PAGE) {
+            size_t size = (std::min)(XREF_PAGE, code.size() - offset);
+            if (!read(address + offset, code.data() + offset, size)) {
+                memset(code.data() + offset, 0, size);
+            }
+        }
+    }
+
+    void parallel_for(size_t count, uint32_t threads, const std::function<void(size_t)>& body) {
+        std::atomic<size_t> next(0);
+        auto work = [&] () {
+            for (size_t i = next++; i < count; i = next++) {
+                body(i);
+            }
+        };
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < threads && i < count; i++) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // The previous chunk ended at start, past this chunk's begin: walk from there alongside the
+    // speculative walk from begin until they reach the same instruction start, and replace what
+    // the speculative walk found before it. If they never meet, the true walk covers the chunk.
+    void resync(const uint8_t* code, size_t size, size_t start, sweep_chunk& chunk) {
+        size_t speculative = chunk.begin;
+        size_t actual = start;
+        uint64_t speculative_count = 0;
+        uint64_t actual_count = 0;
+        std::vector<uint32_t> references;
+        x86_instruction instruction;
+        while (speculative != actual && actual < chunk.end) {
+            bool is_actual = actual < speculative;
+            size_t& position = is_actual ? actual : speculative;
+            bool decoded = x86_decode(code + position, size - position, instruction);
+            if (decoded && is_actual) {
+                actual_count++;
+                uint64_t target;
+                if (x86_target(instruction, 0, target)) {
+                    references.push_back(static_cast<uint32_t>(position));
+                }
+            }
+            else if (decoded) {
+                speculative_count++;
+            }
+            position += decoded ? instruction.length : 1;
+        }
+
+        if (actual >= chunk.end) {
+            chunk.references.swap(references);
+            chunk.instructions = actual_count;
+            chunk.stop = actual;
+            return;
+        }
+        auto kept = std::lower_bound(chunk.references.begin(), chunk.references.end(), static_cast<uint32_t>(actual));
+        chunk.references.erase(chunk.references.begin(), kept);
+        chunk.references.insert(chunk.references.begin(), references.begin(), references.end());
+        chunk.instructions = chunk.instructions - speculative_count + actual_count;
+    }
+
+    xref_kind kind_of(const x86_instruction& instruction) {
+        switch (instruction.flow) {
+        case x86_flow::call: return xref_kind::call;
+        case x86_flow::jump: return xref_kind::jump;
+        case x86_flow::branch: return xref_kind::branch;
+        default:
+            return instruction.encoding == x86_encoding::legacy && instruction.map == 0 && instruction.opcode == 0x8D
+                   ? xref_kind::address : xref_kind::data;
+        }
+    }
+
+    bool make_directory(const char* path) {
+#ifdef _WIN32
+        return _mkdir(path) == 0 || errno == EEXIST;
+#else
+        return mkdir(path, 0755) == 0 || errno == EEXIST;
+#endif
+    }
+}
+
+bool xref_module_key(const xref_reader& read, const module_range& module, uint64_t& key) {
+    std::vector<uint8_t> header;
+    if (!read_header_page(read, module, header)) {
+        return false;
+    }
+    // The loader writes the base it chose into a relocated PE's ImageBase (optional header + 0x18).
+    uint32_t nt_offset = 0;
+    uint16_t magic = 0;
+    if (header[0] == 'M' && header[1] == 'Z' && header_value(header, 0x3C, nt_offset) &&
+        header_value(header, nt_offset + 0x18, magic) && magic == 0x20B && nt_offset + 0x18 + 0x20 <= header.size()) {
+        memset(header.data() + nt_offset + 0x18 + 0x18, 0, 8);
+    }
+    key = fnv1a(reinterpret_cast<const uint8_t*>(&module.size), sizeof(module.size), 0xCBF29CE484222325ull);
+    key = fnv1a(header.data(), header.size(), key);
+    return true;
+}
+
+const char* xref_kind_name(xref_kind kind) {
+    switch (kind) {
+    case xref_kind::call: return "call";
+    case xref_kind::jump: return "jump";
+    case xref_kind::branch: return "branch";
+    case xref_kind::data: return "data";
+    case xref_kind::address: return "address";
+    }
+    return "?";
+}
+
+bool xref_build(const xref_reader& read, const module_range& module, uint64_t key, const std::string& path, xref_build_stats& stats) {
+    uint64_t before = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    stats = xref_build_stats();
+    std::vector<uint8_t> header;
+    std::vector<code_region> regions;
+    if (!read_header_page(read, module, header)) {
+        return false;
+    }
+    find_code(header, module, regions);
+    if (regions.empty() || module.size > UINT32_MAX) {
+        return false;
+    }
+
+    std::vector<std::vector<uint8_t>> code(regions.size());
+    std::vector<sweep_chunk> chunks;
+    for (size_t i = 0; i < regions.size(); i++) {
+        code[i].resize(static_cast<size_t>(regions[i].size));
+        read_region(read, module.base + regions[i].offset, code[i]);
+        stats.code_bytes += regions[i].size;
+        for (size_t begin = 0; begin < code[i].size(); begin += XREF_CHUNK) {
+            sweep_chunk chunk;
+            chunk.region = i;
+            chunk.begin = begin;
+            chunk.end = (std::min)(code[i].size(), begin + XREF_CHUNK);
+            chunk.stop = chunk.end;
+            chunk.instructions = 0;
+            chunks.push_back(std::move(chunk));
+        }
+    }
+    stats.threads = (std::max)(1u, std::thread::hardware_concurrency());
+    stats.chunks = static_cast<uint32_t>(chunks.size());
+
+    parallel_for(chunks.size(), stats.threads, [&] (size_t i) {
+        sweep_chunk& chunk = chunks[i];
+        const std::vector<uint8_t>& bytes = code[chunk.region];
+        chunk.stop = x86_sweep(bytes.data(), bytes.size(), chunk.begin, chunk.end, chunk.references, chunk.instructions);
+    });
+    for (size_t i = 1; i < chunks.size(); i++) {
+        sweep_chunk& previous = chunks[i - 1];
+        sweep_chunk& chunk = chunks[i];
+        if (previous.region == chunk.region && previous.stop != chunk.begin) {
+            const std::vector<uint8_t>& bytes = code[chunk.region];
+            resync(bytes.data(), bytes.size(), previous.stop, chunk);
+            stats.resynced++;
+        }
+    }
+    parallel_for(chunks.size(), stats.threads, [&] (size_t i) {
+        sweep_chunk& chunk = chunks[i];
+        const std::vector<uint8_t>& bytes = code[chunk.region];
+        uint64_t region_address = module.base + regions[chunk.region].offset;
+        chunk.records.reserve(chunk.references.size());
+        x86_instruction instruction;
+        for (uint32_t offset : chunk.references) {
+            uint64_t target = 0;
+            if (!x86_decode(bytes.data() + offset, bytes.size() - offset, instruction) ||
+                !x86_target(instruction, region_address + offset, target) || target - module.base >= module.size) {
+                continue;
+            }
+            chunk.records.push_back(xref_record{static_cast<uint32_t>(target - module.base),
+                                                static_cast<uint32_t>(regions[chunk.region].offset + offset), kind_of(instruction)});
+        }
+    });
+
+    std::vector<xref_record> records;
+    for (sweep_chunk& chunk : chunks) {
+        stats.instructions += chunk.instructions;
+        records.insert(records.end(), chunk.records.begin(), chunk.records.end());
+        std::vector<xref_record>().swap(chunk.records);
+    }
+    std::sort(records.begin(), records.end(), [] (const xref_record& a, const xref_record& b) {
+        return a.target != b.target ? a.target < b.target : a.source < b.source;
+    });
+    stats.references = records.size();
+
+    std::vector<xref_entry> entries(records.size());
+    std::vector<uint8_t> kinds(records.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        entries[i] = xref_entry{records[i].target, records[i].source};
+        kinds[i] = static_cast<uint8_t>(records[i].kind);
+    }
+    xref_file_header file_header = {};
+    memcpy(file_header.magic, XREF_MAGIC, sizeof(XREF_MAGIC));
+    file_header.key = key;
+    file_header.image_size = module.size;
+    file_header.count = entries.size();
+    file_header.instructions = stats.instructions;
+    file_header.code_bytes = stats.code_bytes;
+
+    // Written aside and renamed, so a reader never maps a half-written index.
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool written = fwrite(&file_header, sizeof(file_header), 1, file) == 1 &&
+                   fwrite(entries.data(), sizeof(xref_entry), entries.size(), file) == entries.size() &&
+                   fwrite(kinds.data(), 1, kinds.size(), file) == kinds.size();
+    written = fclose(file) == 0 && written;
+    remove(path.c_str());
+    if (!written || rename(temporary.c_str(), path.c_str()) != 0) {
+        remove(temporary.c_str());
+        return false;
+    }
+    stats.nanoseconds = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count()) - before;
+    return true;
+}
+
+bool xref_index::open(const std::string& path, uint64_t key) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    LARGE_INTEGER size = {};
+    HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart >= static_cast<LONGLONG>(sizeof(xref_file_header))
+                     ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    // The view keeps the file mapped after both handles are closed.
+    view = mapping ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    view_size = static_cast<size_t>(size.QuadPart);
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        return false;
+    }
+    struct stat status = {};
+    void* mapped = fstat(file, &status) == 0 && status.st_size >= static_cast<off_t>(sizeof(xref_file_header))
+                   ? mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+    view = mapped != MAP_FAILED ? static_cast<const uint8_t*>(mapped) : nullptr;
+    view_size = static_cast<size_t>(status.st_size);
+    ::close(file);
+#endif
+    if (!view) {
+        view_size = 0;
+        return false;
+    }
+    header = reinterpret_cast<const xref_file_header*>(view);
+    if (memcmp(header->magic, XREF_MAGIC, sizeof(XREF_MAGIC)) != 0 || header->key != key ||
+        header->count > (view_size - sizeof(xref_file_header)) / (sizeof(xref_entry) + 1) ||
+        view_size != sizeof(xref_file_header) + header->count * (sizeof(xref_entry) + 1)) {
+        close();
+        return false;
+    }
+    entries = reinterpret_cast<const xref_entry*>(view + sizeof(xref_file_header));
+    kinds = view + sizeof(xref_file_header) + header->count * sizeof(xref_entry);
+    return true;
+}
+
+void xref_index::close() {
+    if (view) {
+#ifdef _WIN32
+        UnmapViewOfFile(view);
+#else
+        munmap(const_cast<uint8_t*>(view), view_size);
+#endif
+    }
+    view = nullptr;
+    view_size = 0;
+    header = nullptr;
+    entries = nullptr;
+    kinds = nullptr;
+}
+
+void xref_index::find(uint32_t low, uint32_t high, size_t& first, size_t& last) const {
+    const xref_entry* end = entries + get_count();
+    const xref_entry* lower = std::lower_bound(entries, end, low, [] (const xref_entry& entry, uint32_t target) {
+        return entry.target < target;
+    });
+    const xref_entry* upper = std::upper_bound(lower, end, high, [] (uint32_t target, const xref_entry& entry) {
+        return target < entry.target;
+    });
+    first = static_cast<size_t>(lower - entries);
+    last = static_cast<size_t>(upper - entries);
+}
+
+std::string xref_store::path_for(const module_range& module, uint64_t key) const {
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-%016llx.xref", static_cast<unsigned long long>(key));
+    return std::string(XREF_DIRECTORY) + "/" + module.name.substr(module.name.find_last_of("/\\") + 1) + suffix;
+}
+
+const xref_index* xref_store::find(const module_range& module) const {
+    for (const loaded_index& loaded : indexes) {
+        if (loaded.module.base == module.base && loaded.module.size == module.size && loaded.module.name == module.name) {
+            return loaded.index.get();
+        }
+    }
+    return nullptr;
+}
+
+const xref_index* xref_store::load(const xref_reader& read, const module_range& module, bool allow_build, bool& built, xref_build_stats& stats) {
+    built = false;
+    uint64_t key = 0;
+    if (!xref_module_key(read, module, key)) {
+        return nullptr;
+    }
+    // Another module loaded at this base, or another build of this one, replaces the old index.
+    indexes.erase(std::remove_if(indexes.begin(), indexes.end(), [&] (const loaded_index& loaded) {
+        return loaded.module.base == module.base || (loaded.key == key && loaded.module.name == module.name);
+    }), indexes.end());
+
+    std::string path = path_for(module, key);
+    std::unique_ptr<xref_index> index(new xref_index());
+    if (!index->open(path, key)) {
+        if (!allow_build || !make_directory(XREF_DIRECTORY) || !xref_build(read, module, key, path, stats) || !index->open(path, key)) {
+            return nullptr;
+        }
+        built = true;
+    }
+    indexes.push_back(loaded_index{module, key, std::move(index)});
+    return indexes.back().index.get();
+}
@@ -0,0 +1,119 @@
+#ifndef XREF_H
+#define XREF_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../debugger/modules.h"
+
+enum class xref_kind : uint8_t
+{
+    call,
+    jump,
+    branch,             // conditional, loop and jrcxz
+    data,               // rip-relative memory operand, including call/jmp through one
+    address,            // lea of a rip-relative address
+};
+
+// One reference, both ends as offsets from the module base.
+struct xref_entry
+{
+    uint32_t target;
+    uint32_t source;
+};
+
+// Index file: this header, the entries sorted by target then source, then one xref_kind byte
+// per entry in the same order. key is the module's xref_module_key.
+struct xref_file_header
+{
+    char magic[8];
+    uint64_t key;
+    uint64_t image_size;
+    uint64_t count;
+    uint64_t instructions;
+    uint64_t code_bytes;
+};
+
+// Reads size bytes of the target at address; false when any of them cannot be read.
+using xref_reader = std::function<bool(uint64_t address, void* buffer, size_t size)>;
+
+// Identifies one build of an image: a hash of its size and header page (PE headers with the
+// image base zeroed, the ELF header, program headers and build id), which every load of the
+// same file shares wherever it is mapped.
+bool xref_module_key(const xref_reader& read, const module_range& module, uint64_t& key);
+
+const char* xref_kind_name(xref_kind kind);
+
+struct xref_build_stats
+{
+    uint64_t instructions;
+    uint64_t references;
+    uint64_t code_bytes;
+    uint32_t threads;
+    uint32_t chunks;
+    uint32_t resynced;          // chunks whose speculative start was not an instruction start
+    uint64_t nanoseconds;
+};
+
+// Decodes every executable section of module on all cores and writes the index file. Each
+// chunk is swept from its own start; afterwards each chunk start is checked in order against
+// where the previous chunk really ended and the chunk is walked again from there until both
+// walks meet, so the index holds exactly what one linear sweep of each section would find.
+// Targets outside the image are not recorded.
+bool xref_build(const xref_reader& read, const module_range& module, uint64_t key, const std::string& path, xref_build_stats& stats);
+
+// A read-only mapping of one index file; lookups are binary searches over the mapped entries.
+class xref_index
+{
+    const uint8_t* view;
+    size_t view_size;
+    const xref_file_header* header;
+    const xref_entry* entries;
+    const uint8_t* kinds;
+public:
+    xref_index() : view(nullptr), view_size(0), header(nullptr), entries(nullptr), kinds(nullptr) {}
+    ~xref_index() { close(); }
+    xref_index(const xref_index&) = delete;
+    xref_index& operator=(const xref_index&) = delete;
+
+    // False when the file is missing, damaged or indexes another build than key.
+    bool open(const std::string& path, uint64_t key);
+    void close();
+
+    // Entries [first, last) whose target offset lies in [low, high].
+    void find(uint32_t low, uint32_t high, size_t& first, size_t& last) const;
+    const xref_entry& entry(size_t index) const { return entries[index]; }
+    xref_kind kind(size_t index) const { return static_cast<xref_kind>(kinds[index]); }
+    uint64_t get_count() const { return header ? header->count : 0; }
+    uint64_t get_instructions() const { return header ? header->instructions : 0; }
+};
+
+// The indexes opened so far, one per loaded module; files are cached in the "xref" folder
+// as <module>-<key>.xref. CLI thread only.
+class xref_store
+{
+    struct loaded_index
+    {
+        module_range module;
+        uint64_t key;
+        std::unique_ptr<xref_index> index;
+    };
+    std::vector<loaded_index> indexes;
+
+    xref_store() {}
+public:
+    static xref_store* instance() {
+        static xref_store singleton;
+        return &singleton;
+    }
+
+    std::string path_for(const module_range& module, uint64_t key) const;
+    // The index already opened for this load of module, or null.
+    const xref_index* find(const module_range& module) const;
+    // Opens module's cached index, first building it when allowed and no file matches its key.
+    // built tells whether it was built; stats are only filled then.
+    const xref_index* load(const xref_reader& read, const module_range& module, bool allow_build, bool& built, xref_build_stats& stats);
+};
+#endif // !XREF_H
@@ -0,0 +1,221 @@
+#include "kernel_counters.h"
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // _WIN32
+
+std::atomic<bool> kernel_profiler::enabled(false);
+
+static const char* counter_names[] = { "cycles", "instructions", "llc_misses", "branch_misses" };
+
+#ifdef _WIN32
+hw_counter_group::hw_counter_group() : thread_handle(nullptr), start_cycles(0), opened(false) {}
+
+hw_counter_group::~hw_counter_group() {
+    close();
+}
+
+bool hw_counter_group::open() {
+    thread_handle = GetCurrentThread();
+    accumulated = hw_sample();
+    accumulated.valid[static_cast<int>(hw_counter::cycles)] = true;
+    opened = true;
+    return true;
+}
+
+void hw_counter_group::close() {
+    thread_handle = nullptr;
+    opened = false;
+}
+
+void hw_counter_group::start() {
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(thread_handle, &cycles);
+    start_cycles = cycles;
+}
+
+void hw_counter_group::stop() {
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(thread_handle, &cycles);
+    accumulated.values[static_cast<int>(hw_counter::cycles)] += cycles - start_cycles;
+}
+
+void hw_counter_group::read() {}
+#else
+hw_counter_group::hw_counter_group() : opened(false) {
+    for (int i = 0; i < static_cast<int>(hw_counter::count); i++) {
+        fds[i] = -1;
+        ids[i] = 0;
+    }
+}
+
+hw_counter_group::~hw_counter_group() {
+    close();
+}
+
+bool hw_counter_group::open() {
+    static const struct { uint32_t type; uint64_t config; } events[] = {
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+        { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    };
+
+    close();
+    accumulated = hw_sample();
+    for (int i = 0; i < static_cast<int>(hw_counter::count); i++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID;
+
+        fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+        if (fds[i] < 0) {
+            // Without the cycles leader there is no group; other counters are optional.
+            if (i == 0) {
+                return false;
+            }
+            continue;
+        }
+        ioctl(fds[i], PERF_EVENT_IOC_ID, &ids[i]);
+    }
+    opened = true;
+    return true;
+}
+
+void hw_counter_group::close() {
+    for (int i = static_cast<int>(hw_counter::count) - 1; i >= 0; i--) {
+        if (fds[i] >= 0) {
+            ::close(fds[i]);
+            fds[i] = -1;
+        }
+    }
+    opened = false;
+}
+
+void hw_counter_group::start() {
+    ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void hw_counter_group::stop() {
+    ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void hw_counter_group::read() {
+    struct { uint64_t value; uint64_t id; } entries[static_cast<int>(hw_counter::count)];
+    uint64_t buffer[1 + 2 * static_cast<int>(hw_counter::count)] = {};
+
+    if (!opened || ::read(fds[0], buffer, sizeof(buffer)) <= 0) {
+        return;
+    }
+
+    uint64_t entry_count = buffer[0] < static_cast<uint64_t>(hw_counter::count) ? buffer[0] : static_cast<uint64_t>(hw_counter::count);
+    memcpy(entries, &buffer[1], entry_count * sizeof(entries[0]));
+    for (uint64_t e = 0; e < entry_count; e++) {
+        for (int i = 0; i < static_cast<int>(hw_counter::count); i++) {
+            if (fds[i] >= 0 && ids[i] == entries[e].id) {
+                accumulated.values[i] = entries[e].value;
+                accumulated.valid[i] = true;
+            }
+        }
+    }
+}
+#endif // _WIN32
+
+void kernel_profiler::reset() {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    profiles.clear();
+}
+
+void kernel_profiler::submit(const char* kernel, const char* type, const hw_sample& sample, uint64_t bytes, uint64_t calls, uint64_t ns) {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    kernel_profile* profile = nullptr;
+    for (auto& existing : profiles) {
+        if (existing.kernel == kernel && existing.type == type) {
+            profile = &existing;
+            break;
+        }
+    }
+    if (!profile) {
+        profiles.push_back(kernel_profile());
+        profile = &profiles.back();
+        profile->kernel = kernel;
+        profile->type = type;
+    }
+
+    profile->calls += calls;
+    profile->bytes += bytes;
+    profile->ns += ns;
+    for (int i = 0; i < static_cast<int>(hw_counter::count); i++) {
+        if (sample.valid[i]) {
+            profile->counters.values[i] += sample.values[i];
+            profile->counters.valid[i] = true;
+        }
+    }
+}
+
+static double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+void kernel_profiler::print(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    if (profiles.empty()) {
+        out << "No kernel counters recorded" << (enabled ? ".\n" : " (enable with: stats hw on).\n");
+        return;
+    }
+
+    out << "Kernel counters:\n";
+    for (auto& profile : profiles) {
+        const hw_sample& c = profile.counters;
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(3);
+        line << "  " << profile.kernel << "<" << profile.type << "> calls: " << profile.calls << " bytes: " << profile.bytes
+             << " ns/byte: " << ratio(profile.ns, profile.bytes);
+        if (c.valid[static_cast<int>(hw_counter::cycles)]) {
+            line << " cycles/byte: " << ratio(c.values[static_cast<int>(hw_counter::cycles)], profile.bytes);
+        }
+        if (c.valid[static_cast<int>(hw_counter::cycles)] && c.valid[static_cast<int>(hw_counter::instructions)]) {
+            line << " IPC: " << ratio(c.values[static_cast<int>(hw_counter::instructions)], c.values[static_cast<int>(hw_counter::cycles)]);
+        }
+        if (c.valid[static_cast<int>(hw_counter::llc_misses)]) {
+            line << " LLC misses: " << c.values[static_cast<int>(hw_counter::llc_misses)];
+        }
+        if (c.valid[static_cast<int>(hw_counter::branch_misses)]) {
+            line << " branch misses: " << c.values[static_cast<int>(hw_counter::branch_misses)];
+        }
+        if (!c.valid[static_cast<int>(hw_counter::cycles)]) {
+            line << " (hardware counters unavailable)";
+        }
+        out << line.str() << "\n";
+    }
+}
+
+void kernel_profiler::write_json(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(profiles_mutex);
+    out << "[";
+    for (size_t p = 0; p < profiles.size(); p++) {
+        const kernel_profile& profile = profiles[p];
+        out << (p ? "," : "") << "{\"kernel\":\"" << profile.kernel << "\",\"type\":\"" << profile.type
+            << "\",\"calls\":" << profile.calls << ",\"bytes\":" << profile.bytes << ",\"ns\":" << profile.ns;
+        for (int i = 0; i < static_cast<int>(hw_counter::count); i++) {
+            if (profile.counters.valid[i]) {
+                out << ",\"" << counter_names[i] << "\":" << profile.counters.values[i];
+            }
+        }
+        out << "}";
+    }
+    out << "]";
+}
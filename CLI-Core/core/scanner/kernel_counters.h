@@ -0,0 +1,135 @@
+#ifndef KERNEL_COUNTERS_H
+#define KERNEL_COUNTERS_H
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hardware counters for the scan kernels. On Linux the full group is read through
+// perf_event_open; Windows exposes no PMU to user mode, so only thread cycles are filled.
+enum class hw_counter : int { cycles, instructions, llc_misses, branch_misses, count };
+
+struct hw_sample
+{
+    uint64_t values[static_cast<int>(hw_counter::count)] = {};
+    bool valid[static_cast<int>(hw_counter::count)] = {};
+};
+
+class hw_counter_group
+{
+#ifdef _WIN32
+    void* thread_handle;
+    uint64_t start_cycles;
+#else
+    int fds[static_cast<int>(hw_counter::count)];
+    uint64_t ids[static_cast<int>(hw_counter::count)];
+#endif // _WIN32
+    hw_sample accumulated;
+    bool opened;
+public:
+    hw_counter_group();
+    ~hw_counter_group();
+    hw_counter_group(const hw_counter_group&) = delete;
+    hw_counter_group& operator=(const hw_counter_group&) = delete;
+
+    // Counts the calling thread only.
+    bool open();
+    void close();
+    void start();
+    void stop();
+    // Folds the totals counted between start()/stop() pairs into sample().
+    void read();
+    bool is_open() const { return opened; }
+    const hw_sample& sample() const { return accumulated; }
+};
+
+struct kernel_profile
+{
+    std::string kernel;
+    std::string type;
+    uint64_t calls = 0;
+    uint64_t bytes = 0;
+    uint64_t ns = 0;
+    hw_sample counters;
+};
+
+class kernel_profiler
+{
+    std::mutex profiles_mutex;
+    std::vector<kernel_profile> profiles;
+    kernel_profiler() {}
+public:
+    static std::atomic<bool> enabled;
+
+    static kernel_profiler* instance() {
+        static kernel_profiler singleton;
+        return &singleton;
+    }
+    void reset();
+    void submit(const char* kernel, const char* type, const hw_sample& sample, uint64_t bytes, uint64_t calls, uint64_t ns);
+    void print(std::ostream& out);
+    void write_json(std::ostream& out);
+};
+
+template<typename T> inline const char* kernel_type_name() { return "unknown"; }
+template<> inline const char* kernel_type_name<int>() { return "int"; }
+
+// Opens a counter group for the calling thread when profiling is enabled and
+// submits it on destruction; start()/stop() bracket the kernel's inner loop.
+// Wall time is always recorded, so hosts without a PMU still get ns/byte.
+class kernel_counter_scope
+{
+    hw_counter_group group;
+    const char* kernel;
+    const char* type;
+    uint64_t bytes;
+    uint64_t calls;
+    uint64_t ns;
+    std::chrono::steady_clock::time_point started;
+    bool active;
+public:
+    kernel_counter_scope(const char* kernel, const char* type)
+        : kernel(kernel), type(type), bytes(0), calls(0), ns(0), active(kernel_profiler::enabled.load(std::memory_order_relaxed)) {
+        if (active) {
+            group.open();
+        }
+    }
+    ~kernel_counter_scope() {
+        if (active) {
+            if (group.is_open()) {
+                group.read();
+            }
+            kernel_profiler::instance()->submit(kernel, type, group.sample(), bytes, calls, ns);
+        }
+    }
+    void start() {
+        if (active) {
+            if (group.is_open()) {
+                group.start();
+            }
+            started = std::chrono::steady_clock::now();
+        }
+    }
+    // Leaves out work the kernel calls into, such as a page read, without ending the call.
+    void pause() {
+        if (active) {
+            ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+            if (group.is_open()) {
+                group.stop();
+            }
+        }
+    }
+    void resume() { start(); }
+    void stop(uint64_t processed_bytes) {
+        if (active) {
+            pause();
+            bytes += processed_bytes;
+            calls++;
+        }
+    }
+};
+
+#endif // !KERNEL_COUNTERS_H
@@ -0,0 +1,102 @@
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// Inner loops of the scanner, kept free of Win32 types so they can be driven
+// on plain buffers by benchmarks/kernel_bench.
+
+template<typename T>
+struct scanned_value
+{
+    T value;
+    uintptr_t address;
+};
+
+// Appends every element equal to value to cache; flush() is called whenever the cache fills up.
+template<typename T, typename Flush>
+inline void search_kernel_scalar(const T* data, size_t count, T value, uintptr_t base_address,
+                                 scanned_value<T>* cache, size_t& cache_count, size_t cache_size, Flush&& flush) {
+    for (size_t j = 0; j < count; j++) {
+        if (data[j] == value) {
+            cache[cache_count++] = {data[j], base_address + j * sizeof(T)};
+
+            if (cache_count == cache_size) {
+                flush();
+            }
+        }
+    }
+}
+
+// Small round-robin cache of target pages used by the filter pass. The reader is
+// called as reader(page_address, destination, block_size) and returns false on failure.
+template<typename T, size_t BLOCK_SIZE = 4096, size_t PAGE_CACHE_SIZE = 32>
+class scan_page_cache
+{
+    struct page_entry
+    {
+        uintptr_t page_addr;
+        T data[BLOCK_SIZE / sizeof(T)];
+        bool valid;
+    };
+
+    std::unique_ptr<page_entry[]> pages;
+    size_t cache_next;
+public:
+    scan_page_cache() : pages(new page_entry[PAGE_CACHE_SIZE]), cache_next(0) {
+        memset(pages.get(), 0, sizeof(page_entry) * PAGE_CACHE_SIZE);
+    }
+
+    template<typename Reader>
+    const T* get(uintptr_t addr, Reader&& reader) {
+        uintptr_t page_addr = addr & ~(static_cast<uintptr_t>(BLOCK_SIZE) - 1);
+
+        for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
+            if (pages[i].valid && pages[i].page_addr == page_addr) {
+                return pages[i].data;
+            }
+        }
+
+        page_entry& new_cache = pages[cache_next];
+        cache_next = (cache_next + 1) % PAGE_CACHE_SIZE;
+
+        new_cache.valid = false;
+        new_cache.page_addr = page_addr;
+
+        if (reader(page_addr, new_cache.data, BLOCK_SIZE)) {
+            new_cache.valid = true;
+            return new_cache.data;
+        }
+
+        return nullptr;
+    }
+
+    static size_t offset_of(uintptr_t addr) {
+        return (addr & (BLOCK_SIZE - 1)) / sizeof(T);
+    }
+};
+
+// Keeps the candidates in [begin, end) whose current value equals value.
+template<typename T, typename PageCache, typename Reader, typename Flush>
+inline void filter_kernel_scalar(const scanned_value<T>* begin, const scanned_value<T>* end, T value,
+                                 PageCache& page_cache, Reader&& reader,
+                                 scanned_value<T>* cache, size_t& cache_count, size_t cache_size, Flush&& flush) {
+    for (const scanned_value<T>* candidate = begin; candidate != end; candidate++) {
+        uintptr_t addr = candidate->address;
+        const T* page_data = page_cache.get(addr, reader);
+
+        if (page_data) {
+            if (page_data[PageCache::offset_of(addr)] == value) {
+                cache[cache_count++] = {value, addr};
+
+                if (cache_count == cache_size) {
+                    flush();
+                }
+            }
+        }
+    }
+}
+
+#endif // !SCAN_KERNELS_H
@@ -0,0 +1,149 @@
+#include "scan_stats.h"
+#include "kernel_counters.h"
+#include <iostream>
+#include <sstream>
+
+static const char* phase_names[] = { "query", "read", "compare", "merge", "print" };
+
+static std::string escape_json(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+        case '"': escaped += "\\\""; break;
+        case '\\': escaped += "\\\\"; break;
+        case '\n': escaped += "\\n"; break;
+        case '\t': escaped += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                continue;
+            }
+            escaped += c;
+            break;
+        }
+    }
+    return escaped;
+}
+
+void scan_stats::begin(const std::string& command) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    last_command = command;
+    thread_stats.clear();
+    command_ns = 0;
+    peak_candidate_bytes = candidate_bytes.load();
+    kernel_profiler::instance()->reset();
+    command_start = std::chrono::steady_clock::now();
+}
+
+void scan_stats::end() {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    auto elapsed = std::chrono::steady_clock::now() - command_start;
+    command_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+void scan_stats::submit(const scan_thread_stats& stats) {
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    thread_stats.push_back(stats);
+    thread_stats.back().thread_id = GetCurrentThreadId();
+}
+
+void scan_stats::track_memory(int64_t delta) {
+    int64_t current = candidate_bytes.fetch_add(delta) + delta;
+    int64_t peak = peak_candidate_bytes.load();
+    while (current > peak && !peak_candidate_bytes.compare_exchange_weak(peak, current)) {}
+}
+
+void scan_stats::print(bool json) {
+#ifndef SCAN_STATS_ENABLED
+    std::cout << "Scanner statistics are disabled in this build (DISABLE_SCAN_STATS).\n";
+#else
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    const int phase_count = static_cast<int>(scan_phase::count);
+
+    scan_thread_stats total;
+    for (auto& stats : thread_stats) {
+        total.regions_queried += stats.regions_queried;
+        total.regions_visited += stats.regions_visited;
+        total.bytes_read += stats.bytes_read;
+        total.failed_reads += stats.failed_reads;
+        total.syscalls += stats.syscalls;
+        total.compared_bytes += stats.compared_bytes;
+        for (int i = 0; i < phase_count; i++) {
+            total.phase_ns[i] += stats.phase_ns[i];
+        }
+    }
+
+    auto ns_per_byte = [] (const scan_thread_stats& stats) -> double {
+        if (!stats.compared_bytes) {
+            return 0.0;
+        }
+        return static_cast<double>(stats.phase_ns[static_cast<int>(scan_phase::compare)]) / stats.compared_bytes;
+    };
+
+    std::ostringstream ss;
+    if (json) {
+        auto write_counters = [&] (const scan_thread_stats& stats) {
+            ss << "\"regions_queried\":" << stats.regions_queried
+               << ",\"regions_visited\":" << stats.regions_visited
+               << ",\"bytes_read\":" << stats.bytes_read
+               << ",\"failed_reads\":" << stats.failed_reads
+               << ",\"syscalls\":" << stats.syscalls
+               << ",\"compared_bytes\":" << stats.compared_bytes
+               << ",\"compare_ns_per_byte\":" << ns_per_byte(stats)
+               << ",\"phase_ns\":{";
+            for (int i = 0; i < phase_count; i++) {
+                ss << (i ? "," : "") << "\"" << phase_names[i] << "\":" << stats.phase_ns[i];
+            }
+            ss << "}";
+        };
+
+        ss << "{\"command\":\"" << escape_json(last_command) << "\""
+           << ",\"wall_ns\":" << command_ns
+           << ",\"peak_candidate_bytes\":" << peak_candidate_bytes.load()
+           << ",\"total\":{";
+        write_counters(total);
+        ss << "},\"threads\":[";
+        for (size_t i = 0; i < thread_stats.size(); i++) {
+            ss << (i ? "," : "") << "{\"thread_id\":" << thread_stats[i].thread_id << ",";
+            write_counters(thread_stats[i]);
+            ss << "}";
+        }
+        ss << "],\"kernels\":";
+        kernel_profiler::instance()->write_json(ss);
+        ss << "}";
+        std::cout << ss.str() << std::endl;
+        return;
+    }
+
+    if (last_command.empty()) {
+        std::cout << "No command recorded yet.\n";
+        return;
+    }
+
+    ss << "Last command: " << last_command << "\n";
+    ss << "Wall time: " << command_ns / 1000000.0 << " ms\n";
+    ss << "Regions queried: " << total.regions_queried << ", scanned: " << total.regions_visited << "\n";
+    ss << "Bytes read: " << total.bytes_read << " (" << total.failed_reads << " failed reads)\n";
+    ss << "Syscalls: " << total.syscalls << "\n";
+    ss << "Compare: " << ns_per_byte(total) << " ns/byte\n";
+    ss << "Peak candidate memory: " << peak_candidate_bytes.load() / 1024 << " KB\n";
+    ss << "Phase time (ms, summed over threads):";
+    for (int i = 0; i < phase_count; i++) {
+        ss << " " << phase_names[i] << "=" << total.phase_ns[i] / 1000000.0;
+    }
+    ss << "\n";
+    for (auto& stats : thread_stats) {
+        ss << "  [thread " << stats.thread_id << "] regions: " << stats.regions_visited
+           << " bytes: " << stats.bytes_read
+           << " failed: " << stats.failed_reads
+           << " syscalls: " << stats.syscalls
+           << " read: " << stats.phase_ns[static_cast<int>(scan_phase::read)] / 1000000.0 << " ms"
+           << " compare: " << stats.phase_ns[static_cast<int>(scan_phase::compare)] / 1000000.0 << " ms"
+           << " merge: " << stats.phase_ns[static_cast<int>(scan_phase::merge)] / 1000000.0 << " ms\n";
+    }
+    if (kernel_profiler::enabled) {
+        kernel_profiler::instance()->print(ss);
+    }
+    std::cout << ss.str();
+#endif // !SCAN_STATS_ENABLED
+}
@@ -0,0 +1,99 @@
+#ifndef SCAN_STATS_H
+#define SCAN_STATS_H
+#include <Windows.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Define DISABLE_SCAN_STATS to compile every SCAN_STATS_* site out of the scanner.
+#ifndef DISABLE_SCAN_STATS
+#define SCAN_STATS_ENABLED
+#endif // !DISABLE_SCAN_STATS
+
+enum class scan_phase : int { query, read, compare, merge, print, count };
+
+struct scan_thread_stats
+{
+    DWORD thread_id = 0;
+    uint64_t regions_queried = 0;       // VirtualQueryEx results, any state
+    uint64_t regions_visited = 0;       // readable regions a search went through
+    uint64_t bytes_read = 0;
+    uint64_t failed_reads = 0;
+    uint64_t syscalls = 0;
+    uint64_t compared_bytes = 0;
+    uint64_t phase_ns[static_cast<int>(scan_phase::count)] = {};
+};
+
+class scan_phase_timer
+{
+    scan_thread_stats& stats;
+    scan_phase phase;
+    int excluded;
+    uint64_t excluded_before;
+    std::chrono::steady_clock::time_point start;
+public:
+    scan_phase_timer(scan_thread_stats& stats, scan_phase phase)
+        : stats(stats), phase(phase), excluded(-1), excluded_before(0), start(std::chrono::steady_clock::now()) {}
+    // Time that nested timers of the excluded phase record meanwhile is not counted twice.
+    scan_phase_timer(scan_thread_stats& stats, scan_phase phase, scan_phase excluded_phase)
+        : stats(stats), phase(phase), excluded(static_cast<int>(excluded_phase)), excluded_before(stats.phase_ns[static_cast<int>(excluded_phase)]),
+          start(std::chrono::steady_clock::now()) {}
+    ~scan_phase_timer() {
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        if (excluded >= 0) {
+            ns -= (std::min)(ns, stats.phase_ns[excluded] - excluded_before);
+        }
+        stats.phase_ns[static_cast<int>(phase)] += ns;
+    }
+};
+
+class scan_stats
+{
+    std::mutex stats_mutex;
+    std::string last_command;
+    std::vector<scan_thread_stats> thread_stats;
+    std::chrono::steady_clock::time_point command_start;
+    uint64_t command_ns;
+    std::atomic<int64_t> candidate_bytes;
+    std::atomic<int64_t> peak_candidate_bytes;
+    scan_stats() : command_ns(0), candidate_bytes(0), peak_candidate_bytes(0) {}
+public:
+    static scan_stats* instance() {
+        static scan_stats singleton;
+        return &singleton;
+    }
+    void begin(const std::string& command);
+    void end();
+    void submit(const scan_thread_stats& stats);
+    void track_memory(int64_t delta);
+    void print(bool json);
+};
+
+#ifdef SCAN_STATS_ENABLED
+#define SCAN_STATS_CONCAT_INNER(a, b) a##b
+#define SCAN_STATS_CONCAT(a, b) SCAN_STATS_CONCAT_INNER(a, b)
+#define SCAN_STATS_DECLARE(name) scan_thread_stats name
+#define SCAN_STATS_ADD(stats, field, value) ((stats).field += (value))
+#define SCAN_STATS_PHASE(stats, phase) scan_phase_timer SCAN_STATS_CONCAT(scan_phase_timer_, __LINE__)((stats), scan_phase::phase)
+#define SCAN_STATS_PHASE_EXCLUDING(stats, phase, excluded) \
+    scan_phase_timer SCAN_STATS_CONCAT(scan_phase_timer_, __LINE__)((stats), scan_phase::phase, scan_phase::excluded)
+#define SCAN_STATS_SUBMIT(stats) scan_stats::instance()->submit(stats)
+#define SCAN_STATS_MEMORY(delta) scan_stats::instance()->track_memory(static_cast<int64_t>(delta))
+// Remembers a container's capacity for a later SCAN_STATS_MEMORY of its growth.
+#define SCAN_STATS_CAPACITY(name, container) size_t name = (container).capacity()
+#else
+#define SCAN_STATS_DECLARE(name)
+#define SCAN_STATS_ADD(stats, field, value) ((void)0)
+#define SCAN_STATS_PHASE(stats, phase) ((void)0)
+#define SCAN_STATS_PHASE_EXCLUDING(stats, phase, excluded) ((void)0)
+#define SCAN_STATS_SUBMIT(stats) ((void)0)
+#define SCAN_STATS_MEMORY(delta) ((void)0)
+#define SCAN_STATS_CAPACITY(name, container) ((void)0)
+#endif // SCAN_STATS_ENABLED
+
+#endif // !SCAN_STATS_H
@@ -1,4 +1,8 @@
 #include "scanner.h"
+#include "scan_stats.h"
+#include "kernel_counters.h"
+#include "../trace_recorder/trace_recorder.h"
+#include "../debugger/output_pipe/output_pipe.h"
 #include <iostream>
 #include <thread>
 #include <algorithm>
@@ -20,20 +24,28 @@ void scanner::scan_regions() {
     MEMORY_BASIC_INFORMATION mbi;
     memset(&mbi, 0, sizeof(mbi));
     uintptr_t base_address = 0;
-    while (VirtualQueryEx(attached_handle, (LPCVOID)base_address, &mbi, sizeof(MEMORY_BASIC_INFORMATION))) {
-        if ((mbi.State == MEM_COMMIT) &&
-            (mbi.Protect & (PAGE_READONLY | PAGE_READWRITE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE)) &&
-            !(mbi.Protect & PAGE_GUARD)
-            ) {
-            memory_region current_region;
-            memset(&current_region, 0, sizeof(current_region));
-            current_region.start_adress = (uintptr_t)mbi.BaseAddress;
-            current_region.protection = mbi.Protect;
-            current_region.size = mbi.RegionSize;
-            scanned_regions.push_back(current_region);
+    SCAN_STATS_DECLARE(stats);
+    {
+        TRACE_SCOPE("scan_regions");
+        SCAN_STATS_PHASE(stats, query);
+        while (VirtualQueryEx(attached_handle, (LPCVOID)base_address, &mbi, sizeof(MEMORY_BASIC_INFORMATION))) {
+            SCAN_STATS_ADD(stats, syscalls, 1);
+            SCAN_STATS_ADD(stats, regions_queried, 1);
+            if ((mbi.State == MEM_COMMIT) &&
+                (mbi.Protect & (PAGE_READONLY | PAGE_READWRITE | PAGE_EXECUTE_READ | PAGE_EXECUTE_READWRITE | PAGE_EXECUTE)) &&
+                !(mbi.Protect & PAGE_GUARD)
+                ) {
+                memory_region current_region;
+                memset(&current_region, 0, sizeof(current_region));
+                current_region.start_adress = (uintptr_t)mbi.BaseAddress;
+                current_region.protection = mbi.Protect;
+                current_region.size = mbi.RegionSize;
+                scanned_regions.push_back(current_region);
+            }
+            base_address = ((uintptr_t)mbi.BaseAddress + mbi.RegionSize);
         }
-        base_address = ((uintptr_t)mbi.BaseAddress + mbi.RegionSize);
     }
+    SCAN_STATS_SUBMIT(stats);
 }
 
 void scanner::print_regions() {
@@ -72,9 +84,13 @@ void scanner::search_int(int value){
     for (auto& thread : local_threads) {
         thread.join();
     }
+    DEBUG_LOG(DEBUG, SCANNER, "[scanner] Search %d: %zu results in %zu regions",
+              value, scanned_ints.size(), scanned_regions.size());
 }
 
 void scanner::search_int_thread(int value, size_t start_idx, size_t end_idx) {
+    trace_recorder::instance()->set_thread_name("scanner search");
+    TRACE_SCOPE_ARG("search_int_thread", end_idx - start_idx);
     const size_t buffer_size = 32768;
     std::vector<int> buffer(buffer_size / sizeof(int));
 
@@ -86,12 +102,17 @@ void scanner::search_int_thread(int value, size_t start_idx, size_t end_idx) {
 
     std::vector<scanned_value<int>> local_results;
     local_results.reserve(1000000);
+    SCAN_STATS_DECLARE(stats);
+    SCAN_STATS_MEMORY(local_results.capacity() * sizeof(scanned_value<int>));
+    kernel_counter_scope kernel_counters("search_int", kernel_type_name<int>());
 
     auto flush_cache = [&] () {
         if (cache_count > 0) {
             if (local_results.size() + cache_count > local_results.capacity()) {
+                SCAN_STATS_CAPACITY(old_capacity, local_results);
                 local_results.reserve(max(local_results.capacity() * 2,
                                       local_results.size() + cache_count));
+                SCAN_STATS_MEMORY((local_results.capacity() - old_capacity) * sizeof(scanned_value<int>));
             }
 
             local_results.insert(local_results.end(),
@@ -107,6 +128,8 @@ void scanner::search_int_thread(int value, size_t start_idx, size_t end_idx) {
         if (region.protection & (PAGE_EXECUTE_READWRITE | PAGE_EXECUTE)) {
             continue;
         }
+        SCAN_STATS_ADD(stats, regions_visited, 1);
+        TRACE_SCOPE_ARG("region", region.size);
 
         uintptr_t base_address = region.start_adress;
         uintptr_t end_address = region.start_adress + region.size;
@@ -114,22 +137,29 @@ void scanner::search_int_thread(int value, size_t start_idx, size_t end_idx) {
         while (base_address < end_address) {
             size_t bytes_to_read = min(buffer_size, static_cast<size_t>(end_address - base_address));
             size_t bytes_read = 0;
+            BOOL read_ok = FALSE;
+            {
+                TRACE_SCOPE_ARG("ReadProcessMemory", bytes_to_read);
+                SCAN_STATS_PHASE(stats, read);
+                read_ok = ReadProcessMemory(attached_handle, (void*)base_address, buffer.data(),
+                                            bytes_to_read, &bytes_read);
+            }
+            SCAN_STATS_ADD(stats, syscalls, 1);
+            SCAN_STATS_ADD(stats, bytes_read, bytes_read);
 
-            if (ReadProcessMemory(attached_handle, (void*)base_address, buffer.data(),
-                bytes_to_read, &bytes_read)) {
-
+            if (read_ok) {
+                SCAN_STATS_PHASE(stats, compare);
                 size_t ints_read = bytes_read / sizeof(int);
                 int* data = buffer.data();
+                SCAN_STATS_ADD(stats, compared_bytes, ints_read * sizeof(int));
 
-                for (size_t j = 0; j < ints_read; j++) {
-                    if (data[j] == value) {
-                        cache_buffer[cache_count++] = {data[j], base_address + j * sizeof(int)};
-
-                        if (cache_count == CACHE_SIZE) {
-                            flush_cache();
-                        }
-                    }
-                }
+                kernel_counters.start();
+                search_kernel_scalar(data, ints_read, value, base_address,
+                                     cache_buffer, cache_count, CACHE_SIZE, flush_cache);
+                kernel_counters.stop(ints_read * sizeof(int));
+            }
+            else {
+                SCAN_STATS_ADD(stats, failed_reads, 1);
             }
             base_address += bytes_read;
         }
@@ -138,13 +168,18 @@ void scanner::search_int_thread(int value, size_t start_idx, size_t end_idx) {
     flush_cache();
 
     if (!local_results.empty()) {
+        TRACE_SCOPE("merge");
+        SCAN_STATS_PHASE(stats, merge);
         std::lock_guard<std::mutex> lock(results_mutex);
+        SCAN_STATS_CAPACITY(old_capacity, scanned_ints);
         scanned_ints.insert(scanned_ints.end(),
                             std::make_move_iterator(local_results.begin()),
                             std::make_move_iterator(local_results.end()));
+        SCAN_STATS_MEMORY((scanned_ints.capacity() - old_capacity) * sizeof(scanned_value<int>));
     }
 
-
+    SCAN_STATS_MEMORY(-static_cast<int64_t>(local_results.capacity() * sizeof(scanned_value<int>)));
+    SCAN_STATS_SUBMIT(stats);
     delete[] cache_buffer;
 }
 
@@ -169,9 +204,14 @@ void scanner::filter_int(int value) {
     for (auto& thread : local_threads) {
         thread.join();
     }
+    SCAN_STATS_MEMORY(-static_cast<int64_t>(scanned_ints_local.capacity() * sizeof(scanned_value<int>)));
+    DEBUG_LOG(DEBUG, SCANNER, "[scanner] Filter %d: %zu -> %zu results",
+              value, scanned_ints_local.size(), scanned_ints.size());
 }
 
 void scanner::filter_int_thread(int value, size_t start_idx, size_t end_idx, const std::vector<scanned_value<int>>& source_values) {
+    trace_recorder::instance()->set_thread_name("scanner filter");
+    TRACE_SCOPE_ARG("filter_batch", end_idx - start_idx);
     const size_t CACHE_SIZE = 16384;
     scanned_value<int>* cache_buffer = new scanned_value<int>[CACHE_SIZE];
     memset(cache_buffer, 0, sizeof(scanned_value<int>[CACHE_SIZE]));
@@ -179,101 +219,86 @@ void scanner::filter_int_thread(int value, size_t start_idx, size_t end_idx, con
 
     std::vector<scanned_value<int>> local_results;
     local_results.reserve((end_idx - start_idx) / 3); 
+    SCAN_STATS_DECLARE(stats);
+    SCAN_STATS_MEMORY(local_results.capacity() * sizeof(scanned_value<int>));
 
     auto flush_cache = [&] () {
         if (cache_count > 0) {
+            SCAN_STATS_CAPACITY(old_capacity, local_results);
             local_results.insert(local_results.end(), cache_buffer, cache_buffer + cache_count);
+            SCAN_STATS_MEMORY((local_results.capacity() - old_capacity) * sizeof(scanned_value<int>));
             cache_count = 0;
         }
     };
 
-    const size_t BLOCK_SIZE = 4096; 
-    int* block_buffer = new int[BLOCK_SIZE / sizeof(int)];
-    memset(block_buffer, 0, sizeof(int[BLOCK_SIZE / sizeof(int)]));
-    
-    struct PageCache
-    {
-        uintptr_t page_addr;
-        int data[BLOCK_SIZE / sizeof(int)];
-        bool valid;
-    };
-
-    const size_t PAGE_CACHE_SIZE = 32;
-    PageCache* page_cache = new PageCache[PAGE_CACHE_SIZE];
-    memset(page_cache, 0, sizeof(PageCache[PAGE_CACHE_SIZE]));
-    size_t cache_next = 0;
-
-    for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
-        page_cache[i].valid = false;
-        page_cache[i].page_addr = 0;
-    }
-
-    auto get_page_data = [&] (uintptr_t addr) -> int* {
-        uintptr_t page_addr = addr & ~(BLOCK_SIZE - 1);
-
-        for (size_t i = 0; i < PAGE_CACHE_SIZE; i++) {
-            if (page_cache[i].valid && page_cache[i].page_addr == page_addr) {
-                return page_cache[i].data;
-            }
-        }
-
-        PageCache& new_cache = page_cache[cache_next];
-        cache_next = (cache_next + 1) % PAGE_CACHE_SIZE;
-
-        new_cache.valid = false;
-        new_cache.page_addr = page_addr;
-
+    kernel_counter_scope kernel_counters("filter_int", kernel_type_name<int>());
+    scan_page_cache<int> page_cache;
+    auto read_page = [&] (uintptr_t page_addr, int* destination, size_t block_size) -> bool {
         size_t bytes_read = 0;
-        if (ReadProcessMemory(attached_handle, (void*)page_addr, new_cache.data,
-            BLOCK_SIZE, &bytes_read) && bytes_read > 0) {
-            new_cache.valid = true;
-            return new_cache.data;
+        BOOL read_ok = FALSE;
+        {
+            TRACE_SCOPE_ARG("ReadProcessMemory", block_size);
+            SCAN_STATS_PHASE(stats, read);
+            kernel_counters.pause();
+            read_ok = ReadProcessMemory(attached_handle, (void*)page_addr, destination,
+                                        block_size, &bytes_read);
+            kernel_counters.resume();
+        }
+        SCAN_STATS_ADD(stats, syscalls, 1);
+        SCAN_STATS_ADD(stats, bytes_read, bytes_read);
+        if (read_ok && bytes_read > 0) {
+            return true;
         }
 
-        return nullptr;
+        SCAN_STATS_ADD(stats, failed_reads, 1);
+        return false;
     };
 
-    for (size_t i = start_idx; i < end_idx; i++) {
-        uintptr_t addr = source_values[i].address;
-
-        int* page_data = get_page_data(addr);
-
-        if (page_data) {
-            size_t offset = (addr & (BLOCK_SIZE - 1)) / sizeof(int);
-
-            if (page_data[offset] == value) {
-                cache_buffer[cache_count++] = {value, addr};
-
-                if (cache_count == CACHE_SIZE) {
-                    flush_cache();
-                }
-            }
-        }
+    {
+        // Page reads happen inside the kernel; their read phase time is taken out of compare.
+        SCAN_STATS_PHASE_EXCLUDING(stats, compare, read);
+        SCAN_STATS_ADD(stats, compared_bytes, (end_idx - start_idx) * sizeof(int));
+        kernel_counters.start();
+        filter_kernel_scalar(source_values.data() + start_idx, source_values.data() + end_idx, value,
+                             page_cache, read_page, cache_buffer, cache_count, CACHE_SIZE, flush_cache);
+        kernel_counters.stop((end_idx - start_idx) * sizeof(int));
     }
 
     flush_cache();
 
     if (!local_results.empty()) {
+        TRACE_SCOPE("merge");
+        SCAN_STATS_PHASE(stats, merge);
         std::lock_guard<std::mutex> lock(results_mutex);
+        SCAN_STATS_CAPACITY(old_capacity, scanned_ints);
         scanned_ints.insert(scanned_ints.end(),
                             std::make_move_iterator(local_results.begin()),
                             std::make_move_iterator(local_results.end()));
-
+        SCAN_STATS_MEMORY((scanned_ints.capacity() - old_capacity) * sizeof(scanned_value<int>));
     }
-    delete[] block_buffer;
-    delete[] page_cache;
+    SCAN_STATS_MEMORY(-static_cast<int64_t>(local_results.capacity() * sizeof(scanned_value<int>)));
+    SCAN_STATS_SUBMIT(stats);
     delete[] cache_buffer;
 }
 
-void scanner::print_scanned_ints() {
+void scanner::print_scanned_ints(const std::vector<module_range>& modules) {
     if (scanned_ints.empty()) {
         std::cout << "Scanned data empty" << std::endl;
         return;
     }
 
-    for (auto& scanned_int : scanned_ints) {
-        std::cout << "[0x" << (void*)scanned_int.address << "] " << scanned_int.value << std::endl;
+    SCAN_STATS_DECLARE(stats);
+    {
+        SCAN_STATS_PHASE(stats, print);
+        module_resolver resolver(modules);
+        char address[MAX_ADDRESS_TEXT];
+        for (auto& scanned_int : scanned_ints) {
+            resolver.format(scanned_int.address, address, sizeof(address));
+            std::cout << "[" << address << "] " << scanned_int.value << "\n";
+        }
+        std::cout.flush();
     }
+    SCAN_STATS_SUBMIT(stats);
 }
 
 int scanner::get_scanned_count() {
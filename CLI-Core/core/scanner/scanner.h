@@ -6,6 +6,8 @@
 #include <map>
 #include <unordered_map>
 #include <mutex>
+#include "scan_kernels.h"
+#include "../debugger/modules.h"
 
 struct memory_region
 {
@@ -14,13 +16,6 @@ struct memory_region
     DWORD protection;
 };
 
-template<typename T>
-struct scanned_value
-{
-    T value;
-    uintptr_t address;
-};
-
 class scanner
 {
     DWORD attached_pid;
@@ -40,7 +35,8 @@ public:
     void reset();
     void scan_regions();
     void print_regions();
-    void print_scanned_ints();
+    // Addresses inside a module print as module+0xOFF.
+    void print_scanned_ints(const std::vector<module_range>& modules);
     int get_scanned_count();
     void search_int(int value);
     void filter_int(int value);
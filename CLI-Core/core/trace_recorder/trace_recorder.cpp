@@ -0,0 +1,155 @@
+#include "trace_recorder.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+std::atomic<bool> trace_recorder::enabled(false);
+
+// Buffers are allocated on a thread's first event and retired when the thread exits,
+// so short-lived scanner workers do not pin their buffers past the next session.
+struct local_trace_state
+{
+    trace_buffer* buffer = nullptr;
+    std::string thread_name;
+    ~local_trace_state() {
+        if (buffer) {
+            buffer->retired = true;
+        }
+    }
+};
+
+static thread_local local_trace_state local_state;
+
+trace_buffer* trace_recorder::register_thread() {
+    auto buffer = std::make_shared<trace_buffer>();
+    buffer->thread_id = GetCurrentThreadId();
+    buffer->thread_name = local_state.thread_name;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffers.push_back(buffer);
+    return buffer.get();
+}
+
+bool trace_recorder::start(const std::string& path) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (enabled) {
+        std::cout << "Trace is already running (" << output_path << ").\n";
+        return false;
+    }
+
+    buffers.erase(std::remove_if(buffers.begin(), buffers.end(),
+                                 [] (const std::shared_ptr<trace_buffer>& buffer) { return buffer->retired.load(); }),
+                  buffers.end());
+
+    output_path = path;
+    session_start_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+    session.fetch_add(1, std::memory_order_release);
+    enabled = true;
+    return true;
+}
+
+bool trace_recorder::is_running() {
+    return enabled;
+}
+
+void trace_recorder::set_thread_name(const std::string& name) {
+    local_state.thread_name = name;
+    if (local_state.buffer) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        local_state.buffer->thread_name = name;
+    }
+}
+
+uint32_t trace_recorder::record(char phase, const char* name, uint64_t argument, uint32_t scope_session) {
+    uint32_t current_session = session.load(std::memory_order_acquire);
+    if (scope_session && scope_session != current_session) {
+        return current_session;
+    }
+    if (!local_state.buffer) {
+        local_state.buffer = register_thread();
+    }
+    trace_buffer* local_buffer = local_state.buffer;
+
+    // Each thread resets its own buffer the first time it records in a new session.
+    if (local_buffer->session.load(std::memory_order_relaxed) != current_session) {
+        local_buffer->count.store(0, std::memory_order_relaxed);
+        local_buffer->dropped.store(0, std::memory_order_relaxed);
+        local_buffer->session.store(current_session, std::memory_order_release);
+    }
+
+    size_t index = local_buffer->count.load(std::memory_order_relaxed);
+    if (index >= trace_buffer::capacity) {
+        local_buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return current_session;
+    }
+
+    int64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    trace_event& event = local_buffer->events[index];
+    event.timestamp_ns = static_cast<uint64_t>((std::max)(now_ns - session_start_ns.load(std::memory_order_relaxed), int64_t(0)));
+    event.name = name;
+    event.argument = argument;
+    event.phase = phase;
+    local_buffer->count.store(index + 1, std::memory_order_release);
+    return current_session;
+}
+
+bool trace_recorder::stop() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (!enabled) {
+        std::cout << "Trace is not running.\n";
+        return false;
+    }
+    enabled = false;
+
+    std::ofstream file(output_path, std::ios::out | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cout << "Failed to open trace file: " << output_path << std::endl;
+        return false;
+    }
+
+    uint32_t current_session = session.load();
+    DWORD pid = GetCurrentProcessId();
+    size_t total_events = 0;
+    uint64_t total_dropped = 0;
+    bool first = true;
+
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (auto& buffer : buffers) {
+        if (buffer->session.load(std::memory_order_acquire) != current_session) {
+            continue;
+        }
+
+        if (!buffer->thread_name.empty()) {
+            file << (first ? "" : ",") << "\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid
+                 << ",\"tid\":" << buffer->thread_id << ",\"args\":{\"name\":\"" << buffer->thread_name << "\"}}";
+            first = false;
+        }
+
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; i++) {
+            const trace_event& event = buffer->events[i];
+            file << (first ? "" : ",") << "\n{\"ph\":\"" << event.phase << "\",\"name\":\"" << event.name
+                 << "\",\"pid\":" << pid << ",\"tid\":" << buffer->thread_id
+                 << ",\"ts\":" << event.timestamp_ns / 1000 << "." << (event.timestamp_ns % 1000) / 100;
+            if (event.phase == 'i') {
+                file << ",\"s\":\"t\"";
+            }
+            if (event.argument) {
+                file << ",\"args\":{\"value\":" << event.argument << "}";
+            }
+            file << "}";
+            first = false;
+        }
+        total_events += count;
+        total_dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    file << "\n]}\n";
+
+    std::cout << "Trace written to " << output_path << ": " << total_events << " events";
+    if (total_dropped) {
+        std::cout << ", " << total_dropped << " dropped (buffer full)";
+    }
+    std::cout << std::endl;
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+#include <Windows.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct trace_event
+{
+    uint64_t timestamp_ns;
+    const char* name;   // must point to a string literal
+    uint64_t argument;
+    char phase;         // 'B' begin, 'E' end, 'i' instant
+};
+
+// Written only by its owning thread; the recorder reads it after tracing is stopped.
+struct trace_buffer
+{
+    static const size_t capacity = 1 << 16;
+    DWORD thread_id;
+    std::string thread_name;
+    std::atomic<size_t> count;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint32_t> session;
+    std::atomic<bool> retired;
+    std::unique_ptr<trace_event[]> events;
+    trace_buffer() : thread_id(0), count(0), dropped(0), session(0), retired(false), events(new trace_event[capacity]) {}
+};
+
+class trace_recorder
+{
+    std::mutex registry_mutex;
+    std::vector<std::shared_ptr<trace_buffer>> buffers;
+    // steady_clock nanoseconds; written before session is bumped, read by every recording thread.
+    std::atomic<int64_t> session_start_ns;
+    std::atomic<uint32_t> session;
+    std::string output_path;
+    trace_recorder() : session_start_ns(0), session(0) {}
+    trace_buffer* register_thread();
+public:
+    static std::atomic<bool> enabled;
+
+    static trace_recorder* instance() {
+        static trace_recorder singleton;
+        return &singleton;
+    }
+    bool start(const std::string& path);
+    bool stop();
+    bool is_running();
+    void set_thread_name(const std::string& name);
+    // Returns the session the event belongs to. scope_session, when set, is the session of the
+    // scope's begin event: an end event from an earlier session is dropped.
+    uint32_t record(char phase, const char* name, uint64_t argument, uint32_t scope_session = 0);
+};
+
+class trace_scope
+{
+    const char* name;
+    bool active;
+    uint32_t session;
+public:
+    trace_scope(const char* name, uint64_t argument = 0)
+        : name(name), active(trace_recorder::enabled.load(std::memory_order_acquire)), session(0) {
+        if (active) {
+            session = trace_recorder::instance()->record('B', name, argument);
+        }
+    }
+    ~trace_scope() {
+        if (active) {
+            trace_recorder::instance()->record('E', name, 0, session);
+        }
+    }
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_SCOPE_ARG(name, argument) trace_scope TRACE_CONCAT(trace_scope_, __LINE__)(name, argument)
+#define TRACE_INSTANT(name, argument) \
+    do { if (trace_recorder::enabled.load(std::memory_order_acquire)) trace_recorder::instance()->record('i', name, argument); } while (0)
+
+#endif // !TRACE_RECORDER_H
@@ -0,0 +1,1532 @@
+// Debug-event throughput: runs the debugger's event source and dispatch table
+// (CLI-Core/core/debugger/debug_event_source.h) against a forked child on Linux.
+//
+// Linux only:  g++ -O2 -std=c++14 -pthread -I../../CLI-Core/core/debugger debug_bench.cpp
+//                  ../../CLI-Core/core/debugger/debug_event_source.cpp
+//                  ../../CLI-Core/core/debugger/debug_event_source_linux.cpp
+//                  ../../CLI-Core/core/debugger/breakpoints.cpp
+//                  ../../CLI-Core/core/debugger/breakpoint_condition.cpp
+//                  ../../CLI-Core/core/debugger/hardware_breakpoints.cpp
+//                  ../../CLI-Core/core/debugger/access_tracer.cpp
+//                  ../../CLI-Core/core/debugger/modules.cpp
+//                  ../../CLI-Core/core/debugger/page_watches.cpp
+//                  ../../CLI-Core/core/debugger/step_tracer.cpp
+//                  ../../CLI-Core/core/debugger/coverage.cpp
+//                  ../../CLI-Core/core/debugger/profiler.cpp
+//                  ../../CLI-Core/core/debugger/stack_walker.cpp
+//                  ../../CLI-Core/core/debugger/event_journal.cpp
+//                  ../../CLI-Core/core/debugger/exception_stats.cpp -o debug_bench
+// Usage:       debug_bench [--hits N] [--wakes N] [--batch N] [--blocks N] [--ticks N] [--walks N]
+//                  [--addresses N] [--events N]
+//
+// Phases:
+//   breakpoints   the child executes N compiled-in int3s; the tracer owns each one through
+//                 a registered handler. Reports events/s and the child-side round trip
+//                 (int3 -> tracer -> resumed) percentiles.
+//   managed       breakpoint_manager sets an int3 on a function the child calls N times.
+//                 The function keeps a frame pointer, so its first instruction (push rbp or
+//                 endbr64) is emulated and each hit is one event. Reports hits/s.
+//   stepped       the same with emulation off: every hit is a step-over and re-arm (two events).
+//   conditional   the managed breakpoint with the condition "[rdi] % 10 == 0" (the counter the
+//                 function is passed): every call is evaluated, one in ten counts.
+//   hardware      access_tracer on a variable that 4 child threads store to N times in total;
+//                 2 threads run while its write watchpoint is set, 2 start afterwards and get it
+//                 on their create event. Reports the time to set and clear it on all threads,
+//                 hits/s, the debugger-side cost per hit and the top writer as module+offset.
+//   pages         a page watch on the first 64 bytes of a page; the child writes there and to
+//                 the other end of the page N/20 times each. Reports hits, false hits, faults/s
+//                 and the stall per fault (fault to re-guard).
+//   steps         step_tracer single-steps a spinning child for N steps into a trace file,
+//                 without and with changed registers. Reports steps/s, bytes per step and how
+//                 long the reader takes to list the executed instructions.
+//   coverage      coverage_collector on every function of this binary (found through its
+//                 .eh_frame_hdr) while the child calls breakpoint_target; reports how many were
+//                 reached and the XOR diff against the map taken before. Then arms and disarms
+//                 N one-shot int3s across libc's text (--blocks, default 500000).
+//   profile       sampling_profiler takes N ticks (--ticks, default 2000) of a child whose two
+//                 worker threads spin in spin_inner (called from spin_outer), without and with
+//                 stacks. Reports ticks/s, how long each tick holds the threads,
+//                 the share of worker samples in spin_inner and whether the folded stacks show
+//                 spin_outer calling it. Then a 1 s schedule at 100 and 1000 Hz of a sleeping
+//                 child, clocked the way the debugger loop clocks it, by wait() timeouts with
+//                 no wake; reports the ticks taken against the ticks due and the mean lateness
+//                 of a timeout.
+//   stack         stack_walker walks a child thread that spins 60 calls deep in recurse, which
+//                 has no frame pointer, N times (--walks, default 10000). Reports the frames
+//                 found, how many are recurse, and the first (tables read) and later walk times.
+//   modules       module_map built from the child's create_process event, then N addresses
+//                 (--addresses, default 10000000) spread in order over its modules, a fifth
+//                 of them just past each one, resolved to module+0xOFF with module_resolver, and a tenth as
+//                 many with the allocating format_address for comparison.
+//   journal       event_journal records N events (--events, default 1000000): exceptions of
+//                 four codes over 1024 addresses, thread events in between. Reports ns per
+//                 record and the time count, top and since take over the full ring.
+//   exceptions    the child executes N ud2s at four sites and its SIGILL handler skips each
+//                 one, so every exception goes back to the target. Once through the journal
+//                 and the dispatch table with the managers registered and a handler that
+//                 formats log text, as the debugger runs without statistics mode, and once
+//                 through exception_stats. Reports exceptions/s and the debugger-side ns per
+//                 exception between wait() and resume().
+//   batch         sets and removes N breakpoints across the child's text in one batch each.
+//   detach        20 rounds of attach, a write watchpoint that 4 child threads hit nonstop,
+//                 200 hits, then clearing it, unbinding and detaching while they still run,
+//                 every other round with the last hit not resumed. Every detach must finish
+//                 and the child must run on to a clean exit. Reports the slowest teardown.
+//   wake          the child sleeps; another thread calls wake() N times and the tracer
+//                 thread, blocked in wait(), reports how long each wake took to arrive.
+//                 Repeated with a child that raises its own SIGURG every 100 us, every one
+//                 of which and no wake must reach its handler, and with a child that blocks
+//                 SIGURG.
+#if !defined(__linux__) || !defined(__x86_64__)
+#include <cstdio>
+
+int main() {
+    fprintf(stderr, "debug_bench: only the x86-64 Linux ptrace source is implemented.\n");
+    return 1;
+}
+#else
+#include "debug_event_source.h"
+#include "breakpoints.h"
+#include "access_tracer.h"
+#include "modules.h"
+#include "page_watches.h"
+#include "step_tracer.h"
+#include "coverage.h"
+#include "profiler.h"
+#include "stack_walker.h"
+#include "event_journal.h"
+#include "exception_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    struct shared_block
+    {
+        std::atomic<int> go;
+        uint64_t count;
+        uint32_t round_trip_ns[1];
+    };
+
+    uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    shared_block* map_shared(uint64_t count) {
+        size_t size = sizeof(shared_block) + count * sizeof(uint32_t);
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            return nullptr;
+        }
+        shared_block* block = static_cast<shared_block*>(memory);
+        block->go.store(0);
+        block->count = count;
+        return block;
+    }
+
+    pid_t spawn_breakpoint_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        while (block->go.load() == 0) {
+            usleep(100);
+        }
+        for (uint64_t i = 0; i < block->count; i++) {
+            uint64_t before = now_ns();
+            __asm__ volatile("int3");
+            block->round_trip_ns[i] = static_cast<uint32_t>(std::min<uint64_t>(now_ns() - before, UINT32_MAX));
+        }
+        _exit(0);
+    }
+
+    __attribute__((noinline)) void bump(volatile uint64_t* counter) {
+        (*counter)++;
+    }
+
+    // Not a leaf, so it gets a frame-pointer prologue like most function entries a
+    // breakpoint lands on.
+    __attribute__((noinline, optimize("no-omit-frame-pointer"))) void breakpoint_target(volatile uint64_t* counter) {
+        bump(counter);
+        __asm__ volatile("" ::: "memory");
+    }
+
+    pid_t spawn_call_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        volatile uint64_t counter = 0;
+        while (block->go.load() == 0) {
+            usleep(100);
+        }
+        for (uint64_t i = 0; i < block->count; i++) {
+            uint64_t before = now_ns();
+            breakpoint_target(&counter);
+            block->round_trip_ns[i] = static_cast<uint32_t>(std::min<uint64_t>(now_ns() - before, UINT32_MAX));
+        }
+        _exit(counter == block->count ? 0 : 1);
+    }
+
+    alignas(8) volatile uint64_t watched = 0;
+    const int WATCH_THREADS = 4;
+
+    pid_t spawn_watch_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        uint64_t per_thread = block->count / WATCH_THREADS;
+        auto writer = [block, per_thread] {
+            while (block->go.load() == 0) {
+                usleep(100);
+            }
+            for (uint64_t i = 0; i < per_thread; i++) {
+                watched = i;
+            }
+        };
+        std::vector<std::thread> writers;
+        for (int i = 0; i < WATCH_THREADS / 2; i++) {
+            writers.emplace_back(writer);
+        }
+        while (block->go.load() == 0) {
+            usleep(100);
+        }
+        for (int i = WATCH_THREADS / 2; i < WATCH_THREADS; i++) {
+            writers.emplace_back(writer);
+        }
+        for (auto& thread : writers) {
+            thread.join();
+        }
+        _exit(0);
+    }
+
+    // Writers that store to watched until go is 2, for detaching while the watchpoint is hot.
+    pid_t spawn_hot_watch_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        auto writer = [block] {
+            for (uint64_t i = 0; block->go.load(std::memory_order_relaxed) != 2; i++) {
+                watched = i;
+            }
+        };
+        std::vector<std::thread> writers;
+        for (int i = 0; i < WATCH_THREADS; i++) {
+            writers.emplace_back(writer);
+        }
+        for (auto& thread : writers) {
+            thread.join();
+        }
+        _exit(0);
+    }
+
+    // Calls bump so it is not a leaf and keeps its frame pointer, like breakpoint_target.
+    __attribute__((noinline, optimize("no-omit-frame-pointer"))) uint64_t spin_inner(uint64_t seed) {
+        volatile uint64_t calls = 0;
+        for (int i = 0; i < 1000; i++) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            __asm__ volatile("" : "+r"(seed));
+        }
+        bump(&calls);
+        return seed;
+    }
+
+    __attribute__((noinline, optimize("no-omit-frame-pointer"))) void spin_outer(shared_block* block) {
+        uint64_t seed = 1;
+        while (block->go.load(std::memory_order_relaxed) == 0) {
+            seed = spin_inner(seed);
+        }
+        block->count = seed;
+    }
+
+    const int RECURSE_DEPTH = 60;
+
+    // Frameless at -O2; the barrier keeps the call from becoming a loop.
+    __attribute__((noinline, optimize("omit-frame-pointer"))) uint64_t recurse(shared_block* block, int depth) {
+        if (depth == 0) {
+            uint64_t seed = 1;
+            while (block->go.load(std::memory_order_relaxed) == 0) {
+                seed = spin_inner(seed);
+            }
+            return seed;
+        }
+        uint64_t result = recurse(block, depth - 1);
+        __asm__ volatile("" : "+r"(result));
+        return result + depth;
+    }
+
+    void skip_ud2(int, siginfo_t*, void* context) {
+        static_cast<ucontext_t*>(context)->uc_mcontext.gregs[REG_RIP] += 2;
+    }
+
+    pid_t spawn_throwing_child(shared_block* block, uint64_t count) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        struct sigaction action = {};
+        action.sa_sigaction = skip_ud2;
+        action.sa_flags = SA_SIGINFO;
+        sigaction(SIGILL, &action, nullptr);
+        while (block->go.load() == 0) {
+            usleep(1000);
+        }
+        for (uint64_t i = 0; i < count; i += 4) {
+            __asm__ volatile("ud2");
+            __asm__ volatile("ud2");
+            __asm__ volatile("ud2");
+            __asm__ volatile("ud2");
+            block->count += 4;
+        }
+        _exit(0);
+    }
+
+    pid_t spawn_deep_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        std::thread worker([block] {
+            block->count = recurse(block, RECURSE_DEPTH);
+        });
+        worker.join();
+        _exit(0);
+    }
+
+    const int SPIN_THREADS = 2;
+
+    // Workers spin until go is set; the main thread sleeps in the kernel.
+    pid_t spawn_spin_child(shared_block* block) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        std::vector<std::thread> workers;
+        for (int i = 0; i < SPIN_THREADS; i++) {
+            workers.emplace_back(spin_outer, block);
+        }
+        for (auto& thread : workers) {
+            thread.join();
+        }
+        _exit(0);
+    }
+
+    pid_t spawn_idle_child() {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        for (;;) {
+            pause();
+        }
+    }
+
+    volatile sig_atomic_t urgent_handled = 0;
+    volatile sig_atomic_t urgent_stray = 0;
+
+    void count_urgent(int, siginfo_t* info, void*) {
+        if (info->si_pid == getpid()) {
+            urgent_handled = urgent_handled + 1;
+        }
+        else {
+            urgent_stray = urgent_stray + 1;
+        }
+    }
+
+    // Raises its own SIGURG every 100 us until go is 2, then leaves how many it raised, how
+    // many of those its handler saw and how many SIGURGs from elsewhere (a leaked wake) it saw
+    // in round_trip_ns[0], [1] and [2]. blocked: SIGURG is blocked and the child only sleeps.
+    pid_t spawn_urgent_child(shared_block* block, bool blocked) {
+        pid_t child = fork();
+        if (child != 0) {
+            return child;
+        }
+        if (blocked) {
+            sigset_t set;
+            sigemptyset(&set);
+            sigaddset(&set, SIGURG);
+            sigprocmask(SIG_BLOCK, &set, nullptr);
+            for (;;) {
+                pause();
+            }
+        }
+        struct sigaction action = {};
+        action.sa_sigaction = count_urgent;
+        action.sa_flags = SA_SIGINFO;
+        sigaction(SIGURG, &action, nullptr);
+        uint32_t raised = 0;
+        while (block->go.load() != 2) {
+            kill(getpid(), SIGURG);
+            raised++;
+            usleep(100);
+        }
+        block->round_trip_ns[0] = raised;
+        block->round_trip_ns[1] = static_cast<uint32_t>(urgent_handled);
+        block->round_trip_ns[2] = static_cast<uint32_t>(urgent_stray);
+        _exit(0);
+    }
+
+    template<typename T>
+    T percentile(std::vector<T>& values, double p) {
+        return values.empty() ? T() : values[static_cast<size_t>(p * (values.size() - 1))];
+    }
+
+    bool run_breakpoints(uint64_t hits) {
+        shared_block* block = map_shared(hits);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_breakpoint_child(block);
+
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        uint64_t owned = 0;
+        uint64_t events = 0;
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            if (event.code != DEBUG_EXCEPTION_BREAKPOINT) {
+                return false;
+            }
+            owned++;
+            return true;
+        });
+
+        block->go.store(1);
+        uint64_t start = 0;
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            if (event.type == debug_event_type::exception && start == 0) {
+                start = now_ns();
+            }
+            events++;
+            source->resume(event, dispatcher.dispatch(event));
+            if (event.type == debug_event_type::exit_process) {
+                break;
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        waitpid(child, nullptr, __WALL | WNOHANG);
+
+        std::vector<uint32_t> round_trip(block->round_trip_ns, block->round_trip_ns + hits);
+        std::sort(round_trip.begin(), round_trip.end());
+        printf("breakpoints: hits=%llu owned=%llu events=%llu seconds=%.3f events_per_s=%.0f\n",
+               static_cast<unsigned long long>(hits), static_cast<unsigned long long>(owned),
+               static_cast<unsigned long long>(events), seconds, seconds > 0 ? owned / seconds : 0.0);
+        printf("breakpoints: round_trip_us p50=%.2f p99=%.2f p999=%.2f max=%.2f\n",
+               percentile(round_trip, 0.50) / 1000.0, percentile(round_trip, 0.99) / 1000.0,
+               percentile(round_trip, 0.999) / 1000.0, round_trip.empty() ? 0.0 : round_trip.back() / 1000.0);
+        munmap(block, sizeof(shared_block) + hits * sizeof(uint32_t));
+        return owned == hits;
+    }
+
+    bool run_managed(uint64_t hits, bool emulate, const char* condition) {
+        const char* phase = condition ? "conditional" : emulate ? "managed" : "stepped";
+        shared_block* block = map_shared(hits);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_call_child(block);
+
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        breakpoint_manager breakpoints;
+        breakpoints.bind(source.get());
+        breakpoints.set_emulation(emulate);
+        // fork keeps the layout, so the parent's address of the function is the child's.
+        uint64_t target = reinterpret_cast<uint64_t>(&breakpoint_target);
+        if (breakpoints.add({ target }) != 1) {
+            fprintf(stderr, "could not set breakpoint\n");
+            kill(child, SIGKILL);
+            return false;
+        }
+        std::string error;
+        if (condition && !breakpoints.set_condition(target, condition, error)) {
+            fprintf(stderr, "could not set condition: %s\n", error.c_str());
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            return breakpoints.on_exception(event);
+        });
+
+        block->go.store(1);
+        uint64_t start = now_ns();
+        uint32_t exit_code = 1;
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            source->resume(event, dispatcher.dispatch(event));
+            if (event.type == debug_event_type::exit_process) {
+                exit_code = event.code;
+                break;
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        uint64_t counted = breakpoints.get_total_hits();
+        uint64_t expected = condition ? (hits + 9) / 10 : hits;
+        uint64_t executed = counted + (breakpoints.list().empty() ? 0 : breakpoints.list()[0].misses);
+
+        std::vector<uint32_t> round_trip(block->round_trip_ns, block->round_trip_ns + hits);
+        std::sort(round_trip.begin(), round_trip.end());
+        printf("%s: hits=%llu counted=%llu child_ok=%s seconds=%.3f hits_per_s=%.0f\n", phase,
+               static_cast<unsigned long long>(hits), static_cast<unsigned long long>(counted),
+               exit_code == 0 ? "yes" : "no", seconds, seconds > 0 ? executed / seconds : 0.0);
+        printf("%s: round_trip_us p50=%.2f p99=%.2f max=%.2f\n", phase,
+               percentile(round_trip, 0.50) / 1000.0, percentile(round_trip, 0.99) / 1000.0,
+               round_trip.empty() ? 0.0 : round_trip.back() / 1000.0);
+        munmap(block, sizeof(shared_block) + hits * sizeof(uint32_t));
+        return counted == expected && executed == hits && exit_code == 0;
+    }
+
+    bool run_hardware(uint64_t hits) {
+        hits -= hits % WATCH_THREADS;
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        block->count = hits;
+        pid_t child = spawn_watch_child(block);
+        // Let the first writers start before attaching.
+        usleep(20000);
+
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        hardware_breakpoint_manager watchpoints;
+        watchpoints.bind(source.get());
+        access_tracer tracer;
+        size_t threads = source->get_threads().size();
+        uint64_t before = now_ns();
+        bool started = tracer.start(watchpoints, reinterpret_cast<uint64_t>(&watched), hardware_condition::write, 8);
+        double set_us = (now_ns() - before) / 1000.0;
+        if (!started) {
+            fprintf(stderr, "could not set watchpoint\n");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            return watchpoints.on_exception(event);
+        });
+        dispatcher.register_handler(debug_event_type::create_thread, [&] (const debug_event& event) {
+            return watchpoints.on_create_thread(event);
+        });
+        dispatcher.register_handler(debug_event_type::exit_thread, [&] (const debug_event& event) {
+            return watchpoints.on_exit_thread(event);
+        });
+
+        block->go.store(1);
+        uint64_t start = now_ns();
+        uint64_t dispatch_ns = 0;
+        uint32_t exit_code = 1;
+        double clear_us = 0;
+        std::string top_writer = "-";
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            before = now_ns();
+            continue_action action = dispatcher.dispatch(event);
+            if (event.type == debug_event_type::exception) {
+                dispatch_ns += now_ns() - before;
+            }
+            source->resume(event, action);
+            if (tracer.is_running() && tracer.get_hits() == hits) {
+                // Every write seen: clearing now has to reach threads that are still running.
+                before = now_ns();
+                tracer.stop(watchpoints);
+                clear_us = (now_ns() - before) / 1000.0;
+                std::vector<std::pair<uint64_t, uint64_t>> results = tracer.results();
+                if (!results.empty()) {
+                    top_writer = format_address(enumerate_modules(static_cast<uint32_t>(child)), results[0].first);
+                }
+            }
+            if (event.type == debug_event_type::exit_process) {
+                exit_code = event.code;
+                break;
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        uint64_t counted = tracer.get_hits();
+        watchpoints.unbind();
+
+        printf("hardware: writes=%llu counted=%llu child_ok=%s threads_at_set=%zu set_us=%.1f clear_us=%.1f seconds=%.3f hits_per_s=%.0f\n",
+               static_cast<unsigned long long>(hits), static_cast<unsigned long long>(counted),
+               exit_code == 0 ? "yes" : "no", threads, set_us, clear_us, seconds, seconds > 0 ? counted / seconds : 0.0);
+        printf("hardware: debugger_us_per_hit=%.2f instructions=%zu top=%s\n",
+               counted ? dispatch_ns / 1000.0 / counted : 0.0, tracer.results().size(), top_writer.c_str());
+        munmap(block, sizeof(shared_block));
+        return counted == hits && exit_code == 0;
+    }
+
+    bool run_pages(uint64_t faults) {
+        uint64_t writes = faults / 2;
+        void* memory = mmap(nullptr, 0x1000, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        shared_block* block = map_shared(0);
+        if (memory == MAP_FAILED || !block) {
+            perror("mmap");
+            return false;
+        }
+        volatile uint64_t* page = static_cast<volatile uint64_t*>(memory);
+        pid_t child = fork();
+        if (child == 0) {
+            while (block->go.load() == 0) {
+                usleep(100);
+            }
+            for (uint64_t i = 0; i < writes; i++) {
+                page[0] = i;
+                page[400] = i;
+            }
+            _exit(page[0] == writes - 1 && page[400] == writes - 1 ? 0 : 1);
+        }
+
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        page_watch_manager watches;
+        watches.bind(source.get());
+        uint64_t before = now_ns();
+        uint32_t id = watches.add(reinterpret_cast<uint64_t>(memory), 64);
+        double add_us = (now_ns() - before) / 1000.0;
+        if (!id) {
+            fprintf(stderr, "could not watch the page\n");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            return watches.on_exception(event);
+        });
+
+        block->go.store(1);
+        uint64_t start = now_ns();
+        uint32_t exit_code = 1;
+        watched_page stats = {};
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            source->resume(event, dispatcher.dispatch(event));
+            if (event.type == debug_event_type::exit_process) {
+                exit_code = event.code;
+                break;
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        std::vector<watched_page> pages = watches.page_stats();
+        if (!pages.empty()) {
+            stats = pages[0];
+        }
+        watches.unbind();
+
+        uint64_t total = stats.hits + stats.false_hits;
+        printf("pages: accesses=%llu hits=%llu false_hits=%llu child_ok=%s add_us=%.1f seconds=%.3f faults_per_s=%.0f stall_us=%.2f\n",
+               static_cast<unsigned long long>(writes * 2 + 2), static_cast<unsigned long long>(stats.hits),
+               static_cast<unsigned long long>(stats.false_hits), exit_code == 0 ? "yes" : "no", add_us, seconds,
+               seconds > 0 ? total / seconds : 0.0, total ? stats.stall_ns / 1000.0 / total : 0.0);
+        munmap(block, sizeof(shared_block));
+        munmap(memory, 0x1000);
+        // The child's closing check reads both slots once more.
+        return stats.hits == writes + 1 && stats.false_hits == writes + 1 && exit_code == 0;
+    }
+
+    // The child's own text segment, from /proc/<pid>/maps.
+    // The executable mapping holding breakpoint_target, or the first one whose path contains name.
+    bool text_range(pid_t child, const char* name, uint64_t& start, uint64_t& end) {
+        std::string path = "/proc/" + std::to_string(child) + "/maps";
+        FILE* maps = fopen(path.c_str(), "r");
+        if (!maps) {
+            return false;
+        }
+        uint64_t self = reinterpret_cast<uint64_t>(&breakpoint_target);
+        char line[512];
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), maps)) {
+            unsigned long long low = 0, high = 0;
+            char permissions[8] = {};
+            if (sscanf(line, "%llx-%llx %7s", &low, &high, permissions) == 3 && permissions[2] == 'x' &&
+                (name ? strstr(line, name) != nullptr : self >= low && self < high)) {
+                start = low;
+                end = high;
+                found = true;
+            }
+        }
+        fclose(maps);
+        return found;
+    }
+
+    bool run_steps(uint64_t count, bool with_registers) {
+        const char* phase = with_registers ? "steps_regs" : "steps";
+        const char* path = "debug_bench_steps.trace";
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = fork();
+        if (child == 0) {
+            volatile uint64_t spins = 0;
+            while (block->go.load(std::memory_order_relaxed) == 0) {
+                spins++;
+            }
+            _exit(0);
+        }
+
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        step_tracer tracer;
+        tracer.bind(source.get());
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            return tracer.on_exception(event);
+        });
+        if (!tracer.start(static_cast<uint32_t>(child), count, 0, path, with_registers)) {
+            fprintf(stderr, "could not start the step tracer\n");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        uint64_t start = now_ns();
+        double seconds = 0;
+        uint32_t exit_code = 1;
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            source->resume(event, dispatcher.dispatch(event));
+            if (!tracer.is_running() && block->go.load() == 0) {
+                seconds = (now_ns() - start) / 1e9;
+                block->go.store(1);
+            }
+            if (event.type == debug_event_type::exit_process) {
+                exit_code = event.code;
+                break;
+            }
+        }
+        uint64_t steps = tracer.get_steps();
+        tracer.unbind();
+
+        uint64_t before = now_ns();
+        step_trace_reader reader;
+        address_histogram executed;
+        bool read = reader.open(path) && reader.executed(executed);
+        double read_ms = (now_ns() - before) / 1e6;
+        uint64_t recorded = reader.get_header().steps;
+        uint64_t bytes = 0;
+        FILE* file = fopen(path, "rb");
+        if (file) {
+            fseek(file, 0, SEEK_END);
+            bytes = static_cast<uint64_t>(ftell(file));
+            fclose(file);
+        }
+        reader.close();
+        remove(path);
+
+        printf("%s: steps=%llu recorded=%llu child_ok=%s seconds=%.3f steps_per_s=%.0f bytes_per_step=%.2f "
+               "instructions=%zu read_ms=%.1f\n", phase,
+               static_cast<unsigned long long>(steps), static_cast<unsigned long long>(recorded), exit_code == 0 ? "yes" : "no",
+               seconds, seconds > 0 ? steps / seconds : 0.0, steps ? static_cast<double>(bytes) / steps : 0.0,
+               executed.size(), read_ms);
+        munmap(block, sizeof(shared_block));
+        return read && steps == count && recorded == count && exit_code == 0;
+    }
+
+    bool run_coverage(uint64_t calls, uint64_t count) {
+        shared_block* block = map_shared(calls);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_call_child(block);
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        uint64_t target = reinterpret_cast<uint64_t>(&breakpoint_target);
+        std::vector<module_range> modules = enumerate_modules(static_cast<uint32_t>(child));
+        const module_range* self = find_module(modules, target);
+        std::vector<uint64_t> functions = self ? discover_functions(source.get(), *self) : std::vector<uint64_t>();
+
+        coverage_collector coverage;
+        coverage.bind(source.get());
+        uint64_t before = now_ns();
+        size_t armed = self ? coverage.start(*self, functions) : 0;
+        double arm_ms = (now_ns() - before) / 1e6;
+        coverage_map idle = coverage.snapshot();
+
+        debug_event_dispatcher dispatcher;
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            return coverage.on_exception(event);
+        });
+        block->go.store(1);
+        uint32_t exit_code = 1;
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            source->resume(event, dispatcher.dispatch(event));
+            if (event.type == debug_event_type::exit_process) {
+                exit_code = event.code;
+                break;
+            }
+        }
+        coverage_map run = coverage.snapshot();
+        coverage.unbind();
+        munmap(block, sizeof(shared_block) + calls * sizeof(uint32_t));
+
+        std::vector<uint32_t> only_idle, only_run;
+        bool diffed = coverage_diff(idle, run, only_idle, only_run);
+        bool target_hit = std::find(only_run.begin(), only_run.end(), static_cast<uint32_t>(self ? target - self->base : 0)) != only_run.end();
+        printf("coverage: functions=%zu armed=%zu hit=%zu diff_new=%zu target_hit=%s child_ok=%s arm_ms=%.2f\n",
+               functions.size(), armed, run.count(), only_run.size(), target_hit ? "yes" : "no", exit_code == 0 ? "yes" : "no", arm_ms);
+
+        // Bulk: a stride of a few bytes over libc's text, like a dense block list. The idle
+        // child sits in pause() and never reaches them.
+        pid_t idle_child = spawn_idle_child();
+        std::unique_ptr<debug_event_source> bulk_source = create_debug_event_source();
+        uint64_t start = 0, end = 0;
+        if (!bulk_source->attach(static_cast<uint32_t>(idle_child)) || !text_range(idle_child, "libc", start, end)) {
+            perror("attach");
+            kill(idle_child, SIGKILL);
+            return false;
+        }
+        uint64_t stride = (std::max<uint64_t>)(1, (end - start) / (std::max<uint64_t>)(count, 1));
+        std::vector<uint64_t> addresses;
+        for (uint64_t address = start; address < end && addresses.size() < count; address += stride) {
+            addresses.push_back(address);
+        }
+        coverage_collector bulk;
+        bulk.bind(bulk_source.get());
+        before = now_ns();
+        size_t bulk_armed = bulk.start(module_range{start, end - start, "libc"}, addresses);
+        double bulk_arm_ms = (now_ns() - before) / 1e6;
+        before = now_ns();
+        size_t bulk_removed = bulk.stop();
+        double bulk_remove_ms = (now_ns() - before) / 1e6;
+        bulk.unbind();
+        bool detached = bulk_source->detach();
+        kill(idle_child, SIGKILL);
+        waitpid(idle_child, nullptr, 0);
+        // libc's own 0xCC padding is skipped, not taken over.
+        printf("coverage: blocks=%zu armed=%zu removed=%zu text_kb=%llu arm_ms=%.1f remove_ms=%.1f detached=%s\n",
+               addresses.size(), bulk_armed, bulk_removed, static_cast<unsigned long long>((end - start) / 1024),
+               bulk_arm_ms, bulk_remove_ms, detached ? "yes" : "no");
+
+        return diffed && target_hit && armed == functions.size() && exit_code == 0 && bulk_armed * 100 >= addresses.size() * 99 &&
+               bulk_removed == bulk_armed;
+    }
+
+    bool run_profile(uint64_t ticks, bool with_stacks) {
+        const char* phase = with_stacks ? "profile_stacks" : "profile";
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_spin_child(block);
+        // Let the workers start so attach seizes them with the rest.
+        usleep(50000);
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        std::vector<module_range> modules = enumerate_modules(static_cast<uint32_t>(child));
+        stack_walker walker;
+        walker.bind(source.get());
+        walker.set_modules(modules);
+        sampling_profiler profiler;
+        profiler.bind(source.get(), &walker);
+        profiler.start(with_stacks);
+        uint64_t samples = 0;
+        uint64_t start = now_ns();
+        for (uint64_t i = 0; i < ticks; i++) {
+            samples += profiler.sample();
+        }
+        double seconds = (now_ns() - start) / 1e9;
+
+        uint64_t before = now_ns();
+        profile_report report = profiler.report(modules);
+        double report_ms = (now_ns() - before) / 1e6;
+        profiler.unbind();
+        walker.unbind();
+        bool detached = source->detach();
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        munmap(block, sizeof(shared_block));
+
+        // Names as the report spells them: short module name plus the function's offset.
+        const module_range* self = find_module(modules, reinterpret_cast<uint64_t>(&spin_inner));
+        auto function_name = [self] (uint64_t address) {
+            std::string name = self ? self->name.substr(self->name.find_last_of('/') + 1) : "";
+            char offset[32];
+            snprintf(offset, sizeof(offset), "+0x%llX", static_cast<unsigned long long>(self ? address - self->base : 0));
+            return name + offset;
+        };
+        std::string inner = function_name(reinterpret_cast<uint64_t>(&spin_inner));
+        std::string outer = function_name(reinterpret_cast<uint64_t>(&spin_outer));
+        uint64_t inner_samples = 0;
+        for (const profile_count& function : report.functions) {
+            inner_samples += function.name == inner ? function.samples : 0;
+        }
+        bool called = false;
+        for (const profile_count& stack : report.stacks) {
+            called = called || stack.name.find(outer + ";" + inner) != std::string::npos;
+        }
+        // Every tick also samples the sleeping main thread.
+        uint64_t worker_samples = ticks * SPIN_THREADS;
+        double inner_share = worker_samples ? 100.0 * inner_samples / worker_samples : 0.0;
+        printf("%s: ticks=%llu samples=%llu seconds=%.3f ticks_per_s=%.0f held_us_per_tick=%.1f inner_pct=%.1f "
+               "outer_calls_inner=%s stacks=%zu report_ms=%.1f detached=%s\n", phase,
+               static_cast<unsigned long long>(ticks), static_cast<unsigned long long>(samples), seconds,
+               seconds > 0 ? ticks / seconds : 0.0, ticks ? profiler.get_held_ns() / 1000.0 / ticks : 0.0, inner_share,
+               called ? "yes" : "no", report.stacks.size(), report_ms, detached ? "yes" : "no");
+        return samples == ticks * (SPIN_THREADS + 1) && inner_share >= 50.0 && (called || !with_stacks) && detached;
+    }
+
+    // The child sleeps, so the ticks measure the clock rather than how the host shares its
+    // cores with spinning threads.
+    bool run_profile_schedule(uint32_t hz) {
+        pid_t child = spawn_idle_child();
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        const uint32_t duration_ms = 1000;
+        sampling_profiler profiler;
+        profiler.bind(source.get(), nullptr);
+        profiler.start(false);
+        profiler.schedule(duration_ms, hz);
+        uint64_t timeouts = 0;
+        uint64_t late_ns = 0;
+        bool failed = false;
+        while (!failed) {
+            profiler.on_timer();
+            if (!profiler.is_scheduled()) {
+                break;
+            }
+            uint32_t due_in = profiler.due_in();
+            uint64_t due_at = now_ns() + static_cast<uint64_t>(due_in) * 1000000;
+            debug_event event;
+            wait_status status = source->wait(event, due_in);
+            if (status == wait_status::timeout) {
+                timeouts++;
+                late_ns += now_ns() - (std::min)(now_ns(), due_at);
+            }
+            else if (status == wait_status::event) {
+                source->resume(event, debug_event_dispatcher::default_action(event));
+            }
+            else {
+                failed = true;
+            }
+        }
+        profiler.unbind();
+        bool detached = source->detach();
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+
+        uint64_t ticks = profiler.get_ticks();
+        uint64_t due = static_cast<uint64_t>(duration_ms) * hz / 1000;
+        printf("profile_schedule: hz=%u ticks=%llu due=%llu timeouts=%llu late_us=%.1f samples=%llu detached=%s\n", hz,
+               static_cast<unsigned long long>(ticks), static_cast<unsigned long long>(due), static_cast<unsigned long long>(timeouts),
+               timeouts ? late_ns / 1000.0 / timeouts : 0.0, static_cast<unsigned long long>(profiler.get_samples()), detached ? "yes" : "no");
+        return !failed && ticks * 10 >= due * 9 && ticks <= due && profiler.get_samples() == ticks && detached;
+    }
+
+    bool run_stack(uint64_t walks) {
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_deep_child(block);
+        usleep(50000);
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        std::vector<module_range> modules = enumerate_modules(static_cast<uint32_t>(child));
+        stack_walker walker;
+        walker.bind(source.get());
+        walker.set_modules(modules);
+
+        // The deep thread is the one that is not the main thread.
+        uint32_t tid = 0;
+        for (uint32_t thread : source->get_threads()) {
+            tid = thread != static_cast<uint32_t>(child) ? thread : tid;
+        }
+        uint64_t frames[STACK_WALK_MAX_FRAMES];
+        size_t count = 0;
+        uint64_t first_ns = 0;
+        uint64_t warm_ns = 0;
+        uint64_t walked = 0;
+        for (uint64_t i = 0; i < walks && tid; i++) {
+            source->sample_threads(&tid, 1, [&] (size_t, const thread_registers& registers) {
+                uint64_t before = now_ns();
+                count = walker.walk(registers, frames, STACK_WALK_MAX_FRAMES);
+                uint64_t elapsed = now_ns() - before;
+                (walked ? warm_ns : first_ns) += elapsed;
+                walked++;
+            });
+        }
+
+        // recurse frames: return addresses inside recurse, found through the unwind table.
+        const module_range* self = find_module(modules, reinterpret_cast<uint64_t>(&recurse));
+        std::vector<uint64_t> functions = self ? discover_functions(source.get(), *self) : std::vector<uint64_t>();
+        auto next = std::upper_bound(functions.begin(), functions.end(), reinterpret_cast<uint64_t>(&recurse));
+        uint64_t recurse_end = next != functions.end() ? *next : 0;
+        size_t recurse_frames = 0;
+        for (size_t i = 1; i < count; i++) {
+            recurse_frames += frames[i] - 1 >= reinterpret_cast<uint64_t>(&recurse) && frames[i] - 1 < recurse_end ? 1 : 0;
+        }
+        std::string outermost = count ? format_address(modules, frames[count - 1]) : "";
+
+        walker.unbind();
+        bool detached = source->detach();
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        munmap(block, sizeof(shared_block));
+        printf("stack: walks=%llu frames=%zu recurse_frames=%zu outermost=%s first_us=%.1f walk_us=%.2f detached=%s\n",
+               static_cast<unsigned long long>(walked), count, recurse_frames,
+               outermost.substr(outermost.find_last_of('/') + 1).c_str(), first_ns / 1000.0,
+               walked > 1 ? warm_ns / 1000.0 / (walked - 1) : 0.0, detached ? "yes" : "no");
+        // recurse(60) down to recurse(1) return into recurse; recurse(0) is where spin_inner returns.
+        return walked == walks && recurse_frames == RECURSE_DEPTH + 1 && count > RECURSE_DEPTH + 2 && detached;
+    }
+
+    bool run_modules(uint64_t count) {
+        pid_t child = spawn_idle_child();
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+        module_map map;
+        map.bind(source.get());
+        debug_event event;
+        bool reported = source->wait(event) == wait_status::event && event.type == debug_event_type::create_process;
+        if (reported) {
+            map.on_create_process(event);
+            source->resume(event, continue_action::handled);
+        }
+        std::shared_ptr<const std::vector<module_range>> modules = map.snapshot();
+        bool matches = reported && modules->size() == enumerate_modules(static_cast<uint32_t>(child)).size() && !modules->empty();
+
+        // A module loaded over part of another replaces it; unloading it leaves the gap.
+        module_range first = modules->empty() ? module_range{0x10000, 0x1000, "none"} : modules->front();
+        map.add(module_range{first.base, 1, "overlay"});
+        bool replaced = map.snapshot()->size() == modules->size() && map.snapshot()->front().name == "overlay";
+        bool removed = map.remove(first.base) && map.snapshot()->size() + 1 == modules->size();
+
+        // In order, as scan results come out: each module in turn, a fifth of its share just
+        // past its end.
+        auto address_at = [&] (uint64_t i) -> uint64_t {
+            uint64_t share = (std::max<uint64_t>)(1, count / modules->size());
+            const module_range& module = (*modules)[(std::min)(static_cast<size_t>(i / share), modules->size() - 1)];
+            return module.base + (i % share) * (module.size + module.size / 4) / share;
+        };
+        char text[MAX_ADDRESS_TEXT];
+        size_t inside = 0;
+        size_t checksum = 0;
+        uint64_t before = now_ns();
+        module_resolver resolver(*modules);
+        for (uint64_t i = 0; i < count && !modules->empty(); i++) {
+            size_t length = resolver.format(address_at(i), text, sizeof(text));
+            inside += text[0] != '0' || text[1] != 'x' ? 1 : 0;
+            checksum += length;
+        }
+        double resolve_ns = count ? static_cast<double>(now_ns() - before) / count : 0.0;
+        uint64_t slow_count = count / 10;
+        before = now_ns();
+        for (uint64_t i = 0; i < slow_count && !modules->empty(); i++) {
+            checksum += format_address(*modules, address_at(i * 10)).size();
+        }
+        double format_ns = slow_count ? static_cast<double>(now_ns() - before) / slow_count : 0.0;
+        std::string sample = format_address(*modules, reinterpret_cast<uint64_t>(&recurse));
+
+        map.unbind();
+        bool detached = source->detach();
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        printf("modules: modules=%zu from_event=%s replaced=%s removed=%s addresses=%llu inside=%zu resolve_ns=%.1f format_address_ns=%.1f "
+               "sample=%s detached=%s\n",
+               modules->size(), matches ? "yes" : "no", replaced ? "yes" : "no", removed ? "yes" : "no",
+               static_cast<unsigned long long>(count), inside, resolve_ns, format_ns,
+               sample.substr(sample.find_last_of('/') + 1).c_str(), detached && checksum ? "yes" : "no");
+        return matches && replaced && removed && inside > 0 && inside < count && detached;
+    }
+
+    bool run_journal(uint64_t count) {
+        static const uint32_t CODES[4] = { DEBUG_EXCEPTION_BREAKPOINT, DEBUG_EXCEPTION_SINGLE_STEP,
+                                           DEBUG_EXCEPTION_ACCESS_VIOLATION, DEBUG_EXCEPTION_GUARD_PAGE };
+        event_journal journal;
+        uint64_t before = now_ns();
+        for (uint64_t i = 0; i < count; i++) {
+            debug_event event = debug_event{};
+            event.pid = 100;
+            event.tid = 100 + static_cast<uint32_t>(i % 8);
+            // Every eighth event is a thread starting or exiting; the rest are exceptions.
+            if (i % 8 == 7) {
+                event.type = i % 16 == 7 ? debug_event_type::create_thread : debug_event_type::exit_thread;
+            }
+            else {
+                event.type = debug_event_type::exception;
+                event.code = CODES[i % 4];
+                event.address = 0x140001000 + (i * 2654435761u % 1024) * 16;
+                event.first_chance = true;
+            }
+            journal.record(event);
+        }
+        double record_ns = count ? static_cast<double>(now_ns() - before) / count : 0.0;
+
+        before = now_ns();
+        journal_counts counts = journal.count(0);
+        double count_ms = (now_ns() - before) / 1e6;
+        before = now_ns();
+        std::vector<journal_site> sites = journal.top(0, DEBUG_EXCEPTION_ACCESS_VIOLATION, 25);
+        double top_ms = (now_ns() - before) / 1e6;
+        before = now_ns();
+        std::vector<journal_event> recent = journal.since(0, 100);
+        double since_ms = (now_ns() - before) / 1e6;
+
+        size_t kept = journal.get_kept();
+        uint64_t exceptions = counts.by_type[static_cast<size_t>(debug_event_type::exception)];
+        uint64_t sum = 0;
+        for (const auto& code : counts.by_code) {
+            sum += code.second;
+        }
+        printf("journal: events=%llu kept=%zu exceptions=%llu codes=%zu av_sites=%zu record_ns=%.1f count_ms=%.2f top_ms=%.2f since_ms=%.3f\n",
+               static_cast<unsigned long long>(count), kept, static_cast<unsigned long long>(exceptions), counts.by_code.size(),
+               sites.size(), record_ns, count_ms, top_ms, since_ms);
+        return kept == (std::min)(static_cast<size_t>(count), EVENT_JOURNAL_CAPACITY) && counts.events == kept && sum == exceptions &&
+               counts.by_code.size() == 4 && !sites.empty() && recent.size() == (std::min)(kept, static_cast<size_t>(100));
+    }
+
+    bool run_exceptions(uint64_t count, bool statistics) {
+        count = (count + 3) / 4 * 4;
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_throwing_child(block, count);
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        // What core_debugger runs for an exception outside statistics mode.
+        event_journal journal;
+        breakpoint_manager breakpoints;
+        hardware_breakpoint_manager hardware;
+        page_watch_manager pages;
+        coverage_collector coverage;
+        step_tracer stepper;
+        breakpoints.bind(source.get());
+        hardware.bind(source.get());
+        pages.bind(source.get());
+        coverage.bind(source.get());
+        stepper.bind(source.get());
+        debug_event_dispatcher dispatcher;
+        char text[256];
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+            snprintf(text, sizeof(text), "[debugger] Exception caught: 0x%X at address 0x%llX (first chance: %s)", event.code,
+                     static_cast<unsigned long long>(event.address), event.first_chance ? "yes" : "no");
+            return false;
+        });
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) { return breakpoints.on_exception(event); });
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) { return hardware.on_exception(event); });
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) { return pages.on_exception(event); });
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) { return coverage.on_exception(event); });
+        dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) { return stepper.on_exception(event); });
+        exception_stats stats;
+        stats.set_enabled(statistics);
+
+        block->go.store(1);
+        uint64_t exceptions = 0;
+        uint64_t debugger_ns = 0;
+        uint64_t start = 0;
+        for (;;) {
+            debug_event event;
+            if (source->wait(event) != wait_status::event) {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+            uint64_t before = now_ns();
+            continue_action action = continue_action::handled;
+            bool counted = event.type == debug_event_type::exception && stats.is_enabled() && stats.record(event, action);
+            if (!counted) {
+                journal.record(event);
+                action = dispatcher.dispatch(event);
+            }
+            if (event.type == debug_event_type::exception) {
+                debugger_ns += now_ns() - before;
+                start = start ? start : before;
+                exceptions++;
+            }
+            source->resume(event, action);
+            if (event.type == debug_event_type::exit_process) {
+                break;
+            }
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        int status = 0;
+        waitpid(child, &status, __WALL);
+        bool child_ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && block->count == count;
+        std::vector<exception_site> sites = stats.top(8);
+        breakpoints.unbind();
+        hardware.unbind();
+        pages.unbind();
+        coverage.unbind();
+        stepper.unbind();
+        munmap(block, sizeof(shared_block));
+        printf("%s: exceptions=%llu sites=%zu child_ok=%s seconds=%.3f exceptions_per_s=%.0f debugger_ns=%.0f\n",
+               statistics ? "exceptions_stats" : "exceptions", static_cast<unsigned long long>(exceptions), sites.size(),
+               child_ok ? "yes" : "no", seconds, exceptions / seconds, exceptions ? static_cast<double>(debugger_ns) / exceptions : 0.0);
+        return child_ok && exceptions == count && (!statistics || (sites.size() == 4 && stats.get_total() == count));
+    }
+
+    bool run_batch(uint64_t count) {
+        pid_t child = spawn_idle_child();
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        uint64_t start = 0, end = 0;
+        if (!source->attach(static_cast<uint32_t>(child)) || !text_range(child, nullptr, start, end)) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        // Spread over the text segment; a stride of a few bytes is what basic-block coverage sets.
+        uint64_t stride = (std::max<uint64_t>)(1, (end - start) / (std::max<uint64_t>)(count, 1));
+        std::vector<uint64_t> addresses;
+        for (uint64_t address = start; address < end && addresses.size() < count; address += stride) {
+            addresses.push_back(address);
+        }
+
+        breakpoint_manager breakpoints;
+        breakpoints.bind(source.get());
+        uint64_t before = now_ns();
+        size_t set = breakpoints.add(addresses);
+        double add_ms = (now_ns() - before) / 1e6;
+        before = now_ns();
+        size_t removed = breakpoints.remove(addresses);
+        double remove_ms = (now_ns() - before) / 1e6;
+        breakpoints.unbind();
+
+        bool detached = source->detach();
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        printf("batch: breakpoints=%zu set=%zu removed=%zu text_kb=%llu add_ms=%.1f remove_ms=%.1f detached=%s\n",
+               addresses.size(), set, removed, static_cast<unsigned long long>((end - start) / 1024), add_ms, remove_ms,
+               detached ? "yes" : "no");
+        return set == addresses.size() && removed == set;
+    }
+
+    volatile pid_t detach_child = 0;
+
+    void kill_detach_child(int) {
+        if (detach_child) {
+            kill(detach_child, SIGKILL);
+        }
+    }
+
+    // Tears down a hot write watchpoint the way the debugger does (clear it on every thread,
+    // unbind, detach) while the writers keep hitting it, every other round with the last hit
+    // not resumed. Clearing it reaps the stops of threads caught on a hit; detach has to let
+    // those go as well. A detach that takes longer than DETACH_TIMEOUT_S is cut short by
+    // killing the child.
+    const unsigned DETACH_TIMEOUT_S = 2;
+
+    bool run_detach(uint64_t rounds) {
+        shared_block* block = map_shared(0);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = spawn_hot_watch_child(block);
+        block->go.store(1);
+        usleep(20000);
+        detach_child = child;
+        struct sigaction action = {};
+        struct sigaction previous = {};
+        action.sa_handler = kill_detach_child;
+        sigaction(SIGALRM, &action, &previous);
+
+        uint64_t detached = 0;
+        bool stalled = false;
+        double worst_ms = 0;
+        for (uint64_t round = 0; round < rounds && !stalled; round++) {
+            std::unique_ptr<debug_event_source> source = create_debug_event_source();
+            if (!source->attach(static_cast<uint32_t>(child))) {
+                perror("attach");
+                break;
+            }
+            hardware_breakpoint_manager watchpoints;
+            watchpoints.bind(source.get());
+            access_tracer tracer;
+            tracer.start(watchpoints, reinterpret_cast<uint64_t>(&watched), hardware_condition::write, 8);
+            debug_event_dispatcher dispatcher;
+            dispatcher.register_handler(debug_event_type::exception, [&] (const debug_event& event) {
+                return watchpoints.on_exception(event);
+            });
+            dispatcher.register_handler(debug_event_type::create_thread, [&] (const debug_event& event) {
+                return watchpoints.on_create_thread(event);
+            });
+            for (int i = 0; i < 200; i++) {
+                debug_event event;
+                if (source->wait(event) != wait_status::event) {
+                    break;
+                }
+                continue_action handled = dispatcher.dispatch(event);
+                if (i < 199 || round % 2 == 0) {
+                    source->resume(event, handled);
+                }
+            }
+            uint64_t before = now_ns();
+            alarm(DETACH_TIMEOUT_S);
+            tracer.stop(watchpoints);
+            watchpoints.unbind();
+            bool done = source->detach();
+            alarm(0);
+            double ms = (now_ns() - before) / 1e6;
+            worst_ms = (std::max)(worst_ms, ms);
+            stalled = ms >= DETACH_TIMEOUT_S * 1000.0;
+            detached += done && !stalled;
+        }
+
+        block->go.store(2);
+        int status = 0;
+        alarm(DETACH_TIMEOUT_S);
+        pid_t waited = waitpid(child, &status, 0);
+        alarm(0);
+        sigaction(SIGALRM, &previous, nullptr);
+        detach_child = 0;
+        bool child_ok = waited == child && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!child_ok && waited != child) {
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+        }
+        printf("detach: rounds=%llu detached=%llu stalled=%s worst_ms=%.1f child_ok=%s\n", static_cast<unsigned long long>(rounds),
+               static_cast<unsigned long long>(detached), stalled ? "yes" : "no", worst_ms, child_ok ? "yes" : "no");
+        munmap(block, sizeof(shared_block));
+        return detached == rounds && child_ok;
+    }
+
+    enum class wake_child { idle, urgent, blocked };
+
+    // The child's own SIGURG must not be taken for a wake, and one that blocks SIGURG must not
+    // keep a wake from arriving.
+    bool run_wakes(uint64_t wakes, wake_child kind) {
+        shared_block* block = map_shared(3);
+        if (!block) {
+            perror("mmap");
+            return false;
+        }
+        pid_t child = kind == wake_child::idle ? spawn_idle_child() : spawn_urgent_child(block, kind == wake_child::blocked);
+        std::unique_ptr<debug_event_source> source = create_debug_event_source();
+        if (!source->attach(static_cast<uint32_t>(child))) {
+            perror("attach");
+            kill(child, SIGKILL);
+            return false;
+        }
+
+        std::atomic<uint64_t> sent_at(0);
+        std::atomic<uint64_t> received(0);
+        std::vector<uint64_t> latencies;
+        latencies.reserve(static_cast<size_t>(wakes));
+
+        std::thread waker([&] {
+            for (uint64_t i = 0; i < wakes; i++) {
+                // Let the tracer get back into wait() so each wake interrupts a blocked waitpid.
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                sent_at.store(now_ns());
+                source->wake();
+                while (received.load() <= i) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+
+        while (received.load() < wakes) {
+            debug_event event;
+            wait_status status = source->wait(event);
+            if (status == wait_status::woken) {
+                latencies.push_back(now_ns() - sent_at.load());
+                received.fetch_add(1);
+            }
+            else if (status == wait_status::event) {
+                source->resume(event, debug_event_dispatcher::default_action(event));
+            }
+            else {
+                fprintf(stderr, "wait failed\n");
+                break;
+            }
+        }
+        waker.join();
+
+        bool detached = source->detach();
+        bool delivered = true;
+        if (kind == wake_child::urgent) {
+            block->go.store(2);
+            int status = 0;
+            delivered = waitpid(child, &status, 0) == child && WIFEXITED(status) &&
+                        block->round_trip_ns[0] > 0 && block->round_trip_ns[1] == block->round_trip_ns[0] &&
+                        block->round_trip_ns[2] == 0;
+        }
+        else {
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        const char* phase = kind == wake_child::idle ? "wake" : kind == wake_child::urgent ? "wake_urgent" : "wake_blocked";
+        printf("%s: wakes=%llu detached=%s latency_us p50=%.1f p99=%.1f max=%.1f", phase,
+               static_cast<unsigned long long>(latencies.size()), detached ? "yes" : "no",
+               percentile(latencies, 0.50) / 1000.0, percentile(latencies, 0.99) / 1000.0,
+               latencies.empty() ? 0.0 : latencies.back() / 1000.0);
+        if (kind == wake_child::urgent) {
+            printf(" raised=%u handled=%u stray=%u", block->round_trip_ns[0], block->round_trip_ns[1], block->round_trip_ns[2]);
+        }
+        printf("\n");
+        munmap(block, sizeof(shared_block) + 3 * sizeof(uint32_t));
+        return detached && delivered && latencies.size() == wakes;
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t hits = 200000;
+    uint64_t wakes = 1000;
+    uint64_t batch = 20000;
+    uint64_t blocks = 500000;
+    uint64_t ticks = 2000;
+    uint64_t walks = 10000;
+    uint64_t addresses = 10000000;
+    uint64_t events = 1000000;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--hits" && i + 1 < argc) {
+            hits = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--wakes" && i + 1 < argc) {
+            wakes = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--batch" && i + 1 < argc) {
+            batch = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--blocks" && i + 1 < argc) {
+            blocks = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--ticks" && i + 1 < argc) {
+            ticks = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--walks" && i + 1 < argc) {
+            walks = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--addresses" && i + 1 < argc) {
+            addresses = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--events" && i + 1 < argc) {
+            events = strtoull(argv[++i], nullptr, 0);
+        }
+        else {
+            fprintf(stderr, "Usage: debug_bench [--hits N] [--wakes N] [--batch N] [--blocks N] [--ticks N] [--walks N] [--addresses N]\n"
+                            "                   [--events N]\n");
+            return 1;
+        }
+    }
+
+    bool ok = run_breakpoints(hits);
+    ok = run_managed(hits, true, nullptr) && ok;
+    ok = run_managed(hits, false, nullptr) && ok;
+    ok = run_managed(hits, true, "[rdi] % 10 == 0") && ok;
+    ok = run_hardware(hits) && ok;
+    ok = run_pages(hits / 10) && ok;
+    ok = run_steps(hits, false) && ok;
+    ok = run_steps(hits, true) && ok;
+    ok = run_coverage(hits / 100, blocks) && ok;
+    ok = run_profile(ticks, false) && ok;
+    ok = run_profile(ticks, true) && ok;
+    ok = run_profile_schedule(100) && ok;
+    ok = run_profile_schedule(1000) && ok;
+    ok = run_stack(walks) && ok;
+    ok = run_modules(addresses) && ok;
+    ok = run_journal(events) && ok;
+    ok = run_exceptions(hits, false) && ok;
+    ok = run_exceptions(hits, true) && ok;
+    ok = run_batch(batch) && ok;
+    ok = run_detach(20) && ok;
+    ok = run_wakes(wakes, wake_child::idle) && ok;
+    ok = run_wakes(wakes, wake_child::urgent) && ok;
+    ok = run_wakes(wakes, wake_child::blocked) && ok;
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+#endif
@@ -0,0 +1,434 @@
+// Decoder throughput: runs the x86-64 decoder (CLI-Core/core/disasm/x86_decoder.h) over
+// this process's own libc text on Linux.
+//
+// Linux only:  g++ -O2 -std=c++14 -I../../CLI-Core/core/disasm disasm_bench.cpp
+//                  ../../CLI-Core/core/disasm/x86_decoder.cpp
+//                  ../../CLI-Core/core/disasm/x86_sweep.cpp
+//                  ../../CLI-Core/core/disasm/x86_format.cpp
+//                  ../../CLI-Core/core/disasm/xref.cpp -pthread -o disasm_bench
+// Usage:       disasm_bench [--passes N] [--index FILE]
+//
+// Phases:
+//   known     a list of hand-checked encodings (prefixes, REX, VEX, EVEX, rip-relative,
+//             moffs, enter, group 3, x87) decoded and formatted; every length, flow and
+//             text must match.
+//   decode    linear walk of libc's executable mapping N times with x86_decode, a byte
+//             skipped wherever it stops. Reports instructions/s, MB/s and ns per instruction.
+//   targets   the same walk also resolving every branch and rip-relative target.
+//   sweep     x86_sweep over the same text N times, the path for whole modules; its instruction
+//             count and reference offsets must match the targets walk exactly.
+//   format    Intel-syntax text for one pass. Reports instructions/s.
+//   xref      xref_build over libc as a module (parallel chunks, resynced at their starts)
+//             into FILE (default /tmp/disasm_bench.xref); the mapped index must hold exactly
+//             the references of a serial walk of its code. Reports build time and ns per
+//             'xref to' lookup.
+#ifndef __linux__
+#include <cstdio>
+
+int main() {
+    fprintf(stderr, "disasm_bench: only the Linux /proc/self/maps lookup is implemented.\n");
+    return 1;
+}
+#else
+#include "x86_decoder.h"
+#include "xref.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+    struct known_encoding
+    {
+        std::vector<uint8_t> bytes;
+        uint64_t address;
+        x86_flow flow;
+        const char* text;
+    };
+
+    const known_encoding KNOWN[] = {
+        { { 0x90 }, 0x1000, x86_flow::none, "nop" },
+        { { 0xC3 }, 0x1000, x86_flow::ret, "ret" },
+        { { 0x48, 0x89, 0xE5 }, 0x1000, x86_flow::none, "mov rbp, rsp" },
+        { { 0x40, 0x88, 0xF7 }, 0x1000, x86_flow::none, "mov dil, sil" },
+        { { 0x88, 0xE3 }, 0x1000, x86_flow::none, "mov bl, ah" },
+        { { 0xE8, 0xFB, 0xFF, 0xFF, 0xFF }, 0x1000, x86_flow::call, "call 0x1000" },
+        { { 0x0F, 0x84, 0x10, 0x00, 0x00, 0x00 }, 0x2000, x86_flow::branch, "je 0x2016" },
+        { { 0xEB, 0xFE }, 0x3000, x86_flow::jump, "jmp 0x3000" },
+        { { 0xFF, 0x15, 0x10, 0x00, 0x00, 0x00 }, 0x1000, x86_flow::call_indirect, "call qword ptr [rip+0x10]" },
+        { { 0xFF, 0xE0 }, 0x1000, x86_flow::jump_indirect, "jmp rax" },
+        { { 0x48, 0x8B, 0x05, 0x00, 0x01, 0x00, 0x00 }, 0x1000, x86_flow::none, "mov rax, qword ptr [rip+0x100]" },
+        { { 0x64, 0x48, 0x8B, 0x04, 0x25, 0x28, 0x00, 0x00, 0x00 }, 0x1000, x86_flow::none, "mov rax, qword ptr fs:[0x28]" },
+        { { 0x4A, 0x8D, 0x44, 0xA5, 0xF8 }, 0x1000, x86_flow::none, "lea rax, [rbp+r12*4-0x8]" },
+        { { 0x48, 0xB8, 0x88, 0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11 }, 0x1000, x86_flow::none, "mov rax, 0x1122334455667788" },
+        { { 0x48, 0xA1, 0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01 }, 0x1000, x86_flow::none, "mov rax, qword ptr [0x102030405060708]" },
+        { { 0x66, 0x81, 0xC1, 0x34, 0x12 }, 0x1000, x86_flow::none, "add cx, 0x1234" },
+        { { 0x48, 0x83, 0xEC, 0xF8 }, 0x1000, x86_flow::none, "sub rsp, -0x8" },
+        { { 0xF6, 0xC1, 0x01 }, 0x1000, x86_flow::none, "test cl, 0x1" },
+        { { 0xF7, 0xD8 }, 0x1000, x86_flow::none, "neg eax" },
+        { { 0xC8, 0x10, 0x00, 0x01 }, 0x1000, x86_flow::none, "enter 0x10, 0x1" },
+        { { 0xF3, 0x48, 0xAB }, 0x1000, x86_flow::none, "rep stosq" },
+        { { 0xF0, 0x48, 0x0F, 0xB1, 0x0A }, 0x1000, x86_flow::none, "lock cmpxchg qword ptr [rdx], rcx" },
+        { { 0xF3, 0x0F, 0x1E, 0xFA }, 0x1000, x86_flow::none, "endbr64" },
+        { { 0x66, 0x0F, 0x1F, 0x44, 0x00, 0x00 }, 0x1000, x86_flow::none, "nop word ptr [rax+rax*1]" },
+        { { 0xF2, 0x0F, 0x58, 0x05, 0x00, 0x00, 0x00, 0x00 }, 0x1000, x86_flow::none, "addsd xmm0, qword ptr [rip]" },
+        { { 0x66, 0x0F, 0xEF, 0xC0 }, 0x1000, x86_flow::none, "pxor xmm0, xmm0" },
+        { { 0x0F, 0xEF, 0xC0 }, 0x1000, x86_flow::none, "pxor mm0, mm0" },
+        { { 0xC5, 0xFD, 0xEF, 0xC9 }, 0x1000, x86_flow::none, "vpxor ymm1, ymm0, ymm1" },
+        { { 0xC4, 0xE2, 0x79, 0x00, 0xC1 }, 0x1000, x86_flow::none, "vpshufb xmm0, xmm0, xmm1" },
+        { { 0xC4, 0xE2, 0xF0, 0xF5, 0xC2 }, 0x1000, x86_flow::none, "bzhi rax, rdx, rcx" },
+        { { 0x62, 0xE1, 0xFD, 0x48, 0x6F, 0x4F, 0x01 }, 0x1000, x86_flow::none, "vmovdqa zmm17, zmmword ptr [rdi+0x40]" },
+        { { 0x66, 0x0F, 0x3A, 0x0F, 0xC1, 0x08 }, 0x1000, x86_flow::none, "palignr xmm0, xmm1, 0x8" },
+        { { 0xDD, 0x44, 0x24, 0x08 }, 0x1000, x86_flow::none, "fld qword ptr [rsp+0x8]" },
+        { { 0xDE, 0xC1 }, 0x1000, x86_flow::none, "faddp st(1), st" },
+        { { 0x0F, 0x05 }, 0x1000, x86_flow::none, "syscall" },
+        { { 0x0F, 0x01, 0xD0 }, 0x1000, x86_flow::none, "xgetbv" },
+        { { 0x0F, 0x22, 0xC0 }, 0x1000, x86_flow::none, "mov cr0, rax" },
+    };
+
+    // Encodings that must not decode: invalid in 64-bit mode, or cut short.
+    const std::vector<uint8_t> REJECTED[] = {
+        { 0x06 },                               // push es
+        { 0x27 },                               // daa
+        { 0xD6 },                               // salc
+        { 0x0F, 0x04 },
+        { 0x48, 0x8B },                         // no modrm
+        { 0x48, 0x8B, 0x84, 0x24, 0x00 },       // disp32 cut short
+        { 0xE8, 0x00, 0x00 },                   // rel32 cut short
+        { 0x48, 0xC5, 0xF8, 0x77 },             // REX before VEX
+        { 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x90 },  // 16 bytes
+    };
+
+    uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // libc's executable mapping in this process.
+    bool find_libc_text(const uint8_t*& text, size_t& size) {
+        FILE* maps = fopen("/proc/self/maps", "r");
+        if (!maps) {
+            return false;
+        }
+        char line[512];
+        bool found = false;
+        while (!found && fgets(line, sizeof(line), maps)) {
+            unsigned long long start, end;
+            char permissions[8];
+            if (sscanf(line, "%llx-%llx %7s", &start, &end, permissions) == 3 && permissions[2] == 'x'
+                && strstr(line, "/libc.so")) {
+                text = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(start));
+                size = static_cast<size_t>(end - start);
+                found = true;
+            }
+        }
+        fclose(maps);
+        return found;
+    }
+
+    // libc as a module: from its first mapping (the ELF header) to the end of its last.
+    bool find_libc_module(module_range& module) {
+        FILE* maps = fopen("/proc/self/maps", "r");
+        if (!maps) {
+            return false;
+        }
+        char line[512];
+        uint64_t first = UINT64_MAX;
+        uint64_t last = 0;
+        while (fgets(line, sizeof(line), maps)) {
+            unsigned long long start, end;
+            if (sscanf(line, "%llx-%llx", &start, &end) == 2 && strstr(line, "/libc.so")) {
+                first = std::min<uint64_t>(first, start);
+                last = std::max<uint64_t>(last, end);
+            }
+        }
+        fclose(maps);
+        module = module_range{first, last - first, "libc.so"};
+        return first < last;
+    }
+
+    bool run_known() {
+        size_t failures = 0;
+        char text[X86_MAX_TEXT];
+        for (const known_encoding& known : KNOWN) {
+            x86_instruction instruction;
+            bool decoded = x86_decode(known.bytes.data(), known.bytes.size(), instruction);
+            if (decoded) {
+                x86_format(instruction, known.address, text, sizeof(text));
+            }
+            if (!decoded || instruction.length != known.bytes.size() || instruction.flow != known.flow || strcmp(text, known.text)) {
+                fprintf(stderr, "known: expected \"%s\" (%zu bytes), got \"%s\" (%d bytes)\n", known.text, known.bytes.size(),
+                        decoded ? text : "invalid", decoded ? instruction.length : 0);
+                failures++;
+            }
+        }
+        for (const std::vector<uint8_t>& bytes : REJECTED) {
+            x86_instruction instruction;
+            if (x86_decode(bytes.data(), bytes.size(), instruction)) {
+                fprintf(stderr, "known: %zu-byte encoding starting %02X decoded, expected it rejected\n", bytes.size(), bytes[0]);
+                failures++;
+            }
+        }
+        size_t total = sizeof(KNOWN) / sizeof(KNOWN[0]) + sizeof(REJECTED) / sizeof(REJECTED[0]);
+        printf("known: encodings=%zu failures=%zu\n", total, failures);
+        return failures == 0;
+    }
+
+    struct walk_result
+    {
+        uint64_t instructions = 0;
+        uint64_t skipped = 0;
+        uint64_t targets = 0;
+        uint64_t checksum = 0;
+    };
+
+    template<bool with_targets>
+    walk_result walk(const uint8_t* text, size_t size, std::vector<uint32_t>* references) {
+        walk_result result;
+        uint64_t base = reinterpret_cast<uintptr_t>(text);
+        x86_instruction instruction;
+        size_t offset = 0;
+        while (offset < size) {
+            if (!x86_decode(text + offset, size - offset, instruction)) {
+                result.skipped++;
+                offset++;
+                continue;
+            }
+            result.instructions++;
+            result.checksum += instruction.opcode;
+            if (with_targets) {
+                uint64_t target;
+                if (x86_target(instruction, base + offset, target)) {
+                    result.targets++;
+                    result.checksum += target;
+                    if (references) {
+                        references->push_back(static_cast<uint32_t>(offset));
+                    }
+                }
+            }
+            offset += instruction.length;
+        }
+        return result;
+    }
+
+    template<bool with_targets>
+    bool run_walk(const char* phase, const uint8_t* text, size_t size, uint64_t passes) {
+        walk_result total;
+        uint64_t before = now_ns();
+        for (uint64_t pass = 0; pass < passes; pass++) {
+            walk_result result = walk<with_targets>(text, size, nullptr);
+            total.instructions += result.instructions;
+            total.skipped += result.skipped;
+            total.targets += result.targets;
+            total.checksum += result.checksum;
+        }
+        double seconds = (now_ns() - before) / 1e9;
+        double per_s = seconds > 0 ? total.instructions / seconds : 0.0;
+        printf("%s: text_kb=%zu passes=%llu instructions=%llu skipped=%llu targets=%llu seconds=%.3f "
+               "instructions_per_s=%.0f mb_per_s=%.0f ns_per_instruction=%.2f checksum=%llx\n",
+               phase, size / 1024, static_cast<unsigned long long>(passes), static_cast<unsigned long long>(total.instructions),
+               static_cast<unsigned long long>(total.skipped), static_cast<unsigned long long>(total.targets), seconds,
+               per_s, seconds > 0 ? size * passes / seconds / 1e6 : 0.0, per_s > 0 ? 1e9 / per_s : 0.0,
+               static_cast<unsigned long long>(total.checksum));
+        // Compiled code is almost all instructions; a decoder that loses sync skips far more.
+        return total.instructions > 0 && total.skipped * 100 < total.instructions;
+    }
+
+    bool run_sweep(const uint8_t* text, size_t size, uint64_t passes) {
+        std::vector<uint32_t> expected;
+        walk_result walked = walk<true>(text, size, &expected);
+
+        std::vector<uint32_t> references;
+        references.reserve(expected.size());
+        uint64_t instructions = 0;
+        bool same = true;
+        uint64_t before = now_ns();
+        for (uint64_t pass = 0; pass < passes; pass++) {
+            references.clear();
+            uint64_t counted = 0;
+            size_t stop = x86_sweep(text, size, 0, size, references, counted);
+            same = same && stop == size && counted == walked.instructions && references == expected;
+            instructions += counted;
+        }
+        double seconds = (now_ns() - before) / 1e9;
+        double per_s = seconds > 0 ? instructions / seconds : 0.0;
+        printf("sweep: text_kb=%zu passes=%llu instructions=%llu references=%zu seconds=%.3f "
+               "instructions_per_s=%.0f mb_per_s=%.0f ns_per_instruction=%.2f matches_decode=%s\n",
+               size / 1024, static_cast<unsigned long long>(passes), static_cast<unsigned long long>(instructions),
+               references.size(), seconds, per_s, seconds > 0 ? size * passes / seconds / 1e6 : 0.0,
+               per_s > 0 ? 1e9 / per_s : 0.0, same ? "yes" : "no");
+        return same && instructions > 0;
+    }
+
+    bool run_format(const uint8_t* text, size_t size) {
+        uint64_t base = reinterpret_cast<uintptr_t>(text);
+        uint64_t instructions = 0;
+        uint64_t characters = 0;
+        char buffer[X86_MAX_TEXT];
+        x86_instruction instruction;
+        uint64_t before = now_ns();
+        for (size_t offset = 0; offset < size;) {
+            if (!x86_decode(text + offset, size - offset, instruction)) {
+                offset++;
+                continue;
+            }
+            characters += x86_format(instruction, base + offset, buffer, sizeof(buffer));
+            instructions++;
+            offset += instruction.length;
+        }
+        double seconds = (now_ns() - before) / 1e9;
+        printf("format: instructions=%llu chars_per_instruction=%.1f seconds=%.3f instructions_per_s=%.0f\n",
+               static_cast<unsigned long long>(instructions), instructions ? static_cast<double>(characters) / instructions : 0.0,
+               seconds, seconds > 0 ? instructions / seconds : 0.0);
+        return instructions > 0;
+    }
+
+    // Code reached through the module's own program headers, like xref_build does, and
+    // walked serially with x86_decode.
+    bool serial_references(const module_range& module, std::vector<std::pair<xref_entry, xref_kind>>& expected, uint64_t& instructions) {
+        const uint8_t* image = reinterpret_cast<const uint8_t*>(static_cast<uintptr_t>(module.base));
+        uint64_t header_offset = 0;
+        uint16_t header_count = 0;
+        memcpy(&header_offset, image + 0x20, sizeof(header_offset));
+        memcpy(&header_count, image + 0x38, sizeof(header_count));
+        uint64_t first_load = UINT64_MAX;
+        for (uint16_t i = 0; i < header_count; i++) {
+            const uint8_t* header = image + header_offset + i * 56;
+            uint32_t type;
+            uint64_t address;
+            memcpy(&type, header, 4);
+            memcpy(&address, header + 0x10, 8);
+            if (type == 1) {
+                first_load = std::min<uint64_t>(first_load, address & ~0xFFFull);
+            }
+        }
+        for (uint16_t i = 0; i < header_count; i++) {
+            const uint8_t* header = image + header_offset + i * 56;
+            uint32_t type, flags;
+            uint64_t address, memory_size;
+            memcpy(&type, header, 4);
+            memcpy(&flags, header + 4, 4);
+            memcpy(&address, header + 0x10, 8);
+            memcpy(&memory_size, header + 0x28, 8);
+            if (type != 1 || !(flags & 1)) {
+                continue;
+            }
+            uint64_t offset = address - first_load;
+            size_t size = static_cast<size_t>(std::min<uint64_t>(memory_size, module.size - offset));
+            const uint8_t* code = image + offset;
+            x86_instruction instruction;
+            for (size_t position = 0; position < size;) {
+                if (!x86_decode(code + position, size - position, instruction)) {
+                    position++;
+                    continue;
+                }
+                instructions++;
+                uint64_t target;
+                if (x86_target(instruction, module.base + offset + position, target) && target - module.base < module.size) {
+                    xref_kind kind = instruction.flow == x86_flow::call ? xref_kind::call :
+                                     instruction.flow == x86_flow::jump ? xref_kind::jump :
+                                     instruction.flow == x86_flow::branch ? xref_kind::branch :
+                                     instruction.encoding == x86_encoding::legacy && instruction.map == 0 && instruction.opcode == 0x8D
+                                     ? xref_kind::address : xref_kind::data;
+                    expected.push_back({ xref_entry{ static_cast<uint32_t>(target - module.base), static_cast<uint32_t>(offset + position) }, kind });
+                }
+                position += instruction.length;
+            }
+        }
+        std::sort(expected.begin(), expected.end(), [] (const std::pair<xref_entry, xref_kind>& a, const std::pair<xref_entry, xref_kind>& b) {
+            return a.first.target != b.first.target ? a.first.target < b.first.target : a.first.source < b.first.source;
+        });
+        return !expected.empty();
+    }
+
+    bool run_xref(const std::string& path) {
+        module_range module;
+        if (!find_libc_module(module)) {
+            fprintf(stderr, "xref: libc's mappings not found in /proc/self/maps\n");
+            return false;
+        }
+        xref_reader read = [] (uint64_t address, void* buffer, size_t size) -> bool {
+            memcpy(buffer, reinterpret_cast<const void*>(static_cast<uintptr_t>(address)), size);
+            return true;
+        };
+        uint64_t key = 0;
+        xref_build_stats stats = {};
+        xref_index index;
+        if (!xref_module_key(read, module, key) || !xref_build(read, module, key, path, stats) || !index.open(path, key)) {
+            fprintf(stderr, "xref: building or opening %s failed\n", path.c_str());
+            return false;
+        }
+
+        std::vector<std::pair<xref_entry, xref_kind>> expected;
+        uint64_t instructions = 0;
+        bool same = serial_references(module, expected, instructions) && instructions == stats.instructions &&
+                    index.get_count() == expected.size() && index.get_instructions() == instructions;
+        for (size_t i = 0; same && i < expected.size(); i++) {
+            same = index.entry(i).target == expected[i].first.target && index.entry(i).source == expected[i].first.source &&
+                   index.kind(i) == expected[i].second;
+        }
+        xref_index other;
+        bool rejects_other_key = !other.open(path, key + 1);
+
+        // Lookups of every referenced target, in a scattered order.
+        std::vector<uint32_t> targets;
+        for (size_t i = 0; i < index.get_count(); i += 7) {
+            targets.push_back(index.entry(i).target);
+        }
+        std::reverse(targets.begin(), targets.end());
+        uint64_t found = 0;
+        uint64_t before = now_ns();
+        for (uint32_t target : targets) {
+            size_t first, last;
+            index.find(target, target, first, last);
+            found += last - first;
+        }
+        double lookup_ns = targets.empty() ? 0.0 : static_cast<double>(now_ns() - before) / targets.size();
+
+        double seconds = stats.nanoseconds / 1e9;
+        printf("xref: code_kb=%llu threads=%u chunks=%u resynced=%u instructions=%llu references=%llu seconds=%.3f "
+               "instructions_per_s=%.0f lookups=%zu ns_per_lookup=%.1f found=%llu matches_walk=%s rejects_other_key=%s\n",
+               static_cast<unsigned long long>(stats.code_bytes / 1024), stats.threads, stats.chunks, stats.resynced,
+               static_cast<unsigned long long>(stats.instructions), static_cast<unsigned long long>(stats.references), seconds,
+               seconds > 0 ? stats.instructions / seconds : 0.0, targets.size(), lookup_ns, static_cast<unsigned long long>(found),
+               same ? "yes" : "no", rejects_other_key ? "yes" : "no");
+        return same && rejects_other_key && found >= targets.size();
+    }
+}
+
+int main(int argc, char** argv) {
+    uint64_t passes = 20;
+    std::string index_path = "/tmp/disasm_bench.xref";
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--passes" && i + 1 < argc) {
+            passes = strtoull(argv[++i], nullptr, 0);
+        }
+        else if (arg == "--index" && i + 1 < argc) {
+            index_path = argv[++i];
+        }
+        else {
+            fprintf(stderr, "usage: disasm_bench [--passes N] [--index FILE]\n");
+            return 1;
+        }
+    }
+
+    const uint8_t* text = nullptr;
+    size_t size = 0;
+    if (!find_libc_text(text, size)) {
+        fprintf(stderr, "disasm_bench: libc's text mapping not found in /proc/self/maps\n");
+        return 1;
+    }
+    bool ok = run_known();
+    ok = run_walk<false>("decode", text, size, passes) && ok;
+    ok = run_walk<true>("targets", text, size, passes) && ok;
+    ok = run_sweep(text, size, passes) && ok;
+    ok = run_format(text, size) && ok;
+    ok = run_xref(index_path) && ok;
+    return ok ? 0 : 1;
+}
+#endif
@@ -0,0 +1,240 @@
+// Standalone microbenchmark for the scanner's inner loops (scan_kernels.h).
+// Runs on in-memory buffers only, no target process or Win32 API is needed.
+//
+// Linux:   g++ -O2 -std=c++14 -pthread -I../../CLI-Core/core/scanner kernel_bench.cpp
+//              ../../CLI-Core/core/scanner/kernel_counters.cpp -o kernel_bench
+// Windows: build kernel_bench.vcxproj from CLI-Core.sln
+//
+// Usage: kernel_bench [--elements N] [--repeat N] [--csv]
+#include "scan_kernels.h"
+#include "kernel_counters.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+    const size_t SCAN_CHUNK_SIZE = 32768;   // search_int_thread read size
+    const size_t CACHE_SIZE = 16384;        // search/filter hit cache size
+    const int SEARCH_VALUE = 0x1337;
+    const double HIT_RATES[] = { 0.0, 0.001, 0.01, 0.05, 0.10, 0.25, 0.50 };
+
+    struct bench_config
+    {
+        size_t elements = 8u << 20;
+        int repeat = 5;
+        bool csv = false;
+    };
+
+    struct bench_result
+    {
+        double ns_per_element;
+        double cycles_per_element;
+        size_t hits;
+    };
+
+    uint64_t next_random(uint64_t& state) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    // Fills data with values that never equal SEARCH_VALUE except at a hit_rate fraction of positions.
+    void fill_buffer(std::vector<int>& data, double hit_rate, uint64_t seed) {
+        uint64_t state = seed;
+        uint64_t threshold = static_cast<uint64_t>(hit_rate * static_cast<double>(UINT32_MAX));
+        for (auto& element : data) {
+            uint64_t random = next_random(state);
+            if ((random & UINT32_MAX) < threshold) {
+                element = SEARCH_VALUE;
+            }
+            else {
+                element = static_cast<int>(random >> 40) | 0x40000000;
+            }
+        }
+    }
+
+    template<typename T>
+    struct result_sink
+    {
+        std::vector<scanned_value<T>> results;
+        std::unique_ptr<scanned_value<T>[]> cache;
+        size_t cache_count = 0;
+
+        result_sink() : cache(new scanned_value<T>[CACHE_SIZE]) {
+            results.reserve(1000000);
+        }
+        void flush() {
+            results.insert(results.end(), cache.get(), cache.get() + cache_count);
+            cache_count = 0;
+        }
+    };
+
+    // Drives a search kernel the way search_int_thread does: fixed-size chunks,
+    // a bounded hit cache and a growing per-thread result vector.
+    typedef size_t (*search_kernel_runner)(const std::vector<int>& data, result_sink<int>& sink);
+
+    size_t run_search_scalar(const std::vector<int>& data, result_sink<int>& sink) {
+        const size_t chunk_elements = SCAN_CHUNK_SIZE / sizeof(int);
+        auto flush = [&] () { sink.flush(); };
+        for (size_t offset = 0; offset < data.size(); offset += chunk_elements) {
+            size_t count = std::min(chunk_elements, data.size() - offset);
+            search_kernel_scalar(data.data() + offset, count, SEARCH_VALUE,
+                                 static_cast<uintptr_t>(offset * sizeof(int)),
+                                 sink.cache.get(), sink.cache_count, CACHE_SIZE, flush);
+        }
+        sink.flush();
+        return sink.results.size();
+    }
+
+    // Drives a filter kernel the way filter_int_thread does; the page reader copies
+    // from the in-memory "target" instead of calling ReadProcessMemory.
+    typedef size_t (*filter_kernel_runner)(const std::vector<int>& memory, const std::vector<scanned_value<int>>& candidates, result_sink<int>& sink);
+
+    size_t run_filter_scalar(const std::vector<int>& memory, const std::vector<scanned_value<int>>& candidates, result_sink<int>& sink) {
+        scan_page_cache<int> page_cache;
+        const char* base = reinterpret_cast<const char*>(memory.data());
+        size_t memory_bytes = memory.size() * sizeof(int);
+        auto read_page = [&] (uintptr_t page_addr, int* destination, size_t block_size) -> bool {
+            if (page_addr + block_size > memory_bytes) {
+                return false;
+            }
+            memcpy(destination, base + page_addr, block_size);
+            return true;
+        };
+        auto flush = [&] () { sink.flush(); };
+        filter_kernel_scalar(candidates.data(), candidates.data() + candidates.size(), SEARCH_VALUE,
+                             page_cache, read_page, sink.cache.get(), sink.cache_count, CACHE_SIZE, flush);
+        sink.flush();
+        return sink.results.size();
+    }
+
+    struct search_kernel_entry { const char* name; search_kernel_runner run; };
+    struct filter_kernel_entry { const char* name; filter_kernel_runner run; };
+
+    // New kernels are benchmarked by adding them here.
+    const search_kernel_entry SEARCH_KERNELS[] = {
+        { "search_scalar", run_search_scalar },
+    };
+    const filter_kernel_entry FILTER_KERNELS[] = {
+        { "filter_scalar", run_filter_scalar },
+    };
+
+    template<typename Body>
+    bench_result measure(const bench_config& config, size_t elements, Body&& body) {
+        double best_ns = 0.0;
+        uint64_t best_cycles = 0;
+        size_t hits = 0;
+        for (int r = 0; r < config.repeat; r++) {
+            hw_counter_group counters;
+            bool has_counters = counters.open();
+            auto start = std::chrono::steady_clock::now();
+            if (has_counters) {
+                counters.start();
+            }
+            hits = body();
+            if (has_counters) {
+                counters.stop();
+                counters.read();
+            }
+            double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            if (r == 0 || ns < best_ns) {
+                best_ns = ns;
+                const hw_sample& sample = counters.sample();
+                best_cycles = sample.valid[static_cast<int>(hw_counter::cycles)] ? sample.values[static_cast<int>(hw_counter::cycles)] : 0;
+            }
+        }
+        bench_result result;
+        result.ns_per_element = best_ns / elements;
+        result.cycles_per_element = static_cast<double>(best_cycles) / elements;
+        result.hits = hits;
+        return result;
+    }
+
+    void print_header(const bench_config& config) {
+        if (config.csv) {
+            printf("kernel,hit_rate,elements,hits,ns_per_element,cycles_per_element\n");
+            return;
+        }
+        printf("%-16s %9s %12s %12s %14s %16s\n", "kernel", "hit rate", "elements", "hits", "ns/element", "cycles/element");
+    }
+
+    void print_row(const bench_config& config, const char* kernel, double hit_rate, size_t elements, const bench_result& result) {
+        if (config.csv) {
+            printf("%s,%.4f,%zu,%zu,%.4f,%.4f\n", kernel, hit_rate, elements, result.hits, result.ns_per_element, result.cycles_per_element);
+            return;
+        }
+        if (result.cycles_per_element > 0.0) {
+            printf("%-16s %8.1f%% %12zu %12zu %14.4f %16.4f\n", kernel, hit_rate * 100.0, elements, result.hits, result.ns_per_element, result.cycles_per_element);
+        }
+        else {
+            printf("%-16s %8.1f%% %12zu %12zu %14.4f %16s\n", kernel, hit_rate * 100.0, elements, result.hits, result.ns_per_element, "n/a");
+        }
+    }
+
+    bool parse_args(int argc, char** argv, bench_config& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--elements" && i + 1 < argc) {
+                config.elements = static_cast<size_t>(strtoull(argv[++i], nullptr, 0));
+            }
+            else if (arg == "--repeat" && i + 1 < argc) {
+                config.repeat = std::max(1, atoi(argv[++i]));
+            }
+            else if (arg == "--csv") {
+                config.csv = true;
+            }
+            else {
+                fprintf(stderr, "Usage: kernel_bench [--elements N] [--repeat N] [--csv]\n");
+                return false;
+            }
+        }
+        // Whole pages keep the filter reader in bounds.
+        const size_t page_elements = 4096 / sizeof(int);
+        config.elements = std::max(page_elements, config.elements / page_elements * page_elements);
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    bench_config config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+
+    std::vector<int> memory(config.elements);
+    print_header(config);
+
+    for (double hit_rate : HIT_RATES) {
+        fill_buffer(memory, hit_rate, 0x9E3779B97F4A7C15ull);
+
+        for (auto& kernel : SEARCH_KERNELS) {
+            bench_result result = measure(config, memory.size(), [&] () {
+                result_sink<int> sink;
+                return kernel.run(memory, sink);
+            });
+            print_row(config, kernel.name, hit_rate, memory.size(), result);
+        }
+
+        // Filter candidates: every 16th int (one per cache line), as after a broad first scan.
+        std::vector<scanned_value<int>> candidates;
+        candidates.reserve(memory.size() / 16);
+        for (size_t i = 0; i < memory.size(); i += 16) {
+            candidates.push_back({SEARCH_VALUE, static_cast<uintptr_t>(i * sizeof(int))});
+        }
+
+        for (auto& kernel : FILTER_KERNELS) {
+            bench_result result = measure(config, candidates.size(), [&] () {
+                result_sink<int> sink;
+                return kernel.run(memory, candidates, sink);
+            });
+            print_row(config, kernel.name, hit_rate, candidates.size(), result);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,153 @@
+// End-to-end debug log latency: drives debug::print_fmt through the real writer thread
+// and transport into the reference console (debugger_console --quiet --latency), which
+// reports delivery latency percentiles. The producer side reports the cost of a call.
+//
+// Linux:   g++ -O2 -std=c++14 -pthread -I../../CLI-Core/core/debugger/output_pipe log_bench.cpp
+//              ../../CLI-Core/core/debugger/output_pipe/output_pipe.cpp
+//              ../../CLI-Core/core/debugger/output_pipe/log_format.cpp
+//              ../../CLI-Core/core/debugger/output_pipe/log_transport.cpp -o log_bench
+//          (build debugger_console next to it, or pass --console)
+// Windows: build log_bench.vcxproj from CLI-Core.sln
+//
+// Usage: log_bench [--transport pipe|uds|shm] [--mode text|binary] [--messages N]
+//                  [--rate N] [--flush-kb N] [--flush-us N] [--policy drop-oldest|drop-new|block]
+//                  [--console PATH]
+//   --rate 0 sends as fast as possible; otherwise N messages per second.
+#include "output_pipe.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    struct bench_config
+    {
+        debug::TransportKind transport = debug::default_transport_kind();
+        debug::WireMode mode = debug::WireMode::BINARY;
+        debug::OverflowPolicy policy = debug::OverflowPolicy::BLOCK;
+        uint64_t messages = 200000;
+        uint64_t rate = 0;
+        uint32_t flush_kb = debug::LOG_BATCH_BYTES / 1024;
+        uint32_t flush_us = debug::LOG_BATCH_LATENCY_US;
+        std::string console;
+    };
+
+    uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool parse_args(int argc, char** argv, bench_config& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool has_value = i + 1 < argc;
+            if (arg == "--transport" && has_value) {
+                if (!debug::parse_transport_kind(argv[++i], config.transport)) {
+                    return false;
+                }
+            }
+            else if (arg == "--mode" && has_value) {
+                std::string mode = argv[++i];
+                if (mode != "text" && mode != "binary") {
+                    return false;
+                }
+                config.mode = mode == "text" ? debug::WireMode::TEXT : debug::WireMode::BINARY;
+            }
+            else if (arg == "--policy" && has_value) {
+                std::string policy = argv[++i];
+                if (policy == "drop-oldest") config.policy = debug::OverflowPolicy::DROP_OLDEST;
+                else if (policy == "drop-new") config.policy = debug::OverflowPolicy::DROP_NEW;
+                else if (policy == "block") config.policy = debug::OverflowPolicy::BLOCK;
+                else return false;
+            }
+            else if (arg == "--messages" && has_value) {
+                config.messages = strtoull(argv[++i], nullptr, 0);
+            }
+            else if (arg == "--rate" && has_value) {
+                config.rate = strtoull(argv[++i], nullptr, 0);
+            }
+            else if (arg == "--flush-kb" && has_value) {
+                config.flush_kb = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+            }
+            else if (arg == "--flush-us" && has_value) {
+                config.flush_us = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 0));
+            }
+            else if (arg == "--console" && has_value) {
+                config.console = argv[++i];
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    bench_config config;
+    if (!parse_args(argc, argv, config)) {
+        fprintf(stderr, "Usage: log_bench [--transport pipe|uds|shm] [--mode text|binary] [--messages N] [--rate N]\n"
+                        "                 [--flush-kb N] [--flush-us N] [--policy drop-oldest|drop-new|block] [--console PATH]\n");
+        return 1;
+    }
+
+    if (config.console.empty()) {
+#ifdef _WIN32
+        config.console = debug::executable_directory() + "debugger_console.exe";
+#else
+        config.console = debug::executable_directory() + "debugger_console";
+#endif
+    }
+
+    debug::Debugger& logger = debug::Debugger::instance();
+    logger.set_console(config.console, { "--quiet", "--latency" });
+    logger.set_transport(config.transport);
+    logger.set_wire_mode(config.mode);
+    logger.set_overflow_policy(config.policy);
+    logger.set_flush_policy(debug::FlushPolicy{ config.flush_kb * 1024, config.flush_us });
+
+    uint64_t connect_start = now_ns();
+    if (!debug::start()) {
+        return 1;
+    }
+    double connect_ms = (now_ns() - connect_start) / 1e6;
+
+    std::vector<uint32_t> call_ns;
+    call_ns.reserve(static_cast<size_t>(config.messages));
+    uint64_t interval_ns = config.rate ? 1000000000ull / config.rate : 0;
+    uint64_t start = now_ns();
+    for (uint64_t i = 0; i < config.messages; i++) {
+        if (interval_ns) {
+            uint64_t due = start + i * interval_ns;
+            while (now_ns() < due) {
+                std::this_thread::yield();
+            }
+        }
+        uint64_t before = now_ns();
+        debug::print_fmt("latency probe %llu", static_cast<unsigned long long>(before));
+        call_ns.push_back(static_cast<uint32_t>(std::min<uint64_t>(now_ns() - before, UINT32_MAX)));
+    }
+    double seconds = (now_ns() - start) / 1e9;
+
+    debug::stop();
+
+    std::sort(call_ns.begin(), call_ns.end());
+    auto percentile = [&] (double p) {
+        return call_ns.empty() ? 0u : call_ns[static_cast<size_t>(p * (call_ns.size() - 1))];
+    };
+    debug::LogStats stats = debug::get_stats();
+    printf("producer: transport=%s mode=%s messages=%llu seconds=%.3f msgs_per_s=%.0f connect_ms=%.1f\n",
+           debug::transport_kind_name(config.transport), config.mode == debug::WireMode::BINARY ? "binary" : "text",
+           static_cast<unsigned long long>(config.messages), seconds, seconds > 0 ? config.messages / seconds : 0.0, connect_ms);
+    printf("producer: call_ns p50=%u p99=%u max=%u\n", percentile(0.50), percentile(0.99), call_ns.empty() ? 0u : call_ns.back());
+    printf("producer: written=%llu frames=%llu messages_per_frame=%.2f dropped=%llu blocked=%llu credit_waits=%llu credit_wait_ms=%.1f\n",
+           static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.write_calls),
+           stats.write_calls ? static_cast<double>(stats.written) / stats.write_calls : 0.0,
+           static_cast<unsigned long long>(stats.dropped_oldest + stats.dropped_new), static_cast<unsigned long long>(stats.blocked),
+           static_cast<unsigned long long>(stats.credit_waits), stats.credit_wait_ns / 1e6);
+    fflush(stdout);
+    return 0;
+}
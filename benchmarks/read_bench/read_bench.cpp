@@ -0,0 +1,297 @@
+// Read-path benchmark: copies a synthetic child process's memory through every
+// transport the host offers and sweeps the chunk size, to decide how the scanner
+// should read target memory. Results are written to stdout as CSV.
+//
+// Linux only:  g++ -O2 -std=c++14 read_bench.cpp -o read_bench
+// Usage:       read_bench [--size MB] [--repeat N]
+//
+// Methods:
+//   scanner_baseline   process_vm_readv, one 32 KB iovec per call (search_int_thread today)
+//   vm_readv_single    process_vm_readv, one iovec per call of chunk size
+//   vm_readv_pages     process_vm_readv, chunk split into 4 KB iovecs (up to IOV_MAX per call)
+//   proc_mem_pread     pread on /proc/<pid>/mem
+//   cooperative_shm_upper_bound
+//                      memcpy from a MAP_SHARED buffer the child set up for the parent (zero
+//                      syscalls). No real target offers this: it needs the target's cooperation,
+//                      so it only bounds what any copy path could reach and is not a candidate.
+#ifndef __linux__
+#include <cstdio>
+
+int main() {
+    fprintf(stderr, "read_bench: only Linux transports are implemented.\n");
+    return 1;
+}
+#else
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    const size_t PAGE_SIZE_BYTES = 4096;
+    const size_t SCANNER_CHUNK_SIZE = 32768;
+
+    struct bench_config
+    {
+        size_t size = 256u << 20;
+        int repeat = 3;
+    };
+
+    struct target_child
+    {
+        pid_t pid = -1;
+        uintptr_t private_address = 0;  // copy-on-write private buffer, read through the kernel
+        uint8_t* shared_mapping = nullptr;
+        size_t size = 0;
+    };
+
+    struct read_stats
+    {
+        uint64_t bytes = 0;
+        uint64_t syscalls = 0;
+        uint64_t failures = 0;
+    };
+
+    // The child owns a private buffer (the real case: scanner reads another process's
+    // anonymous memory) and a shared one the parent maps directly for the cooperative upper bound.
+    bool spawn_child(size_t size, target_child& child) {
+        uint8_t* shared = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+        if (shared == MAP_FAILED) {
+            perror("mmap");
+            return false;
+        }
+
+        int address_pipe[2];
+        if (pipe(address_pipe) != 0) {
+            perror("pipe");
+            return false;
+        }
+
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            return false;
+        }
+
+        if (pid == 0) {
+            close(address_pipe[0]);
+            uint8_t* buffer = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (buffer == MAP_FAILED) {
+                _exit(1);
+            }
+            for (size_t i = 0; i < size; i += sizeof(uint32_t)) {
+                uint32_t value = static_cast<uint32_t>(i * 2654435761u);
+                memcpy(buffer + i, &value, sizeof(value));
+                memcpy(shared + i, &value, sizeof(value));
+            }
+            uintptr_t address = reinterpret_cast<uintptr_t>(buffer);
+            if (write(address_pipe[1], &address, sizeof(address)) != sizeof(address)) {
+                _exit(1);
+            }
+            close(address_pipe[1]);
+            for (;;) {
+                pause();
+            }
+        }
+
+        close(address_pipe[1]);
+        uintptr_t address = 0;
+        ssize_t received = read(address_pipe[0], &address, sizeof(address));
+        close(address_pipe[0]);
+        if (received != sizeof(address)) {
+            fprintf(stderr, "read_bench: child failed to start\n");
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+            return false;
+        }
+
+        child.pid = pid;
+        child.private_address = address;
+        child.shared_mapping = shared;
+        child.size = size;
+        return true;
+    }
+
+    void stop_child(target_child& child) {
+        if (child.pid > 0) {
+            kill(child.pid, SIGKILL);
+            waitpid(child.pid, nullptr, 0);
+        }
+        if (child.shared_mapping) {
+            munmap(child.shared_mapping, child.size);
+        }
+    }
+
+    // Each reader copies the whole target buffer into a chunk-sized local buffer, one chunk at a time.
+    read_stats read_vm_single(const target_child& child, size_t chunk_size, uint8_t* buffer) {
+        read_stats stats;
+        for (size_t offset = 0; offset < child.size; offset += chunk_size) {
+            size_t length = std::min(chunk_size, child.size - offset);
+            iovec local = { buffer, length };
+            iovec remote = { reinterpret_cast<void*>(child.private_address + offset), length };
+            ssize_t result = process_vm_readv(child.pid, &local, 1, &remote, 1, 0);
+            stats.syscalls++;
+            if (result < 0) {
+                stats.failures++;
+                continue;
+            }
+            stats.bytes += static_cast<uint64_t>(result);
+        }
+        return stats;
+    }
+
+    read_stats read_vm_pages(const target_child& child, size_t chunk_size, uint8_t* buffer) {
+        read_stats stats;
+        std::vector<iovec> remote;
+        remote.reserve(IOV_MAX);
+        for (size_t offset = 0; offset < child.size; offset += chunk_size) {
+            size_t length = std::min(chunk_size, child.size - offset);
+            size_t page = 0;
+            while (page < length) {
+                remote.clear();
+                size_t batch_start = page;
+                while (page < length && remote.size() < IOV_MAX) {
+                    size_t page_length = std::min(PAGE_SIZE_BYTES, length - page);
+                    remote.push_back({ reinterpret_cast<void*>(child.private_address + offset + page), page_length });
+                    page += page_length;
+                }
+                iovec local = { buffer + batch_start, page - batch_start };
+                ssize_t result = process_vm_readv(child.pid, &local, 1, remote.data(), remote.size(), 0);
+                stats.syscalls++;
+                if (result < 0) {
+                    stats.failures++;
+                    continue;
+                }
+                stats.bytes += static_cast<uint64_t>(result);
+            }
+        }
+        return stats;
+    }
+
+    read_stats read_proc_mem(int mem_fd, const target_child& child, size_t chunk_size, uint8_t* buffer) {
+        read_stats stats;
+        for (size_t offset = 0; offset < child.size; offset += chunk_size) {
+            size_t length = std::min(chunk_size, child.size - offset);
+            ssize_t result = pread(mem_fd, buffer, length, static_cast<off_t>(child.private_address + offset));
+            stats.syscalls++;
+            if (result < 0) {
+                stats.failures++;
+                continue;
+            }
+            stats.bytes += static_cast<uint64_t>(result);
+        }
+        return stats;
+    }
+
+    read_stats cooperative_shm_upper_bound(const target_child& child, size_t chunk_size, uint8_t* buffer) {
+        read_stats stats;
+        for (size_t offset = 0; offset < child.size; offset += chunk_size) {
+            size_t length = std::min(chunk_size, child.size - offset);
+            memcpy(buffer, child.shared_mapping + offset, length);
+            stats.bytes += length;
+        }
+        return stats;
+    }
+
+    template<typename Reader>
+    void run_method(const bench_config& config, const char* method, size_t chunk_size, Reader&& reader) {
+        double best_seconds = 0.0;
+        read_stats best;
+        for (int r = 0; r < config.repeat; r++) {
+            auto start = std::chrono::steady_clock::now();
+            read_stats stats = reader();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (r == 0 || seconds < best_seconds) {
+                best_seconds = seconds;
+                best = stats;
+            }
+        }
+        double gb_per_second = best_seconds > 0.0 ? best.bytes / best_seconds / 1e9 : 0.0;
+        double syscalls_per_second = best_seconds > 0.0 ? best.syscalls / best_seconds : 0.0;
+        printf("%s,%zu,%llu,%llu,%llu,%.6f,%.3f,%.0f\n", method, chunk_size,
+               static_cast<unsigned long long>(best.bytes), static_cast<unsigned long long>(best.syscalls),
+               static_cast<unsigned long long>(best.failures), best_seconds, gb_per_second, syscalls_per_second);
+        fflush(stdout);
+    }
+
+    bool parse_args(int argc, char** argv, bench_config& config) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--size" && i + 1 < argc) {
+                config.size = static_cast<size_t>(std::max(1, atoi(argv[++i]))) << 20;
+            }
+            else if (arg == "--repeat" && i + 1 < argc) {
+                config.repeat = std::max(1, atoi(argv[++i]));
+            }
+            else {
+                fprintf(stderr, "Usage: read_bench [--size MB] [--repeat N]\n");
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    bench_config config;
+    if (!parse_args(argc, argv, config)) {
+        return 1;
+    }
+
+    target_child child;
+    if (!spawn_child(config.size, child)) {
+        return 1;
+    }
+
+    std::string mem_path = "/proc/" + std::to_string(child.pid) + "/mem";
+    int mem_fd = open(mem_path.c_str(), O_RDONLY);
+    if (mem_fd < 0) {
+        perror("open /proc/<pid>/mem");
+    }
+
+    const size_t max_chunk = 16u << 20;
+    std::vector<uint8_t> buffer(max_chunk);
+    // Touch the destination once so the first method does not pay for page faults.
+    memset(buffer.data(), 0, buffer.size());
+
+    printf("method,chunk_bytes,bytes,syscalls,failures,seconds,gb_per_s,syscalls_per_s\n");
+
+    run_method(config, "scanner_baseline", SCANNER_CHUNK_SIZE, [&] () {
+        return read_vm_single(child, SCANNER_CHUNK_SIZE, buffer.data());
+    });
+
+    for (size_t chunk_size = 4096; chunk_size <= max_chunk; chunk_size *= 4) {
+        run_method(config, "vm_readv_single", chunk_size, [&] () {
+            return read_vm_single(child, chunk_size, buffer.data());
+        });
+        run_method(config, "vm_readv_pages", chunk_size, [&] () {
+            return read_vm_pages(child, chunk_size, buffer.data());
+        });
+        if (mem_fd >= 0) {
+            run_method(config, "proc_mem_pread", chunk_size, [&] () {
+                return read_proc_mem(mem_fd, child, chunk_size, buffer.data());
+            });
+        }
+        run_method(config, "cooperative_shm_upper_bound", chunk_size, [&] () {
+            return cooperative_shm_upper_bound(child, chunk_size, buffer.data());
+        });
+    }
+
+    if (mem_fd >= 0) {
+        close(mem_fd);
+    }
+    stop_child(child);
+    return 0;
+}
+#endif // !__linux__
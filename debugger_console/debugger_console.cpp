@@ -0,0 +1,229 @@
+// Reference consumer for the CLI's debug log (CLI-Core/core/debugger/output_pipe).
+// The CLI creates the log endpoint and starts this program with it:
+//
+//   debugger_console <pipe|uds|shm> <endpoint> [--quiet] [--latency]
+//
+//   --quiet     do not print messages (for benchmarks)
+//   --latency   time "latency probe <steady_clock ns>" messages (see benchmarks/log_bench)
+//               and print percentiles on exit
+//
+// Linux:   g++ -O2 -std=c++14 -pthread -I../CLI-Core/core/debugger/output_pipe debugger_console.cpp
+//              ../CLI-Core/core/debugger/output_pipe/log_format.cpp
+//              ../CLI-Core/core/debugger/output_pipe/log_transport.cpp -o debugger_console
+// Windows: build debugger_console.vcxproj from CLI-Core.sln (lands next to CLI-Core.exe)
+#include "output_pipe.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+#ifdef ERROR
+#undef ERROR
+#endif // ERROR
+
+namespace {
+    const char LATENCY_PROBE[] = "latency probe ";
+
+    struct console_options
+    {
+        debug::TransportKind kind;
+        std::string endpoint;
+        bool quiet = false;
+        bool latency = false;
+    };
+
+    struct console_state
+    {
+        bool binary = false;
+        bool exit = false;
+        uint64_t frames = 0;
+        uint64_t messages = 0;
+        uint64_t bytes = 0;
+        std::vector<uint64_t> latencies_ns;
+        debug::LogDecoder decoder;
+        bool color = false;
+    };
+
+    uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    debug::MessageType type_from_prefix(const std::string& line) {
+        if (line.compare(0, 7, "ERROR: ") == 0) return debug::MessageType::ERROR;
+        if (line.compare(0, 9, "WARNING: ") == 0) return debug::MessageType::WARNING;
+        if (line.compare(0, 9, "SUCCESS: ") == 0) return debug::MessageType::SUCCESS;
+        return debug::MessageType::INFO;
+    }
+
+    const char* prefix_for(debug::MessageType type) {
+        switch (type) {
+        case debug::MessageType::ERROR: return "ERROR: ";
+        case debug::MessageType::WARNING: return "WARNING: ";
+        case debug::MessageType::SUCCESS: return "SUCCESS: ";
+        default: return "";
+        }
+    }
+
+    void print_line(const console_state& state, debug::MessageType type, const std::string& line) {
+#ifdef _WIN32
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        WORD color = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE;
+        if (type == debug::MessageType::ERROR) color = FOREGROUND_RED | FOREGROUND_INTENSITY;
+        if (type == debug::MessageType::WARNING) color = FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_INTENSITY;
+        if (type == debug::MessageType::SUCCESS) color = FOREGROUND_GREEN | FOREGROUND_INTENSITY;
+        SetConsoleTextAttribute(console, color);
+        fwrite(line.data(), 1, line.size(), stdout);
+        fputc('\n', stdout);
+        SetConsoleTextAttribute(console, FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE);
+#else
+        const char* color = nullptr;
+        if (state.color) {
+            if (type == debug::MessageType::ERROR) color = "\x1b[91m";
+            if (type == debug::MessageType::WARNING) color = "\x1b[93m";
+            if (type == debug::MessageType::SUCCESS) color = "\x1b[92m";
+        }
+        if (color) {
+            fputs(color, stdout);
+        }
+        fwrite(line.data(), 1, line.size(), stdout);
+        fputs(color ? "\x1b[0m\n" : "\n", stdout);
+#endif
+    }
+
+    // line is the message as the CLI produced it, prefix included.
+    void handle_message(const console_options& options, console_state& state, debug::MessageType type, const std::string& line) {
+        state.messages++;
+        if (line == "EXIT_DEBUGGER") {
+            state.exit = true;
+            return;
+        }
+        if (options.latency && line.compare(0, sizeof(LATENCY_PROBE) - 1, LATENCY_PROBE) == 0) {
+            uint64_t sent = strtoull(line.c_str() + sizeof(LATENCY_PROBE) - 1, nullptr, 10);
+            uint64_t now = now_ns();
+            state.latencies_ns.push_back(now > sent ? now - sent : 0);
+        }
+        if (!options.quiet) {
+            print_line(state, type, line);
+        }
+    }
+
+    bool handle_frame(const console_options& options, console_state& state, const std::vector<char>& frame) {
+        state.frames++;
+        state.bytes += frame.size();
+
+        if (state.frames == 1 && frame.size() == sizeof(debug::LOG_BINARY_HANDSHAKE) &&
+            memcmp(frame.data(), debug::LOG_BINARY_HANDSHAKE, frame.size()) == 0) {
+            state.binary = true;
+            return true;
+        }
+
+        if (state.binary) {
+            return state.decoder.decode(reinterpret_cast<const uint8_t*>(frame.data()), frame.size(),
+                [&] (uint8_t type, const std::string& text) {
+                    debug::MessageType message_type = static_cast<debug::MessageType>(type);
+                    handle_message(options, state, message_type, text == "EXIT_DEBUGGER" ? text : prefix_for(message_type) + text);
+                });
+        }
+
+        size_t start = 0;
+        while (start < frame.size()) {
+            const char* begin = frame.data() + start;
+            size_t length = strnlen(begin, frame.size() - start);
+            std::string line(begin, length);
+            handle_message(options, state, type_from_prefix(line), line);
+            start += length + 1;
+        }
+        return true;
+    }
+
+    void print_report(const console_options& options, console_state& state) {
+        printf("console: transport=%s mode=%s frames=%llu messages=%llu bytes=%llu messages_per_frame=%.2f\n",
+               debug::transport_kind_name(options.kind), state.binary ? "binary" : "text",
+               static_cast<unsigned long long>(state.frames), static_cast<unsigned long long>(state.messages),
+               static_cast<unsigned long long>(state.bytes),
+               state.frames ? static_cast<double>(state.messages) / state.frames : 0.0);
+        if (!options.latency || state.latencies_ns.empty()) {
+            return;
+        }
+        std::vector<uint64_t>& values = state.latencies_ns;
+        std::sort(values.begin(), values.end());
+        auto percentile = [&] (double p) {
+            size_t index = static_cast<size_t>(p * (values.size() - 1));
+            return values[index] / 1000.0;
+        };
+        printf("console: latency_us probes=%zu p50=%.1f p90=%.1f p99=%.1f p999=%.1f max=%.1f\n",
+               values.size(), percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999), values.back() / 1000.0);
+    }
+
+    bool parse_args(int argc, char** argv, console_options& options) {
+        if (argc < 3 || !debug::parse_transport_kind(argv[1], options.kind)) {
+            return false;
+        }
+        options.endpoint = argv[2];
+        for (int i = 3; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--quiet") {
+                options.quiet = true;
+            }
+            else if (arg == "--latency") {
+                options.latency = true;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv) {
+    console_options options;
+    if (!parse_args(argc, argv, options)) {
+        fprintf(stderr, "Usage: debugger_console <pipe|uds|shm> <endpoint> [--quiet] [--latency]\n");
+        return 1;
+    }
+
+    std::unique_ptr<debug::LogSource> source = debug::create_source(options.kind);
+    if (!source) {
+        fprintf(stderr, "debugger_console: %s transport is not available on this platform\n", debug::transport_kind_name(options.kind));
+        return 1;
+    }
+    if (!source->connect(options.endpoint, debug::LOG_CREDIT_WINDOW)) {
+        fprintf(stderr, "debugger_console: could not attach to %s\n", options.endpoint.c_str());
+        return 1;
+    }
+
+    console_state state;
+#ifdef _WIN32
+    SetConsoleTitleA("Debugger");
+#else
+    state.color = isatty(fileno(stdout)) != 0;
+#endif
+    if (options.latency) {
+        state.latencies_ns.reserve(1 << 20);
+    }
+
+    std::vector<char> frame;
+    frame.reserve(debug::LOG_MAX_FRAME_SIZE);
+    while (!state.exit && source->read(frame)) {
+        if (!handle_frame(options, state, frame)) {
+            fprintf(stderr, "debugger_console: malformed frame\n");
+            break;
+        }
+        if (!options.quiet) {
+            fflush(stdout);
+        }
+    }
+
+    source->close();
+    if (options.quiet || options.latency) {
+        print_report(options, state);
+    }
+    return 0;
+}